@@ -0,0 +1,122 @@
+#include "execution/basic_operators.h"
+#include "execution/hash_aggregate.h"
+#include "execution/table_scan.h"
+#include "storage/bulk_loader.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <unordered_map>
+
+// Runs
+//   SELECT g, COUNT(*), SUM(v) FROM t WHERE v < 500 GROUP BY g
+// over a bulk-loaded table, once tuple at a time through DataTable::Scan and
+// once as a vectorized pipeline, serially and on a scheduler.
+//
+//   execution_benchmark [num_rows] [num_groups] [num_workers]
+namespace noisepage {
+namespace {
+double Seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+void Report(const char *name, uint32_t num_rows, double seconds,
+            int64_t checksum) {
+  printf("%-10s %8.3f s %8.1f M rows/s  (checksum %ld)\n", name, seconds,
+         num_rows / seconds / 1e6, static_cast<long>(checksum));
+}
+
+// 把结果加起来，保证各个版本算的是一样的东西
+int64_t Checksum(const execution::ResultCollector &result) {
+  int64_t checksum = 0;
+  const execution::RowBuffer *rows = result.Rows();
+  for (uint64_t row = 0; rows != nullptr && row < rows->NumRows(); row++) {
+    checksum += rows->ReadInteger(0, row) * rows->ReadInteger(1, row) +
+                rows->ReadInteger(2, row);
+  }
+  return checksum;
+}
+
+void Run(uint32_t num_rows, uint32_t num_groups, uint32_t num_workers) {
+  storage::BlockLayout layout(3, {8, 8, 8});
+  storage::BlockStore block_store(0);
+  storage::DataTable table(block_store, layout);
+  std::default_random_engine generator;
+  std::vector<int64_t> groups(num_rows), values(num_rows);
+  for (uint32_t i = 0; i < num_rows; i++) {
+    groups[i] = static_cast<int64_t>(generator() % num_groups);
+    values[i] = static_cast<int64_t>(generator() % 1000);
+  }
+  storage::BulkLoader::BulkLoad(
+      &table,
+      {{1, reinterpret_cast<const byte *>(groups.data())},
+       {2, reinterpret_cast<const byte *>(values.data())}},
+      num_rows);
+  std::vector<storage::ColumnPredicate> predicates{
+      {2, storage::PredicateType::LESS, 500}};
+  printf("%u rows, %u groups\n", num_rows, num_groups);
+
+  {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<uint16_t> col_ids{1, 2};
+    std::vector<byte> buffer(storage::ProjectedRow::Size(layout, col_ids));
+    auto *row = storage::ProjectedRow::InitializeProjectedRow(buffer.data(),
+                                                              layout, col_ids);
+    std::unordered_map<int64_t, std::pair<int64_t, int64_t>> aggregates;
+    table.Scan(0, predicates, row,
+               [&](const storage::TupleSlot &, const storage::ProjectedRow &r) {
+                 auto group = *reinterpret_cast<const int64_t *>(
+                     r.AccessWithNullCheck(0));
+                 auto &aggregate = aggregates[group];
+                 aggregate.first++;
+                 aggregate.second += *reinterpret_cast<const int64_t *>(
+                     r.AccessWithNullCheck(1));
+               });
+    int64_t checksum = 0;
+    for (const auto &entry : aggregates) {
+      checksum += entry.first * entry.second.first + entry.second.second;
+    }
+    Report("tuple", num_rows, Seconds(start), checksum);
+  }
+
+  auto run_pipeline = [&](Scheduler *scheduler) {
+    execution::ResultCollector result;
+    execution::HashAggregate aggregate(
+        {0},
+        {{execution::AggregateType::COUNT_STAR, 0},
+         {execution::AggregateType::SUM, 1}},
+        &result);
+    execution::TableScan scan(&table, 0, {1, 2}, predicates, &aggregate);
+    if (scheduler == nullptr) {
+      scan.Run();
+    } else {
+      scan.Run(scheduler);
+    }
+    return Checksum(result);
+  };
+  {
+    auto start = std::chrono::steady_clock::now();
+    int64_t checksum = run_pipeline(nullptr);
+    Report("vectorized", num_rows, Seconds(start), checksum);
+  }
+  {
+    Scheduler scheduler(num_workers);
+    auto start = std::chrono::steady_clock::now();
+    int64_t checksum = run_pipeline(&scheduler);
+    Report("parallel", num_rows, Seconds(start), checksum);
+  }
+}
+} // namespace
+} // namespace noisepage
+
+int main(int argc, char **argv) {
+  uint32_t num_rows = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000000;
+  uint32_t num_groups = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1000;
+  uint32_t num_workers = argc > 3 ? std::strtoul(argv[3], nullptr, 10)
+                                  : std::thread::hardware_concurrency();
+  noisepage::Run(num_rows, num_groups, num_workers);
+  return 0;
+}
@@ -0,0 +1,128 @@
+#include "storage/bulk_loader.h"
+#include "storage/data_table.h"
+#include "storage/storage_util.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <thread>
+
+// Loads the same rows into a DataTable through Insert, BulkLoad and
+// ParallelBulkLoad, and compares the load rate with a plain memcpy of the
+// input. Insert only loads a prefix of the rows since it is orders of
+// magnitude slower.
+//
+//   bulk_load_benchmark [num_rows] [num_cols] [num_inserted_rows]
+//                       [num_threads]
+namespace noisepage {
+namespace {
+double Seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+void Report(const char *name, uint32_t num_rows, uint64_t num_bytes,
+            double seconds) {
+  printf("%-8s %8.3f s %12.0f rows/s %8.2f GB/s\n", name, seconds,
+         num_rows / seconds, static_cast<double>(num_bytes) / seconds / 1e9);
+}
+
+void Run(uint32_t num_rows, uint16_t num_cols, uint32_t num_inserted_rows,
+         uint32_t num_threads) {
+  std::vector<uint16_t> attr_sizes(num_cols + 1, 8);
+  storage::BlockLayout layout(static_cast<uint16_t>(num_cols + 1), attr_sizes);
+  std::default_random_engine generator;
+  std::vector<std::vector<int64_t>> values(num_cols);
+  std::vector<storage::BulkLoadColumn> columns;
+  for (uint16_t i = 0; i < num_cols; i++) {
+    values[i].resize(num_rows);
+    for (auto &value : values[i]) {
+      value = static_cast<int64_t>(generator());
+    }
+    columns.push_back({static_cast<uint16_t>(i + 1),
+                       reinterpret_cast<const byte *>(values[i].data())});
+  }
+  uint64_t num_bytes = static_cast<uint64_t>(num_rows) * num_cols * 8;
+  printf("%u rows, %u 8-byte columns, %.2f GB\n", num_rows, num_cols,
+         static_cast<double>(num_bytes) / 1e9);
+
+  {
+    // 和bulk load一样，目标内存的page fault也算在里面
+    auto start = std::chrono::steady_clock::now();
+    std::unique_ptr<int64_t[]> copy(
+        new int64_t[static_cast<uint64_t>(num_rows) * num_cols]);
+    for (uint16_t i = 0; i < num_cols; i++) {
+      std::memcpy(copy.get() + static_cast<uint64_t>(i) * num_rows,
+                  values[i].data(), static_cast<uint64_t>(num_rows) * 8);
+    }
+    Report("memcpy", num_rows, num_bytes, Seconds(start));
+  }
+
+  {
+    storage::BlockStore block_store(0);
+    storage::DataTable table(block_store, layout);
+    auto start = std::chrono::steady_clock::now();
+    storage::BulkLoader::BulkLoad(&table, columns, num_rows);
+    Report("bulk", num_rows, num_bytes, Seconds(start));
+  }
+
+  {
+    storage::BlockStore block_store(0);
+    storage::DataTable table(block_store, layout);
+    auto start = std::chrono::steady_clock::now();
+    storage::BulkLoader::ParallelBulkLoad(&table, columns, num_rows,
+                                          num_threads);
+    char name[32];
+    snprintf(name, sizeof(name), "bulk x%u", num_threads);
+    Report(name, num_rows, num_bytes, Seconds(start));
+  }
+
+  {
+    storage::BlockStore block_store(0);
+    storage::DataTable table(block_store, layout);
+    std::vector<uint16_t> col_ids;
+    for (uint16_t col_id = 1; col_id <= num_cols; col_id++) {
+      col_ids.push_back(col_id);
+    }
+    std::vector<byte> redo_buffer(storage::ProjectedRow::Size(layout, col_ids));
+    auto *redo = storage::ProjectedRow::InitializeProjectedRow(
+        redo_buffer.data(), layout, col_ids);
+    num_inserted_rows = std::min(num_inserted_rows, num_rows);
+    // 每一行的undo record都要一直留着，和真实的insert一样
+    uint32_t undo_size = storage::DeltaRecord::Size(layout, col_ids);
+    std::vector<byte> undo_buffers(static_cast<uint64_t>(num_inserted_rows) *
+                                   undo_size);
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t row = 0; row < num_inserted_rows; row++) {
+      for (uint16_t i = 0; i < num_cols; i++) {
+        storage::StorageUtil::WriteBytes(
+            8, static_cast<uint64_t>(values[i][row]),
+            redo->AccessForceNotNull(i));
+      }
+      auto *undo = storage::DeltaRecord::InitializeDeltaRecord(
+          undo_buffers.data() + static_cast<uint64_t>(row) * undo_size, 0,
+          layout, col_ids);
+      table.Insert(*redo, undo);
+    }
+    Report("insert", num_inserted_rows,
+           num_bytes / num_rows * num_inserted_rows, Seconds(start));
+  }
+}
+} // namespace
+} // namespace noisepage
+
+int main(int argc, char **argv) {
+  uint32_t num_rows = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000000;
+  auto num_cols = static_cast<uint16_t>(
+      argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 4);
+  uint32_t num_inserted_rows =
+      argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 100000;
+  uint32_t num_threads = argc > 4 ? std::strtoul(argv[4], nullptr, 10)
+                                  : std::thread::hardware_concurrency();
+  noisepage::Run(num_rows, num_cols, num_inserted_rows,
+                 std::max(num_threads, 1u));
+  return 0;
+}
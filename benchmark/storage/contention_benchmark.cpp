@@ -0,0 +1,144 @@
+#include "storage/bulk_loader.h"
+#include "storage/contention_manager.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Single-row update transactions on rows picked with Zipfian skew theta:
+// update, do a little work while holding the row, commit, release. Compares
+// callers that retry a failed Update at once (spin) with ContentionManager's
+// BACKOFF and WAIT policies, in committed transactions per second; aborted
+// transactions are retried as new ones.
+//
+//   contention_benchmark [num_threads] [theta] [num_rows] [txns_per_thread]
+namespace noisepage {
+namespace {
+// 预先算好CDF，二分查找
+class Zipf {
+public:
+  Zipf(uint32_t n, double theta) : cdf_(n) {
+    double sum = 0;
+    for (uint32_t i = 0; i < n; i++) {
+      sum += 1.0 / std::pow(i + 1, theta);
+      cdf_[i] = sum;
+    }
+    for (auto &value : cdf_) {
+      value /= sum;
+    }
+  }
+
+  template <typename Generator> uint32_t operator()(Generator &generator) {
+    double u = std::uniform_real_distribution<double>(0, 1)(generator);
+    auto it = std::lower_bound(cdf_.begin(), cdf_.end(), u);
+    return static_cast<uint32_t>(
+        std::min<ptrdiff_t>(it - cdf_.begin(), cdf_.size() - 1));
+  }
+
+private:
+  std::vector<double> cdf_;
+};
+
+void Work() {
+  volatile uint64_t x = 0;
+  for (uint32_t i = 0; i < 200; i++) {
+    x = x + i;
+  }
+}
+
+// policy为空表示调用者自己原地重试
+double Run(const storage::ContentionOptions *options, uint32_t num_threads,
+           double theta, uint32_t num_rows, uint32_t num_txns,
+           storage::ContentionStats *stats) {
+  storage::BlockStore block_store(0);
+  storage::BlockLayout layout(2, {8, 8});
+  storage::DataTable table(block_store, layout);
+  std::vector<int64_t> values(num_rows, 0);
+  std::vector<storage::TupleSlot> slots;
+  storage::BulkLoader::BulkLoad(
+      &table, {{1, reinterpret_cast<const byte *>(values.data())}}, num_rows,
+      &slots);
+  storage::ContentionManager manager(
+      &table, options == nullptr ? storage::ContentionOptions{} : *options);
+  storage::ProjectedRowInitializer initializer(layout, {1});
+  Zipf zipf(num_rows, theta);
+  std::atomic<timestamp_t> commit_timestamp{1};
+  uint32_t undo_size = storage::DeltaRecord::Size(initializer);
+  // 没有GC，undo record要一直留到所有线程结束
+  std::vector<std::unique_ptr<byte[]>> undo_buffers(num_threads);
+  for (auto &buffers : undo_buffers) {
+    buffers.reset(new byte[uint64_t(undo_size) * num_txns]);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (uint32_t id = 0; id < num_threads; id++) {
+    threads.emplace_back([&, id] {
+      std::default_random_engine generator(id);
+      std::vector<byte> buffer(initializer.ProjectedRowSize());
+      auto *row = initializer.InitializeRow(buffer.data());
+      uint64_t txn_id = uint64_t(id) << 32;
+      for (uint32_t i = 0; i < num_txns; i++) {
+        const storage::TupleSlot &slot = slots[zipf(generator)];
+        *reinterpret_cast<int64_t *>(row->AccessForceNotNull(0)) = i;
+        auto *undo = storage::DeltaRecord::InitializeDeltaRecord(
+            undo_buffers[id].get() + uint64_t(i) * undo_size,
+            timestamp_t(1) << 63 | txn_id++, initializer);
+        // 盲写，每次重试都拿最新的snapshot
+        while (options == nullptr
+                   ? !table.Update(slot, *row, undo)
+                   : !manager.Update(commit_timestamp.load() - 1, slot, *row,
+                                     undo)) {
+          undo->timestamp_ = timestamp_t(1) << 63 | txn_id++;
+        }
+        Work();
+        table.Commit(slot, undo, commit_timestamp++);
+        manager.Release(slot);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  *stats = manager.Stats();
+  return static_cast<double>(num_threads) * num_txns / seconds / 1e6;
+}
+} // namespace
+} // namespace noisepage
+
+int main(int argc, char **argv) {
+  using namespace noisepage;
+  uint32_t num_threads = argc > 1 ? std::strtoul(argv[1], nullptr, 10)
+                                  : std::thread::hardware_concurrency();
+  double theta = argc > 2 ? std::strtod(argv[2], nullptr) : 0.99;
+  uint32_t num_rows = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 1000;
+  uint32_t num_txns = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 200000;
+  printf("%u threads, theta %.2f, %u rows\n", num_threads, theta, num_rows);
+  printf("%-8s %10s %10s %10s %10s %10s\n", "policy", "M txns/s", "conflicts",
+         "retries", "waits", "aborts");
+  storage::ContentionOptions backoff;
+  backoff.policy_ = storage::ContentionPolicy::BACKOFF;
+  storage::ContentionOptions wait;
+  wait.policy_ = storage::ContentionPolicy::WAIT;
+  const std::pair<const char *, const storage::ContentionOptions *> runs[] = {
+      {"spin", nullptr}, {"backoff", &backoff}, {"wait", &wait}};
+  for (const auto &run : runs) {
+    storage::ContentionStats stats;
+    double throughput =
+        Run(run.second, num_threads, theta, num_rows, num_txns, &stats);
+    printf("%-8s %10.3f %10lu %10lu %10lu %10lu\n", run.first, throughput,
+           static_cast<unsigned long>(stats.conflicts_),
+           static_cast<unsigned long>(stats.retries_),
+           static_cast<unsigned long>(stats.waits_),
+           static_cast<unsigned long>(stats.aborts_));
+  }
+  return 0;
+}
@@ -0,0 +1,145 @@
+#include "storage/bulk_loader.h"
+#include "storage/partitioned_table.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Measures inserts per second at growing thread counts into one DataTable
+// and into a PartitionedTable hash-partitioned on the key with one
+// partition per thread, then the time of a range scan over a tenth of the
+// keys with and without range partitions to prune.
+//
+//   partitioned_benchmark [max_threads] [inserts_per_thread]
+namespace noisepage {
+namespace {
+storage::BlockLayout layout(3, {8, 8, 8});
+storage::ProjectedRowInitializer initializer(layout, {1, 2});
+
+// 每个线程自己的redo和undo，undo要活到表析构
+struct Inserter {
+  explicit Inserter(uint32_t num_inserts)
+      : redo_buffer_(new byte[initializer.ProjectedRowSize()]),
+        redo_(initializer.InitializeRow(redo_buffer_.get())),
+        undo_size_(storage::DeltaRecord::Size(initializer)),
+        undo_buffer_(new byte[static_cast<uint64_t>(undo_size_) *
+                              num_inserts]) {}
+
+  storage::ProjectedRow &Redo(int64_t key) {
+    *reinterpret_cast<int64_t *>(redo_->AccessForceNotNull(0)) = key;
+    *reinterpret_cast<int64_t *>(redo_->AccessForceNotNull(1)) = key;
+    return *redo_;
+  }
+
+  storage::DeltaRecord *Undo(uint32_t i) {
+    return storage::DeltaRecord::InitializeDeltaRecord(
+        undo_buffer_.get() + static_cast<uint64_t>(undo_size_) * i, 0,
+        initializer);
+  }
+
+  std::unique_ptr<byte[]> redo_buffer_;
+  storage::ProjectedRow *redo_;
+  uint32_t undo_size_;
+  std::unique_ptr<byte[]> undo_buffer_;
+};
+
+template <typename F>
+double Run(uint32_t num_threads, uint32_t num_inserts, const F &insert) {
+  std::vector<std::unique_ptr<Inserter>> inserters;
+  for (uint32_t i = 0; i < num_threads; i++) {
+    inserters.emplace_back(new Inserter(num_inserts));
+  }
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t < num_threads; t++) {
+    threads.emplace_back([&, t] {
+      for (uint32_t i = 0; i < num_inserts; i++) {
+        auto key = static_cast<int64_t>(i) * num_threads + t;
+        insert(inserters[t]->Redo(key), inserters[t]->Undo(i));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  return static_cast<double>(num_threads) * num_inserts / seconds / 1e6;
+}
+
+template <typename Table> double ScanMillis(Table *table, int64_t num_keys) {
+  std::vector<byte> buffer(initializer.ProjectedRowSize());
+  auto *row = initializer.InitializeRow(buffer.data());
+  std::vector<storage::ColumnPredicate> predicates{
+      {1, storage::PredicateType::BETWEEN, num_keys / 2,
+       num_keys / 2 + num_keys / 10}};
+  uint64_t matched = 0;
+  auto start = std::chrono::steady_clock::now();
+  table->Scan(0, predicates, row,
+              [&](const storage::TupleSlot &, const storage::ProjectedRow &) {
+                matched++;
+              });
+  double millis = std::chrono::duration<double, std::milli>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+  if (matched == 0) {
+    printf("scan found nothing\n");
+  }
+  return millis;
+}
+} // namespace
+} // namespace noisepage
+
+int main(int argc, char **argv) {
+  using namespace noisepage;
+  uint32_t max_threads = argc > 1 ? std::strtoul(argv[1], nullptr, 10)
+                                  : std::thread::hardware_concurrency();
+  uint32_t num_inserts = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 50000;
+  printf("%8s %14s %14s  (M inserts/s)\n", "threads", "one table",
+         "partitioned");
+  for (uint32_t num_threads = 1; num_threads <= max_threads;
+       num_threads *= 2) {
+    storage::BlockStore store(0);
+    storage::DataTable single(store, layout);
+    double one = Run(num_threads, num_inserts,
+                     [&](const storage::ProjectedRow &redo,
+                         storage::DeltaRecord *undo) {
+                       single.Insert(redo, undo);
+                     });
+    storage::PartitionedTable partitioned(
+        store, layout, storage::PartitionScheme::Hash(1, num_threads));
+    double many = Run(num_threads, num_inserts,
+                      [&](const storage::ProjectedRow &redo,
+                          storage::DeltaRecord *undo) {
+                        partitioned.Insert(redo, undo);
+                      });
+    printf("%8u %14.2f %14.2f\n", num_threads, one, many);
+  }
+
+  // 扫十分之一的key：zone map对插入顺序的key本来就能剪，打乱之后只有分区能剪
+  const uint32_t num_keys = 2000000;
+  std::vector<int64_t> keys(num_keys);
+  for (uint32_t i = 0; i < num_keys; i++) {
+    keys[i] = static_cast<int64_t>((i * 2654435761ULL) % num_keys);
+  }
+  storage::BlockStore store(0);
+  storage::DataTable single(store, layout);
+  storage::BulkLoader::BulkLoad(
+      &single, {{1, reinterpret_cast<const byte *>(keys.data())}}, num_keys);
+  std::vector<int64_t> splits;
+  for (uint32_t i = 1; i < 16; i++) {
+    splits.push_back(static_cast<int64_t>(num_keys) / 16 * i);
+  }
+  storage::PartitionedTable partitioned(
+      store, layout, storage::PartitionScheme::Range(1, splits));
+  partitioned.BulkLoad({{1, reinterpret_cast<const byte *>(keys.data())}},
+                       num_keys);
+  printf("range scan over shuffled keys: one table %.2f ms, 16 range "
+         "partitions %.2f ms\n",
+         ScanMillis(&single, num_keys), ScanMillis(&partitioned, num_keys));
+  return 0;
+}
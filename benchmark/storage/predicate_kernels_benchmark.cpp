@@ -0,0 +1,83 @@
+#include "storage/predicate_kernels.h"
+#include "storage/storage_util.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+// Compares the scalar and SIMD filter kernels on columns that fit in a block
+// (as a scan sees them) and on columns much larger than the caches.
+namespace noisepage {
+namespace {
+const char *LevelName(storage::SimdLevel level) {
+  switch (level) {
+  case storage::SimdLevel::AVX2:
+    return "avx2";
+  case storage::SimdLevel::SSE4:
+    return "sse4";
+  default:
+    return "scalar";
+  }
+}
+
+void RunOne(uint8_t attr_size, uint32_t num_slots, uint32_t repeat,
+            storage::SimdLevel level) {
+  std::default_random_engine generator;
+  std::uniform_int_distribution<int64_t> dist(0, 99);
+  std::vector<byte> column(static_cast<uint64_t>(num_slots) * attr_size);
+  for (uint32_t i = 0; i < num_slots; i++) {
+    storage::StorageUtil::WriteBytes(
+        attr_size, static_cast<uint64_t>(dist(generator)),
+        column.data() + static_cast<uint64_t>(i) * attr_size);
+  }
+  std::vector<uint8_t> nulls(BitmapSize(num_slots), 0xFF);
+  std::vector<uint8_t> selection(BitmapSize(num_slots));
+  auto *null_bitmap =
+      reinterpret_cast<const RawConcurrentBitmap *>(nulls.data());
+  // 大约10%的选择率
+  storage::ColumnPredicate predicate(1, storage::PredicateType::BETWEEN, 20,
+                                     29);
+
+  uint64_t selected = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < repeat; i++) {
+    storage::PredicateKernels::InitializeSelection(null_bitmap, num_slots,
+                                                   selection.data());
+    storage::PredicateKernels::Evaluate(predicate, column.data(), attr_size,
+                                        null_bitmap, num_slots,
+                                        selection.data(), level);
+    selected += selection[i % selection.size()];
+  }
+  auto end = std::chrono::steady_clock::now();
+  double seconds = std::chrono::duration<double>(end - start).count();
+  double bytes = static_cast<double>(column.size()) * repeat;
+  printf("%-6s size=%u slots=%-9u %8.2f GB/s %10.1f M values/s (%lu)\n",
+         LevelName(level), attr_size, num_slots, bytes / seconds / 1e9,
+         static_cast<double>(num_slots) * repeat / seconds / 1e6, selected);
+}
+} // namespace
+} // namespace noisepage
+
+int main() {
+  using noisepage::storage::SimdLevel;
+  auto best = noisepage::storage::PredicateKernels::DetectSimdLevel();
+  std::vector<SimdLevel> levels{SimdLevel::SCALAR};
+  if (best >= SimdLevel::SSE4) {
+    levels.push_back(SimdLevel::SSE4);
+  }
+  if (best >= SimdLevel::AVX2) {
+    levels.push_back(SimdLevel::AVX2);
+  }
+
+  for (uint8_t attr_size : {1, 2, 4, 8}) {
+    // 一个1MB block里一列大概的大小，在cache里
+    uint32_t in_cache_slots = 256 * 1024 / attr_size;
+    for (auto level : levels) {
+      noisepage::RunOne(attr_size, in_cache_slots, 2000, level);
+    }
+    uint32_t large_slots = (256u << 20) / attr_size;
+    for (auto level : levels) {
+      noisepage::RunOne(attr_size, large_slots, 4, level);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,122 @@
+#include "storage/bulk_loader.h"
+#include "storage/data_table.h"
+#include "storage/snapshot_file.h"
+#include "storage/storage_util.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <random>
+#include <unistd.h>
+
+// Exports a bulk-loaded table as a columnar snapshot and compares the rate
+// with writing the same number of bytes from one buffer, which is as fast as
+// the target can take them. Every hundredth row is updated after the
+// snapshot, so some tuples go through their version chain.
+//
+//   snapshot_export_benchmark [num_rows] [num_cols] [path]
+namespace noisepage {
+namespace {
+double Seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+void Report(const char *name, uint64_t num_bytes, double seconds) {
+  printf("%-8s %8.3f s %8.2f GB/s\n", name, seconds,
+         static_cast<double>(num_bytes) / seconds / 1e9);
+}
+
+int Open(const char *path) {
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    perror(path);
+    exit(1);
+  }
+  return fd;
+}
+
+void Run(uint32_t num_rows, uint16_t num_cols, const char *path) {
+  std::vector<uint16_t> attr_sizes(num_cols + 1, 8);
+  storage::BlockLayout layout(static_cast<uint16_t>(num_cols + 1), attr_sizes);
+  storage::BlockStore block_store(0);
+  storage::DataTable table(block_store, layout);
+  std::default_random_engine generator;
+  std::vector<uint16_t> col_ids;
+  std::vector<std::vector<int64_t>> values(num_cols,
+                                           std::vector<int64_t>(num_rows));
+  std::vector<storage::BulkLoadColumn> columns;
+  for (uint16_t i = 0; i < num_cols; i++) {
+    for (auto &value : values[i]) {
+      value = static_cast<int64_t>(generator());
+    }
+    col_ids.push_back(static_cast<uint16_t>(i + 1));
+    columns.push_back({static_cast<uint16_t>(i + 1),
+                       reinterpret_cast<const byte *>(values[i].data())});
+  }
+  std::vector<storage::TupleSlot> slots;
+  slots.reserve(num_rows);
+  storage::BulkLoader::BulkLoad(&table, columns, num_rows, &slots);
+
+  std::vector<uint16_t> update_col_ids{1};
+  std::vector<byte> redo_buffer(
+      storage::ProjectedRow::Size(layout, update_col_ids));
+  auto *redo = storage::ProjectedRow::InitializeProjectedRow(
+      redo_buffer.data(), layout, update_col_ids);
+  storage::StorageUtil::WriteBytes(8, 0, redo->AccessForceNotNull(0));
+  uint32_t undo_size = storage::DeltaRecord::Size(layout, update_col_ids);
+  std::vector<byte> undo_buffers(static_cast<uint64_t>(num_rows / 100 + 1) *
+                                 undo_size);
+  for (uint32_t row = 0; row < num_rows; row += 100) {
+    auto *undo = storage::DeltaRecord::InitializeDeltaRecord(
+        undo_buffers.data() + static_cast<uint64_t>(row / 100) * undo_size, 2,
+        layout, update_col_ids);
+    table.Update(slots[row], *redo, undo);
+  }
+
+  // 值加上每列的bitmap
+  uint64_t num_bytes = static_cast<uint64_t>(num_rows) * num_cols * 8 +
+                       static_cast<uint64_t>(BitmapSize(num_rows)) * num_cols;
+  printf("%u rows, %u 8-byte columns, %.2f GB to %s\n", num_rows, num_cols,
+         static_cast<double>(num_bytes) / 1e9, path);
+
+  {
+    std::vector<byte> buffer(storage::SnapshotWriter::DEFAULT_BUFFER_SIZE);
+    int fd = Open(path);
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t written = 0; written < num_bytes;) {
+      ssize_t n = write(fd, buffer.data(),
+                        std::min<uint64_t>(buffer.size(), num_bytes - written));
+      if (n < 0) {
+        perror("write");
+        exit(1);
+      }
+      written += static_cast<uint64_t>(n);
+    }
+    fsync(fd);
+    Report("write", num_bytes, Seconds(start));
+    close(fd);
+  }
+
+  {
+    int fd = Open(path);
+    auto start = std::chrono::steady_clock::now();
+    storage::ExportSnapshot(&table, 1, col_ids, fd);
+    fsync(fd);
+    Report("export", num_bytes, Seconds(start));
+    close(fd);
+  }
+}
+} // namespace
+} // namespace noisepage
+
+int main(int argc, char **argv) {
+  uint32_t num_rows = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000000;
+  auto num_cols = static_cast<uint16_t>(
+      argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 4);
+  const char *path = argc > 3 ? argv[3] : "snapshot.bin";
+  noisepage::Run(num_rows, num_cols, path);
+  return 0;
+}
@@ -0,0 +1,71 @@
+#include "storage/timestamp_manager.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// Measures empty transactions (take a read timestamp, commit) per second at
+// growing thread counts, once with one global counter that both timestamps
+// come from and once with TimestampManager, its epoch advanced every
+// millisecond.
+//
+//   timestamp_benchmark [max_threads] [txns_per_thread]
+namespace noisepage {
+namespace {
+// 防止编译器把时间戳优化掉
+std::atomic<timestamp_t> sink{0};
+
+template <typename F>
+double Run(uint32_t num_threads, uint32_t num_txns, const F &txn) {
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < num_threads; i++) {
+    threads.emplace_back([&] {
+      timestamp_t sum = 0;
+      for (uint32_t k = 0; k < num_txns; k++) {
+        sum += txn();
+      }
+      sink += sum;
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  return static_cast<double>(num_threads) * num_txns / seconds / 1e6;
+}
+} // namespace
+} // namespace noisepage
+
+int main(int argc, char **argv) {
+  using namespace noisepage;
+  uint32_t max_threads = argc > 1 ? std::strtoul(argv[1], nullptr, 10)
+                                  : std::thread::hardware_concurrency();
+  uint32_t num_txns = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1000000;
+  printf("%8s %14s %14s  (M txns/s)\n", "threads", "global", "epoch");
+  for (uint32_t num_threads = 1; num_threads <= max_threads;
+       num_threads *= 2) {
+    std::atomic<timestamp_t> counter{0};
+    double global = Run(num_threads, num_txns, [&] {
+      timestamp_t read = counter.fetch_add(1);
+      return read + counter.fetch_add(1);
+    });
+
+    Scheduler scheduler(1);
+    storage::TimestampManager manager(num_threads);
+    manager.StartEpochAdvancer(&scheduler, std::chrono::milliseconds(1));
+    double epoch = Run(num_threads, num_txns, [&] {
+      storage::TimestampManager::Transaction txn(&manager);
+      timestamp_t commit = txn.BeginCommit();
+      txn.EndCommit();
+      return txn.ReadTimestamp() + commit;
+    });
+    manager.StopEpochAdvancer();
+    printf("%8u %14.2f %14.2f\n", num_threads, global, epoch);
+  }
+  return 0;
+}
@@ -0,0 +1,581 @@
+#include "common/tracing.h"
+#include "storage/data_table.h"
+#include "storage/ssi_manager.h"
+#include "storage/storage_util.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+
+// YCSB-style workload driver running directly against DataTable. Every
+// operation is its own transaction: reads take a snapshot of a global clock,
+// writes install an uncommitted undo record and then commit it with the next
+// timestamp. An update that hits another thread's uncommitted version aborts.
+// With --isolation=serializable every transaction is also validated by an
+// SsiManager at commit, and refused updates are rolled back; comparing with
+// the default --isolation=snapshot gives the cost of SSI.
+//
+//   ycsb_benchmark --workload=A --threads=8 --records=100000 --ops=1000000
+//                  --fields=10 --field_size=8 --theta=0.99
+//                  [--read=0.5 --update=0.5 --insert=0 --scan=0 --rmw=0]
+//                  [--block_size=1048576] [--isolation=snapshot]
+//                  [--trace=trace.json]
+//
+// Built with -DNOISEPAGE_TRACING=ON it also prints where DataTable spent its
+// time, and --trace writes a Chrome trace of the run.
+namespace noisepage {
+namespace {
+enum class OpType : uint8_t { READ = 0, UPDATE, INSERT, SCAN, RMW, NUM_TYPES };
+const char *OP_NAMES[] = {"read", "update", "insert", "scan", "rmw"};
+constexpr uint16_t KEY_COL = 1;
+
+struct Config {
+  std::string workload_ = "A";
+  uint32_t threads_ = 4;
+  uint32_t records_ = 100000;
+  uint32_t ops_ = 1000000;
+  uint16_t fields_ = 10;
+  uint16_t field_size_ = 8;
+  double theta_ = 0.99;
+  uint32_t max_scan_length_ = 100;
+  uint32_t block_size_ = storage::BLOCK_SIZE;
+  std::string trace_path_;
+  bool serializable_ = false;
+  // 各种操作的比例，按顺序对应OpType
+  double mix_[static_cast<int>(OpType::NUM_TYPES)] = {0.5, 0.5, 0, 0, 0};
+  // D: 读最近插入的key
+  bool read_latest_ = false;
+};
+
+void SetMix(Config *config, double read, double update, double insert,
+            double scan, double rmw) {
+  double mix[] = {read, update, insert, scan, rmw};
+  std::copy(std::begin(mix), std::end(mix), config->mix_);
+}
+
+Config ParseArgs(int argc, char **argv) {
+  Config config;
+  std::map<std::string, std::string> args;
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    auto eq = arg.find('=');
+    if (arg.rfind("--", 0) != 0 || eq == std::string::npos) {
+      fprintf(stderr, "ignoring argument %s\n", argv[i]);
+      continue;
+    }
+    args[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+  }
+  if (args.count("trace")) {
+    config.trace_path_ = args["trace"];
+  }
+  if (args.count("isolation")) {
+    config.serializable_ = args["isolation"] == "serializable";
+  }
+  if (args.count("workload")) {
+    config.workload_ = args["workload"];
+  }
+  switch (config.workload_[0]) {
+  case 'A':
+    SetMix(&config, 0.5, 0.5, 0, 0, 0);
+    break;
+  case 'B':
+    SetMix(&config, 0.95, 0.05, 0, 0, 0);
+    break;
+  case 'C':
+    SetMix(&config, 1, 0, 0, 0, 0);
+    break;
+  case 'D':
+    SetMix(&config, 0.95, 0, 0.05, 0, 0);
+    config.read_latest_ = true;
+    break;
+  case 'E':
+    SetMix(&config, 0, 0, 0.05, 0.95, 0);
+    break;
+  case 'F':
+    SetMix(&config, 0.5, 0, 0, 0, 0.5);
+    break;
+  default:
+    fprintf(stderr, "unknown workload %s, using A\n", config.workload_.c_str());
+  }
+  auto number = [&](const char *name, auto *field) {
+    if (args.count(name)) {
+      *field = static_cast<std::remove_reference_t<decltype(*field)>>(
+          std::stod(args[name]));
+    }
+  };
+  number("threads", &config.threads_);
+  number("records", &config.records_);
+  number("ops", &config.ops_);
+  number("fields", &config.fields_);
+  number("field_size", &config.field_size_);
+  number("theta", &config.theta_);
+  number("max_scan_length", &config.max_scan_length_);
+  number("block_size", &config.block_size_);
+  for (int i = 0; i < static_cast<int>(OpType::NUM_TYPES); i++) {
+    number(OP_NAMES[i], &config.mix_[i]);
+  }
+  return config;
+}
+
+/**
+ * Zipfian distribution over [0, n) as in the YCSB paper (Gray et al.), with
+ * item 0 the most popular. n may grow, which is how "latest" reads follow
+ * inserts.
+ */
+class ZipfianGenerator {
+public:
+  ZipfianGenerator(uint64_t n, double theta)
+      : theta_(theta), alpha_(1.0 / (1.0 - theta)), zeta2_(Zeta(0, 2, 0)) {
+    Resize(n);
+  }
+
+  template <typename Random> uint64_t Next(Random &generator, uint64_t n) {
+    if (n != n_) {
+      Resize(n);
+    }
+    double u = std::uniform_real_distribution<double>(0, 1)(generator);
+    double uz = u * zetan_;
+    if (uz < 1.0) {
+      return 0;
+    }
+    if (uz < 1.0 + std::pow(0.5, theta_)) {
+      return 1;
+    }
+    auto result = static_cast<uint64_t>(
+        static_cast<double>(n_) * std::pow(eta_ * u - eta_ + 1, alpha_));
+    return std::min(result, n_ - 1);
+  }
+
+private:
+  double theta_, alpha_, zeta2_;
+  uint64_t n_ = 0;
+  double zetan_ = 0, eta_ = 0;
+
+  double Zeta(uint64_t from, uint64_t to, double initial) const {
+    double sum = initial;
+    for (uint64_t i = from; i < to; i++) {
+      sum += 1.0 / std::pow(static_cast<double>(i + 1), theta_);
+    }
+    return sum;
+  }
+
+  void Resize(uint64_t n) {
+    // n只会变大，zeta增量计算
+    zetan_ = n > n_ ? Zeta(n_, n, zetan_) : Zeta(0, n, 0);
+    n_ = n;
+    eta_ = (1 - std::pow(2.0 / static_cast<double>(n_), 1 - theta_)) /
+           (1 - zeta2_ / zetan_);
+  }
+};
+
+// 把热点打散到整个key空间，不然热的key都挤在最前面的几个block里
+uint64_t Scramble(uint64_t rank, uint64_t n) {
+  return (rank * 0x9E3779B97F4A7C15ull) % n;
+}
+
+struct ThreadResult {
+  std::vector<uint32_t> latencies_[static_cast<int>(OpType::NUM_TYPES)];
+  uint64_t aborts_ = 0;
+  uint64_t attempted_writes_ = 0;
+  // SSI拒绝提交的事务，包括只读的
+  uint64_t serialization_failures_ = 0;
+};
+
+class Driver {
+public:
+  explicit Driver(const Config &config)
+      : config_(config), layout_(MakeLayout(config)),
+        table_(block_store_, layout_),
+        all_columns_(layout_, AllColumns(layout_)),
+        slots_(config.records_ + config.ops_), active_(config.threads_) {
+    for (uint16_t i = 0; i < config_.fields_; i++) {
+      fields_.emplace_back(layout_,
+                           std::vector<uint16_t>{static_cast<uint16_t>(2 + i)});
+    }
+  }
+
+  ~Driver() {
+    for (auto *ptr : undo_buffers_) {
+      delete[] ptr;
+    }
+  }
+
+  void Load() {
+    std::default_random_engine generator(42);
+    std::vector<byte *> undos;
+    for (uint32_t key = 0; key < config_.records_; key++) {
+      InsertKey(key, generator, &undos);
+    }
+    next_key_ = config_.records_;
+    undo_buffers_.insert(undo_buffers_.end(), undos.begin(), undos.end());
+  }
+
+  std::vector<ThreadResult> Run(double *seconds) {
+    std::vector<ThreadResult> results(config_.threads_);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t id = 0; id < config_.threads_; id++) {
+      threads.emplace_back([this, id, &results] { Work(id, &results[id]); });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    *seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                             start)
+                   .count();
+    return results;
+  }
+
+  const storage::BlockLayout &Layout() const { return layout_; }
+
+private:
+  const Config config_;
+  storage::BlockStore block_store_{100};
+  storage::BlockLayout layout_;
+  storage::DataTable table_;
+  // projection都是固定的，row header提前算好
+  storage::ProjectedRowInitializer all_columns_;
+  std::vector<storage::ProjectedRowInitializer> fields_;
+  // key -> slot，插入完成之前是空的TupleSlot
+  std::vector<std::atomic<storage::TupleSlot>> slots_;
+  std::atomic<uint64_t> next_key_{0};
+  std::atomic<timestamp_t> clock_{1};
+  std::atomic<uint64_t> next_txn_id_{0};
+  std::mutex undo_latch_;
+  // version chain一直会引用undo record，table析构之后才能释放
+  std::vector<byte *> undo_buffers_;
+  storage::SsiManager ssi_;
+  // 每个线程当前事务的read timestamp，没有事务时是UINT64_MAX，给Prune用
+  struct alignas(64) ActiveSnapshot {
+    std::atomic<timestamp_t> read_timestamp_{UINT64_MAX};
+  };
+  std::vector<ActiveSnapshot> active_;
+
+  static storage::BlockLayout MakeLayout(const Config &config) {
+    std::vector<uint16_t> attr_sizes{8, 8};
+    attr_sizes.insert(attr_sizes.end(), config.fields_, config.field_size_);
+    return {static_cast<uint16_t>(attr_sizes.size()), attr_sizes,
+            config.block_size_};
+  }
+
+  static std::vector<uint16_t> AllColumns(const storage::BlockLayout &layout) {
+    std::vector<uint16_t> col_ids;
+    for (uint16_t col_id = 1; col_id < layout.num_cols_; col_id++) {
+      col_ids.push_back(col_id);
+    }
+    return col_ids;
+  }
+
+  timestamp_t NewTxnId() {
+    return (uint64_t(1) << 63) | next_txn_id_.fetch_add(1);
+  }
+
+  timestamp_t BeginSnapshot(uint32_t id) {
+    if (!config_.serializable_) {
+      return clock_.load();
+    }
+    // 先占住再读时钟：Prune要么看到0，要么看到的时钟不比这次读到的新
+    active_[id].read_timestamp_.store(0);
+    timestamp_t read_timestamp = clock_.load();
+    active_[id].read_timestamp_.store(read_timestamp);
+    return read_timestamp;
+  }
+
+  /**
+   * Commits txn, rolling its updates back if SSI refuses it. Inserts cannot
+   * be rolled back and are kept.
+   */
+  void Commit(uint32_t id, storage::SsiManager::Transaction *txn, bool writes,
+              ThreadResult *result) {
+    if (!config_.serializable_) {
+      if (writes) {
+        txn->CommitWrites(clock_.fetch_add(1));
+      }
+      return;
+    }
+    timestamp_t commit_timestamp = writes ? clock_.fetch_add(1) : clock_.load();
+    bool committed = ssi_.Commit(txn, commit_timestamp);
+    result->serialization_failures_ += !committed;
+    if (!committed) {
+      txn->Rollback();
+    }
+    txn->CommitWrites(commit_timestamp);
+    active_[id].read_timestamp_.store(UINT64_MAX);
+  }
+
+  void Prune() {
+    timestamp_t oldest = clock_.load();
+    for (auto &active : active_) {
+      oldest = std::min(oldest, active.read_timestamp_.load());
+    }
+    ssi_.Prune(oldest);
+  }
+
+  template <typename Random>
+  void InsertKey(uint64_t key, Random &generator, std::vector<byte *> *undos,
+                 uint32_t id = 0, ThreadResult *result = nullptr) {
+    std::vector<byte> redo_buffer(all_columns_.ProjectedRowSize());
+    auto *redo = all_columns_.InitializeRow(redo_buffer.data());
+    for (uint16_t i = 0; i < redo->NumColumns(); i++) {
+      if (redo->ColumnIds()[i] == KEY_COL) {
+        storage::StorageUtil::WriteBytes(8, key, redo->AccessForceNotNull(i));
+      } else {
+        FillField(redo->AccessForceNotNull(i), generator);
+      }
+    }
+    byte *undo_buffer = new byte[storage::DeltaRecord::Size(all_columns_)];
+    undos->push_back(undo_buffer);
+    auto *undo = storage::DeltaRecord::InitializeDeltaRecord(
+        undo_buffer, NewTxnId(), all_columns_);
+    if (result == nullptr) {
+      storage::TupleSlot slot = table_.Insert(*redo, undo);
+      table_.Commit(slot, undo, clock_.fetch_add(1));
+      slots_[key].store(slot);
+      return;
+    }
+    storage::SsiManager::Transaction txn(BeginSnapshot(id),
+                                         config_.serializable_);
+    storage::TupleSlot slot = txn.Insert(&table_, *redo, undo);
+    Commit(id, &txn, true, result);
+    slots_[key].store(slot);
+  }
+
+  template <typename Random> void FillField(byte *field, Random &generator) {
+    for (uint16_t j = 0; j < config_.field_size_; j++) {
+      field[j] = static_cast<byte>(generator());
+    }
+  }
+
+  template <typename Random>
+  bool UpdateKey(storage::SsiManager::Transaction *txn,
+                 const storage::TupleSlot &slot, Random &generator,
+                 std::vector<byte *> *undos, uint32_t id,
+                 ThreadResult *result) {
+    // 和YCSB一样每次只改一个field
+    const storage::ProjectedRowInitializer &field =
+        fields_[std::uniform_int_distribution<uint16_t>(
+            0, static_cast<uint16_t>(config_.fields_ - 1))(generator)];
+    std::vector<byte> redo_buffer(field.ProjectedRowSize());
+    auto *redo = field.InitializeRow(redo_buffer.data());
+    FillField(redo->AccessForceNotNull(0), generator);
+    byte *undo_buffer = new byte[storage::DeltaRecord::Size(field)];
+    auto *undo = storage::DeltaRecord::InitializeDeltaRecord(
+        undo_buffer, NewTxnId(), field);
+    if (!txn->Update(&table_, slot, *redo, undo)) {
+      delete[] undo_buffer;
+      active_[id].read_timestamp_.store(UINT64_MAX);
+      return false;
+    }
+    // 回滚之后reader可能还在读这个undo record，也要留着
+    undos->push_back(undo_buffer);
+    Commit(id, txn, true, result);
+    return true;
+  }
+
+  void Work(uint32_t id, ThreadResult *result) {
+    std::default_random_engine generator(id + 1);
+    ZipfianGenerator zipf(config_.records_, config_.theta_);
+    std::discrete_distribution<int> op_dist(std::begin(config_.mix_),
+                                            std::end(config_.mix_));
+    std::vector<byte> read_buffer(all_columns_.ProjectedRowSize());
+    auto *row = all_columns_.InitializeRow(read_buffer.data());
+    std::vector<byte *> undos;
+
+    auto choose_slot = [&] {
+      uint64_t n = next_key_.load();
+      for (;;) {
+        uint64_t rank = zipf.Next(generator, n);
+        uint64_t key = config_.read_latest_ ? n - 1 - rank : Scramble(rank, n);
+        storage::TupleSlot slot = slots_[key].load();
+        // 刚分到key的insert可能还没做完
+        if (slot != storage::TupleSlot()) {
+          return slot;
+        }
+      }
+    };
+
+    uint32_t num_ops = config_.ops_ / config_.threads_;
+    for (uint32_t i = 0; i < num_ops; i++) {
+      auto op = static_cast<OpType>(op_dist(generator));
+      auto start = std::chrono::steady_clock::now();
+      if (config_.serializable_ && i % 256 == 0) {
+        Prune();
+      }
+      switch (op) {
+      case OpType::READ: {
+        storage::SsiManager::Transaction txn(BeginSnapshot(id),
+                                             config_.serializable_);
+        txn.Select(&table_, choose_slot(), row);
+        Commit(id, &txn, false, result);
+        break;
+      }
+      case OpType::UPDATE: {
+        storage::SsiManager::Transaction txn(BeginSnapshot(id),
+                                             config_.serializable_);
+        result->attempted_writes_++;
+        result->aborts_ +=
+            !UpdateKey(&txn, choose_slot(), generator, &undos, id, result);
+        break;
+      }
+      case OpType::INSERT:
+        InsertKey(next_key_.fetch_add(1), generator, &undos, id, result);
+        break;
+      case OpType::SCAN: {
+        uint64_t n = next_key_.load();
+        auto lo = static_cast<int64_t>(Scramble(zipf.Next(generator, n), n));
+        auto length = std::uniform_int_distribution<int64_t>(
+            1, config_.max_scan_length_)(generator);
+        storage::SsiManager::Transaction txn(BeginSnapshot(id),
+                                             config_.serializable_);
+        txn.Scan(
+            &table_,
+            {{KEY_COL, storage::PredicateType::BETWEEN, lo, lo + length - 1}},
+            row, [](const storage::TupleSlot &, const storage::ProjectedRow &) {
+            });
+        Commit(id, &txn, false, result);
+        break;
+      }
+      case OpType::RMW: {
+        storage::SsiManager::Transaction txn(BeginSnapshot(id),
+                                             config_.serializable_);
+        storage::TupleSlot slot = choose_slot();
+        txn.Select(&table_, slot, row);
+        result->attempted_writes_++;
+        result->aborts_ +=
+            !UpdateKey(&txn, slot, generator, &undos, id, result);
+        break;
+      }
+      default:
+        break;
+      }
+      auto end = std::chrono::steady_clock::now();
+      result->latencies_[static_cast<int>(op)].push_back(
+          static_cast<uint32_t>(
+              std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+                  .count()));
+    }
+
+    std::lock_guard<std::mutex> lock(undo_latch_);
+    undo_buffers_.insert(undo_buffers_.end(), undos.begin(), undos.end());
+  }
+};
+
+double Percentile(const std::vector<uint32_t> &sorted, double p) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  auto index = static_cast<uint64_t>(p * static_cast<double>(sorted.size()));
+  return sorted[std::min<uint64_t>(index, sorted.size() - 1)] / 1000.0;
+}
+
+void Report(const Config &config, const std::vector<ThreadResult> &results,
+            double seconds) {
+  uint64_t total_ops = 0, aborts = 0, attempted_writes = 0;
+  std::vector<uint32_t> all;
+  printf("%-7s %10s %10s %10s %10s %10s\n", "op", "count", "ops/s", "p50(us)",
+         "p99(us)", "p999(us)");
+  for (int type = 0; type < static_cast<int>(OpType::NUM_TYPES); type++) {
+    std::vector<uint32_t> latencies;
+    for (const auto &result : results) {
+      latencies.insert(latencies.end(), result.latencies_[type].begin(),
+                       result.latencies_[type].end());
+    }
+    if (latencies.empty()) {
+      continue;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    printf("%-7s %10zu %10.0f %10.2f %10.2f %10.2f\n", OP_NAMES[type],
+           latencies.size(), static_cast<double>(latencies.size()) / seconds,
+           Percentile(latencies, 0.5), Percentile(latencies, 0.99),
+           Percentile(latencies, 0.999));
+    total_ops += latencies.size();
+    all.insert(all.end(), latencies.begin(), latencies.end());
+  }
+  uint64_t serialization_failures = 0;
+  for (const auto &result : results) {
+    aborts += result.aborts_;
+    attempted_writes += result.attempted_writes_;
+    serialization_failures += result.serialization_failures_;
+  }
+  std::sort(all.begin(), all.end());
+  printf("%-7s %10lu %10.0f %10.2f %10.2f %10.2f\n", "total", total_ops,
+         static_cast<double>(total_ops) / seconds, Percentile(all, 0.5),
+         Percentile(all, 0.99), Percentile(all, 0.999));
+  printf("workload %s, %u threads, %.2f s, abort rate %.4f%%\n",
+         config.workload_.c_str(), config.threads_, seconds,
+         attempted_writes == 0
+             ? 0.0
+             : 100.0 * static_cast<double>(aborts) /
+                   static_cast<double>(attempted_writes));
+  if (config.serializable_) {
+    printf("serializable, %lu transactions refused at commit (%.4f%%)\n",
+           serialization_failures,
+           total_ops == 0 ? 0.0
+                          : 100.0 *
+                                static_cast<double>(serialization_failures) /
+                                static_cast<double>(total_ops));
+  }
+}
+
+void ReportTracing(const Config &config) {
+  auto &tracer = Tracer::Get();
+  double cycles_per_us = tracer.CyclesPerMicrosecond();
+  bool header = false;
+  for (uint32_t i = 0; i < NUM_TRACE_POINTS; i++) {
+    auto point = static_cast<TracePoint>(i);
+    LatencyHistogram histogram = tracer.Histogram(point);
+    if (histogram.Count() == 0) {
+      continue;
+    }
+    if (!header) {
+      printf("%-17s %10s %10s %10s %10s\n", "phase", "count", "p50(us)",
+             "p99(us)", "p999(us)");
+      header = true;
+    }
+    printf("%-17s %10lu %10.2f %10.2f %10.2f\n", TracePointName(point),
+           histogram.Count(),
+           static_cast<double>(histogram.Percentile(0.5)) / cycles_per_us,
+           static_cast<double>(histogram.Percentile(0.99)) / cycles_per_us,
+           static_cast<double>(histogram.Percentile(0.999)) / cycles_per_us);
+  }
+  if (!config.trace_path_.empty()) {
+    std::ofstream out(config.trace_path_);
+    tracer.DumpChromeTrace(out);
+    printf("trace written to %s\n", config.trace_path_.c_str());
+  }
+}
+} // namespace
+} // namespace noisepage
+
+int main(int argc, char **argv) {
+  noisepage::Config config = noisepage::ParseArgs(argc, argv);
+  noisepage::Driver driver(config);
+  const auto &layout = driver.Layout();
+  printf("%u records of %u bytes, %u slots per %u byte block\n",
+         config.records_, layout.tuple_size_, layout.num_slots_,
+         layout.block_size_);
+
+  auto load_start = std::chrono::steady_clock::now();
+  driver.Load();
+  printf("loaded in %.2f s\n",
+         std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       load_start)
+             .count());
+
+  // 只看运行阶段
+  noisepage::Tracer::Get().Reset();
+  noisepage::Tracer::Get().EnableEvents(!config.trace_path_.empty());
+  double seconds;
+  auto results = driver.Run(&seconds);
+  noisepage::Tracer::Get().EnableEvents(false);
+  noisepage::Report(config, results, seconds);
+  noisepage::ReportTracing(config);
+  return 0;
+}
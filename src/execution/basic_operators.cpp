@@ -0,0 +1,86 @@
+#include "execution/basic_operators.h"
+#include <algorithm>
+#include <cassert>
+
+namespace noisepage::execution {
+namespace {
+// 不分支，留下的行号写回selection前面
+template <typename T>
+uint32_t FilterRange(const byte *column, const uint8_t *present,
+                     uint32_t *selection, uint32_t num_selected, int64_t lo,
+                     int64_t hi) {
+  const auto *values = reinterpret_cast<const T *>(column);
+  uint32_t num_kept = 0;
+  for (uint32_t k = 0; k < num_selected; k++) {
+    uint32_t row = selection[k];
+    auto value = static_cast<int64_t>(values[row]);
+    bool keep = (present[row / BYTE_SIZE] & ONE_HOT_MASK(row % BYTE_SIZE)) &&
+                lo <= value && value <= hi;
+    selection[num_kept] = row;
+    num_kept += keep;
+  }
+  return num_kept;
+}
+} // namespace
+
+void FilterSelection(const storage::ColumnPredicate &predicate, uint16_t col,
+                     ColumnBatch *batch) {
+  uint32_t *selection = batch->Selection();
+  uint32_t n = batch->NumSelected();
+  if (predicate.type_ == storage::PredicateType::IN) {
+    uint32_t num_kept = 0;
+    for (uint32_t k = 0; k < n; k++) {
+      uint32_t row = selection[k];
+      if (!batch->IsNull(col, row) &&
+          predicate.Evaluate(batch->ReadInteger(col, row))) {
+        selection[num_kept++] = row;
+      }
+    }
+    batch->SetNumSelected(num_kept);
+    return;
+  }
+
+  int64_t lo, hi;
+  if (!predicate.Bounds(&lo, &hi)) {
+    batch->SetNumSelected(0);
+    return;
+  }
+  const byte *values = batch->Values(col);
+  const uint8_t *present = batch->Present(col);
+  switch (batch->AttrSize(col)) {
+  case 1:
+    n = FilterRange<int8_t>(values, present, selection, n, lo, hi);
+    break;
+  case 2:
+    n = FilterRange<int16_t>(values, present, selection, n, lo, hi);
+    break;
+  case 4:
+    n = FilterRange<int32_t>(values, present, selection, n, lo, hi);
+    break;
+  case 8:
+    n = FilterRange<int64_t>(values, present, selection, n, lo, hi);
+    break;
+  default:
+    assert(false);
+  }
+  batch->SetNumSelected(n);
+}
+
+void Project::Consume(ColumnBatch *batch) {
+  std::unique_ptr<ColumnBatch> &output = outputs_.Local();
+  if (output == nullptr) {
+    std::vector<uint16_t> attr_sizes;
+    for (uint16_t col : columns_) {
+      attr_sizes.push_back(batch->AttrSize(col));
+    }
+    output = std::make_unique<ColumnBatch>(std::move(attr_sizes),
+                                           batch->Capacity());
+  }
+  uint32_t n = batch->NumSelected();
+  for (uint16_t i = 0; i < columns_.size(); i++) {
+    GatherColumn(*batch, columns_[i], batch->Selection(), n, output.get(), i);
+  }
+  output->Reset(n);
+  next_->Consume(output.get());
+}
+} // namespace noisepage::execution
@@ -0,0 +1,204 @@
+#include "execution/hash_aggregate.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace noisepage::execution {
+HashAggregate::GroupTable::GroupTable(uint16_t num_keys,
+                                      uint16_t num_aggregates)
+    : num_keys_(num_keys), num_aggregates_(num_aggregates), buckets_(64, 0) {}
+
+uint32_t HashAggregate::GroupTable::FindOrInsert(uint64_t hash,
+                                                 const int64_t *keys,
+                                                 uint64_t key_nulls) {
+  uint64_t mask = buckets_.size() - 1;
+  for (uint64_t pos = hash & mask;; pos = (pos + 1) & mask) {
+    uint32_t entry = buckets_[pos];
+    if (entry == 0) {
+      break;
+    }
+    uint32_t group = entry - 1;
+    if (hashes_[group] == hash && key_nulls_[group] == key_nulls &&
+        std::equal(keys, keys + num_keys_, Keys(group))) {
+      return group;
+    }
+  }
+
+  auto group = NumGroups();
+  hashes_.push_back(hash);
+  keys_.insert(keys_.end(), keys, keys + num_keys_);
+  key_nulls_.push_back(key_nulls);
+  values_.resize(values_.size() + num_aggregates_, 0);
+  counts_.resize(counts_.size() + num_aggregates_, 0);
+  // 装载率保持在1/2以下
+  if (2 * static_cast<uint64_t>(NumGroups()) > buckets_.size()) {
+    Grow();
+  } else {
+    uint64_t pos = hash & mask;
+    while (buckets_[pos] != 0) {
+      pos = (pos + 1) & mask;
+    }
+    buckets_[pos] = group + 1;
+  }
+  return group;
+}
+
+void HashAggregate::GroupTable::Grow() {
+  buckets_.assign(buckets_.size() * 2, 0);
+  uint64_t mask = buckets_.size() - 1;
+  for (uint32_t group = 0; group < NumGroups(); group++) {
+    uint64_t pos = hashes_[group] & mask;
+    while (buckets_[pos] != 0) {
+      pos = (pos + 1) & mask;
+    }
+    buckets_[pos] = group + 1;
+  }
+}
+
+void HashAggregate::GroupTable::Update(const AggregateSpec &spec,
+                                       uint32_t group, uint16_t agg,
+                                       int64_t value) {
+  int64_t &current = Value(group, agg);
+  uint64_t &count = Count(group, agg);
+  switch (spec.type_) {
+  case AggregateType::COUNT_STAR:
+  case AggregateType::COUNT:
+    break;
+  case AggregateType::SUM:
+    current += value;
+    break;
+  case AggregateType::MIN:
+    current = count == 0 ? value : std::min(current, value);
+    break;
+  case AggregateType::MAX:
+    current = count == 0 ? value : std::max(current, value);
+    break;
+  }
+  count++;
+}
+
+void HashAggregate::GroupTable::Merge(
+    const GroupTable &other, const std::vector<AggregateSpec> &aggregates) {
+  for (uint32_t group = 0; group < other.NumGroups(); group++) {
+    uint32_t into = FindOrInsert(other.hashes_[group], other.Keys(group),
+                                 other.KeyNulls(group));
+    for (uint16_t agg = 0; agg < num_aggregates_; agg++) {
+      uint64_t count = other.Count(group, agg);
+      if (count == 0) {
+        continue;
+      }
+      // 先按一个值更新，再把剩下的个数补上
+      Update(aggregates[agg], into, agg, other.Value(group, agg));
+      Count(into, agg) += count - 1;
+    }
+  }
+}
+
+HashAggregate::HashAggregate(std::vector<uint16_t> group_by,
+                             std::vector<AggregateSpec> aggregates,
+                             Operator *next)
+    : Operator(next), group_by_(std::move(group_by)),
+      aggregates_(std::move(aggregates)) {
+  assert(group_by_.size() <= 64);
+}
+
+void HashAggregate::Consume(ColumnBatch *batch) {
+  auto num_keys = static_cast<uint16_t>(group_by_.size());
+  auto num_aggregates = static_cast<uint16_t>(aggregates_.size());
+  std::unique_ptr<GroupTable> &table = tables_.Local();
+  if (table == nullptr) {
+    table = std::make_unique<GroupTable>(num_keys, num_aggregates);
+  }
+  uint32_t n = batch->NumSelected();
+  const uint32_t *selection = batch->Selection();
+  table->row_keys_.resize(static_cast<uint64_t>(n) * num_keys);
+  table->row_key_nulls_.assign(n, 0);
+  table->row_hashes_.assign(n, 0);
+  table->row_groups_.resize(n);
+
+  // 一列一列地读key、算hash
+  for (uint16_t k = 0; k < num_keys; k++) {
+    uint16_t col = group_by_[k];
+    for (uint32_t i = 0; i < n; i++) {
+      uint32_t row = selection[i];
+      int64_t key = 0;
+      if (batch->IsNull(col, row)) {
+        table->row_key_nulls_[i] |= uint64_t{1} << k;
+      } else {
+        key = batch->ReadInteger(col, row);
+      }
+      table->row_keys_[static_cast<uint64_t>(i) * num_keys + k] = key;
+      table->row_hashes_[i] = HashCombine(table->row_hashes_[i], key);
+    }
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    table->row_groups_[i] = table->FindOrInsert(
+        table->row_hashes_[i],
+        table->row_keys_.data() + static_cast<uint64_t>(i) * num_keys,
+        table->row_key_nulls_[i]);
+  }
+
+  for (uint16_t agg = 0; agg < num_aggregates; agg++) {
+    const AggregateSpec &spec = aggregates_[agg];
+    if (spec.type_ == AggregateType::COUNT_STAR) {
+      for (uint32_t i = 0; i < n; i++) {
+        table->Count(table->row_groups_[i], agg)++;
+      }
+      continue;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+      uint32_t row = selection[i];
+      if (!batch->IsNull(spec.col_, row)) {
+        table->Update(spec, table->row_groups_[i], agg,
+                      batch->ReadInteger(spec.col_, row));
+      }
+    }
+  }
+}
+
+void HashAggregate::Finish() {
+  auto num_keys = static_cast<uint16_t>(group_by_.size());
+  auto num_aggregates = static_cast<uint16_t>(aggregates_.size());
+  GroupTable result(num_keys, num_aggregates);
+  tables_.ForEach(
+      [&](const GroupTable &table) { result.Merge(table, aggregates_); });
+  tables_.Clear();
+  if (num_keys == 0 && result.NumGroups() == 0) {
+    result.FindOrInsert(0, nullptr, 0);
+  }
+
+  ColumnBatch output(std::vector<uint16_t>(num_keys + num_aggregates, 8));
+  for (uint32_t first = 0; first < result.NumGroups();
+       first += output.Capacity()) {
+    uint32_t n = std::min(output.Capacity(), result.NumGroups() - first);
+    for (uint32_t i = 0; i < n; i++) {
+      uint32_t group = first + i;
+      const int64_t *keys = result.Keys(group);
+      for (uint16_t k = 0; k < num_keys; k++) {
+        bool is_null = (result.KeyNulls(group) >> k) & 1;
+        output.Write(k, i,
+                     is_null ? nullptr
+                             : reinterpret_cast<const byte *>(keys + k));
+      }
+      for (uint16_t agg = 0; agg < num_aggregates; agg++) {
+        auto col = static_cast<uint16_t>(num_keys + agg);
+        uint64_t count = result.Count(group, agg);
+        AggregateType type = aggregates_[agg].type_;
+        if (type == AggregateType::COUNT_STAR ||
+            type == AggregateType::COUNT) {
+          auto value = static_cast<int64_t>(count);
+          output.Write(col, i, reinterpret_cast<const byte *>(&value));
+        } else {
+          output.Write(col, i,
+                       count == 0 ? nullptr
+                                  : reinterpret_cast<const byte *>(
+                                        &result.Value(group, agg)));
+        }
+      }
+    }
+    output.Reset(n);
+    next_->Consume(&output);
+  }
+  next_->Finish();
+}
+} // namespace noisepage::execution
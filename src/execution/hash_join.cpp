@@ -0,0 +1,120 @@
+#include "execution/hash_join.h"
+
+namespace noisepage::execution {
+void HashJoinBuild::Consume(ColumnBatch *batch) {
+  // 先把key为null的行去掉
+  uint32_t *selection = batch->Selection();
+  uint32_t num_kept = 0;
+  for (uint32_t i = 0; i < batch->NumSelected(); i++) {
+    bool has_null = false;
+    for (uint16_t col : keys_) {
+      has_null |= batch->IsNull(col, selection[i]);
+    }
+    selection[num_kept] = selection[i];
+    num_kept += !has_null;
+  }
+  batch->SetNumSelected(num_kept);
+
+  std::unique_ptr<RowBuffer> &partition = partitions_.Local();
+  if (partition == nullptr) {
+    partition = std::make_unique<RowBuffer>(batch->AttrSizes());
+  }
+  partition->Append(*batch);
+}
+
+void HashJoinBuild::Finish() {
+  partitions_.ForEach([this](const RowBuffer &partition) {
+    if (rows_ == nullptr) {
+      rows_ = std::make_unique<RowBuffer>(partition.AttrSizes());
+    }
+    rows_->Append(partition);
+  });
+  partitions_.Clear();
+  if (rows_ == nullptr) {
+    return;
+  }
+
+  uint64_t num_rows = rows_->NumRows();
+  hashes_.assign(num_rows, 0);
+  for (uint16_t k = 0; k < NumKeys(); k++) {
+    for (uint64_t row = 0; row < num_rows; row++) {
+      hashes_[row] = HashCombine(hashes_[row], Key(k, row));
+    }
+  }
+  uint64_t num_buckets = 1;
+  while (num_buckets < num_rows) {
+    num_buckets <<= 1;
+  }
+  buckets_.assign(num_buckets, 0);
+  next_in_chain_.assign(num_rows, 0);
+  for (uint64_t row = 0; row < num_rows; row++) {
+    uint64_t &head = buckets_[hashes_[row] & (num_buckets - 1)];
+    next_in_chain_[row] = head;
+    head = row + 1;
+  }
+}
+
+void HashJoinProbe::Consume(ColumnBatch *batch) {
+  std::unique_ptr<ProbeState> &state = states_.Local();
+  if (state == nullptr) {
+    state = std::make_unique<ProbeState>();
+  }
+  if (build_->NumRows() == 0) {
+    return;
+  }
+  if (state->output_ == nullptr) {
+    std::vector<uint16_t> attr_sizes = batch->AttrSizes();
+    const std::vector<uint16_t> &build_sizes = build_->Rows().AttrSizes();
+    attr_sizes.insert(attr_sizes.end(), build_sizes.begin(),
+                      build_sizes.end());
+    state->output_ =
+        std::make_unique<ColumnBatch>(std::move(attr_sizes), batch->Capacity());
+  }
+
+  auto num_keys = static_cast<uint16_t>(keys_.size());
+  const uint32_t *selection = batch->Selection();
+  state->row_keys_.resize(num_keys);
+  for (uint32_t i = 0; i < batch->NumSelected(); i++) {
+    uint32_t row = selection[i];
+    uint64_t hash = 0;
+    bool has_null = false;
+    for (uint16_t k = 0; k < num_keys; k++) {
+      has_null |= batch->IsNull(keys_[k], row);
+      state->row_keys_[k] = batch->ReadInteger(keys_[k], row);
+      hash = HashCombine(hash, state->row_keys_[k]);
+    }
+    if (has_null) {
+      continue;
+    }
+    build_->ForEachCandidate(hash, [&](uint64_t build_row) {
+      for (uint16_t k = 0; k < num_keys; k++) {
+        if (build_->Key(k, build_row) != state->row_keys_[k]) {
+          return;
+        }
+      }
+      state->probe_rows_.push_back(row);
+      state->build_rows_.push_back(build_row);
+      if (state->probe_rows_.size() == state->output_->Capacity()) {
+        Flush(*batch, state.get());
+      }
+    });
+  }
+  // 不能留到下一个batch，probe行只在这个batch里有效
+  Flush(*batch, state.get());
+}
+
+void HashJoinProbe::Flush(const ColumnBatch &batch, ProbeState *state) {
+  auto n = static_cast<uint32_t>(state->probe_rows_.size());
+  if (n == 0) {
+    return;
+  }
+  ColumnBatch *output = state->output_.get();
+  Gather(batch, state->probe_rows_.data(), n, output);
+  build_->Rows().Gather(state->build_rows_.data(), n, output,
+                        batch.NumColumns());
+  output->Reset(n);
+  state->probe_rows_.clear();
+  state->build_rows_.clear();
+  next_->Consume(output);
+}
+} // namespace noisepage::execution
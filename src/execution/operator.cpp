@@ -0,0 +1,112 @@
+#include "execution/operator.h"
+#include <cstring>
+
+namespace noisepage::execution {
+namespace {
+// 常见的宽度展开成定长拷贝，编译器能生成普通的load/store
+template <uint16_t SIZE>
+void GatherValues(const byte *from, const uint32_t *rows, uint32_t num_rows,
+                  byte *to) {
+  for (uint32_t k = 0; k < num_rows; k++) {
+    std::memcpy(to + static_cast<uint64_t>(k) * SIZE,
+                from + static_cast<uint64_t>(rows[k]) * SIZE, SIZE);
+  }
+}
+
+void GatherValues(uint16_t attr_size, const byte *from, const uint32_t *rows,
+                  uint32_t num_rows, byte *to) {
+  switch (attr_size) {
+  case 1:
+    GatherValues<1>(from, rows, num_rows, to);
+    break;
+  case 2:
+    GatherValues<2>(from, rows, num_rows, to);
+    break;
+  case 4:
+    GatherValues<4>(from, rows, num_rows, to);
+    break;
+  case 8:
+    GatherValues<8>(from, rows, num_rows, to);
+    break;
+  default:
+    for (uint32_t k = 0; k < num_rows; k++) {
+      std::memcpy(to + static_cast<uint64_t>(k) * attr_size,
+                  from + static_cast<uint64_t>(rows[k]) * attr_size,
+                  attr_size);
+    }
+  }
+}
+
+void SetBit(uint8_t *bitmap, uint32_t pos, bool value) {
+  if (value) {
+    bitmap[pos / BYTE_SIZE] |= ONE_HOT_MASK(pos % BYTE_SIZE);
+  } else {
+    bitmap[pos / BYTE_SIZE] &= ONE_COLD_MASK(pos % BYTE_SIZE);
+  }
+}
+} // namespace
+
+void RowBuffer::Append(const ColumnBatch &batch) {
+  uint32_t n = batch.NumSelected();
+  const uint32_t *selection = batch.Selection();
+  for (uint16_t col = 0; col < NumColumns(); col++) {
+    uint16_t attr_size = attr_sizes_[col];
+    values_[col].resize((num_rows_ + n) * attr_size);
+    GatherValues(attr_size, batch.Values(col), selection, n,
+                 values_[col].data() + num_rows_ * attr_size);
+    present_[col].resize(num_rows_ + n);
+    uint8_t *present = present_[col].data() + num_rows_;
+    for (uint32_t k = 0; k < n; k++) {
+      present[k] = batch.IsNull(col, selection[k]) ? 0 : 1;
+    }
+  }
+  num_rows_ += n;
+}
+
+void RowBuffer::Append(const RowBuffer &other) {
+  for (uint16_t col = 0; col < NumColumns(); col++) {
+    values_[col].insert(values_[col].end(), other.values_[col].begin(),
+                        other.values_[col].end());
+    present_[col].insert(present_[col].end(), other.present_[col].begin(),
+                         other.present_[col].end());
+  }
+  num_rows_ += other.num_rows_;
+}
+
+void RowBuffer::Gather(const uint64_t *rows, uint32_t num_rows,
+                       ColumnBatch *batch, uint16_t first_col,
+                       uint32_t first_row) const {
+  for (uint16_t col = 0; col < NumColumns(); col++) {
+    uint16_t attr_size = attr_sizes_[col];
+    byte *values = batch->Values(static_cast<uint16_t>(first_col + col)) +
+                   static_cast<uint64_t>(first_row) * attr_size;
+    uint8_t *present = batch->Present(static_cast<uint16_t>(first_col + col));
+    for (uint32_t k = 0; k < num_rows; k++) {
+      std::memcpy(values + static_cast<uint64_t>(k) * attr_size,
+                  values_[col].data() + rows[k] * attr_size, attr_size);
+      SetBit(present, first_row + k, present_[col][rows[k]] != 0);
+    }
+  }
+}
+
+void GatherColumn(const ColumnBatch &from, uint16_t from_col,
+                  const uint32_t *rows, uint32_t num_rows, ColumnBatch *to,
+                  uint16_t to_col, uint32_t first_row) {
+  uint16_t attr_size = from.AttrSize(from_col);
+  GatherValues(attr_size, from.Values(from_col), rows, num_rows,
+               to->Values(to_col) +
+                   static_cast<uint64_t>(first_row) * attr_size);
+  uint8_t *present = to->Present(to_col);
+  for (uint32_t k = 0; k < num_rows; k++) {
+    SetBit(present, first_row + k, !from.IsNull(from_col, rows[k]));
+  }
+}
+
+void Gather(const ColumnBatch &from, const uint32_t *rows, uint32_t num_rows,
+            ColumnBatch *to, uint16_t first_col, uint32_t first_row) {
+  for (uint16_t col = 0; col < from.NumColumns(); col++) {
+    GatherColumn(from, col, rows, num_rows, to,
+                 static_cast<uint16_t>(first_col + col), first_row);
+  }
+}
+} // namespace noisepage::execution
@@ -0,0 +1,59 @@
+#include "execution/sort.h"
+#include <algorithm>
+#include <numeric>
+
+namespace noisepage::execution {
+void Sort::Finish() {
+  std::unique_ptr<RowBuffer> rows;
+  partitions_.ForEach([&](const RowBuffer &partition) {
+    if (rows == nullptr) {
+      rows = std::make_unique<RowBuffer>(partition.AttrSizes());
+    }
+    rows->Append(partition);
+  });
+  partitions_.Clear();
+  if (rows == nullptr) {
+    next_->Finish();
+    return;
+  }
+
+  // 只排行号，最后一次性gather
+  std::vector<uint64_t> order(rows->NumRows());
+  std::iota(order.begin(), order.end(), uint64_t{0});
+  auto less = [&](uint64_t a, uint64_t b) {
+    for (const SortKey &key : keys_) {
+      bool a_null = rows->IsNull(key.col_, a);
+      bool b_null = rows->IsNull(key.col_, b);
+      int cmp;
+      if (a_null || b_null) {
+        cmp = static_cast<int>(b_null) - static_cast<int>(a_null);
+      } else {
+        int64_t x = rows->ReadInteger(key.col_, a);
+        int64_t y = rows->ReadInteger(key.col_, b);
+        cmp = (x > y) - (x < y);
+      }
+      if (cmp != 0) {
+        return key.ascending_ ? cmp < 0 : cmp > 0;
+      }
+    }
+    return false;
+  };
+  if (limit_ < order.size()) {
+    std::partial_sort(order.begin(), order.begin() + limit_, order.end(),
+                      less);
+    order.resize(limit_);
+  } else {
+    std::stable_sort(order.begin(), order.end(), less);
+  }
+
+  ColumnBatch output(rows->AttrSizes());
+  for (uint64_t first = 0; first < order.size(); first += output.Capacity()) {
+    auto n = static_cast<uint32_t>(
+        std::min<uint64_t>(output.Capacity(), order.size() - first));
+    rows->Gather(order.data() + first, n, &output);
+    output.Reset(n);
+    next_->Consume(&output);
+  }
+  next_->Finish();
+}
+} // namespace noisepage::execution
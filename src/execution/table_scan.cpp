@@ -0,0 +1,42 @@
+#include "execution/table_scan.h"
+#include "execution/basic_operators.h"
+#include <algorithm>
+#include <cassert>
+
+namespace noisepage::execution {
+TableScan::TableScan(storage::DataTable *table, timestamp_t timestamp,
+                     std::vector<uint16_t> col_ids,
+                     std::vector<storage::ColumnPredicate> predicates,
+                     Operator *next, uint32_t batch_size)
+    : table_(table), timestamp_(timestamp), col_ids_(std::move(col_ids)),
+      predicates_(std::move(predicates)), next_(next),
+      batch_size_(batch_size) {
+  const storage::BlockLayout &layout = table_->GetBlockLayout();
+  for (uint16_t col_id : col_ids_) {
+    attr_sizes_.push_back(layout.attr_sizes_[col_id]);
+  }
+  for (const auto &predicate : predicates_) {
+    auto it = std::find(col_ids_.begin(), col_ids_.end(), predicate.col_id_);
+    assert(it != col_ids_.end());
+    batch_predicates_.push_back(predicate);
+    batch_predicates_.back().col_id_ =
+        static_cast<uint16_t>(it - col_ids_.begin());
+  }
+}
+
+void TableScan::ScanMorsel(uint64_t begin, uint64_t end) {
+  std::unique_ptr<ColumnBatch> &batch = batches_.Local();
+  if (batch == nullptr) {
+    batch = std::make_unique<ColumnBatch>(attr_sizes_, batch_size_);
+  }
+  table_->ScanColumns(begin, end, timestamp_, col_ids_, predicates_,
+                      batch.get(), [this](ColumnBatch *batch) {
+                        for (const auto &predicate : batch_predicates_) {
+                          FilterSelection(predicate, predicate.col_id_, batch);
+                        }
+                        if (batch->NumSelected() != 0) {
+                          next_->Consume(batch);
+                        }
+                      });
+}
+} // namespace noisepage::execution
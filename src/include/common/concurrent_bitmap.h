@@ -1,5 +1,8 @@
 #pragma once
 #include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
 
 #ifndef BYTE_SIZE
 #define BYTE_SIZE 8u
@@ -7,7 +10,7 @@
 
 static_assert(BYTE_SIZE == 8u, "BYTE_SIZE should be set to 8!");
 
-#define ONE_HOT_MASK(n) (1u << (BYTE_SIZE - n - 1u))
+#define ONE_HOT_MASK(n) (1u << (BYTE_SIZE - (n)-1u))
 #define ONE_COLD_MASK(n) (0xFF ^ ONE_HOT_MASK(n))
 
 namespace noisepage {
@@ -16,10 +19,51 @@ constexpr uint32_t BitmapSize(uint32_t n) {
   return n % BYTE_SIZE == 0 ? n / BYTE_SIZE : n / BYTE_SIZE + 1;
 }
 
-class RawConcurrentBitmap {
+/**
+ * 同一byte的不同bit可能被几个thread同时改，所以要CAS
+ * Bits shared between threads, e.g. the bitmaps inside a block.
+ */
+struct ConcurrentBitmapPolicy {
+  using Word = std::atomic<uint8_t>;
+
+  static uint8_t Load(const Word &word) { return word.load(); }
+
+  static bool CompareAndSwap(Word &word, uint8_t expected, uint8_t desired) {
+    return word.compare_exchange_strong(expected, desired);
+  }
+
+  static void Or(Word &word, uint8_t mask) { word.fetch_or(mask); }
+
+  static void And(Word &word, uint8_t mask) { word.fetch_and(mask); }
+};
+
+/**
+ * 只有一个thread会写，不需要locked指令
+ * Bits in a buffer only its owner writes, e.g. the null bitmap of a redo,
+ * undo or output ProjectedRow. Others may read it once it is published.
+ */
+struct PrivateBitmapPolicy {
+  using Word = uint8_t;
+
+  static uint8_t Load(const Word &word) { return word; }
+
+  static bool CompareAndSwap(Word &word, uint8_t expected, uint8_t desired) {
+    if (word != expected) {
+      return false;
+    }
+    word = desired;
+    return true;
+  }
+
+  static void Or(Word &word, uint8_t mask) { word |= mask; }
+
+  static void And(Word &word, uint8_t mask) { word &= mask; }
+};
+
+template <class Policy> class RawBitmap {
 public:
   bool Test(uint32_t pos) const {
-    auto elem = bits_[pos / BYTE_SIZE].load();
+    auto elem = Policy::Load(bits_[pos / BYTE_SIZE]);
     return static_cast<bool>(elem & ONE_HOT_MASK(pos % BYTE_SIZE));
   }
 
@@ -28,21 +72,52 @@ public:
   bool Flip(uint32_t pos, bool expected) {
     auto mask = ONE_HOT_MASK(pos % BYTE_SIZE);
     // 这里用for循环是有道理的，多个thread可能同时修改同一byte的不同bit
-    for (auto old_val = bits_[pos / BYTE_SIZE].load();
+    for (auto old_val = Policy::Load(bits_[pos / BYTE_SIZE]);
          static_cast<bool>(old_val & mask) == expected;
-         old_val = bits_[pos / BYTE_SIZE].load()) {
-      if (bits_[pos / BYTE_SIZE].compare_exchange_strong(old_val,
-                                                         old_val ^ mask)) {
+         old_val = Policy::Load(bits_[pos / BYTE_SIZE])) {
+      if (Policy::CompareAndSwap(bits_[pos / BYTE_SIZE], old_val,
+                                 static_cast<uint8_t>(old_val ^ mask))) {
         return true;
       }
     }
     return false;
   }
 
+  void Set(uint32_t pos, bool value) {
+    auto mask = static_cast<uint8_t>(ONE_HOT_MASK(pos % BYTE_SIZE));
+    if (value) {
+      Policy::Or(bits_[pos / BYTE_SIZE], mask);
+    } else {
+      Policy::And(bits_[pos / BYTE_SIZE], static_cast<uint8_t>(~mask));
+    }
+  }
+
+  /**
+   * Sets the first n bits to value a whole byte range at a time; the bits
+   * after them are left alone.
+   */
+  void SetAll(uint32_t n, bool value) {
+    static_assert(std::is_same_v<Policy, PrivateBitmapPolicy>,
+                  "Only private bitmaps can be overwritten in bulk");
+    uint32_t num_bytes = n / BYTE_SIZE;
+    std::memset(bits_, value ? 0xFF : 0, num_bytes);
+    if (n % BYTE_SIZE != 0) {
+      auto mask = static_cast<uint8_t>(0xFF << (BYTE_SIZE - n % BYTE_SIZE));
+      if (value) {
+        bits_[num_bytes] |= mask;
+      } else {
+        bits_[num_bytes] &= static_cast<uint8_t>(~mask);
+      }
+    }
+  }
+
 private:
-  std::atomic<uint8_t> bits_[0];
+  typename Policy::Word bits_[0];
 };
 
+using RawConcurrentBitmap = RawBitmap<ConcurrentBitmapPolicy>;
+using RawPrivateBitmap = RawBitmap<PrivateBitmapPolicy>;
+
 template <uint32_t N> class ConcurrentBitmap : public RawConcurrentBitmap {
 private:
   std::atomic<uint8_t> bits_[BitmapSize(N)]{};
@@ -31,6 +31,11 @@ public:
 
   void PushBack(const T &item) { vector_.push_back(item); }
 
+  // T不能拷贝（比如std::atomic）时用这个
+  template <typename... Args> void EmplaceBack(Args &&... args) {
+    vector_.emplace_back(std::forward<Args>(args)...);
+  }
+
   T &At(uint64_t index) { return vector_.at(index); }
 
   T &operator[](int64_t index) { return At(index); }
@@ -0,0 +1,277 @@
+#pragma once
+#include "common/concurrent_queue.h"
+#include "common/macros.h"
+#include "common/scheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace noisepage {
+/**
+ * 基于epoch的内存回收
+ * Epoch-based reclamation. A thread pins the current epoch (through a Guard)
+ * before reading a shared structure and unpins it afterwards. Memory unlinked
+ * from the structure is retired instead of freed, and is only freed once the
+ * global epoch has moved two steps past the epoch it was retired in. The
+ * global epoch can only move past e once every pinned thread has announced
+ * e, so by then nobody can still hold a pointer obtained before the unlink.
+ *
+ * Readers only write to their own announcement slot, so the read path takes
+ * no locks and keeps no reference counts. Reclamation is batched: every
+ * reclaim_batch retirements the retiring thread tries to advance the epoch
+ * and free what is safe, and a background thread or a periodic task on a
+ * Scheduler can do the same.
+ */
+class EpochManager {
+  struct alignas(64) Announcement {
+    std::atomic<bool> in_use_{false};
+    std::atomic<uint64_t> epoch_{0};
+  };
+
+  struct Retired {
+    void *ptr_;
+    void (*deleter_)(void *);
+    uint64_t epoch_;
+  };
+
+  // 一个线程在一个manager上的pin，嵌套的guard共用
+  struct Pinned {
+    const EpochManager *manager_;
+    Announcement *announcement_;
+    uint32_t depth_;
+  };
+
+public:
+  /**
+   * Pins the epoch for as long as it lives. Guards may be nested; a nested
+   * guard reuses the announcement of the outermost one on its thread.
+   */
+  class Guard {
+  public:
+    explicit Guard(EpochManager *manager)
+        : manager_(manager), announcement_(manager->Pin()) {}
+
+    ~Guard() { manager_->Unpin(announcement_); }
+
+    DISALLOW_COPY_AND_MOVE(Guard);
+
+  private:
+    EpochManager *manager_;
+    Announcement *announcement_;
+  };
+
+  /**
+   * @param max_pinned how many threads can hold guards at once; further
+   * threads wait until one releases its outermost guard
+   * @param reclaim_batch number of retirements between piggybacked
+   * reclamation attempts, 0 to only reclaim explicitly or in the background
+   */
+  explicit EpochManager(uint32_t max_pinned = 128, uint32_t reclaim_batch = 64)
+      : announcements_(max_pinned), reclaim_batch_(reclaim_batch) {}
+
+  /**
+   * Frees everything still retired. No guard may be alive.
+   */
+  ~EpochManager() {
+    StopBackgroundReclamation();
+    ReclaimAll();
+  }
+
+  DISALLOW_COPY_AND_MOVE(EpochManager);
+
+  uint64_t CurrentEpoch() const { return epoch_.load(); }
+
+  /**
+   * Frees ptr with deleter once no pinned thread can still be reading it.
+   * ptr must already be unreachable for threads that pin from now on.
+   * Deleters run in the order their objects were retired, so a deleter may
+   * still use what was retired after it.
+   */
+  void Retire(void *ptr, void (*deleter)(void *)) {
+    retired_.Enqueue(Retired{ptr, deleter, epoch_.load()});
+    if (reclaim_batch_ != 0 &&
+        num_retired_.fetch_add(1) % reclaim_batch_ == reclaim_batch_ - 1) {
+      TryReclaim();
+    }
+  }
+
+  template <typename T> void Retire(T *ptr) {
+    Retire(ptr, [](void *obj) { delete static_cast<T *>(obj); });
+  }
+
+  /**
+   * Moves the global epoch forward if every pinned thread has caught up with
+   * it.
+   * @return whether the epoch moved
+   */
+  bool TryAdvance() {
+    uint64_t epoch = epoch_.load();
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (auto &announcement : announcements_) {
+      if (announcement.in_use_.load() && announcement.epoch_.load() != epoch) {
+        return false;
+      }
+    }
+    return epoch_.compare_exchange_strong(epoch, epoch + 1);
+  }
+
+  /**
+   * Tries to advance the epoch and frees everything retired at least two
+   * epochs ago. Only one thread reclaims at a time; others return at once.
+   * @return number of objects freed
+   */
+  uint32_t TryReclaim() {
+    std::unique_lock<std::mutex> lock(reclaim_latch_, std::try_to_lock);
+    if (!lock.owns_lock()) {
+      return 0;
+    }
+    TryAdvance();
+    Retired retired{};
+    while (retired_.Dequeue(retired)) {
+      limbo_.push_back(retired);
+    }
+    uint64_t epoch = epoch_.load();
+    // 保持retire的顺序
+    auto safe = std::stable_partition(
+        limbo_.begin(), limbo_.end(),
+        [&](const Retired &item) { return item.epoch_ + 2 > epoch; });
+    auto num_freed = static_cast<uint32_t>(limbo_.end() - safe);
+    for (auto it = safe; it != limbo_.end(); ++it) {
+      it->deleter_(it->ptr_);
+    }
+    limbo_.erase(safe, limbo_.end());
+    return num_freed;
+  }
+
+  /**
+   * Frees everything still retired, in order, without waiting for the
+   * epoch. No guard may be alive.
+   */
+  void ReclaimAll() {
+    std::lock_guard<std::mutex> lock(reclaim_latch_);
+    Retired retired{};
+    while (retired_.Dequeue(retired)) {
+      limbo_.push_back(retired);
+    }
+    for (auto &item : limbo_) {
+      item.deleter_(item.ptr_);
+    }
+    limbo_.clear();
+  }
+
+  /**
+   * Starts a thread that calls TryReclaim every period until stopped.
+   */
+  void StartBackgroundReclamation(std::chrono::microseconds period) {
+    StopBackgroundReclamation();
+    running_ = true;
+    background_ = std::thread([this, period] {
+      std::unique_lock<std::mutex> lock(background_latch_);
+      while (running_) {
+        lock.unlock();
+        TryReclaim();
+        lock.lock();
+        background_cv_.wait_for(lock, period, [this] { return !running_; });
+      }
+    });
+  }
+
+  /**
+   * Calls TryReclaim every period as a background task of scheduler until
+   * stopped, instead of on a thread of its own. The scheduler must outlive
+   * the reclamation.
+   */
+  void StartBackgroundReclamation(Scheduler *scheduler,
+                                  std::chrono::microseconds period) {
+    StopBackgroundReclamation();
+    scheduler_ = scheduler;
+    periodic_id_ =
+        scheduler->RunPeriodically(period, [this] { TryReclaim(); });
+  }
+
+  void StopBackgroundReclamation() {
+    if (scheduler_ != nullptr) {
+      scheduler_->Cancel(periodic_id_);
+      scheduler_ = nullptr;
+    }
+    {
+      std::lock_guard<std::mutex> lock(background_latch_);
+      running_ = false;
+    }
+    background_cv_.notify_all();
+    if (background_.joinable()) {
+      background_.join();
+    }
+  }
+
+private:
+  std::vector<Announcement> announcements_;
+  const uint32_t reclaim_batch_;
+  std::atomic<uint64_t> epoch_{0};
+  std::atomic<uint64_t> num_retired_{0};
+  ConcurrentQueue<Retired> retired_;
+
+  // 只有持有reclaim_latch_的线程会碰limbo_
+  std::mutex reclaim_latch_;
+  std::vector<Retired> limbo_;
+
+  std::mutex background_latch_;
+  std::condition_variable background_cv_;
+  bool running_ = false;
+  std::thread background_;
+  Scheduler *scheduler_ = nullptr;
+  uint64_t periodic_id_ = 0;
+
+  static std::vector<Pinned> &PinnedByThread() {
+    thread_local std::vector<Pinned> pinned;
+    return pinned;
+  }
+
+  Announcement *Pin() {
+    std::vector<Pinned> &pinned = PinnedByThread();
+    for (Pinned &entry : pinned) {
+      if (entry.manager_ == this) {
+        entry.depth_++;
+        return entry.announcement_;
+      }
+    }
+    // 上次用过的slot大概率还空着
+    thread_local uint32_t hint = 0;
+    auto num_slots = static_cast<uint32_t>(announcements_.size());
+    for (uint32_t i = 0;; i++) {
+      uint32_t slot = (hint + i) % num_slots;
+      Announcement &announcement = announcements_[slot];
+      bool expected = false;
+      if (!announcement.in_use_.load(std::memory_order_relaxed) &&
+          announcement.in_use_.compare_exchange_strong(expected, true)) {
+        hint = slot;
+        announcement.epoch_.store(epoch_.load());
+        // 让TryAdvance要么看到这次announce，要么这里之后的读看到新的epoch
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        pinned.push_back({this, &announcement, 1});
+        return &announcement;
+      }
+      if (i % num_slots == num_slots - 1) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  void Unpin(Announcement *announcement) {
+    std::vector<Pinned> &pinned = PinnedByThread();
+    for (auto it = pinned.begin(); it != pinned.end(); ++it) {
+      if (it->announcement_ == announcement) {
+        if (--it->depth_ == 0) {
+          pinned.erase(it);
+          announcement->in_use_.store(false, std::memory_order_release);
+        }
+        return;
+      }
+    }
+  }
+};
+} // namespace noisepage
@@ -3,25 +3,36 @@
 #include "common/concurrent_queue.h"
 
 namespace noisepage {
-template <typename T> class ObjectPool {
+/**
+ * ObjectPool默认的allocator，直接new和delete
+ */
+template <typename T> struct DefaultAllocator {
+  T *New() { return new T(); }
+
+  void Delete(T *obj) { delete obj; }
+};
+
+template <typename T, typename Allocator = DefaultAllocator<T>>
+class ObjectPool {
 public:
-  explicit ObjectPool(uint32_t reuse_limit) : reuse_limit_(reuse_limit) {}
+  explicit ObjectPool(uint32_t reuse_limit, Allocator allocator = Allocator())
+      : reuse_limit_(reuse_limit), allocator_(allocator) {}
 
   ~ObjectPool() {
     T *obj;
     while (queue_.Dequeue(obj)) {
-      delete obj;
+      allocator_.Delete(obj);
     }
   }
 
   T *Get() {
     T *result;
-    return queue_.Dequeue(result) ? result : new T();
+    return queue_.Dequeue(result) ? result : allocator_.New();
   }
 
   void Release(T *obj) {
     if (queue_.UnsafeSize() > reuse_limit_) {
-      delete obj;
+      allocator_.Delete(obj);
     } else {
       queue_.Enqueue(std::move(obj));
     }
@@ -29,6 +40,7 @@ public:
 
 private:
   const uint32_t reuse_limit_;
+  Allocator allocator_;
   ConcurrentQueue<T *> queue_;
 };
 } // namespace noisepage
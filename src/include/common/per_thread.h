@@ -0,0 +1,34 @@
+#pragma once
+#include <memory>
+#include <tbb/enumerable_thread_specific.h>
+
+namespace noisepage {
+/**
+ * 每个线程一份，最后一起合并
+ * One T per thread that asks for it, created on first use, for state that
+ * is built up without synchronization and combined at the end.
+ */
+template <typename T> class PerThread {
+public:
+  /**
+   * @return the calling thread's T, nullptr if it has none yet
+   */
+  std::unique_ptr<T> &Local() { return values_.local(); }
+
+  /**
+   * Calls fn on every T created so far. No thread may be using its T.
+   */
+  template <typename F> void ForEach(const F &fn) {
+    for (auto &value : values_) {
+      if (value != nullptr) {
+        fn(*value);
+      }
+    }
+  }
+
+  void Clear() { values_.clear(); }
+
+private:
+  tbb::enumerable_thread_specific<std::unique_ptr<T>> values_;
+};
+} // namespace noisepage
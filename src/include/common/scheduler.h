@@ -0,0 +1,563 @@
+#pragma once
+#include "common/macros.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <pthread.h>
+#include <sched.h>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace noisepage {
+/**
+ * Chase-Lev deque. The owner pushes and pops at the bottom without locks,
+ * other threads steal from the top. Outgrown arrays are kept until the deque
+ * dies because a thief may still be reading from one.
+ */
+template <typename T> class WorkStealingDeque {
+  static_assert(std::is_pointer_v<T>, "Only pointers can be stolen");
+
+  struct Array {
+    explicit Array(int64_t capacity)
+        : capacity_(capacity), slots_(new std::atomic<T>[capacity]) {}
+
+    T Get(int64_t i) const {
+      return slots_[i & (capacity_ - 1)].load(std::memory_order_relaxed);
+    }
+
+    void Put(int64_t i, T item) {
+      slots_[i & (capacity_ - 1)].store(item, std::memory_order_relaxed);
+    }
+
+    const int64_t capacity_;
+    std::unique_ptr<std::atomic<T>[]> slots_;
+  };
+
+public:
+  /**
+   * @param capacity initial capacity, a power of 2
+   */
+  explicit WorkStealingDeque(int64_t capacity = 64) {
+    arrays_.emplace_back(new Array(capacity));
+    array_.store(arrays_.back().get(), std::memory_order_relaxed);
+  }
+
+  DISALLOW_COPY_AND_MOVE(WorkStealingDeque);
+
+  /**
+   * Only the owner may push.
+   */
+  void Push(T item) {
+    int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    int64_t top = top_.load(std::memory_order_acquire);
+    Array *array = array_.load(std::memory_order_relaxed);
+    if (bottom - top > array->capacity_ - 1) {
+      auto *grown = new Array(2 * array->capacity_);
+      for (int64_t i = top; i < bottom; i++) {
+        grown->Put(i, array->Get(i));
+      }
+      arrays_.emplace_back(grown);
+      array = grown;
+      array_.store(array, std::memory_order_release);
+    }
+    array->Put(bottom, item);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+  }
+
+  /**
+   * Only the owner may pop; it gets the item it pushed last.
+   */
+  bool Pop(T &item) {
+    int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    Array *array = array_.load(std::memory_order_relaxed);
+    bottom_.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = top_.load(std::memory_order_relaxed);
+    if (top > bottom) {
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+      return false;
+    }
+    item = array->Get(bottom);
+    if (top < bottom) {
+      return true;
+    }
+    // 只剩最后一个，和thief抢
+    bool won = top_.compare_exchange_strong(
+        top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+    return won;
+  }
+
+  /**
+   * Any thread may steal; it gets the oldest item.
+   */
+  bool Steal(T &item) {
+    int64_t top = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = bottom_.load(std::memory_order_acquire);
+    if (top >= bottom) {
+      return false;
+    }
+    item = array_.load(std::memory_order_acquire)->Get(top);
+    return top_.compare_exchange_strong(
+        top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+  }
+
+private:
+  alignas(64) std::atomic<int64_t> top_{0};
+  alignas(64) std::atomic<int64_t> bottom_{0};
+  std::atomic<Array *> array_;
+  // 只有owner会改
+  std::vector<std::unique_ptr<Array>> arrays_;
+};
+
+enum class TaskPriority : uint8_t { FOREGROUND, BACKGROUND };
+
+class TaskGroup;
+
+/**
+ * 所有并行的东西共用一组worker
+ * A fixed set of worker threads that run tasks. Every worker owns a
+ * WorkStealingDeque: tasks spawned from a worker go onto its own deque and
+ * run last-in first-out, so nested parallelism stays cache-friendly, and
+ * idle workers steal the oldest tasks of others. Tasks from other threads go
+ * through a shared queue.
+ *
+ * Background tasks (GC and other maintenance, see RunPeriodically) only run
+ * when a worker finds no foreground work, and never on more than
+ * max_background workers at once, so they cannot starve foreground work.
+ */
+class Scheduler {
+  struct Task {
+    std::function<void()> fn_;
+    TaskGroup *group_;
+    TaskPriority priority_;
+  };
+
+  struct alignas(64) Worker {
+    WorkStealingDeque<Task *> deque_;
+    std::thread thread_;
+  };
+
+  struct Periodic {
+    std::function<void()> fn_;
+    std::chrono::microseconds period_;
+    std::chrono::steady_clock::time_point next_run_;
+    // 排着队或者正在跑
+    std::atomic<bool> running_{false};
+    // 正在fn_里面
+    std::atomic<bool> executing_{false};
+    std::atomic<bool> cancelled_{false};
+  };
+
+public:
+  /**
+   * @param num_workers number of worker threads, at least 1
+   * @param pin_workers whether worker i is pinned to core i (mod the number
+   * of cores)
+   * @param max_background most workers that run background tasks at once,
+   * 0 for all but one
+   */
+  explicit Scheduler(
+      uint32_t num_workers = std::max(1u, std::thread::hardware_concurrency()),
+      bool pin_workers = false, uint32_t max_background = 0)
+      : max_background_(max_background != 0
+                            ? max_background
+                            : std::max(1u, num_workers - 1)) {
+    for (uint32_t i = 0; i < num_workers; i++) {
+      workers_.emplace_back(new Worker);
+    }
+    for (uint32_t i = 0; i < num_workers; i++) {
+      workers_[i]->thread_ = std::thread([this, i] { WorkerLoop(i); });
+      if (pin_workers) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(i % std::max(1u, std::thread::hardware_concurrency()), &cpus);
+        // 绑不上也能跑，就不管了
+        pthread_setaffinity_np(workers_[i]->thread_.native_handle(),
+                               sizeof(cpus), &cpus);
+      }
+    }
+    timer_ = std::thread([this] { TimerLoop(); });
+  }
+
+  /**
+   * Stops every periodic task and waits until all submitted tasks are done.
+   */
+  ~Scheduler() {
+    {
+      std::lock_guard<std::mutex> lock(timer_latch_);
+      periodics_.clear();
+      stopping_timer_ = true;
+    }
+    timer_cv_.notify_all();
+    timer_.join();
+    {
+      std::lock_guard<std::mutex> lock(latch_);
+      stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto &worker : workers_) {
+      worker->thread_.join();
+    }
+  }
+
+  DISALLOW_COPY_AND_MOVE(Scheduler);
+
+  uint32_t NumWorkers() const {
+    return static_cast<uint32_t>(workers_.size());
+  }
+
+  /**
+   * Runs fn on some worker and returns at once. Exceptions from fn terminate
+   * the process, as they would on a std::thread; use a TaskGroup to get them
+   * back.
+   */
+  void Submit(std::function<void()> fn,
+              TaskPriority priority = TaskPriority::FOREGROUND) {
+    Spawn(new Task{std::move(fn), nullptr, priority});
+  }
+
+  /**
+   * Calls fn(begin, end) on disjoint ranges covering [begin, end) of at most
+   * grain elements each, in parallel, and returns when all calls are done.
+   * The caller keeps halving its range and hands out the upper halves as
+   * tasks, so thieves take big pieces first.
+   */
+  template <typename F>
+  void ParallelFor(uint64_t begin, uint64_t end, uint64_t grain, const F &fn);
+
+  /**
+   * Runs fn as a background task every period, skipping a run if the
+   * previous one is still going.
+   * @return id for Cancel
+   */
+  uint64_t RunPeriodically(std::chrono::microseconds period,
+                           std::function<void()> fn) {
+    auto periodic = std::make_shared<Periodic>();
+    periodic->fn_ = std::move(fn);
+    periodic->period_ = period;
+    periodic->next_run_ = std::chrono::steady_clock::now() + period;
+    uint64_t id;
+    {
+      std::lock_guard<std::mutex> lock(timer_latch_);
+      id = next_periodic_id_++;
+      periodics_.emplace_back(id, periodic);
+    }
+    timer_cv_.notify_all();
+    return id;
+  }
+
+  /**
+   * Stops a periodic task. A run that is queued but has not started is
+   * dropped, and one in progress is waited for, so a task on a worker may
+   * cancel another periodic task (not its own).
+   */
+  void Cancel(uint64_t id) {
+    std::shared_ptr<Periodic> periodic;
+    {
+      std::lock_guard<std::mutex> lock(timer_latch_);
+      auto it = std::find_if(periodics_.begin(), periodics_.end(),
+                             [id](const auto &entry) {
+                               return entry.first == id;
+                             });
+      if (it == periodics_.end()) {
+        return;
+      }
+      periodic = it->second;
+      periodics_.erase(it);
+    }
+    // 和task里的顺序相反：要么task看到cancelled_不跑，要么这里看到它在跑
+    periodic->cancelled_.store(true);
+    while (periodic->executing_.load()) {
+      std::this_thread::yield();
+    }
+  }
+
+  /**
+   * @return index of the worker calling this, -1 outside the workers of
+   * every scheduler
+   */
+  static int32_t CurrentWorker() { return current_worker_; }
+
+private:
+  friend class TaskGroup;
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  const uint32_t max_background_;
+  std::atomic<uint32_t> num_background_running_{0};
+  // deque和injected_里的foreground task数
+  std::atomic<int64_t> num_foreground_queued_{0};
+  std::atomic<uint32_t> num_sleeping_{0};
+
+  std::mutex latch_;
+  std::condition_variable cv_;
+  std::deque<Task *> injected_;
+  std::deque<Task *> background_;
+  bool stopping_ = false;
+
+  std::mutex timer_latch_;
+  std::condition_variable timer_cv_;
+  std::vector<std::pair<uint64_t, std::shared_ptr<Periodic>>> periodics_;
+  uint64_t next_periodic_id_ = 0;
+  bool stopping_timer_ = false;
+  std::thread timer_;
+
+  static inline thread_local int32_t current_worker_ = -1;
+  static inline thread_local const Scheduler *current_scheduler_ = nullptr;
+
+  bool OnWorker() const { return current_scheduler_ == this; }
+
+  void Spawn(Task *task) {
+    if (task->priority_ == TaskPriority::BACKGROUND) {
+      {
+        std::lock_guard<std::mutex> lock(latch_);
+        background_.push_back(task);
+      }
+      cv_.notify_one();
+      return;
+    }
+    num_foreground_queued_.fetch_add(1);
+    if (OnWorker()) {
+      workers_[current_worker_]->deque_.Push(task);
+    } else {
+      std::lock_guard<std::mutex> lock(latch_);
+      injected_.push_back(task);
+    }
+    // 和Sleep里的顺序相反：要么这里看到有人睡，要么睡的人看到这个task
+    if (num_sleeping_.load() > 0) {
+      std::lock_guard<std::mutex> lock(latch_);
+      cv_.notify_one();
+    }
+  }
+
+  Task *FindForeground() {
+    Task *task = nullptr;
+    if (OnWorker() && workers_[current_worker_]->deque_.Pop(task)) {
+      num_foreground_queued_.fetch_sub(1);
+      return task;
+    }
+    if (num_foreground_queued_.load() <= 0) {
+      return nullptr;
+    }
+    {
+      std::lock_guard<std::mutex> lock(latch_);
+      if (!injected_.empty()) {
+        task = injected_.front();
+        injected_.pop_front();
+        num_foreground_queued_.fetch_sub(1);
+        return task;
+      }
+    }
+    // 从自己后面一个开始偷，免得大家都盯着worker 0
+    auto num_workers = static_cast<uint32_t>(workers_.size());
+    uint32_t start = OnWorker() ? current_worker_ + 1 : 0;
+    for (uint32_t i = 0; i < num_workers; i++) {
+      if (workers_[(start + i) % num_workers]->deque_.Steal(task)) {
+        num_foreground_queued_.fetch_sub(1);
+        return task;
+      }
+    }
+    return nullptr;
+  }
+
+  Task *FindBackground() {
+    std::lock_guard<std::mutex> lock(latch_);
+    if (background_.empty() ||
+        num_background_running_.load() >= max_background_) {
+      return nullptr;
+    }
+    Task *task = background_.front();
+    background_.pop_front();
+    num_background_running_.fetch_add(1);
+    return task;
+  }
+
+  /**
+   * Runs one queued task, foreground ones first.
+   * @return false if there was nothing to run
+   */
+  bool RunOne(bool allow_background) {
+    Task *task = FindForeground();
+    if (task == nullptr && allow_background) {
+      task = FindBackground();
+    }
+    if (task == nullptr) {
+      return false;
+    }
+    Execute(task);
+    return true;
+  }
+
+  void Execute(Task *task);
+
+  void WorkerLoop(uint32_t id) {
+    current_worker_ = static_cast<int32_t>(id);
+    current_scheduler_ = this;
+    for (;;) {
+      if (RunOne(true)) {
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(latch_);
+      num_sleeping_.fetch_add(1);
+      cv_.wait(lock, [this] {
+        return stopping_ || num_foreground_queued_.load() > 0 ||
+               (!background_.empty() &&
+                num_background_running_.load() < max_background_);
+      });
+      num_sleeping_.fetch_sub(1);
+      if (stopping_ && num_foreground_queued_.load() <= 0 &&
+          background_.empty()) {
+        return;
+      }
+    }
+  }
+
+  void TimerLoop() {
+    std::unique_lock<std::mutex> lock(timer_latch_);
+    while (!stopping_timer_) {
+      auto now = std::chrono::steady_clock::now();
+      auto next_wakeup = now + std::chrono::seconds(1);
+      for (auto &entry : periodics_) {
+        Periodic *periodic = entry.second.get();
+        if (periodic->next_run_ <= now) {
+          periodic->next_run_ = now + periodic->period_;
+          bool expected = false;
+          if (periodic->running_.compare_exchange_strong(expected, true)) {
+            // task拿着shared_ptr，Cancel之后也不会悬空
+            Spawn(new Task{[periodic = entry.second] {
+                             periodic->executing_.store(true);
+                             if (!periodic->cancelled_.load()) {
+                               periodic->fn_();
+                             }
+                             periodic->executing_.store(false);
+                             periodic->running_.store(false);
+                           },
+                           nullptr, TaskPriority::BACKGROUND});
+          }
+        }
+        next_wakeup = std::min(next_wakeup, periodic->next_run_);
+      }
+      timer_cv_.wait_until(lock, next_wakeup);
+    }
+  }
+};
+
+/**
+ * Tasks that can be waited for together. A thread waiting for the group
+ * runs queued tasks in the meantime instead of blocking, so groups can be
+ * nested inside tasks and waited for from outside the workers. The first
+ * exception thrown by a task of the group is rethrown by Wait.
+ */
+class TaskGroup {
+public:
+  explicit TaskGroup(Scheduler *scheduler,
+                     TaskPriority priority = TaskPriority::FOREGROUND)
+      : scheduler_(scheduler), priority_(priority) {}
+
+  /**
+   * Waits for the remaining tasks, dropping their exceptions.
+   */
+  ~TaskGroup() {
+    try {
+      Wait();
+    } catch (...) {
+    }
+  }
+
+  DISALLOW_COPY_AND_MOVE(TaskGroup);
+
+  void Run(std::function<void()> fn) {
+    num_pending_.fetch_add(1);
+    scheduler_->Spawn(new Scheduler::Task{std::move(fn), this, priority_});
+  }
+
+  /**
+   * Returns once every task run so far has finished.
+   */
+  void Wait() {
+    while (num_pending_.load(std::memory_order_acquire) != 0) {
+      if (!scheduler_->RunOne(priority_ == TaskPriority::BACKGROUND)) {
+        std::this_thread::yield();
+      }
+    }
+    std::lock_guard<std::mutex> lock(latch_);
+    if (exception_ != nullptr) {
+      std::exception_ptr exception = exception_;
+      exception_ = nullptr;
+      std::rethrow_exception(exception);
+    }
+  }
+
+private:
+  friend class Scheduler;
+
+  Scheduler *const scheduler_;
+  const TaskPriority priority_;
+  std::atomic<uint64_t> num_pending_{0};
+  std::mutex latch_;
+  std::exception_ptr exception_;
+
+  void Fail(std::exception_ptr exception) {
+    std::lock_guard<std::mutex> lock(latch_);
+    if (exception_ == nullptr) {
+      exception_ = exception;
+    }
+  }
+};
+
+inline void Scheduler::Execute(Task *task) {
+  TaskGroup *group = task->group_;
+  bool background = task->priority_ == TaskPriority::BACKGROUND;
+  if (group == nullptr) {
+    task->fn_();
+  } else {
+    try {
+      task->fn_();
+    } catch (...) {
+      group->Fail(std::current_exception());
+    }
+  }
+  delete task;
+  if (background) {
+    num_background_running_.fetch_sub(1);
+    // 空出来的名额给排队的background task
+    std::lock_guard<std::mutex> lock(latch_);
+    if (!background_.empty()) {
+      cv_.notify_one();
+    }
+  }
+  if (group != nullptr) {
+    group->num_pending_.fetch_sub(1, std::memory_order_release);
+  }
+}
+
+template <typename F>
+void Scheduler::ParallelFor(uint64_t begin, uint64_t end, uint64_t grain,
+                            const F &fn) {
+  grain = std::max<uint64_t>(grain, 1);
+  TaskGroup group(this);
+  // 每次把后一半丢出去，自己接着切前一半
+  std::function<void(uint64_t, uint64_t)> split = [&](uint64_t lo,
+                                                      uint64_t hi) {
+    while (hi - lo > grain) {
+      uint64_t mid = lo + (hi - lo) / 2;
+      group.Run([&split, mid, hi] { split(mid, hi); });
+      hi = mid;
+    }
+    fn(lo, hi);
+  };
+  if (begin < end) {
+    split(begin, end);
+  }
+  group.Wait();
+}
+} // namespace noisepage
@@ -0,0 +1,316 @@
+#pragma once
+#include "common/macros.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace noisepage {
+/**
+ * Phases of the storage hot paths that NOISEPAGE_TRACE_SCOPE can time.
+ */
+enum class TracePoint : uint8_t {
+  BLOCK_ALLOCATION = 0,
+  SLOT_ALLOCATION,
+  CHAIN_WALK,
+  DELTA_APPLY,
+  COPY,
+  NUM_POINTS
+};
+
+constexpr uint32_t NUM_TRACE_POINTS =
+    static_cast<uint32_t>(TracePoint::NUM_POINTS);
+
+inline const char *TracePointName(TracePoint point) {
+  static const char *names[] = {"block_allocation", "slot_allocation",
+                                "chain_walk", "delta_apply", "copy"};
+  return names[static_cast<uint32_t>(point)];
+}
+
+/**
+ * @return a cheap, monotonic-enough tick count; TSC cycles on x86
+ */
+inline uint64_t ReadCycleCounter() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return static_cast<uint64_t>(
+      std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+/**
+ * HDR-style log-linear histogram of 64-bit values. Values below 32 are
+ * counted exactly; above that every power of two is split into 16 buckets,
+ * so a reported percentile is at most 1/16 above the real value.
+ *
+ * A histogram has a single writer. Other threads may read it while it is
+ * being written to and see a slightly stale count.
+ */
+class LatencyHistogram {
+public:
+  static constexpr uint32_t SUB_BUCKET_BITS = 4;
+  static constexpr uint32_t SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+  static constexpr uint32_t NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 1) *
+                                          SUB_BUCKETS;
+
+  LatencyHistogram() = default;
+
+  LatencyHistogram(const LatencyHistogram &other) { Merge(other); }
+
+  LatencyHistogram &operator=(const LatencyHistogram &other) {
+    Reset();
+    Merge(other);
+    return *this;
+  }
+
+  void Record(uint64_t value) {
+    // 只有一个writer，不需要原子的read-modify-write
+    auto &count = counts_[BucketIndex(value)];
+    count.store(count.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+  }
+
+  void Merge(const LatencyHistogram &other) {
+    for (uint32_t i = 0; i < NUM_BUCKETS; i++) {
+      counts_[i].store(counts_[i].load(std::memory_order_relaxed) +
+                           other.counts_[i].load(std::memory_order_relaxed),
+                       std::memory_order_relaxed);
+    }
+  }
+
+  void Reset() {
+    for (auto &count : counts_) {
+      count.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  uint64_t Count() const {
+    uint64_t total = 0;
+    for (const auto &count : counts_) {
+      total += count.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  /**
+   * @param p fraction in [0, 1]
+   * @return the largest value that falls into the same bucket as the p-th
+   * recorded value, 0 if nothing was recorded
+   */
+  uint64_t Percentile(double p) const {
+    uint64_t total = Count();
+    if (total == 0) {
+      return 0;
+    }
+    auto rank = static_cast<uint64_t>(p * static_cast<double>(total));
+    rank = std::min(std::max<uint64_t>(rank, 1), total);
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < NUM_BUCKETS; i++) {
+      seen += counts_[i].load(std::memory_order_relaxed);
+      if (seen >= rank) {
+        return BucketUpperBound(i);
+      }
+    }
+    return BucketUpperBound(NUM_BUCKETS - 1);
+  }
+
+  static uint32_t BucketIndex(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+      return static_cast<uint32_t>(value);
+    }
+    uint32_t shift = 63 - __builtin_clzll(value) - SUB_BUCKET_BITS;
+    auto top = static_cast<uint32_t>(value >> shift);
+    return (shift + 1) * SUB_BUCKETS + top - SUB_BUCKETS;
+  }
+
+  static uint64_t BucketUpperBound(uint32_t index) {
+    if (index < SUB_BUCKETS) {
+      return index;
+    }
+    uint32_t shift = index / SUB_BUCKETS - 1;
+    uint64_t top = SUB_BUCKETS + index % SUB_BUCKETS;
+    return ((top + 1) << shift) - 1;
+  }
+
+private:
+  std::atomic<uint64_t> counts_[NUM_BUCKETS] = {};
+};
+
+/**
+ * Process-wide collector behind NOISEPAGE_TRACE_SCOPE. Every thread records
+ * into its own histograms (and, if enabled, its own event buffer), so
+ * recording never synchronizes with other threads. Readers merge the
+ * per-thread data on demand.
+ */
+class Tracer {
+public:
+  /**
+   * A completed scope, in cycles.
+   */
+  struct Event {
+    TracePoint point_;
+    uint64_t start_;
+    uint64_t duration_;
+  };
+
+  static Tracer &Get() {
+    static Tracer tracer;
+    return tracer;
+  }
+
+  DISALLOW_COPY_AND_MOVE(Tracer);
+
+  void Record(TracePoint point, uint64_t start, uint64_t end) {
+    ThreadTrace &local = Local();
+    local.histograms_[static_cast<uint32_t>(point)].Record(end - start);
+    if (events_enabled_.load(std::memory_order_relaxed) &&
+        local.events_.size() < max_events_per_thread_) {
+      local.events_.push_back({point, start, end - start});
+    }
+  }
+
+  /**
+   * @return durations of point in cycles, merged over all threads
+   */
+  LatencyHistogram Histogram(TracePoint point) {
+    LatencyHistogram result;
+    std::lock_guard<std::mutex> lock(latch_);
+    for (const auto &thread : threads_) {
+      result.Merge(thread->histograms_[static_cast<uint32_t>(point)]);
+    }
+    return result;
+  }
+
+  /**
+   * Starts or stops keeping individual events for DumpChromeTrace, at most
+   * max_events_per_thread per thread.
+   */
+  void EnableEvents(bool enabled, uint64_t max_events_per_thread = 1u << 20) {
+    max_events_per_thread_ = max_events_per_thread;
+    events_enabled_.store(enabled);
+  }
+
+  /**
+   * Clears all histograms and events. No thread may be recording.
+   */
+  void Reset() {
+    std::lock_guard<std::mutex> lock(latch_);
+    for (auto &thread : threads_) {
+      for (auto &histogram : thread->histograms_) {
+        histogram.Reset();
+      }
+      thread->events_.clear();
+    }
+  }
+
+  /**
+   * @return how many cycles make up one microsecond
+   */
+  double CyclesPerMicrosecond() {
+    // 启动时记下了一对(cycle, 时间)，和现在比一下就能算出频率
+    auto elapsed = std::chrono::steady_clock::now() - start_time_;
+    if (elapsed < std::chrono::milliseconds(10)) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10) - elapsed);
+    }
+    uint64_t cycles = ReadCycleCounter() - start_cycles_;
+    double micros = std::chrono::duration<double, std::micro>(
+                        std::chrono::steady_clock::now() - start_time_)
+                        .count();
+    return static_cast<double>(cycles) / micros;
+  }
+
+  /**
+   * Writes every recorded event in the Chrome trace-event JSON format
+   * (chrome://tracing, Perfetto). No thread may be recording.
+   */
+  void DumpChromeTrace(std::ostream &out) {
+    double cycles_per_us = CyclesPerMicrosecond();
+    std::lock_guard<std::mutex> lock(latch_);
+    out << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+    bool first = true;
+    for (uint32_t tid = 0; tid < threads_.size(); tid++) {
+      for (const auto &event : threads_[tid]->events_) {
+        out << (first ? "\n" : ",\n") << R"({"name":")"
+            << TracePointName(event.point_)
+            << R"(","cat":"storage","ph":"X","pid":0,"tid":)" << tid
+            << ",\"ts\":"
+            << static_cast<double>(event.start_ - start_cycles_) /
+                   cycles_per_us
+            << ",\"dur\":"
+            << static_cast<double>(event.duration_) / cycles_per_us << "}";
+        first = false;
+      }
+    }
+    out << "\n]}\n";
+  }
+
+private:
+  struct ThreadTrace {
+    LatencyHistogram histograms_[NUM_TRACE_POINTS];
+    std::vector<Event> events_;
+  };
+
+  Tracer()
+      : start_cycles_(ReadCycleCounter()),
+        start_time_(std::chrono::steady_clock::now()) {}
+
+  const uint64_t start_cycles_;
+  const std::chrono::steady_clock::time_point start_time_;
+  std::atomic<bool> events_enabled_{false};
+  uint64_t max_events_per_thread_ = 0;
+
+  // 线程退出之后数据也要保留，所以由tracer持有
+  std::mutex latch_;
+  std::vector<std::unique_ptr<ThreadTrace>> threads_;
+
+  ThreadTrace &Local() {
+    thread_local ThreadTrace *local = nullptr;
+    if (local == nullptr) {
+      std::lock_guard<std::mutex> lock(latch_);
+      threads_.push_back(std::make_unique<ThreadTrace>());
+      local = threads_.back().get();
+    }
+    return *local;
+  }
+};
+
+/**
+ * Records the time between its construction and destruction with the
+ * Tracer.
+ */
+class ScopedTimer {
+public:
+  explicit ScopedTimer(TracePoint point)
+      : point_(point), start_(ReadCycleCounter()) {}
+
+  ~ScopedTimer() { Tracer::Get().Record(point_, start_, ReadCycleCounter()); }
+
+  DISALLOW_COPY_AND_MOVE(ScopedTimer);
+
+private:
+  const TracePoint point_;
+  const uint64_t start_;
+};
+} // namespace noisepage
+
+#define NOISEPAGE_TRACE_CONCAT_INNER(a, b) a##b
+#define NOISEPAGE_TRACE_CONCAT(a, b) NOISEPAGE_TRACE_CONCAT_INNER(a, b)
+
+// 编译时没有打开NOISEPAGE_TRACING的话什么都不生成
+#ifdef NOISEPAGE_TRACING
+#define NOISEPAGE_TRACE_SCOPE(point)                                           \
+  ::noisepage::ScopedTimer NOISEPAGE_TRACE_CONCAT(trace_scope_, __LINE__)(     \
+      ::noisepage::TracePoint::point)
+#else
+#define NOISEPAGE_TRACE_SCOPE(point)
+#endif
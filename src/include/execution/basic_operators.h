@@ -0,0 +1,109 @@
+#pragma once
+#include "execution/operator.h"
+#include "storage/predicate.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace noisepage::execution {
+/**
+ * Narrows batch's selection to the rows whose integer column col satisfies
+ * predicate; predicate.col_id_ is ignored. Nulls never satisfy it.
+ */
+void FilterSelection(const storage::ColumnPredicate &predicate, uint16_t col,
+                     ColumnBatch *batch);
+
+/**
+ * Keeps the rows that satisfy every predicate. The col_id_ of a predicate
+ * is a column position in the incoming batches.
+ */
+class Filter : public Operator {
+public:
+  Filter(std::vector<storage::ColumnPredicate> predicates, Operator *next)
+      : Operator(next), predicates_(std::move(predicates)) {}
+
+  void Consume(ColumnBatch *batch) override {
+    for (const auto &predicate : predicates_) {
+      FilterSelection(predicate, predicate.col_id_, batch);
+      if (batch->NumSelected() == 0) {
+        return;
+      }
+    }
+    next_->Consume(batch);
+  }
+
+private:
+  const std::vector<storage::ColumnPredicate> predicates_;
+};
+
+/**
+ * Passes on the columns at the given positions, in that order, with the
+ * selected rows packed to the front.
+ */
+class Project : public Operator {
+public:
+  Project(std::vector<uint16_t> columns, Operator *next)
+      : Operator(next), columns_(std::move(columns)) {}
+
+  void Consume(ColumnBatch *batch) override;
+
+private:
+  const std::vector<uint16_t> columns_;
+  PerThread<ColumnBatch> outputs_;
+};
+
+/**
+ * Passes on the first limit rows it sees and drops the rest. Which rows
+ * those are is only defined if the input arrives in order from one thread,
+ * e.g. from a Sort.
+ */
+class Limit : public Operator {
+public:
+  Limit(uint64_t limit, Operator *next) : Operator(next), limit_(limit) {}
+
+  void Consume(ColumnBatch *batch) override {
+    uint64_t n = batch->NumSelected();
+    uint64_t taken = num_taken_.fetch_add(n);
+    if (taken >= limit_) {
+      return;
+    }
+    batch->SetNumSelected(static_cast<uint32_t>(std::min(n, limit_ - taken)));
+    next_->Consume(batch);
+  }
+
+private:
+  const uint64_t limit_;
+  std::atomic<uint64_t> num_taken_{0};
+};
+
+/**
+ * End of a pipeline that keeps every row it is given, in arrival order.
+ */
+class ResultCollector : public Operator {
+public:
+  ResultCollector() : Operator(nullptr) {}
+
+  void Consume(ColumnBatch *batch) override {
+    std::lock_guard<std::mutex> lock(latch_);
+    if (rows_ == nullptr) {
+      rows_ = std::make_unique<RowBuffer>(batch->AttrSizes());
+    }
+    rows_->Append(*batch);
+  }
+
+  void Finish() override {}
+
+  uint64_t NumRows() const { return rows_ == nullptr ? 0 : rows_->NumRows(); }
+
+  /**
+   * @return the rows collected, nullptr if there were none
+   */
+  const RowBuffer *Rows() const { return rows_.get(); }
+
+private:
+  std::mutex latch_;
+  std::unique_ptr<RowBuffer> rows_;
+};
+} // namespace noisepage::execution
@@ -0,0 +1,104 @@
+#pragma once
+#include "execution/operator.h"
+#include <vector>
+
+namespace noisepage::execution {
+enum class AggregateType : uint8_t { COUNT_STAR, COUNT, SUM, MIN, MAX };
+
+/**
+ * One aggregate over the integer column at position col_ of the input
+ * batches; col_ is ignored for COUNT_STAR.
+ */
+struct AggregateSpec {
+  AggregateType type_;
+  uint16_t col_;
+};
+
+/**
+ * 每个线程一张hash表，Finish时合并
+ * Groups its input on the integer columns at positions group_by and computes
+ * aggregates for every group. Every worker builds a hash table of its own,
+ * so Consume takes no latch; Finish merges them and emits one row per
+ * group: the group keys, then the aggregates, all 8 bytes wide. A null key
+ * forms a group of its own. COUNT and COUNT_STAR are never null; SUM, MIN
+ * and MAX are null for groups with no non-null input. Without group_by the
+ * output is exactly one row, even for empty input. At most 64 group keys.
+ */
+class HashAggregate : public Operator {
+public:
+  HashAggregate(std::vector<uint16_t> group_by,
+                std::vector<AggregateSpec> aggregates, Operator *next);
+
+  void Consume(ColumnBatch *batch) override;
+
+  void Finish() override;
+
+private:
+  class GroupTable {
+  public:
+    GroupTable(uint16_t num_keys, uint16_t num_aggregates);
+
+    uint32_t NumGroups() const { return static_cast<uint32_t>(hashes_.size()); }
+
+    /**
+     * @return index of the group with the given keys, added if it is new
+     */
+    uint32_t FindOrInsert(uint64_t hash, const int64_t *keys,
+                          uint64_t key_nulls);
+
+    /**
+     * Adds the groups and aggregate values of other to this table.
+     */
+    void Merge(const GroupTable &other,
+               const std::vector<AggregateSpec> &aggregates);
+
+    void Update(const AggregateSpec &spec, uint32_t group, uint16_t agg,
+                int64_t value);
+
+    const int64_t *Keys(uint32_t group) const {
+      return keys_.data() + static_cast<uint64_t>(group) * num_keys_;
+    }
+
+    uint64_t KeyNulls(uint32_t group) const { return key_nulls_[group]; }
+
+    int64_t &Value(uint32_t group, uint16_t agg) {
+      return values_[static_cast<uint64_t>(group) * num_aggregates_ + agg];
+    }
+
+    int64_t Value(uint32_t group, uint16_t agg) const {
+      return values_[static_cast<uint64_t>(group) * num_aggregates_ + agg];
+    }
+
+    uint64_t &Count(uint32_t group, uint16_t agg) {
+      return counts_[static_cast<uint64_t>(group) * num_aggregates_ + agg];
+    }
+
+    uint64_t Count(uint32_t group, uint16_t agg) const {
+      return counts_[static_cast<uint64_t>(group) * num_aggregates_ + agg];
+    }
+
+    // Consume用的临时空间，每行的key、null位、hash和所在group
+    std::vector<int64_t> row_keys_;
+    std::vector<uint64_t> row_key_nulls_;
+    std::vector<uint64_t> row_hashes_;
+    std::vector<uint32_t> row_groups_;
+
+  private:
+    const uint16_t num_keys_;
+    const uint16_t num_aggregates_;
+    // 开放寻址，存group下标+1，0表示空
+    std::vector<uint32_t> buckets_;
+    std::vector<uint64_t> hashes_;
+    std::vector<int64_t> keys_;
+    std::vector<uint64_t> key_nulls_;
+    std::vector<int64_t> values_;
+    std::vector<uint64_t> counts_;
+
+    void Grow();
+  };
+
+  const std::vector<uint16_t> group_by_;
+  const std::vector<AggregateSpec> aggregates_;
+  PerThread<GroupTable> tables_;
+};
+} // namespace noisepage::execution
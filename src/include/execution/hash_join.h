@@ -0,0 +1,93 @@
+#pragma once
+#include "execution/operator.h"
+#include <vector>
+
+namespace noisepage::execution {
+/**
+ * 建hash表的一侧，是一条pipeline的终点
+ * Build side of an inner hash join, the end of its own pipeline: keeps the
+ * rows it is given, every worker in a buffer of its own, and on Finish
+ * concatenates them and hashes the integer columns at positions keys. Rows
+ * with a null key never match and are dropped. The build pipeline must be
+ * finished before the probe pipeline starts.
+ */
+class HashJoinBuild : public Operator {
+public:
+  explicit HashJoinBuild(std::vector<uint16_t> keys)
+      : Operator(nullptr), keys_(std::move(keys)) {}
+
+  void Consume(ColumnBatch *batch) override;
+
+  void Finish() override;
+
+  uint16_t NumKeys() const { return static_cast<uint16_t>(keys_.size()); }
+
+  uint64_t NumRows() const { return rows_ == nullptr ? 0 : rows_->NumRows(); }
+
+  /**
+   * Calls fn(row) on every build row whose keys could equal the given ones;
+   * the caller compares the keys itself.
+   */
+  template <typename F>
+  void ForEachCandidate(uint64_t hash, const F &fn) const {
+    if (buckets_.empty()) {
+      return;
+    }
+    for (uint64_t entry = buckets_[hash & (buckets_.size() - 1)]; entry != 0;
+         entry = next_in_chain_[entry - 1]) {
+      if (hashes_[entry - 1] == hash) {
+        fn(entry - 1);
+      }
+    }
+  }
+
+  /**
+   * @return the value of key k (an index into the keys given at
+   * construction) of build row row
+   */
+  int64_t Key(uint16_t k, uint64_t row) const {
+    return rows_->ReadInteger(keys_[k], row);
+  }
+
+  const RowBuffer &Rows() const { return *rows_; }
+
+private:
+  const std::vector<uint16_t> keys_;
+  PerThread<RowBuffer> partitions_;
+  std::unique_ptr<RowBuffer> rows_;
+  std::vector<uint64_t> hashes_;
+  // 链表式的hash表，存行号+1，0表示链尾
+  std::vector<uint64_t> buckets_;
+  std::vector<uint64_t> next_in_chain_;
+};
+
+/**
+ * Probe side of an inner hash join: for every row of its input it emits one
+ * row per build row with equal keys, made of all the probe columns followed
+ * by all the build columns. keys are positions in the probe batches, paired
+ * with the build keys in order.
+ */
+class HashJoinProbe : public Operator {
+public:
+  HashJoinProbe(const HashJoinBuild *build, std::vector<uint16_t> keys,
+                Operator *next)
+      : Operator(next), build_(build), keys_(std::move(keys)) {}
+
+  void Consume(ColumnBatch *batch) override;
+
+private:
+  struct ProbeState {
+    std::unique_ptr<ColumnBatch> output_;
+    // 等待输出的匹配：probe行和build行
+    std::vector<uint32_t> probe_rows_;
+    std::vector<uint64_t> build_rows_;
+    std::vector<int64_t> row_keys_;
+  };
+
+  const HashJoinBuild *const build_;
+  const std::vector<uint16_t> keys_;
+  PerThread<ProbeState> states_;
+
+  void Flush(const ColumnBatch &batch, ProbeState *state);
+};
+} // namespace noisepage::execution
@@ -0,0 +1,132 @@
+#pragma once
+#include "common/macros.h"
+#include "common/per_thread.h"
+#include "storage/column_batch.h"
+#include <vector>
+
+namespace noisepage::execution {
+using storage::ColumnBatch;
+
+/**
+ * 推的模型：上游把batch交给下游
+ * An operator of a push-based pipeline. The source (TableScan) pushes
+ * batches into the first operator, which pushes its output on to next, and
+ * so on. Consume may be called from several threads at once, one batch per
+ * call; per-thread state goes into a PerThread. The batch belongs to the
+ * caller, and the operator may narrow its selection. Finish is called once
+ * after every Consume has returned; operators that need all their input
+ * before producing output (aggregation, sort, join build) emit it there.
+ */
+class Operator {
+public:
+  explicit Operator(Operator *next) : next_(next) {}
+
+  virtual ~Operator() = default;
+
+  DISALLOW_COPY_AND_MOVE(Operator);
+
+  virtual void Consume(ColumnBatch *batch) = 0;
+
+  virtual void Finish() {
+    if (next_ != nullptr) {
+      next_->Finish();
+    }
+  }
+
+protected:
+  Operator *const next_;
+};
+
+/**
+ * Folds value into a hash of the values before it; used for join and
+ * grouping keys.
+ */
+inline uint64_t HashCombine(uint64_t hash, int64_t value) {
+  // murmur3的finalizer
+  uint64_t h = hash ^ (static_cast<uint64_t>(value) + 0x9E3779B97F4A7C15ull +
+                       (hash << 6) + (hash >> 2));
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDull;
+  h ^= h >> 33;
+  h *= 0xC4CEB9FE1A85EC53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+/**
+ * 攒起来的行，按列存
+ * Rows held by an operator until its input ends, stored column by column
+ * like a ColumnBatch but growing as needed.
+ */
+class RowBuffer {
+public:
+  explicit RowBuffer(std::vector<uint16_t> attr_sizes)
+      : attr_sizes_(std::move(attr_sizes)), values_(attr_sizes_.size()),
+        present_(attr_sizes_.size()) {}
+
+  uint16_t NumColumns() const {
+    return static_cast<uint16_t>(attr_sizes_.size());
+  }
+
+  const std::vector<uint16_t> &AttrSizes() const { return attr_sizes_; }
+
+  uint64_t NumRows() const { return num_rows_; }
+
+  /**
+   * Appends the selected rows of batch, which has the same columns.
+   */
+  void Append(const ColumnBatch &batch);
+
+  /**
+   * Appends every row of other, which has the same columns.
+   */
+  void Append(const RowBuffer &other);
+
+  bool IsNull(uint16_t col, uint64_t row) const {
+    return present_[col][row] == 0;
+  }
+
+  /**
+   * @return pointer to the value, nullptr if it is null
+   */
+  const byte *Access(uint16_t col, uint64_t row) const {
+    return IsNull(col, row) ? nullptr
+                            : values_[col].data() + row * attr_sizes_[col];
+  }
+
+  int64_t ReadInteger(uint16_t col, uint64_t row) const {
+    return storage::StorageUtil::ReadInteger(
+        attr_sizes_[col], values_[col].data() + row * attr_sizes_[col]);
+  }
+
+  /**
+   * Copies rows[0, num_rows) into columns [first_col, first_col +
+   * NumColumns()) of batch's rows [first_row, first_row + num_rows).
+   */
+  void Gather(const uint64_t *rows, uint32_t num_rows, ColumnBatch *batch,
+              uint16_t first_col = 0, uint32_t first_row = 0) const;
+
+private:
+  const std::vector<uint16_t> attr_sizes_;
+  std::vector<std::vector<byte>> values_;
+  // 一行一个byte，比bitmap好拼
+  std::vector<std::vector<uint8_t>> present_;
+  uint64_t num_rows_ = 0;
+};
+
+/**
+ * Copies column from_col of from's rows[0, num_rows) (repeats allowed) into
+ * column to_col of to's rows [first_row, first_row + num_rows).
+ */
+void GatherColumn(const ColumnBatch &from, uint16_t from_col,
+                  const uint32_t *rows, uint32_t num_rows, ColumnBatch *to,
+                  uint16_t to_col, uint32_t first_row = 0);
+
+/**
+ * Copies from's rows[0, num_rows) (repeats allowed) into columns
+ * [first_col, first_col + from.NumColumns()) of to's rows [first_row,
+ * first_row + num_rows).
+ */
+void Gather(const ColumnBatch &from, const uint32_t *rows, uint32_t num_rows,
+            ColumnBatch *to, uint16_t first_col = 0, uint32_t first_row = 0);
+} // namespace noisepage::execution
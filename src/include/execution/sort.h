@@ -0,0 +1,41 @@
+#pragma once
+#include "execution/operator.h"
+#include <vector>
+
+namespace noisepage::execution {
+/**
+ * Orders on the integer column at position col_ of the input batches.
+ */
+struct SortKey {
+  uint16_t col_;
+  bool ascending_ = true;
+};
+
+/**
+ * Keeps all of its input, every worker in a buffer of its own, and on
+ * Finish emits it ordered on keys, nulls first when ascending. With a limit
+ * only the first limit rows are ordered and emitted (top-k). Output comes
+ * from one thread, in order.
+ */
+class Sort : public Operator {
+public:
+  Sort(std::vector<SortKey> keys, Operator *next,
+       uint64_t limit = UINT64_MAX)
+      : Operator(next), keys_(std::move(keys)), limit_(limit) {}
+
+  void Consume(ColumnBatch *batch) override {
+    std::unique_ptr<RowBuffer> &partition = partitions_.Local();
+    if (partition == nullptr) {
+      partition = std::make_unique<RowBuffer>(batch->AttrSizes());
+    }
+    partition->Append(*batch);
+  }
+
+  void Finish() override;
+
+private:
+  const std::vector<SortKey> keys_;
+  const uint64_t limit_;
+  PerThread<RowBuffer> partitions_;
+};
+} // namespace noisepage::execution
@@ -0,0 +1,62 @@
+#pragma once
+#include "common/scheduler.h"
+#include "execution/operator.h"
+#include "storage/data_table.h"
+#include <vector>
+
+namespace noisepage::execution {
+/**
+ * 一条pipeline的源头
+ * Source of a pipeline: reads columns col_ids of the tuples of table
+ * visible at timestamp in batches (see DataTable::ScanColumns) and pushes
+ * the ones satisfying every predicate into next. Batch column i holds
+ * col_ids[i]. Predicates name table columns, all of which must be in
+ * col_ids; they prune blocks through the zone maps and are then evaluated
+ * on the batches.
+ *
+ * Run with a Scheduler splits the table into morsels of blocks that the
+ * workers take as they become free, each scanning into a batch of its own,
+ * so downstream operators see batches from several threads at once.
+ */
+class TableScan {
+public:
+  TableScan(storage::DataTable *table, timestamp_t timestamp,
+            std::vector<uint16_t> col_ids,
+            std::vector<storage::ColumnPredicate> predicates, Operator *next,
+            uint32_t batch_size = ColumnBatch::DEFAULT_CAPACITY);
+
+  DISALLOW_COPY_AND_MOVE(TableScan);
+
+  /**
+   * Runs the pipeline on the calling thread, then finishes it.
+   */
+  void Run() {
+    ScanMorsel(0, table_->NumBlocks());
+    next_->Finish();
+  }
+
+  /**
+   * Runs the pipeline on scheduler, then finishes it.
+   */
+  void Run(Scheduler *scheduler, uint64_t blocks_per_morsel = 1) {
+    scheduler->ParallelFor(
+        0, table_->NumBlocks(), blocks_per_morsel,
+        [this](uint64_t begin, uint64_t end) { ScanMorsel(begin, end); });
+    next_->Finish();
+  }
+
+private:
+  storage::DataTable *const table_;
+  const timestamp_t timestamp_;
+  const std::vector<uint16_t> col_ids_;
+  const std::vector<storage::ColumnPredicate> predicates_;
+  // 同样的谓词，col_id_换成batch里的位置
+  std::vector<storage::ColumnPredicate> batch_predicates_;
+  Operator *const next_;
+  const uint32_t batch_size_;
+  std::vector<uint16_t> attr_sizes_;
+  PerThread<ColumnBatch> batches_;
+
+  void ScanMorsel(uint64_t begin, uint64_t end);
+};
+} // namespace noisepage::execution
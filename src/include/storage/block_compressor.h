@@ -0,0 +1,57 @@
+#pragma once
+#include "storage/compressed_block.h"
+#include "storage/predicate.h"
+#include "storage/tuple_access_strategy.h"
+
+namespace noisepage::storage {
+/**
+ * 把frozen block的每一列用dictionary, frame-of-reference + bit-packing或者
+ * run-length中最小的那种编码重新存一份
+ * Re-encodes every column of a frozen block with whichever of dictionary,
+ * frame-of-reference + bit-packing or run-length encoding is smallest
+ * (falling back to a plain copy). Once no reader can still be inside the
+ * original value arrays, their pages can be given back to the OS. Null
+ * bitmaps stay in the block.
+ */
+class BlockCompressor {
+public:
+  BlockCompressor() = delete;
+
+  /**
+   * Compresses a frozen block and publishes the copy, which readers that see
+   * the block COMPRESSED read from then on. Readers that saw it frozen may
+   * still be in the value arrays, so their pages are only given back by
+   * ReleasePages. Must not run concurrently with writers of the block.
+   * @param previous set to the copy left by an earlier compression, or
+   * nullptr; readers may still be decoding it
+   * @return false if the block is not frozen
+   */
+  static bool Compress(RawBlock *block, const BlockLayout &layout,
+                       CompressedBlock **previous);
+
+  /**
+   * Gives the pages of block's value arrays back to the OS if block is still
+   * compressed into copy, i.e. no writer decompressed it since. Writers that
+   * decompress meanwhile wait for it.
+   */
+  static void ReleasePages(RawBlock *block, const BlockLayout &layout,
+                           const CompressedBlock *copy);
+
+  /**
+   * Decodes a compressed block back into its value arrays and marks it hot.
+   * Readers may keep reading the compressed copy while this runs; if several
+   * writers race, one decodes and the rest wait for it. The copy stays until
+   * the block is compressed again or released.
+   */
+  static void Decompress(RawBlock *block, const BlockLayout &layout);
+
+  /**
+   * Same contract as PredicateKernels::Evaluate, but reads the encoded column
+   * without decoding it into values first.
+   */
+  static void Evaluate(const ColumnPredicate &predicate,
+                       const CompressedBlock &compressed,
+                       const RawConcurrentBitmap *null_bitmap,
+                       uint32_t num_slots, uint8_t *selection);
+};
+} // namespace noisepage::storage
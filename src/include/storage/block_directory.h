@@ -0,0 +1,79 @@
+#pragma once
+#include "common/macros.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace noisepage::storage {
+class RawBlock;
+
+/**
+ * block id到地址的映射，TupleSlot里存的是id
+ * Process-wide table from block id to the address the block currently lives
+ * at. TupleSlots carry the id instead of the address, so a block can be
+ * moved (compacted, swapped in from elsewhere, reloaded after a restart) by
+ * copying it and pointing its id at the copy; slots held by indexes stay
+ * valid. Resolving an id is one load from a flat array that is reserved up
+ * front and only backed by memory as ids get handed out.
+ *
+ * Id 0 is never handed out, so the default TupleSlot resolves to nullptr.
+ * Freed ids are reused, just like freed block addresses used to be.
+ */
+class BlockDirectory {
+public:
+  static constexpr uint32_t MAX_BLOCKS = 1u << 26;
+
+  static BlockDirectory &Get() {
+    static BlockDirectory directory;
+    return directory;
+  }
+
+  DISALLOW_COPY_AND_MOVE(BlockDirectory);
+
+  RawBlock *Resolve(uint32_t block_id) const {
+    return addresses_[block_id].load(std::memory_order_acquire);
+  }
+
+  /**
+   * @return a fresh id that resolves to block
+   */
+  uint32_t Register(RawBlock *block);
+
+  /**
+   * Makes block_id resolve to nullptr and lets it be handed out again.
+   */
+  void Unregister(uint32_t block_id);
+
+  /**
+   * Points block_id at to if it still points at from. The caller copies the
+   * block first and keeps writers away from it until the swap is done.
+   * Readers that resolved the id before the swap may still be reading from,
+   * so the caller must not free from until none can be.
+   * @return false if block_id was pointed somewhere else meanwhile
+   */
+  bool Relocate(uint32_t block_id, RawBlock *from, RawBlock *to) {
+    return addresses_[block_id].compare_exchange_strong(from, to);
+  }
+
+  /**
+   * Count of threads writing the block with this id, for the block's owner
+   * to keep writers away while it moves the block. It lives here rather than
+   * in the block so it follows the id through Relocate and is not lost when
+   * a ColdTier maps a file over the block. Zero for a freshly handed out id.
+   */
+  std::atomic<uint32_t> &Writers(uint32_t block_id) {
+    return writers_[block_id];
+  }
+
+private:
+  BlockDirectory();
+  ~BlockDirectory();
+
+  std::atomic<RawBlock *> *addresses_;
+  std::atomic<uint32_t> *writers_;
+  std::mutex latch_;
+  uint32_t next_id_ = 1;
+  std::vector<uint32_t> free_ids_;
+};
+} // namespace noisepage::storage
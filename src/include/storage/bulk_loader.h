@@ -0,0 +1,121 @@
+#pragma once
+#include "common/macros.h"
+#include "common/scheduler.h"
+#include "storage/data_table.h"
+#include "storage/storage_defs.h"
+#include <mutex>
+#include <vector>
+
+namespace noisepage::storage {
+/**
+ * One column of input to a bulk load: the values of every row packed back
+ * to back at the column's attribute size, and optionally a bitmap of which
+ * rows are not null, in RawConcurrentBitmap bit order. Without one no row is
+ * null.
+ */
+struct BulkLoadColumn {
+  uint16_t col_id_;
+  const byte *values_;
+  const uint8_t *present_ = nullptr;
+};
+
+/**
+ * 并行导入，commit之前谁都看不到
+ * A bulk load into a DataTable that becomes visible all at once. Load may
+ * be called from any number of threads at the same time; every call copies
+ * columns straight into whole blocks of its own from the BlockStore and
+ * never touches the table. Commit then publishes all of them in one step,
+ * so readers see either none or all of the loaded rows. A loader destroyed
+ * without committing gives its blocks back. Loading and committing may run
+ * concurrently with every other DataTable operation.
+ *
+ * Loaded rows have no version chain and are visible at every timestamp, so
+ * no undo records are needed. Their blocks are frozen with exact zone maps.
+ */
+class BulkLoader {
+public:
+  explicit BulkLoader(DataTable *table) : table_(table) {}
+
+  ~BulkLoader() {
+    for (RawBlock *block : blocks_) {
+      table_->FreeBlock(block);
+    }
+  }
+
+  DISALLOW_COPY_AND_MOVE(BulkLoader);
+
+  /**
+   * Loads rows [first_row, first_row + num_rows) of columns into new frozen
+   * blocks. Columns that are not given are null.
+   * @param slots if not null, receives the slot of every row in order
+   */
+  void Load(const std::vector<BulkLoadColumn> &columns, uint32_t first_row,
+            uint32_t num_rows, std::vector<TupleSlot> *slots = nullptr) {
+    std::vector<RawBlock *> blocks;
+    LoadRows(table_, columns, first_row, num_rows, &blocks, slots);
+    std::lock_guard<std::mutex> lock(latch_);
+    blocks_.insert(blocks_.end(), blocks.begin(), blocks.end());
+  }
+
+  /**
+   * Makes every row loaded so far visible. No Load may be in progress.
+   */
+  void Commit() {
+    table_->PublishBlocks(blocks_);
+    blocks_.clear();
+  }
+
+  /**
+   * Loads num_rows rows of columns into table on the calling thread. The
+   * table's insertion head is filled first if it is still empty, e.g. in a
+   * new table, and the last block takes later inserts if it has room. Must
+   * not run concurrently with Insert.
+   * @param slots if not null, receives the slot of every row in order
+   */
+  static void BulkLoad(DataTable *table,
+                       const std::vector<BulkLoadColumn> &columns,
+                       uint32_t num_rows,
+                       std::vector<TupleSlot> *slots = nullptr);
+
+  /**
+   * Splits the rows between num_threads threads (0 is taken as 1) that load
+   * them through one BulkLoader, and commits it. Only the last block can be
+   * partially filled. Unlike BulkLoad, no block takes later inserts, and
+   * this may run concurrently with Insert.
+   * @param slots if not null, receives the slot of every row in order
+   */
+  static void ParallelBulkLoad(DataTable *table,
+                               const std::vector<BulkLoadColumn> &columns,
+                               uint32_t num_rows, uint32_t num_threads,
+                               std::vector<TupleSlot> *slots = nullptr);
+
+  /**
+   * ParallelBulkLoad on the workers of scheduler instead of threads of its
+   * own; blocks are handed out in ranges as workers become free.
+   */
+  static void ParallelBulkLoad(DataTable *table,
+                               const std::vector<BulkLoadColumn> &columns,
+                               uint32_t num_rows, Scheduler *scheduler,
+                               std::vector<TupleSlot> *slots = nullptr);
+
+private:
+  DataTable *const table_;
+  std::mutex latch_;
+  std::vector<RawBlock *> blocks_;
+
+  /**
+   * Loads rows [first_row, first_row + num_rows) of columns into new frozen
+   * blocks that are not yet part of table, appending them to blocks.
+   * @return number of rows in the last block
+   */
+  static uint32_t LoadRows(DataTable *table,
+                           const std::vector<BulkLoadColumn> &columns,
+                           uint32_t first_row, uint32_t num_rows,
+                           std::vector<RawBlock *> *blocks,
+                           std::vector<TupleSlot> *slots);
+
+  static void LoadBlock(DataTable *table, RawBlock *block,
+                        const std::vector<BulkLoadColumn> &columns,
+                        uint32_t first_row, uint32_t num_rows);
+};
+} // namespace noisepage::storage
@@ -0,0 +1,134 @@
+#pragma once
+#include "common/macros.h"
+#include "storage/tuple_access_strategy.h"
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace noisepage::storage {
+/**
+ * 内存不够时把frozen block换到文件里，地址不变
+ * Keeps at most memory_budget bytes of frozen blocks in memory and moves the
+ * rest out to a file. An evicted block is written to an extent of the file,
+ * which is then mapped privately over the block's own address, so every
+ * TupleSlot stays valid and the anonymous memory goes back to the OS. Reads
+ * fault pages back in from the page cache, which the kernel can drop again
+ * under pressure; writes copy the pages they touch back into private memory.
+ *
+ * Victims are picked with CLOCK over the tracked blocks that are still in
+ * memory. DataTable sets a block's reference bit when it reads or writes
+ * the block. Only frozen blocks are evicted; hot and compressed blocks stay
+ * in memory and still count against the budget while tracked. Victims are
+ * picked under the tier's latch but written out after releasing it, so
+ * other tables can track and touch blocks meanwhile.
+ */
+class ColdTier {
+public:
+  /**
+   * @param path file to keep evicted blocks in. It is unlinked right away and
+   * goes away with the tier.
+   * @param memory_budget bytes of tracked blocks to keep in memory
+   */
+  ColdTier(const std::string &path, uint64_t memory_budget);
+
+  /**
+   * Every block must have been forgotten.
+   */
+  ~ColdTier();
+
+  DISALLOW_COPY_AND_MOVE(ColdTier);
+
+  /**
+   * Sets block's reference bit. Only stores if the bit is clear, so blocks
+   * that are read all the time do not keep writing their header.
+   */
+  static void Touch(RawBlock *block) {
+    auto &referenced = reinterpret_cast<Block *>(block)->referenced_;
+    if (referenced.load(std::memory_order_relaxed) == 0) {
+      referenced.store(1, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * Starts managing a block that was just frozen, then evicts blocks until
+   * the budget is met. A block that was already tracked is counted as being
+   * in memory again, since writers may have copied its pages back.
+   * @throw std::system_error if a victim could not be written out; it and
+   * the victims after it stay in memory
+   */
+  void Track(RawBlock *block, uint32_t block_size);
+
+  /**
+   * Counts a block that a writer just thawed as being in memory again, since
+   * its pages are being copied back. Evicting other blocks to make room for
+   * it is left to the next Track, so writers never do I/O. Waits for an
+   * eviction of the block in progress to finish; does nothing for blocks
+   * that are not tracked or not evicted.
+   */
+  void Thawed(RawBlock *block);
+
+  /**
+   * Stops managing block and gives it fresh anonymous memory if it was
+   * evicted, waiting for an eviction in progress to finish. Must be called
+   * before the block goes back to the BlockStore; does nothing for blocks
+   * that are not tracked.
+   */
+  void Forget(RawBlock *block);
+
+  bool IsEvicted(RawBlock *block);
+
+  uint64_t ResidentBytes();
+
+  uint64_t EvictedBytes();
+
+private:
+  static constexpr uint64_t NO_EXTENT = UINT64_MAX;
+
+  struct Entry {
+    RawBlock *block_;
+    uint32_t block_size_;
+    uint64_t extent_;
+    bool evicted_;
+    // 被驱逐过的block就算又回到内存里，没写过的页还是映射着文件
+    bool file_backed_;
+    // 正在latch外面写文件，已经不算在resident_bytes_里
+    bool evicting_;
+  };
+
+  struct Victim {
+    RawBlock *block_;
+    uint32_t block_size_;
+    uint64_t extent_;
+  };
+
+  const int fd_;
+  const uint64_t memory_budget_;
+  std::mutex latch_;
+  // evicting_的block写完了
+  std::condition_variable eviction_done_;
+  std::vector<Entry> entries_;
+  std::unordered_map<RawBlock *, uint64_t> index_;
+  uint64_t hand_ = 0;
+  uint64_t resident_bytes_ = 0;
+  uint64_t evicted_bytes_ = 0;
+  uint64_t file_size_ = 0;
+  std::vector<std::vector<uint64_t>> free_extents_;
+
+  /**
+   * Picks blocks to evict until the budget would be met, and marks them
+   * EVICTING. Must hold the latch.
+   */
+  void PickVictims(std::vector<Victim> *victims);
+
+  /**
+   * Writes victims out and maps the file over them, without the latch.
+   */
+  void Evict(const std::vector<Victim> &victims);
+
+  void WriteOut(const Victim &victim);
+
+  uint64_t AllocateExtent(uint32_t block_size);
+};
+} // namespace noisepage::storage
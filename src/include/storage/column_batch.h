@@ -0,0 +1,125 @@
+#pragma once
+#include "common/concurrent_bitmap.h"
+#include "common/macros.h"
+#include "storage/storage_defs.h"
+#include "storage/storage_util.h"
+#include <numeric>
+#include <vector>
+
+namespace noisepage::storage {
+/**
+ * 一批行，按列存，加一个selection vector
+ * Up to Capacity() rows stored column by column: every column is a dense
+ * array of fixed-size values plus a present bitmap (1 if not null, in
+ * RawConcurrentBitmap bit order), the same shape as a MiniBlock. Which rows
+ * are still live is kept in a selection vector of row indexes, so filters
+ * only rewrite the selection and never move values. Filled by
+ * DataTable::ScanColumns and by the operators in execution/.
+ */
+class ColumnBatch {
+public:
+  static constexpr uint32_t DEFAULT_CAPACITY = 1024;
+
+  explicit ColumnBatch(std::vector<uint16_t> attr_sizes,
+                       uint32_t capacity = DEFAULT_CAPACITY)
+      : attr_sizes_(std::move(attr_sizes)), capacity_(capacity),
+        values_(attr_sizes_.size()), present_(attr_sizes_.size()),
+        slots_(capacity), selection_(capacity) {
+    for (uint16_t i = 0; i < NumColumns(); i++) {
+      values_[i].resize(static_cast<uint64_t>(capacity) * attr_sizes_[i]);
+      present_[i].resize(BitmapSize(capacity));
+    }
+  }
+
+  DISALLOW_COPY_AND_MOVE(ColumnBatch);
+
+  uint16_t NumColumns() const {
+    return static_cast<uint16_t>(attr_sizes_.size());
+  }
+
+  const std::vector<uint16_t> &AttrSizes() const { return attr_sizes_; }
+
+  uint16_t AttrSize(uint16_t col) const { return attr_sizes_[col]; }
+
+  uint32_t Capacity() const { return capacity_; }
+
+  uint32_t NumRows() const { return num_rows_; }
+
+  /**
+   * Sets the number of filled rows and selects all of them.
+   */
+  void Reset(uint32_t num_rows) {
+    num_rows_ = num_rows;
+    num_selected_ = num_rows;
+    std::iota(selection_.begin(), selection_.begin() + num_rows, 0u);
+  }
+
+  byte *Values(uint16_t col) { return values_[col].data(); }
+
+  const byte *Values(uint16_t col) const { return values_[col].data(); }
+
+  uint8_t *Present(uint16_t col) { return present_[col].data(); }
+
+  const uint8_t *Present(uint16_t col) const { return present_[col].data(); }
+
+  bool IsNull(uint16_t col, uint32_t row) const {
+    return !(present_[col][row / BYTE_SIZE] & ONE_HOT_MASK(row % BYTE_SIZE));
+  }
+
+  /**
+   * @return pointer to the value, nullptr if it is null
+   */
+  const byte *Access(uint16_t col, uint32_t row) const {
+    return IsNull(col, row)
+               ? nullptr
+               : values_[col].data() +
+                     static_cast<uint64_t>(row) * attr_sizes_[col];
+  }
+
+  int64_t ReadInteger(uint16_t col, uint32_t row) const {
+    return StorageUtil::ReadInteger(
+        attr_sizes_[col],
+        values_[col].data() + static_cast<uint64_t>(row) * attr_sizes_[col]);
+  }
+
+  /**
+   * Sets a value of a row past the ones being read; value nullptr for null.
+   */
+  void Write(uint16_t col, uint32_t row, const byte *value) {
+    uint8_t &bits = present_[col][row / BYTE_SIZE];
+    if (value == nullptr) {
+      bits &= ONE_COLD_MASK(row % BYTE_SIZE);
+      return;
+    }
+    bits |= ONE_HOT_MASK(row % BYTE_SIZE);
+    std::memcpy(values_[col].data() +
+                    static_cast<uint64_t>(row) * attr_sizes_[col],
+                value, attr_sizes_[col]);
+  }
+
+  /**
+   * @return the slot each row was read from; only filled by scans
+   */
+  TupleSlot *Slots() { return slots_.data(); }
+
+  const TupleSlot *Slots() const { return slots_.data(); }
+
+  uint32_t *Selection() { return selection_.data(); }
+
+  const uint32_t *Selection() const { return selection_.data(); }
+
+  uint32_t NumSelected() const { return num_selected_; }
+
+  void SetNumSelected(uint32_t num_selected) { num_selected_ = num_selected; }
+
+private:
+  const std::vector<uint16_t> attr_sizes_;
+  const uint32_t capacity_;
+  std::vector<std::vector<byte>> values_;
+  std::vector<std::vector<uint8_t>> present_;
+  std::vector<TupleSlot> slots_;
+  std::vector<uint32_t> selection_;
+  uint32_t num_rows_ = 0;
+  uint32_t num_selected_ = 0;
+};
+} // namespace noisepage::storage
@@ -0,0 +1,95 @@
+#pragma once
+#include "storage/storage_defs.h"
+#include <cstring>
+
+namespace noisepage::storage {
+enum class ColumnEncoding : uint8_t {
+  PLAIN,
+  DICTIONARY,
+  FRAME_OF_REFERENCE,
+  RUN_LENGTH
+};
+
+/**
+ * 压缩后一列的元数据
+ * PLAIN:              data is the column array copied verbatim
+ * DICTIONARY:         data is num_entries_ sorted int64 values followed by
+ *                     one bit_width_-bit code per slot
+ * FRAME_OF_REFERENCE: data is one bit_width_-bit (value - base_) per slot
+ * RUN_LENGTH:         data is num_entries_ int64 values followed by
+ *                     num_entries_ 32-bit exclusive run ends
+ * Values of null or unallocated slots are unspecified. Columns that are not
+ * integers are always PLAIN.
+ */
+struct CompressedColumn {
+  ColumnEncoding encoding_;
+  uint8_t bit_width_;
+  uint16_t attr_size_;
+  uint32_t num_entries_;
+  int64_t base_;
+  uint64_t data_offset_;
+};
+
+/**
+ * Out-of-place encoded copy of the value arrays of a frozen block. The block
+ * header points to it and keeps its own null bitmaps, so only values live
+ * here.
+ * ----------------------------------------------------------------
+ * | size | columns[num_attrs] | col1 data | col2 data | ... | pad |
+ * ----------------------------------------------------------------
+ */
+class CompressedBlock {
+public:
+  CompressedBlock() = delete;
+  DISALLOW_COPY_AND_MOVE(CompressedBlock);
+  ~CompressedBlock() = delete;
+
+  // bit-packed数据末尾留出的padding，解码时可以一次读16个byte
+  static constexpr uint32_t PADDING = 16;
+
+  CompressedColumn *Columns() {
+    return reinterpret_cast<CompressedColumn *>(varlen_contents_);
+  }
+
+  const CompressedColumn *Columns() const {
+    return reinterpret_cast<const CompressedColumn *>(varlen_contents_);
+  }
+
+  const byte *Data(uint16_t col_id) const {
+    return reinterpret_cast<const byte *>(this) +
+           Columns()[col_id].data_offset_;
+  }
+
+  /**
+   * @return the pos-th bit_width-bit code packed little-endian into data
+   */
+  static uint64_t UnpackCode(const byte *data, uint32_t pos,
+                             uint8_t bit_width) {
+    if (bit_width == 0) {
+      return 0;
+    }
+    uint64_t bit_pos = static_cast<uint64_t>(pos) * bit_width;
+    unsigned __int128 word;
+    std::memcpy(&word, data + bit_pos / BYTE_SIZE, sizeof(word));
+    uint64_t code = static_cast<uint64_t>(word >> (bit_pos % BYTE_SIZE));
+    return bit_width == 64 ? code : code & ((uint64_t(1) << bit_width) - 1);
+  }
+
+  /**
+   * @return the integer stored at offset in column col_id, sign-extended
+   */
+  int64_t ReadInteger(uint16_t col_id, uint32_t offset) const;
+
+  /**
+   * Decodes the attribute at offset in column col_id into out, which must
+   * have room for layout.attr_sizes_[col_id] bytes.
+   */
+  void AttrAt(const BlockLayout &layout, uint16_t col_id, uint32_t offset,
+              byte *out) const;
+
+  uint64_t size_;
+
+private:
+  byte varlen_contents_[0];
+};
+} // namespace noisepage::storage
@@ -0,0 +1,179 @@
+#pragma once
+#include "common/macros.h"
+#include "storage/data_table.h"
+#include "storage/storage_defs.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+namespace noisepage::storage {
+/**
+ * What a writer does when the tuple it updates has an uncommitted version of
+ * another transaction.
+ */
+enum class ContentionPolicy : uint8_t {
+  // 立刻放弃，让调用者abort
+  ABORT,
+  // Retry after pauses that double each time, with jitter.
+  BACKOFF,
+  // Park in the tuple's wait queue until its owner calls Release.
+  WAIT
+};
+
+struct ContentionOptions {
+  ContentionPolicy policy_ = ContentionPolicy::BACKOFF;
+  // BACKOFF: attempts in total, and the range the pause doubles through
+  uint32_t max_attempts_ = 16;
+  std::chrono::microseconds min_backoff_{1};
+  std::chrono::microseconds max_backoff_{1000};
+  // WAIT: longest total wait, which also breaks deadlocks between waiters
+  std::chrono::microseconds wait_timeout_{10000};
+  // WAIT: a writer that finds this many already waiting for the tuple aborts
+  // at once instead of queueing behind them
+  uint32_t max_waiters_ = 8;
+};
+
+/**
+ * Conflict counts of one table since its ContentionManager was created.
+ */
+struct ContentionStats {
+  // Updates whose first attempt hit a conflict
+  uint64_t conflicts_ = 0;
+  // Attempts after a backoff pause or a wakeup
+  uint64_t retries_ = 0;
+  // Times a writer parked in a wait queue
+  uint64_t waits_ = 0;
+  // Updates that gave up: out of attempts, timed out or aborted early
+  uint64_t aborts_ = 0;
+  // Of those, aborted at once because the wait queue was full
+  uint64_t early_aborts_ = 0;
+};
+
+/**
+ * Exponential backoff with full jitter: each Pause sleeps a uniformly random
+ * time up to a bound that doubles from min to max, so writers that collided
+ * once spread out instead of colliding again in lockstep.
+ */
+class Backoff {
+public:
+  Backoff(std::chrono::microseconds min, std::chrono::microseconds max)
+      : bound_(std::max<int64_t>(1, min.count())), max_(max.count()) {}
+
+  void Pause();
+
+private:
+  int64_t bound_;
+  const int64_t max_;
+};
+
+/**
+ * 热点行上的写写冲突
+ * Retries DataTable::Update on write-write conflicts according to a policy
+ * instead of handing every conflict back to the caller, and counts them.
+ * One per table. With WAIT, a conflicting writer sleeps on the tuple until
+ * the owner of the conflicting version calls Release after committing or
+ * aborting, so owners that write through a manager must release every tuple
+ * they wrote. Only an owner that rolled back lets the writer through: one
+ * that committed did so after the writer's snapshot, and writing over its
+ * version would lose its update, so the writer gives up like under
+ * SsiManager's first-updater-wins. Waiting is striped: writers on tuples that hash alike share a
+ * latch and condition variable, and Release only takes the latch when
+ * someone waits there.
+ */
+class ContentionManager {
+public:
+  explicit ContentionManager(DataTable *table, ContentionOptions options = {})
+      : table_(table), options_(options) {}
+
+  DISALLOW_COPY_AND_MOVE(ContentionManager);
+
+  /**
+   * DataTable::Update, retried on failure according to the policy. Update
+   * also fails if the tuple's block lacks a column of redo; with BACKOFF or
+   * WAIT that only costs the retries.
+   * @param read_timestamp snapshot of the writing transaction. The update
+   * fails without retrying, leaving the tuple as it was, once the tuple has
+   * a version committed after it.
+   * @return false if the update still failed, and the caller should abort
+   */
+  bool Update(timestamp_t read_timestamp, const TupleSlot &slot,
+              const ProjectedRow &redo, DeltaRecord *undo,
+              bool *undo_installed = nullptr);
+
+  /**
+   * Wakes writers waiting for slot. Call once the caller's versions of slot
+   * are committed (their timestamps no longer uncommitted) or rolled back.
+   */
+  void Release(const TupleSlot &slot);
+
+  void Release(const std::vector<TupleSlot> &slots) {
+    for (const auto &slot : slots) {
+      Release(slot);
+    }
+  }
+
+  ContentionStats Stats() const {
+    ContentionStats stats;
+    stats.conflicts_ = conflicts_.load(std::memory_order_relaxed);
+    stats.retries_ = retries_.load(std::memory_order_relaxed);
+    stats.waits_ = waits_.load(std::memory_order_relaxed);
+    stats.aborts_ = aborts_.load(std::memory_order_relaxed);
+    stats.early_aborts_ = early_aborts_.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+private:
+  static constexpr uint32_t NUM_STRIPES = 1 << 8;
+
+  enum class Attempt : uint8_t {
+    INSTALLED,
+    // 别人没提交的版本挡着，可以重试
+    BLOCKED,
+    // 别人在snapshot之后提交了，重试也没用
+    STALE
+  };
+
+  struct alignas(64) Stripe {
+    std::atomic<uint32_t> num_waiters_{0};
+    std::mutex latch_;
+    std::condition_variable wakeup_;
+    // 每个tuple上等着的writer数，latch_保护
+    std::unordered_map<TupleSlot, uint32_t> waiters_;
+  };
+
+  DataTable *const table_;
+  const ContentionOptions options_;
+  Stripe stripes_[NUM_STRIPES];
+  std::atomic<uint64_t> conflicts_{0};
+  std::atomic<uint64_t> retries_{0};
+  std::atomic<uint64_t> waits_{0};
+  std::atomic<uint64_t> aborts_{0};
+  std::atomic<uint64_t> early_aborts_{0};
+
+  Stripe &StripeOf(const TupleSlot &slot) {
+    // slot的hash就是它的bit，低位多半相同，乘一下再取高位
+    uint64_t hash = std::hash<TupleSlot>()(slot) * 0x9E3779B97F4A7C15ULL;
+    return stripes_[hash >> 56];
+  }
+
+  /**
+   * One DataTable::Update, taken back if it covers a version committed after
+   * read_timestamp.
+   */
+  Attempt TryUpdate(timestamp_t read_timestamp, const TupleSlot &slot,
+                    const ProjectedRow &redo, DeltaRecord *undo,
+                    bool *undo_installed);
+
+  bool UpdateWithBackoff(timestamp_t read_timestamp, const TupleSlot &slot,
+                         const ProjectedRow &redo, DeltaRecord *undo,
+                         bool *undo_installed);
+
+  bool UpdateWithWait(timestamp_t read_timestamp, const TupleSlot &slot,
+                      const ProjectedRow &redo, DeltaRecord *undo,
+                      bool *undo_installed);
+};
+} // namespace noisepage::storage
@@ -1,46 +1,542 @@
 #pragma once
 #include "common/concurrent_vector.h"
+#include "common/epoch_manager.h"
+#include "common/scheduler.h"
+#include "common/tracing.h"
+#include "storage/block_compressor.h"
+#include "storage/column_batch.h"
+#include "storage/cold_tier.h"
+#include "storage/predicate.h"
 #include "storage/storage_defs.h"
 #include "storage/tuple_access_strategy.h"
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
 
 namespace noisepage::storage {
 class DataTable {
 public:
-  DataTable(BlockStore &store, BlockLayout layout);
+  /**
+   * @param cold_tier if not null, frozen blocks of this table are tracked by
+   * it and may be evicted; it must outlive the table
+   */
+  DataTable(BlockStore &store, BlockLayout layout,
+            ColdTier *cold_tier = nullptr);
   ~DataTable() {
+    // 还没还的页和压缩副本都挂在block上，先处理掉
+    epoch_manager_.ReclaimAll();
     for (auto it = blocks_.Begin(); it != blocks_.End(); ++it) {
-      block_store_.Release(*it);
+      FreeBlock((*it).load());
     }
   }
 
   void Select(timestamp_t timestamp, const TupleSlot &slot,
               ProjectedRow *out_buffer);
 
+  /**
+   * Writes redo over slot in place, keeping the before-images in undo, whose
+   * columns must include redo's. If the newest version of slot already has
+   * undo's timestamp, i.e. the same transaction updated the tuple before,
+   * the update is merged into that transaction's delta instead of growing
+   * the chain: when that delta covers redo's columns, redo is just written
+   * and undo is left unused; when undo also covers the delta's columns (see
+   * UndoColumns), undo takes the delta's place with the union of both.
+   * Otherwise undo is linked on top as usual. A delta replaced this way is
+   * unlinked but may still be read by concurrent readers, so it must stay
+   * alive as long as the transaction's other undo records.
+   * @param undo_installed if not null, set to whether undo is now in the
+   * version chain, i.e. whether its buffer has to be kept
+   * @return false on a write-write conflict or if the block has no room for
+   * a column of redo
+   */
   bool Update(const TupleSlot &slot, const ProjectedRow &redo,
-              DeltaRecord *undo);
+              DeltaRecord *undo, bool *undo_installed = nullptr);
+
+  /**
+   * Gives undo, installed by Update or Insert with an uncommitted timestamp
+   * and still linked, its commit timestamp. Unlike setting the timestamp
+   * directly, this also takes the version off the block's summary, so once
+   * nothing in the block is uncommitted, readers at or after its newest
+   * commit skip the version chains again.
+   */
+  void Commit(const TupleSlot &slot, DeltaRecord *undo,
+              timestamp_t commit_timestamp);
+
+  /**
+   * Undoes an Update of an aborting transaction: copies the before-images
+   * of undo back into slot and unlinks undo. undo must be the newest
+   * version of slot, which holds while it is uncommitted, and stay alive
+   * for readers that may still be walking it. Readers that copied the
+   * aborted values meanwhile see the block's rollback count change and read
+   * again. Inserts cannot be undone, as the table has no deletes.
+   */
+  void Rollback(const TupleSlot &slot, DeltaRecord *undo);
+
+  /**
+   * @return the columns an undo record needs so that Update merges the
+   * update into the delta of the transaction at timestamp: redo's, plus
+   * those of that transaction's delta at the head of slot's chain if any
+   */
+  std::vector<uint16_t> UndoColumns(const TupleSlot &slot,
+                                    const ProjectedRow &redo,
+                                    timestamp_t timestamp);
 
   TupleSlot Insert(const ProjectedRow &redo, DeltaRecord *undo);
 
+  /**
+   * Hands every tuple visible at timestamp that satisfies all predicates to
+   * consumer, materialized into out_buffer. Every predicate column must be in
+   * out_buffer's projection list. Blocks whose zone maps rule out one of the
+   * predicates are skipped without touching their tuples, and blocks with no
+   * version newer than timestamp are read without looking at version
+   * pointers.
+   * @return number of blocks that were actually read
+   */
+  uint32_t
+  Scan(timestamp_t timestamp, const std::vector<ColumnPredicate> &predicates,
+       ProjectedRow *out_buffer,
+       const std::function<void(const TupleSlot &, const ProjectedRow &)>
+           &consumer);
+
+  /**
+   * Scan with the blocks split into ranges of blocks_per_task that run as
+   * tasks on scheduler. Every task materializes into its own row made by
+   * initializer, so consumer is called concurrently and in no particular
+   * order.
+   * @return number of blocks that were actually read
+   */
+  uint32_t ParallelScan(
+      Scheduler *scheduler, timestamp_t timestamp,
+      const std::vector<ColumnPredicate> &predicates,
+      const ProjectedRowInitializer &initializer,
+      const std::function<void(const TupleSlot &, const ProjectedRow &)>
+          &consumer,
+      uint64_t blocks_per_task = 1);
+
+  /**
+   * 给执行引擎用的列式scan
+   * Copies the tuples visible at timestamp in published blocks [begin,
+   * end) into batch a column at a time, up to batch->Capacity() rows of one
+   * block per batch, and hands every non-empty batch to consumer with all
+   * its rows selected. Batch column i holds col_ids[i] and Slots() is
+   * filled. Blocks whose zone maps rule out one of the predicates are
+   * skipped; otherwise the predicates are not applied. Tuples are
+   * materialized the same way as in CopyColumns.
+   */
+  void ScanColumns(uint64_t begin, uint64_t end, timestamp_t timestamp,
+                   const std::vector<uint16_t> &col_ids,
+                   const std::vector<ColumnPredicate> &predicates,
+                   ColumnBatch *batch,
+                   const std::function<void(ColumnBatch *)> &consumer);
+
+  /**
+   * @return number of published blocks, the end of the ranges ScanColumns
+   * takes
+   */
+  uint64_t NumBlocks() const { return num_published_.load(); }
+
+  /**
+   * Copies the tuples visible at timestamp in the published block at index
+   * into one value array and present bitmap per column of col_ids, in slot
+   * order, each with room for a whole block. Values and bitmaps are copied
+   * a whole column at a time; only tuples changed after timestamp are
+   * materialized through their version chains. May run concurrently with
+   * every other operation.
+   * @return number of tuples copied
+   */
+  uint32_t CopyColumns(uint64_t index, timestamp_t timestamp,
+                       const std::vector<uint16_t> &col_ids,
+                       byte *const *values, uint8_t *const *present);
+
+  /**
+   * Truncates every version chain in block and recomputes its zone maps
+   * exactly. Fails if some chain is still needed by a reader at or after
+   * oldest_active_timestamp, or if block is still taking inserts. The caller
+   * (i.e. the GC) owns the unlinked delta records and must make sure nobody
+   * writes to block while it is being frozen, and that MigrateBlocks does
+   * not run meanwhile. Readers may scan block concurrently.
+   */
+  bool FreezeBlock(RawBlock *block, timestamp_t oldest_active_timestamp);
+
+  /**
+   * Compresses a frozen block with BlockCompressor. Has the same concurrency
+   * requirements as FreezeBlock; readers may stay inside the block, so its
+   * pages are only given back once they are all gone. Writing to the block
+   * later decompresses it again.
+   */
+  bool CompressBlock(RawBlock *block);
+
+  /**
+   * @return whether block may hold a tuple satisfying all predicates
+   */
+  bool BlockMayMatch(RawBlock *block,
+                     const std::vector<ColumnPredicate> &predicates) const;
+
+  /**
+   * @return the layout of the table's current schema, which projections and
+   * bulk loads are built against
+   */
+  const BlockLayout &GetBlockLayout() const {
+    return LatestAccessor().GetBlockLayout();
+  }
+
+  /**
+   * 只改元数据，老的block留给MigrateBlocks慢慢搬
+   * Adds a column to the schema without touching any tuple. Blocks written
+   * before read default_value (null if nullptr, else attr_size bytes) for
+   * it until they are migrated, and the column cannot be updated there
+   * before that. Must not run concurrently with Insert, Update or the bulk
+   * loads.
+   * @return id of the new column
+   */
+  uint16_t AddColumn(uint16_t attr_size, const byte *default_value = nullptr);
+
+  /**
+   * Removes a column from the schema without touching any tuple. The id is
+   * not reused, and must not appear in projections or predicates anymore.
+   * Blocks written before keep the values until they are migrated. Same
+   * concurrency requirements as AddColumn.
+   */
+  void DropColumn(uint16_t col_id);
+
+  /**
+   * 后台慢慢搬，读写都不用停
+   * Moves up to max_blocks blocks written with an older schema into new
+   * blocks with the current layout, dropping removed columns and filling
+   * added ones with their default. Slots stay valid (see BlockDirectory).
+   * May run concurrently with reads, Insert, Update, Commit, Rollback and
+   * the bulk loads, but not with itself, the schema changes, FreezeBlock or
+   * CompressBlock. Writers to a block wait while it is copied and then
+   * write to the copy; readers still inside the old block keep reading it,
+   * and it goes back to the BlockStore once the table's EpochManager says
+   * none can be. Callers throttle migration through max_blocks.
+   * @return number of blocks moved, 0 once every block is current
+   */
+  uint32_t MigrateBlocks(uint32_t max_blocks);
+
 private:
+  friend class BulkLoader;
+
+  static constexpr uint32_t MAX_LAYOUT_VERSIONS = 256;
+  // BlockDirectory::Writers的最高位，block正在被MigrateBlocks搬
+  static constexpr uint32_t MIGRATING = 1u << 31;
+
+  // 同一个table的所有layout都有一样多的slot，block搬家时offset不变
+  struct LayoutVersion {
+    TupleAccessStrategy accessor_;
+    // 每列的默认值，空的就是null
+    std::vector<std::vector<byte>> defaults_;
+  };
+
   BlockStore &block_store_;
-  TupleAccessStrategy accessor_;
+  // 只有前num_versions_个有效，DDL只会在后面加
+  std::vector<std::unique_ptr<LayoutVersion>> versions_;
+  std::atomic<uint32_t> num_versions_{0};
+  uint64_t migration_cursor_ = 0;
+  ColdTier *const cold_tier_;
   RawBlock *insertion_head_;
-  ConcurrentVector<RawBlock *> blocks_;
+  // 只有前num_published_个block对reader可见，push和发布都要拿publish_latch_。
+  // MigrateBlocks会换掉已经发布的block，所以是atomic
+  ConcurrentVector<std::atomic<RawBlock *>> blocks_;
+  std::atomic<uint64_t> num_published_{0};
+  std::mutex publish_latch_;
+  // 读写block之前都要pin，搬走的block等没人pin着了再还。最后析构，
+  // 还block的时候versions_还在
+  EpochManager epoch_manager_;
+
+  /**
+   * Registers as a writer of slot's block for as long as it lives, waiting
+   * out a migration of the block. The block it resolves stays where it is
+   * until then.
+   */
+  class BlockWriter {
+  public:
+    explicit BlockWriter(const TupleSlot &slot);
+
+    ~BlockWriter() { writers_.fetch_sub(1, std::memory_order_release); }
+
+    DISALLOW_COPY_AND_MOVE(BlockWriter);
+
+    RawBlock *GetBlock() const { return block_; }
+
+  private:
+    std::atomic<uint32_t> &writers_;
+    RawBlock *block_;
+  };
 
   DeltaRecord *ReadVersionPtr(const TupleSlot &slot);
 
+  /**
+   * Scan over the published blocks [begin, end).
+   */
+  uint32_t
+  ScanBlocks(uint64_t begin, uint64_t end, timestamp_t timestamp,
+             const std::vector<ColumnPredicate> &predicates,
+             ProjectedRow *out_buffer,
+             const std::function<void(const TupleSlot &, const ProjectedRow &)>
+                 &consumer);
+
+  /**
+   * Copies the allocated tuples among slots [first_slot, first_slot +
+   * num_slots) of block, as visible at timestamp, into one value array and
+   * present bitmap per column of col_ids, in slot order. Tuples with a newer
+   * version, or changed while being copied, are materialized through row,
+   * which holds every column (see id_to_offset).
+   * @param slots if not null, receives the slot of every tuple copied
+   * @param offsets scratch space
+   * @return number of tuples copied
+   */
+  uint32_t
+  CopyColumns(RawBlock *block, uint32_t first_slot, uint32_t num_slots,
+              timestamp_t timestamp, const std::vector<uint16_t> &col_ids,
+              byte *const *values, uint8_t *const *present, TupleSlot *slots,
+              ProjectedRow *row,
+              const std::unordered_map<uint16_t, uint16_t> &id_to_offset,
+              std::vector<uint32_t> *offsets);
+
+  // delta里可能有没导出的列，所以拼版本时要用整行
+  ProjectedRowInitializer AllColumns() const {
+    const BlockLayout &layout = GetBlockLayout();
+    std::vector<uint16_t> col_ids;
+    for (uint16_t col_id = 1; col_id < layout.num_cols_; col_id++) {
+      if (layout.HasColumn(col_id)) {
+        col_ids.push_back(col_id);
+      }
+    }
+    return {layout, std::move(col_ids)};
+  }
+
+  /**
+   * Select without pinning; the caller holds a guard of epoch_manager_.
+   */
+  void SelectInto(timestamp_t timestamp, const TupleSlot &slot,
+                  ProjectedRow *out_buffer,
+                  const std::unordered_map<uint16_t, uint16_t> *id_to_offset);
+
+  /**
+   * One attempt of SelectInto, which has to retry if a rollback in the
+   * block raced it.
+   */
+  void ReadVersion(timestamp_t timestamp, const TupleSlot &slot,
+                   ProjectedRow *out_buffer,
+                   const std::unordered_map<uint16_t, uint16_t> *id_to_offset);
+
+  void Thaw(RawBlock *block);
+
+  void UpdateZoneMaps(const TupleSlot &slot, const ProjectedRow &redo);
+
+  TupleAccessStrategy &Accessor(RawBlock *block) const {
+    return versions_[reinterpret_cast<Block *>(block)->layout_version_]
+        ->accessor_;
+  }
+
+  TupleAccessStrategy &LatestAccessor() const {
+    return versions_[num_versions_.load(std::memory_order_acquire) - 1]
+        ->accessor_;
+  }
+
+  /**
+   * @return col_id's value in tuples whose block does not have the column,
+   * empty for null
+   */
+  const std::vector<byte> &DefaultValue(uint16_t col_id) const {
+    return versions_[num_versions_.load(std::memory_order_acquire) - 1]
+        ->defaults_[col_id];
+  }
+
+  void CopyDefault(ProjectedRow *row, uint16_t projection_list_offset) const {
+    const std::vector<byte> &value =
+        DefaultValue(row->ColumnIds()[projection_list_offset]);
+    if (value.empty()) {
+      row->SetNull(projection_list_offset);
+    } else {
+      std::memcpy(row->AccessForceNotNull(projection_list_offset),
+                  value.data(), value.size());
+    }
+  }
+
+  /**
+   * Makes layout the current one and starts a new insertion head with it.
+   */
+  void AddVersion(const BlockLayout &layout,
+                  std::vector<std::vector<byte>> defaults);
+
+  /**
+   * @return a copy of from with the current layout, under from's block id
+   */
+  RawBlock *MigrateBlock(RawBlock *from);
+
   bool HasConflict(DeltaRecord *version_ptr, DeltaRecord *undo) {
     return version_ptr != nullptr &&
            version_ptr->timestamp_ != undo->timestamp_ &&
            static_cast<int64_t>(version_ptr->timestamp_) < 0;
   }
 
+  /**
+   * @return whether row has every column of other
+   */
+  static bool Covers(const ProjectedRow &row, const ProjectedRow &other) {
+    const uint16_t *end = row.ColumnIds() + row.NumColumns();
+    for (uint16_t i = 0; i < other.NumColumns(); i++) {
+      if (std::find(row.ColumnIds(), end, other.ColumnIds()[i]) == end) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /**
+   * 整个block都不用看version chain
+   * @return whether no tuple of block has a version newer than timestamp,
+   * i.e. its in-place values are what a reader at timestamp sees. Writers
+   * bump the summary before they touch a tuple, so checked after copying
+   * values (and an acquire fence) it also covers writes that raced the
+   * copy. Versions installed with an uncommitted timestamp keep the block
+   * off this path until they are committed through Commit or rolled back.
+   */
+  static bool NoNewerVersions(RawBlock *block, timestamp_t timestamp) {
+    auto *header = reinterpret_cast<Block *>(block);
+    // Commit先抬高max再减计数，这里要反过来读
+    return header->num_versioned_.load() == 0 ||
+           (header->num_uncommitted_.load() == 0 &&
+            header->max_version_timestamp_.load() <= timestamp);
+  }
+
+  /**
+   * Rollback restores a tuple's values before unlinking its undo, so a
+   * reader that copied the aborted values and then finds no newer version
+   * would return them. Rollback counts itself in between, so a reader
+   * checking this after looking at the version pointer or the summary
+   * catches that.
+   * @param seen num_rollbacks_ loaded (acquire) before copying any values
+   * @return whether a rollback in block ran since seen was loaded
+   */
+  static bool RolledBack(RawBlock *block, uint32_t seen) {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return reinterpret_cast<Block *>(block)->num_rollbacks_.load(
+               std::memory_order_relaxed) != seen;
+  }
+
+  static void RaiseMaxVersion(RawBlock *block, timestamp_t timestamp) {
+    auto &max_version =
+        reinterpret_cast<Block *>(block)->max_version_timestamp_;
+    timestamp_t max = max_version.load();
+    while (max < timestamp &&
+           !max_version.compare_exchange_weak(max, timestamp)) {
+    }
+  }
+
+  /**
+   * Records in block's summary that a version with timestamp is about to be
+   * installed, on a tuple with no version chain yet if first. An
+   * uncommitted version is only counted, unless it replaces one of the same
+   * transaction that already was.
+   */
+  static void NoteVersion(RawBlock *block, timestamp_t timestamp, bool first,
+                          bool replaces_own) {
+    auto *header = reinterpret_cast<Block *>(block);
+    if (static_cast<int64_t>(timestamp) >= 0) {
+      RaiseMaxVersion(block, timestamp);
+    } else if (!replaces_own) {
+      header->num_uncommitted_.fetch_add(1);
+    }
+    if (first) {
+      header->num_versioned_.fetch_add(1);
+    }
+  }
+
+  /**
+   * @return an initialized block that is not yet part of the table
+   */
+  RawBlock *AllocateBlock() {
+    NOISEPAGE_TRACE_SCOPE(BLOCK_ALLOCATION);
+    uint32_t version = num_versions_.load() - 1;
+    const BlockLayout &layout = versions_[version]->accessor_.GetBlockLayout();
+    RawBlock *new_block = block_store_.Get(layout.block_size_);
+    InitializeRawBlock(new_block, layout,
+                       BlockDirectory::Get().Register(new_block));
+    auto *zone_maps = new ZoneMap[layout.num_cols_];
+    for (uint16_t i = 0; i < layout.num_cols_; i++) {
+      zone_maps[i].Reset();
+    }
+    reinterpret_cast<Block *>(new_block)->zone_maps_ = zone_maps;
+    reinterpret_cast<Block *>(new_block)->layout_version_ = version;
+    return new_block;
+  }
+
   void NewBlock() {
-    RawBlock *new_block = block_store_.Get();
-    InitializeRawBlock(new_block, accessor_.GetBlockLayout(), 0);
-    insertion_head_ = new_block;
-    blocks_.PushBack(new_block);
+    insertion_head_ = AllocateBlock();
+    PublishBlocks({insertion_head_});
+  }
+
+  void PublishBlocks(const std::vector<RawBlock *> &blocks) {
+    {
+      std::lock_guard<std::mutex> lock(publish_latch_);
+      for (RawBlock *block : blocks) {
+        blocks_.EmplaceBack(block);
+      }
+      num_published_.store(num_published_.load() + blocks.size());
+    }
+    // bulk load出来的block本来就是frozen的
+    for (RawBlock *block : blocks) {
+      if (reinterpret_cast<Block *>(block)->state_.load() ==
+          BlockState::FROZEN) {
+        TrackFrozen(block);
+      }
+    }
   }
+
+  void Touch(RawBlock *block) const {
+    if (cold_tier_ != nullptr) {
+      ColdTier::Touch(block);
+    }
+  }
+
+  void TrackFrozen(RawBlock *block) {
+    if (cold_tier_ != nullptr) {
+      cold_tier_->Track(block, Accessor(block).GetBlockLayout().block_size_);
+    }
+  }
+
+  void FreeBlock(RawBlock *block) {
+    // 换出去的block在Forget之后header就没了，先把id拿出来
+    BlockDirectory::Get().Unregister(block->BlockId());
+    ReleaseBlock(block);
+  }
+
+  /**
+   * ReleaseBlock once no reader that resolved block before it was moved
+   * can still be inside it.
+   */
+  void RetireBlock(RawBlock *block) {
+    struct Retired {
+      DataTable *table_;
+      RawBlock *block_;
+    };
+    epoch_manager_.Retire(new Retired{this, block}, [](void *ptr) {
+      auto *retired = static_cast<Retired *>(ptr);
+      retired->table_->ReleaseBlock(retired->block_);
+      delete retired;
+    });
+  }
+
+  /**
+   * Gives block back to the BlockStore without freeing its id, which may
+   * already resolve to a copy of it.
+   */
+  void ReleaseBlock(RawBlock *block) {
+    uint32_t block_size = Accessor(block).GetBlockLayout().block_size_;
+    if (cold_tier_ != nullptr) {
+      cold_tier_->Forget(block);
+    }
+    delete[] reinterpret_cast<Block *>(block)->zone_maps_;
+    delete[] reinterpret_cast<byte *>(
+        reinterpret_cast<Block *>(block)->compressed_);
+    block_store_.Release(block, block_size);
+  }
+
+  uint32_t NumAllocated(RawBlock *block) const;
 };
 
 } // namespace noisepage::storage
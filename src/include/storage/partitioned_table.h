@@ -0,0 +1,188 @@
+#pragma once
+#include "common/macros.h"
+#include "common/scheduler.h"
+#include "storage/bulk_loader.h"
+#include "storage/data_table.h"
+#include "storage/predicate.h"
+#include "storage/storage_defs.h"
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace noisepage::storage {
+enum class PartitionType : uint8_t { HASH, RANGE };
+
+/**
+ * How rows are split between partitions by the value of one integer key
+ * column. Rows whose key is null go to partition 0.
+ */
+struct PartitionScheme {
+  /**
+   * num_partitions partitions, a row going to the one its key hashes to
+   */
+  static PartitionScheme Hash(uint16_t key_col, uint32_t num_partitions) {
+    return {PartitionType::HASH, key_col, num_partitions, {}};
+  }
+
+  /**
+   * One partition more than split points: partition i holds the keys in
+   * [split_points[i - 1], split_points[i]), the first and last ones open
+   * ended. split_points must be ascending.
+   */
+  static PartitionScheme Range(uint16_t key_col,
+                               std::vector<int64_t> split_points) {
+    auto num_partitions = static_cast<uint32_t>(split_points.size() + 1);
+    return {PartitionType::RANGE, key_col, num_partitions,
+            std::move(split_points)};
+  }
+
+  PartitionType type_;
+  uint16_t key_col_;
+  uint32_t num_partitions_;
+  std::vector<int64_t> split_points_;
+};
+
+/**
+ * 按key分区的表
+ * N DataTables with one layout, with rows routed to them by a
+ * PartitionScheme. Every partition has its own blocks and insertion head,
+ * so inserts into different partitions never touch the same block, and
+ * scans skip partitions the predicates on the key rule out before looking
+ * at any zone map.
+ *
+ * Each partition has a home worker (partition i % workers by default, or
+ * set with SetHomeWorker). Parallel loads and scans hand a partition to its
+ * home worker when that worker is free and to any other otherwise, so with
+ * a scheduler whose workers are pinned to cores a partition is mostly
+ * written and read from one core and, with first-touch allocation, lives
+ * on that core's memory node.
+ *
+ * A slot is used through the partition holding it, Partition(PartitionOf
+ * (key)) or the one Insert reports.
+ */
+class PartitionedTable {
+public:
+  PartitionedTable(BlockStore &store, const BlockLayout &layout,
+                   PartitionScheme scheme);
+
+  DISALLOW_COPY_AND_MOVE(PartitionedTable);
+
+  const PartitionScheme &Scheme() const { return scheme_; }
+
+  uint32_t NumPartitions() const { return scheme_.num_partitions_; }
+
+  DataTable &Partition(uint32_t partition) {
+    return *partitions_[partition];
+  }
+
+  uint32_t PartitionOf(int64_t key) const;
+
+  /**
+   * @return the partition row goes to; its key column must be in row
+   */
+  uint32_t PartitionOf(const ProjectedRow &row) const;
+
+  uint32_t HomeWorker(uint32_t partition) const {
+    return home_workers_[partition];
+  }
+
+  /**
+   * Makes worker the preferred one for parallel work on partition. Worker
+   * indices are taken modulo the scheduler's number of workers.
+   */
+  void SetHomeWorker(uint32_t partition, uint32_t worker) {
+    home_workers_[partition] = worker;
+  }
+
+  /**
+   * DataTable::Insert into the partition of redo's key, which redo must
+   * contain.
+   * @param partition if not null, receives that partition
+   */
+  TupleSlot Insert(const ProjectedRow &redo, DeltaRecord *undo,
+                   uint32_t *partition = nullptr);
+
+  /**
+   * Routes the rows to their partitions and bulk loads every partition as
+   * BulkLoader::BulkLoad does. The key column must be one of columns.
+   * @param slots if not null, receives the slot of every row in order
+   */
+  void BulkLoad(const std::vector<BulkLoadColumn> &columns, uint32_t num_rows,
+                std::vector<TupleSlot> *slots = nullptr);
+
+  /**
+   * BulkLoad with the partitions loaded in parallel on scheduler, each
+   * whole by one worker, preferably its home worker. Like BulkLoad, must not
+   * run concurrently with Insert.
+   */
+  void ParallelBulkLoad(const std::vector<BulkLoadColumn> &columns,
+                        uint32_t num_rows, Scheduler *scheduler,
+                        std::vector<TupleSlot> *slots = nullptr);
+
+  /**
+   * @return whether some row of partition could satisfy every predicate,
+   * judging by the partitioning key alone
+   */
+  bool MayMatch(uint32_t partition,
+                const std::vector<ColumnPredicate> &predicates) const;
+
+  /**
+   * DataTable::Scan over the partitions that MayMatch.
+   * @return number of blocks that were actually read
+   */
+  uint32_t
+  Scan(timestamp_t timestamp, const std::vector<ColumnPredicate> &predicates,
+       ProjectedRow *out_buffer,
+       const std::function<void(const TupleSlot &, const ProjectedRow &)>
+           &consumer);
+
+  /**
+   * DataTable::ParallelScan over the partitions that MayMatch, each
+   * started preferably by its home worker, whose own deque then takes the
+   * partition's block ranges first.
+   * @return number of blocks that were actually read
+   */
+  uint32_t ParallelScan(
+      Scheduler *scheduler, timestamp_t timestamp,
+      const std::vector<ColumnPredicate> &predicates,
+      const ProjectedRowInitializer &initializer,
+      const std::function<void(const TupleSlot &, const ProjectedRow &)>
+          &consumer,
+      uint64_t blocks_per_task = 1);
+
+private:
+  const PartitionScheme scheme_;
+  const uint16_t key_size_;
+  std::vector<std::unique_ptr<DataTable>> partitions_;
+  std::vector<uint32_t> home_workers_;
+
+  /**
+   * Calls fn(partition) for every partition in partitions, in parallel on
+   * scheduler. One task per worker claims partitions, those whose home it
+   * is first.
+   */
+  void ForEachPartition(Scheduler *scheduler,
+                        const std::vector<uint32_t> &partitions,
+                        const std::function<void(uint32_t)> &fn);
+
+  /**
+   * @return partitions that MayMatch the predicates
+   */
+  std::vector<uint32_t>
+  Candidates(const std::vector<ColumnPredicate> &predicates) const;
+
+  /**
+   * Splits columns by partition: per partition the columns of its rows,
+   * backed by buffers, and the input row number of each of its rows.
+   */
+  void Route(const std::vector<BulkLoadColumn> &columns, uint32_t num_rows,
+             std::vector<std::vector<std::vector<byte>>> *buffers,
+             std::vector<std::vector<BulkLoadColumn>> *routed,
+             std::vector<std::vector<uint32_t>> *rows) const;
+
+  void LoadPartition(uint32_t partition,
+                     const std::vector<BulkLoadColumn> &columns,
+                     const std::vector<uint32_t> &rows,
+                     std::vector<TupleSlot> *slots);
+};
+} // namespace noisepage::storage
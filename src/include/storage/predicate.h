@@ -0,0 +1,96 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace noisepage::storage {
+enum class PredicateType : uint8_t {
+  EQUAL,
+  LESS,
+  LESS_EQUAL,
+  GREATER,
+  GREATER_EQUAL,
+  BETWEEN,
+  IN
+};
+
+/**
+ * 单列上的简单谓词，列值按有符号整数解释，null永远不满足谓词
+ * A predicate on one fixed-width integer column. Values are compared as
+ * sign-extended integers and a null never satisfies a predicate. For BETWEEN
+ * both bounds are inclusive; every other type except IN only uses lo_.
+ */
+struct ColumnPredicate {
+  ColumnPredicate(uint16_t col_id, PredicateType type, int64_t lo,
+                  int64_t hi = 0)
+      : col_id_(col_id), type_(type), lo_(lo), hi_(hi) {}
+
+  ColumnPredicate(uint16_t col_id, std::vector<int64_t> in_list)
+      : col_id_(col_id), type_(PredicateType::IN), lo_(0), hi_(0),
+        in_list_(std::move(in_list)) {}
+
+  /**
+   * Computes the smallest inclusive range [lo, hi] containing every value
+   * that satisfies the predicate. Returns false if no value can satisfy it.
+   */
+  bool Bounds(int64_t *lo, int64_t *hi) const {
+    constexpr int64_t min = std::numeric_limits<int64_t>::min();
+    constexpr int64_t max = std::numeric_limits<int64_t>::max();
+    switch (type_) {
+    case PredicateType::EQUAL:
+      *lo = *hi = lo_;
+      return true;
+    case PredicateType::LESS:
+      if (lo_ == min) {
+        return false;
+      }
+      *lo = min;
+      *hi = lo_ - 1;
+      return true;
+    case PredicateType::LESS_EQUAL:
+      *lo = min;
+      *hi = lo_;
+      return true;
+    case PredicateType::GREATER:
+      if (lo_ == max) {
+        return false;
+      }
+      *lo = lo_ + 1;
+      *hi = max;
+      return true;
+    case PredicateType::GREATER_EQUAL:
+      *lo = lo_;
+      *hi = max;
+      return true;
+    case PredicateType::BETWEEN:
+      *lo = lo_;
+      *hi = hi_;
+      return lo_ <= hi_;
+    case PredicateType::IN:
+      if (in_list_.empty()) {
+        return false;
+      }
+      *lo = *std::min_element(in_list_.begin(), in_list_.end());
+      *hi = *std::max_element(in_list_.begin(), in_list_.end());
+      return true;
+    }
+    return false;
+  }
+
+  bool Evaluate(int64_t val) const {
+    if (type_ == PredicateType::IN) {
+      return std::find(in_list_.begin(), in_list_.end(), val) !=
+             in_list_.end();
+    }
+    int64_t lo = 0, hi = 0;
+    return Bounds(&lo, &hi) && lo <= val && val <= hi;
+  }
+
+  uint16_t col_id_;
+  PredicateType type_;
+  int64_t lo_;
+  int64_t hi_;
+  std::vector<int64_t> in_list_;
+};
+} // namespace noisepage::storage
@@ -0,0 +1,43 @@
+#pragma once
+#include "common/concurrent_bitmap.h"
+#include "storage/predicate.h"
+#include "storage/storage_defs.h"
+
+namespace noisepage::storage {
+enum class SimdLevel : uint8_t { SCALAR, SSE4, AVX2 };
+
+/**
+ * 对MiniBlock里的一整列做谓词过滤
+ * Filter kernels over the dense value array of a MiniBlock. Results are
+ * selection bitmaps in the same bit order as RawConcurrentBitmap (the first
+ * slot is the most significant bit of the first byte), so they can be ANDed
+ * with the null bitmaps and column 0's allocation bitmap directly.
+ */
+class PredicateKernels {
+public:
+  PredicateKernels() = delete;
+
+  /**
+   * @return the widest instruction set the running CPU supports
+   */
+  static SimdLevel DetectSimdLevel();
+
+  /**
+   * Copies the first num_slots bits of bitmap into selection, which must
+   * hold BitmapSize(num_slots) bytes.
+   */
+  static void InitializeSelection(const RawConcurrentBitmap *bitmap,
+                                  uint32_t num_slots, uint8_t *selection);
+
+  /**
+   * Clears every bit in selection whose slot is null in null_bitmap or whose
+   * value in column does not satisfy predicate. column holds num_slots
+   * values of attr_size (1, 2, 4 or 8) bytes each.
+   */
+  static void Evaluate(const ColumnPredicate &predicate, const byte *column,
+                       uint16_t attr_size,
+                       const RawConcurrentBitmap *null_bitmap,
+                       uint32_t num_slots, uint8_t *selection,
+                       SimdLevel level = DetectSimdLevel());
+};
+} // namespace noisepage::storage
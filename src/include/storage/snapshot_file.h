@@ -0,0 +1,156 @@
+#pragma once
+#include "common/macros.h"
+#include "storage/storage_defs.h"
+#include <sys/uio.h>
+#include <vector>
+
+namespace noisepage::storage {
+class DataTable;
+
+/**
+ * 按列存的snapshot文件，一个block一个chunk
+ * A columnar snapshot of a DataTable, as written by ExportSnapshot.
+ * Integers and values are in host byte order and nothing is padded.
+ *
+ *   header: magic "NPSNAP01" | timestamp (64) | num_columns (16) |
+ *           { col_id (16) | attr_size (16) } * num_columns
+ *   chunk:  num_rows (32) | { present bitmap | values } * num_columns
+ *   end:    num_rows (32) = 0
+ *
+ * Every chunk holds the rows of one block. The present bitmap has
+ * BitmapSize(num_rows) bytes in RawConcurrentBitmap bit order (most
+ * significant bit first), 1 if the value is not null; bits past num_rows are
+ * 0. Values are num_rows attributes packed back to back, and the value of a
+ * null is unspecified.
+ */
+constexpr char SNAPSHOT_MAGIC[8] = {'N', 'P', 'S', 'N', 'A', 'P', '0', '1'};
+
+/**
+ * Stages chunks in a fixed number of buffers and hands all staged chunks to
+ * the kernel with one writev once the buffers run out, so the memory used
+ * does not depend on the size of the table.
+ */
+class SnapshotWriter {
+public:
+  static constexpr uint64_t DEFAULT_BUFFER_SIZE = 8u << 20;
+
+  /**
+   * @param buffer_size bytes of chunks to stage between two writes; at least
+   * one chunk of layout.num_slots_ rows is always staged
+   */
+  SnapshotWriter(int fd, const BlockLayout &layout,
+                 std::vector<uint16_t> col_ids,
+                 uint64_t buffer_size = DEFAULT_BUFFER_SIZE);
+
+  DISALLOW_COPY_AND_MOVE(SnapshotWriter);
+
+  void WriteHeader(timestamp_t timestamp);
+
+  /**
+   * @return present bitmap of the i-th exported column in the chunk being
+   * staged, with room for layout.num_slots_ rows
+   */
+  uint8_t *Present(uint16_t i) {
+    return reinterpret_cast<uint8_t *>(Current() + present_offsets_[i]);
+  }
+
+  /**
+   * @return values of the i-th exported column in the chunk being staged,
+   * with room for layout.num_slots_ rows
+   */
+  byte *Values(uint16_t i) { return Current() + value_offsets_[i]; }
+
+  /**
+   * Queues the chunk being staged with its first num_rows rows, and moves on
+   * to the next buffer. Writes out every queued chunk if none is left.
+   */
+  void CommitChunk(uint32_t num_rows);
+
+  /**
+   * Writes out the queued chunks followed by the end marker.
+   */
+  void Finish();
+
+  uint64_t BytesWritten() const { return bytes_written_; }
+
+private:
+  const int fd_;
+  const std::vector<uint16_t> col_ids_;
+  std::vector<uint16_t> attr_sizes_;
+  std::vector<uint64_t> present_offsets_;
+  std::vector<uint64_t> value_offsets_;
+  std::vector<byte> header_;
+  std::vector<std::vector<byte>> buffers_;
+  uint32_t current_ = 0;
+  std::vector<iovec> iovecs_;
+  uint64_t bytes_written_ = 0;
+
+  byte *Current() { return buffers_[current_].data(); }
+
+  void Append(const void *data, uint64_t size);
+
+  void Flush();
+};
+
+/**
+ * Writes every tuple of table visible at timestamp to fd as a snapshot file
+ * holding the columns col_ids, one chunk per block, copying each block
+ * straight into the writer's chunk with DataTable::CopyColumns. At most
+ * buffer_size bytes of chunks are staged before they are written with one
+ * writev. May run concurrently with Insert, Update and bulk loads.
+ * @return number of rows written
+ */
+uint64_t ExportSnapshot(DataTable *table, timestamp_t timestamp,
+                        const std::vector<uint16_t> &col_ids, int fd,
+                        uint64_t buffer_size =
+                            SnapshotWriter::DEFAULT_BUFFER_SIZE);
+
+/**
+ * Reads a snapshot file back chunk by chunk. Only one chunk is held in
+ * memory at a time.
+ */
+class SnapshotReader {
+public:
+  /**
+   * Reads the header. Throws if fd does not hold a snapshot.
+   */
+  explicit SnapshotReader(int fd);
+
+  DISALLOW_COPY_AND_MOVE(SnapshotReader);
+
+  timestamp_t Timestamp() const { return timestamp_; }
+
+  const std::vector<uint16_t> &ColumnIds() const { return col_ids_; }
+
+  const std::vector<uint16_t> &AttrSizes() const { return attr_sizes_; }
+
+  /**
+   * Reads the next chunk.
+   * @return false once the end marker is reached
+   */
+  bool NextChunk();
+
+  uint32_t NumRows() const { return num_rows_; }
+
+  const uint8_t *Present(uint16_t i) const {
+    return reinterpret_cast<const uint8_t *>(chunk_.data() +
+                                             present_offsets_[i]);
+  }
+
+  const byte *Values(uint16_t i) const {
+    return chunk_.data() + value_offsets_[i];
+  }
+
+private:
+  const int fd_;
+  timestamp_t timestamp_;
+  std::vector<uint16_t> col_ids_;
+  std::vector<uint16_t> attr_sizes_;
+  uint32_t num_rows_ = 0;
+  std::vector<byte> chunk_;
+  std::vector<uint64_t> present_offsets_;
+  std::vector<uint64_t> value_offsets_;
+
+  void Read(void *data, uint64_t size);
+};
+} // namespace noisepage::storage
@@ -0,0 +1,222 @@
+#pragma once
+#include "common/macros.h"
+#include "storage/data_table.h"
+#include "storage/predicate.h"
+#include "storage/storage_defs.h"
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace noisepage::storage {
+/**
+ * 可串行化的snapshot isolation
+ * Serializable snapshot isolation (Cahill et al.) on top of DataTable's
+ * snapshots, for transactions that ask for it. A serializable transaction
+ * records what it reads: tuples, and the predicates of its scans so that
+ * inserts and updates moving a tuple into a scanned range are caught too.
+ * Commit checks it against the serializable transactions that committed
+ * while it ran for rw-antidependencies (one read a version the other
+ * overwrote) in either direction, and refuses to commit a transaction that
+ * would get both an incoming and an outgoing one, or that would give them
+ * to a transaction already committed. Every cycle in the serialization
+ * graph of SI histories contains such a pivot, so the serializable
+ * transactions stay serializable among themselves; snapshot transactions
+ * are neither tracked nor protected.
+ *
+ * Reads only append to the transaction's own lists; the check runs at
+ * commit, under one latch, against committed transactions kept until Prune
+ * says no snapshot can predate them. Like other flag-based SSI it may
+ * refuse some serializable schedules.
+ */
+class SsiManager {
+  // 只用来比较，hash相同当作同一个tuple，最多多abort几个
+  using SlotKey = uint64_t;
+
+  struct WrittenValue {
+    uint16_t col_id_;
+    bool null_;
+    int64_t value_;
+  };
+
+  struct Write {
+    const DataTable *table_;
+    SlotKey slot_;
+    // 新值里的整数列，判断有没有写进别人scan的范围
+    std::vector<WrittenValue> values_;
+  };
+
+  struct PredicateRead {
+    const DataTable *table_;
+    std::vector<ColumnPredicate> predicates_;
+  };
+
+  struct Committed {
+    timestamp_t commit_timestamp_;
+    // 都排好序
+    std::vector<SlotKey> reads_;
+    std::vector<SlotKey> write_slots_;
+    std::vector<Write> writes_;
+    std::vector<PredicateRead> predicate_reads_;
+    bool in_conflict_;
+    bool out_conflict_;
+  };
+
+public:
+  /**
+   * One transaction's reads and writes. Reads and writes go through it, so
+   * a snapshot transaction costs nothing over calling DataTable directly.
+   * It also keeps the undo records its writes installed, so they can be
+   * committed or rolled back together. Not thread-safe.
+   */
+  class Transaction {
+  public:
+    Transaction(timestamp_t read_timestamp, bool serializable = true)
+        : read_timestamp_(read_timestamp), serializable_(serializable) {}
+
+    DISALLOW_COPY_AND_MOVE(Transaction);
+
+    timestamp_t ReadTimestamp() const { return read_timestamp_; }
+
+    bool Serializable() const { return serializable_; }
+
+    void Select(DataTable *table, const TupleSlot &slot,
+                ProjectedRow *out_buffer) {
+      table->Select(read_timestamp_, slot, out_buffer);
+      RecordRead(slot);
+    }
+
+    /**
+     * DataTable::Scan at the read timestamp, recording the predicates and
+     * every tuple handed to consumer.
+     */
+    uint32_t
+    Scan(DataTable *table, const std::vector<ColumnPredicate> &predicates,
+         ProjectedRow *out_buffer,
+         const std::function<void(const TupleSlot &, const ProjectedRow &)>
+             &consumer);
+
+    /**
+     * DataTable::Update, remembering undo if it was installed. Also fails,
+     * leaving the tuple as it was, if another transaction committed a
+     * version of it after the read timestamp: writing over it would lose
+     * that update, and SSI only catches read-write conflicts on top of
+     * first-updater-wins.
+     */
+    bool Update(DataTable *table, const TupleSlot &slot,
+                const ProjectedRow &redo, DeltaRecord *undo,
+                bool *undo_installed = nullptr);
+
+    TupleSlot Insert(DataTable *table, const ProjectedRow &redo,
+                     DeltaRecord *undo) {
+      TupleSlot slot = table->Insert(redo, undo);
+      RecordUndo(table, slot, undo, true);
+      RecordWrite(table, slot, redo);
+      return slot;
+    }
+
+    /**
+     * Gives every undo record still installed by this transaction
+     * commit_timestamp (DataTable::Commit), after SsiManager::Commit
+     * accepted it or for what Rollback had to keep.
+     */
+    void CommitWrites(timestamp_t commit_timestamp);
+
+    /**
+     * Rolls back this transaction's updates, newest first, each undo record
+     * once however often the tuple was written. Inserts cannot be undone and
+     * stay installed, along with updates merged into their delta; they still
+     * need CommitWrites.
+     */
+    void Rollback();
+
+    void RecordRead(const TupleSlot &slot) {
+      if (serializable_) {
+        reads_.push_back(std::hash<TupleSlot>()(slot));
+      }
+    }
+
+    void RecordPredicateRead(const DataTable *table,
+                             const std::vector<ColumnPredicate> &predicates) {
+      if (serializable_) {
+        predicate_reads_.push_back({table, predicates});
+      }
+    }
+
+    /**
+     * Records that redo was written to slot of table.
+     */
+    void RecordWrite(const DataTable *table, const TupleSlot &slot,
+                     const ProjectedRow &redo);
+
+  private:
+    friend class SsiManager;
+
+    struct Installed {
+      DataTable *table_;
+      TupleSlot slot_;
+      DeltaRecord *undo_;
+      bool insert_;
+    };
+
+    const timestamp_t read_timestamp_;
+    const bool serializable_;
+    std::vector<SlotKey> reads_;
+    std::vector<Write> writes_;
+    std::vector<PredicateRead> predicate_reads_;
+    // 按安装顺序，同一个tuple的undo从旧到新
+    std::vector<Installed> installed_;
+    // 每个tuple最新的那个在installed_里的位置
+    std::unordered_map<TupleSlot, uint64_t> newest_installed_;
+
+    void RecordUndo(DataTable *table, const TupleSlot &slot,
+                    DeltaRecord *undo, bool insert);
+  };
+
+  SsiManager() = default;
+
+  DISALLOW_COPY_AND_MOVE(SsiManager);
+
+  /**
+   * Validates txn before its writes get commit_timestamp, consuming what it
+   * recorded. On success the transaction's reads and writes are kept for
+   * checking later commits; on failure the caller must roll its writes back
+   * (DataTable::Rollback). Snapshot transactions always succeed.
+   * @return whether txn may commit
+   */
+  bool Commit(Transaction *txn, timestamp_t commit_timestamp);
+
+  /**
+   * Forgets committed transactions that no running or future transaction
+   * can be concurrent with.
+   * @param oldest_active no older than the read timestamp of any running
+   * transaction or any started later
+   */
+  void Prune(timestamp_t oldest_active);
+
+  /**
+   * @return how many committed transactions are kept for validation
+   */
+  uint64_t NumRetained() {
+    std::lock_guard<std::mutex> lock(latch_);
+    return committed_.size();
+  }
+
+private:
+  std::mutex latch_;
+  // 按commit时间戳排序
+  std::deque<std::unique_ptr<Committed>> committed_;
+
+  static bool Intersects(const std::vector<SlotKey> &sorted_reads,
+                         const std::vector<SlotKey> &sorted_writes);
+
+  /**
+   * @return whether a write could have moved a tuple into the range of one
+   * of the predicate reads
+   */
+  static bool Phantom(const std::vector<PredicateRead> &predicate_reads,
+                      const std::vector<Write> &writes);
+};
+} // namespace noisepage::storage
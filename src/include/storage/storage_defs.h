@@ -2,9 +2,17 @@
 #include "common/concurrent_bitmap.h"
 #include "common/macros.h"
 #include "common/object_pool.h"
+#include "storage/block_directory.h"
+#include "storage/zone_map.h"
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <sys/mman.h>
 #include <vector>
 
 namespace noisepage {
@@ -12,25 +20,130 @@ using byte = std::byte;
 typedef uint64_t timestamp_t;
 
 namespace storage {
+// block大小是每个table自己选的，只能是2的幂，默认1MB
+constexpr uint32_t MIN_BLOCK_SIZE = 1u << 16;
+constexpr uint32_t MAX_BLOCK_SIZE = 1u << 22;
 constexpr uint32_t BLOCK_SIZE = 1048576u;
 
+/**
+ * @return index of block_size among the supported block sizes, i.e.
+ * block_size == MIN_BLOCK_SIZE << BlockSizeClass(block_size)
+ */
+inline uint32_t BlockSizeClass(uint32_t block_size) {
+  assert(block_size >= MIN_BLOCK_SIZE && block_size <= MAX_BLOCK_SIZE &&
+         (block_size & (block_size - 1)) == 0);
+  return static_cast<uint32_t>(__builtin_ctz(block_size) -
+                               __builtin_ctz(MIN_BLOCK_SIZE));
+}
+
+/**
+ * A hot block may still be written to. A frozen block has no version chains
+ * left and exact zone maps; writing to it turns it hot again. A compressed
+ * block is a frozen block whose values only live in its CompressedBlock;
+ * writing to it decompresses it first. An evicting frozen block is being
+ * moved to the ColdTier; writers wait for it to become frozen again.
+ */
+enum class BlockState : uint32_t {
+  HOT = 0,
+  FROZEN,
+  COMPRESSED,
+  DECOMPRESSING,
+  EVICTING
+};
+
+constexpr uint32_t CACHELINE_SIZE = 64;
+
+/**
+ * Attributes are fixed-width, but may be wider than 8 bytes (e.g. 16-byte
+ * decimals or UUIDs). Only 1, 2, 4 and 8-byte attributes are treated as
+ * integers by predicates, zone maps and compression.
+ *
+ * Every column's null bitmap and value array start on a cache line, so
+ * vectorized scans get aligned loads and no two arrays share a line. Layouts
+ * with so many columns that the padding would take more than an eighth of
+ * the block fall back to 8-byte alignment, and then to packing the arrays
+ * back to back. placement optionally gives the
+ * order the columns are laid out in (see OrderColumns); it does not change
+ * column ids.
+ *
+ * A column of size 0 is absent: it keeps its id but takes no space, and
+ * nothing may be read from or written to it (DataTable uses this for
+ * dropped columns). max_slots caps num_slots_.
+ */
 struct BlockLayout {
-  BlockLayout(uint16_t num_attrs, std::vector<uint8_t> attr_sizes)
+  BlockLayout(uint16_t num_attrs, std::vector<uint16_t> attr_sizes,
+              uint32_t block_size = BLOCK_SIZE,
+              const std::vector<uint16_t> &placement = {},
+              uint32_t max_slots = UINT32_MAX)
       : num_cols_(num_attrs), attr_sizes_(std::move(attr_sizes)),
-        num_slots_(NumSlots()), header_size_(HeaderSize()),
-        tuple_size_(TupleSize()) {}
+        block_size_(block_size), alignment_(Alignment()),
+        num_slots_(std::min(NumSlots(), max_slots)),
+        header_size_(HeaderSize()),
+        tuple_size_(TupleSize()), column_offsets_(ColumnOffsets(placement)) {
+    assert(block_size_ >= MIN_BLOCK_SIZE && block_size_ <= MAX_BLOCK_SIZE &&
+           (block_size_ & (block_size_ - 1)) == 0);
+  }
   const uint16_t num_cols_;
-  const std::vector<uint8_t> attr_sizes_;
+  const std::vector<uint16_t> attr_sizes_;
+  const uint32_t block_size_;
+  const uint32_t alignment_;
   const uint32_t num_slots_;
   const uint32_t header_size_;
   const uint32_t tuple_size_;
+  // 每一列的null bitmap相对block开头的offset
+  const std::vector<uint32_t> column_offsets_;
+
+  /**
+   * @return size of a column's null bitmap, padded so its values are aligned
+   */
+  uint32_t PaddedBitmapSize() const {
+    return Pad(BitmapSize(num_slots_));
+  }
+
+  bool HasColumn(uint16_t col_id) const {
+    return col_id < num_cols_ && attr_sizes_[col_id] != 0;
+  }
+
+  /**
+   * Suggests a placement that lays out frequently accessed columns first and
+   * wide columns before narrow ones. The version pointer column always goes
+   * first since every access reads it.
+   * @param access_counts relative access frequency per column, may be empty
+   */
+  static std::vector<uint16_t>
+  OrderColumns(const std::vector<uint16_t> &attr_sizes,
+               const std::vector<uint32_t> &access_counts = {}) {
+    std::vector<uint16_t> placement;
+    for (uint16_t col_id = 1; col_id < attr_sizes.size(); col_id++) {
+      placement.push_back(col_id);
+    }
+    auto hotness = [&](uint16_t col_id) {
+      return access_counts.empty() ? 0 : access_counts[col_id];
+    };
+    std::stable_sort(placement.begin(), placement.end(),
+                     [&](uint16_t a, uint16_t b) {
+                       if (hotness(a) != hotness(b)) {
+                         return hotness(a) > hotness(b);
+                       }
+                       return attr_sizes[a] > attr_sizes[b];
+                     });
+    placement.insert(placement.begin(), 0);
+    return placement;
+  }
 
 private:
   uint32_t HeaderSize() const {
-    return sizeof(uint32_t) * 3           // block_id, num_records, num_slots
-           + sizeof(uint32_t) * num_cols_ // attr_offsets
-           + sizeof(uint16_t)             // num_attrs
-           + sizeof(uint8_t) * num_cols_; // attr_sizes
+    return sizeof(ZoneMap *)               // zone_maps
+           + sizeof(void *)                // compressed
+           + sizeof(uint32_t) * 9          // block_id, num_records, state,
+                                           // referenced, layout_version,
+                                           // num_versioned,
+                                           // num_uncommitted,
+                                           // num_rollbacks, num_slots
+           + sizeof(timestamp_t)           // max_version_timestamp
+           + sizeof(uint32_t) * num_cols_  // attr_offsets
+           + sizeof(uint16_t)              // num_attrs
+           + sizeof(uint16_t) * num_cols_; // attr_sizes
   }
 
   uint32_t TupleSize() const {
@@ -41,38 +154,123 @@ private:
     return tuple_size;
   }
 
-  uint32_t NumSlots() {
-    return 8 * ((BLOCK_SIZE)-HeaderSize()) / (8 * TupleSize() + num_cols_) - 1;
+  uint32_t Alignment() const {
+    // 每列的bitmap和值数组各自最多浪费alignment - 1个byte
+    for (uint32_t alignment : {CACHELINE_SIZE, 8u}) {
+      if (2ull * alignment * num_cols_ <= block_size_ / 8) {
+        return alignment;
+      }
+    }
+    return 1;
+  }
+
+  uint64_t Pad(uint64_t size) const {
+    return (size + alignment_ - 1) & ~static_cast<uint64_t>(alignment_ - 1);
+  }
+
+  uint64_t ColumnSize(uint16_t col_id, uint32_t num_slots) const {
+    if (attr_sizes_[col_id] == 0) {
+      return 0;
+    }
+    return Pad(BitmapSize(num_slots)) +
+           Pad(static_cast<uint64_t>(num_slots) * attr_sizes_[col_id]);
+  }
+
+  uint64_t BlockBytes(uint32_t num_slots) const {
+    uint64_t size = Pad(HeaderSize());
+    for (uint16_t col_id = 0; col_id < num_cols_; col_id++) {
+      size += ColumnSize(col_id, num_slots);
+    }
+    return size;
+  }
+
+  uint32_t NumSlots() const {
+    if (Pad(HeaderSize()) >= block_size_) {
+      return 0;
+    }
+    // 不算padding的估计是上界，往下调到恰好放得下
+    auto num_present = static_cast<uint32_t>(
+        num_cols_ - std::count(attr_sizes_.begin(), attr_sizes_.end(), 0));
+    auto num_slots = static_cast<uint32_t>(
+        8 * static_cast<uint64_t>(block_size_ - Pad(HeaderSize())) /
+        (8 * TupleSize() + num_present));
+    while (num_slots > 0 && BlockBytes(num_slots) > block_size_) {
+      num_slots--;
+    }
+    return num_slots;
+  }
+
+  std::vector<uint32_t>
+  ColumnOffsets(const std::vector<uint16_t> &placement) const {
+    assert(placement.empty() || placement.size() == num_cols_);
+    std::vector<uint32_t> offsets(num_cols_);
+    uint64_t offset = Pad(header_size_);
+    for (uint16_t i = 0; i < num_cols_; i++) {
+      uint16_t col_id = placement.empty() ? i : placement[i];
+      offsets[col_id] = static_cast<uint32_t>(offset);
+      offset += ColumnSize(col_id, num_slots_);
+    }
+    return offsets;
   }
 };
 
+/**
+ * The storage of a block. Its size is the block_size_ of the layout it was
+ * allocated for, and it is always aligned to that size.
+ */
 class RawBlock {
 public:
-  byte content_[BLOCK_SIZE];
-} __attribute__((aligned(BLOCK_SIZE)));
+  RawBlock() = delete;
+  DISALLOW_COPY_AND_MOVE(RawBlock);
+  ~RawBlock() = delete;
+
+  /**
+   * @return the id InitializeRawBlock gave this block in its header
+   */
+  uint32_t BlockId() const {
+    return *reinterpret_cast<const uint32_t *>(content_ + BLOCK_ID_OFFSET);
+  }
+
+  // Block::block_id_前面是zone_maps_和compressed_两个指针
+  static constexpr uint32_t BLOCK_ID_OFFSET = 2 * sizeof(void *);
+
+  byte content_[0];
+};
 
 void InitializeRawBlock(RawBlock *raw, const BlockLayout &layout,
                         uint32_t block_id);
 
+/**
+ * block id经过BlockDirectory找到地址，block搬走了slot也不变
+ * A block's size is not part of the slot: migration may move a block into
+ * a copy of a different size, and the slot must stay equal to itself.
+ * ---------------------------------------------
+ * | block id (32 bits) | offset (32 bits) |
+ * ---------------------------------------------
+ */
 class TupleSlot {
 public:
   TupleSlot() : bytes_(0) {}
+  TupleSlot(uint32_t block_id, uint32_t offset)
+      : bytes_(static_cast<uint64_t>(block_id) << BLOCK_ID_SHIFT | offset) {}
+
+  /**
+   * block must be registered with the BlockDirectory, and its id resolve to
+   * it or, if it was moved since, to its copy.
+   */
   TupleSlot(RawBlock *block, uint32_t offset)
-      : bytes_((uintptr_t)(block) | static_cast<uintptr_t>(offset)) {
-    assert(!(uintptr_t(block) & static_cast<uintptr_t>(BLOCK_SIZE - 1)));
-    assert(offset < BLOCK_SIZE);
-  }
+      : TupleSlot(block->BlockId(), offset) {}
 
   RawBlock *GetBlock() const {
-    return reinterpret_cast<RawBlock *>(
-        bytes_ & ~static_cast<uintptr_t>(BLOCK_SIZE - 1));
+    return BlockDirectory::Get().Resolve(GetBlockId());
   }
 
-  uint32_t GetOffset() const {
-    return static_cast<uint32_t>(bytes_ &
-                                 static_cast<uintptr_t>(BLOCK_SIZE - 1));
+  uint32_t GetBlockId() const {
+    return static_cast<uint32_t>(bytes_ >> BLOCK_ID_SHIFT);
   }
 
+  uint32_t GetOffset() const { return static_cast<uint32_t>(bytes_); }
+
   bool operator==(const TupleSlot &other) const {
     return bytes_ == other.bytes_;
   }
@@ -83,10 +281,76 @@ public:
 
 private:
   friend struct std::hash<TupleSlot>;
-  uintptr_t bytes_;
+  static constexpr uint32_t BLOCK_ID_SHIFT = 32;
+
+  uint64_t bytes_;
+};
+
+/**
+ * Allocates zeroed blocks of one size, aligned to that size.
+ */
+class BlockAllocator {
+public:
+  explicit BlockAllocator(uint32_t block_size) : block_size_(block_size) {}
+
+  /**
+   * Maps a fresh, zeroed block aligned to its size. Blocks get mappings of
+   * their own rather than heap memory, so that ColdTier can map a file over
+   * one and back without touching memory the allocator owns.
+   */
+  RawBlock *New() {
+    // 多映射一个block大小，再把没对齐的两头还回去
+    size_t length = 2 * static_cast<size_t>(block_size_);
+    void *mapped = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    auto start = reinterpret_cast<uintptr_t>(mapped);
+    uintptr_t block = (start + block_size_ - 1) & ~uintptr_t(block_size_ - 1);
+    uintptr_t end = block + block_size_;
+    if (block != start) {
+      munmap(mapped, block - start);
+    }
+    if (end != start + length) {
+      munmap(reinterpret_cast<void *>(end), start + length - end);
+    }
+    return reinterpret_cast<RawBlock *>(block);
+  }
+
+  void Delete(RawBlock *block) { munmap(block, block_size_); }
+
+private:
+  uint32_t block_size_;
 };
 
-using BlockStore = ObjectPool<RawBlock>;
+/**
+ * 每种block大小有自己的object pool
+ * Hands out and recycles blocks of every supported size. Blocks must be
+ * released with the size they were taken with.
+ */
+class BlockStore {
+  using BlockPool = ObjectPool<RawBlock, BlockAllocator>;
+
+public:
+  explicit BlockStore(uint32_t reuse_limit) {
+    for (uint32_t size = MIN_BLOCK_SIZE; size <= MAX_BLOCK_SIZE; size <<= 1) {
+      pools_.emplace_back(
+          std::make_unique<BlockPool>(reuse_limit, BlockAllocator(size)));
+    }
+  }
+
+  RawBlock *Get(uint32_t block_size) {
+    return pools_[BlockSizeClass(block_size)]->Get();
+  }
+
+  void Release(RawBlock *block, uint32_t block_size) {
+    pools_[BlockSizeClass(block_size)]->Release(block);
+  }
+
+private:
+  std::vector<std::unique_ptr<BlockPool>> pools_;
+};
 
 /**
  * projected row可能只是包含一个record的部分列
@@ -140,14 +404,14 @@ public:
     return reinterpret_cast<const uint32_t *>(ColumnIds() + num_cols_);
   }
 
-  RawConcurrentBitmap *NullBitmap() {
-    return reinterpret_cast<RawConcurrentBitmap *>(AttrValueOffset() +
-                                                   num_cols_);
+  // row只属于一个thread，null bitmap不用atomic
+  RawPrivateBitmap *NullBitmap() {
+    return reinterpret_cast<RawPrivateBitmap *>(AttrValueOffset() + num_cols_);
   }
 
-  const RawConcurrentBitmap *NullBitmap() const {
-    return reinterpret_cast<const RawConcurrentBitmap *>(AttrValueOffset() +
-                                                         num_cols_);
+  const RawPrivateBitmap *NullBitmap() const {
+    return reinterpret_cast<const RawPrivateBitmap *>(AttrValueOffset() +
+                                                      num_cols_);
   }
 
   byte *AccessWithNullCheck(uint16_t offset) {
@@ -165,17 +429,64 @@ public:
   }
 
   byte *AccessForceNotNull(uint16_t offset) {
-    NullBitmap()->Flip(offset, false);
+    NullBitmap()->Set(offset, true);
     return reinterpret_cast<byte *>(this) + AttrValueOffset()[offset];
   }
 
-  void SetNull(uint16_t offset) { NullBitmap()->Flip(offset, true); }
+  void SetNull(uint16_t offset) { NullBitmap()->Set(offset, false); }
+
+  /**
+   * @return bytes taken by num_cols, the column ids, the offsets and the
+   * null-bitmap of a row with num_cols columns
+   */
+  static uint32_t HeaderSize(uint16_t num_cols) {
+    return static_cast<uint32_t>(sizeof(uint16_t)) +
+           num_cols * static_cast<uint32_t>(sizeof(uint16_t) +
+                                            sizeof(uint32_t)) +
+           BitmapSize(num_cols);
+  }
 
 private:
   uint16_t num_cols_;
   byte varlen_contents_[0];
 };
 
+/**
+ * 同一个projection的row header都一样，算一次之后直接拷贝
+ * Lays out a projection once so rows of it can be stamped out with a single
+ * memcpy instead of walking the layout every time. Columns are ordered by
+ * descending attribute size and values start 8-byte aligned, so every value
+ * sits at its natural alignment; ColumnIds() gives the resulting order.
+ * Rows come out with every column null.
+ */
+class ProjectedRowInitializer {
+public:
+  ProjectedRowInitializer(const BlockLayout &layout,
+                          std::vector<uint16_t> col_ids);
+
+  ProjectedRow *InitializeRow(byte *head) const {
+    std::memcpy(head, header_.data(), header_.size());
+    return reinterpret_cast<ProjectedRow *>(head);
+  }
+
+  /**
+   * @return bytes to reserve for a row; a multiple of 8, so rows and delta
+   * records can be packed back to back
+   */
+  uint32_t ProjectedRowSize() const { return size_; }
+
+  uint16_t NumColumns() const {
+    return static_cast<uint16_t>(col_ids_.size());
+  }
+
+  const std::vector<uint16_t> &ColumnIds() const { return col_ids_; }
+
+private:
+  std::vector<uint16_t> col_ids_;
+  std::vector<byte> header_;
+  uint32_t size_;
+};
+
 class DeltaRecord {
 public:
   DeltaRecord() = delete;
@@ -190,6 +501,18 @@ public:
     return reinterpret_cast<ProjectedRow *>(varlen_contents_);
   }
 
+  /**
+   * 装上之后next_就是被盖住的版本
+   * @return whether this record, once installed, covers a version another
+   * transaction committed after read_timestamp. Writing over it would lose
+   * an update the writer never saw.
+   */
+  bool CoversNewerCommit(timestamp_t read_timestamp) const {
+    return next_ != nullptr && next_->timestamp_ != timestamp_ &&
+           static_cast<int64_t>(next_->timestamp_) >= 0 &&
+           next_->timestamp_ > read_timestamp;
+  }
+
   static uint32_t Size(const BlockLayout &layout,
                        const std::vector<uint16_t> &col_ids) {
     return static_cast<uint32_t>(sizeof(DeltaRecord *)) +
@@ -209,6 +532,22 @@ public:
     return delta_record;
   }
 
+  static uint32_t Size(const ProjectedRowInitializer &initializer) {
+    return static_cast<uint32_t>(sizeof(DeltaRecord *)) +
+           static_cast<uint32_t>(sizeof(timestamp_t)) +
+           initializer.ProjectedRowSize();
+  }
+
+  static DeltaRecord *
+  InitializeDeltaRecord(byte *head, timestamp_t timestamp,
+                        const ProjectedRowInitializer &initializer) {
+    DeltaRecord *delta_record = reinterpret_cast<DeltaRecord *>(head);
+    delta_record->timestamp_ = timestamp;
+    delta_record->next_ = nullptr;
+    initializer.InitializeRow(delta_record->varlen_contents_);
+    return delta_record;
+  }
+
 private:
   byte varlen_contents_[0];
 };
@@ -219,7 +558,7 @@ private:
 namespace std {
 template <> struct hash<noisepage::storage::TupleSlot> {
   size_t operator()(const noisepage::storage::TupleSlot &slot) const {
-    return hash<uintptr_t>()(slot.bytes_);
+    return hash<uint64_t>()(slot.bytes_);
   }
 };
 } // namespace std
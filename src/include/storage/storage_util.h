@@ -1,5 +1,6 @@
 #pragma once
 #include "storage/tuple_access_strategy.h"
+#include <cstring>
 #include <iostream>
 #include <unordered_map>
 
@@ -7,7 +8,7 @@ namespace noisepage::storage {
 class StorageUtil {
 public:
   StorageUtil() = delete;
-  static uint64_t ReadBytes(uint8_t size, const byte *pos) {
+  static uint64_t ReadBytes(uint16_t size, const byte *pos) {
     switch (size) {
     case 1:
       return *reinterpret_cast<const uint8_t *>(pos);
@@ -22,7 +23,23 @@ public:
     }
   }
 
-  static void WriteBytes(uint8_t size, uint64_t val, byte *pos) {
+  // 和ReadBytes一样，但是按有符号整数做符号扩展
+  static int64_t ReadInteger(uint16_t size, const byte *pos) {
+    switch (size) {
+    case 1:
+      return *reinterpret_cast<const int8_t *>(pos);
+    case 2:
+      return *reinterpret_cast<const int16_t *>(pos);
+    case 4:
+      return *reinterpret_cast<const int32_t *>(pos);
+    case 8:
+      return *reinterpret_cast<const int64_t *>(pos);
+    default:
+      throw std::runtime_error("Invalid byte read value");
+    }
+  }
+
+  static void WriteBytes(uint16_t size, uint64_t val, byte *pos) {
     switch (size) {
     case 1:
       *reinterpret_cast<uint8_t *>(pos) = static_cast<uint8_t>(val);
@@ -41,18 +58,80 @@ public:
     }
   }
 
+  /**
+   * @return whether attributes of this size are read as integers by
+   * predicates, zone maps and compression
+   */
+  static bool IsInteger(uint16_t size) {
+    return size == 1 || size == 2 || size == 4 || size == 8;
+  }
+
+  // 宽度不限于8个byte，常见的宽度不走memcpy
+  static void CopyBytes(uint16_t size, const byte *from, byte *to) {
+    if (IsInteger(size)) {
+      WriteBytes(size, ReadBytes(size, from), to);
+    } else {
+      std::memcpy(to, from, size);
+    }
+  }
+
+  // bitmap都是高位在前，直接memset就是前num_bits个bit
+  static void SetBits(uint8_t *dst, uint32_t num_bits) {
+    std::memset(dst, 0xFF, num_bits / BYTE_SIZE);
+    if (num_bits % BYTE_SIZE != 0) {
+      dst[num_bits / BYTE_SIZE] =
+          static_cast<uint8_t>(0xFF << (BYTE_SIZE - num_bits % BYTE_SIZE));
+    }
+  }
+
+  /**
+   * Copies num_bits bits starting at bit src_offset of src to the start of
+   * dst, 64 bits at a time. Bits of dst's last byte past num_bits are
+   * cleared.
+   */
+  static void CopyBits(const uint8_t *src, uint32_t src_offset, uint8_t *dst,
+                       uint32_t num_bits) {
+    const uint8_t *from = src + src_offset / BYTE_SIZE;
+    uint32_t shift = src_offset % BYTE_SIZE;
+    uint32_t i = 0;
+    // 每个word要多读一个byte来补上移走的bit
+    for (; i + 72 <= num_bits; i += 64) {
+      uint64_t word;
+      std::memcpy(&word, from + i / BYTE_SIZE, sizeof(word));
+      word = __builtin_bswap64(word);
+      if (shift != 0) {
+        word = word << shift | from[i / BYTE_SIZE + 8] >> (BYTE_SIZE - shift);
+      }
+      word = __builtin_bswap64(word);
+      std::memcpy(dst + i / BYTE_SIZE, &word, sizeof(word));
+    }
+    for (; i < num_bits; i += BYTE_SIZE) {
+      auto bits = static_cast<uint8_t>(from[i / BYTE_SIZE] << shift);
+      if (shift != 0 && num_bits - i > BYTE_SIZE - shift) {
+        bits |= static_cast<uint8_t>(from[i / BYTE_SIZE + 1] >>
+                                     (BYTE_SIZE - shift));
+      }
+      dst[i / BYTE_SIZE] = bits;
+    }
+    if (num_bits % BYTE_SIZE != 0) {
+      dst[num_bits / BYTE_SIZE] &=
+          static_cast<uint8_t>(0xFF << (BYTE_SIZE - num_bits % BYTE_SIZE));
+    }
+  }
+
   static void CopyAttrIntoProjection(const TupleAccessStrategy &accessor,
                                      const TupleSlot &slot, ProjectedRow *to,
                                      uint16_t projection_list_offset) {
     uint16_t col_id = to->ColumnIds()[projection_list_offset];
-    uint8_t attr_size = accessor.GetBlockLayout().attr_sizes_[col_id];
-    auto *store_attr = accessor.AccessWithNullCheck(slot, col_id);
+    uint16_t attr_size = accessor.GetBlockLayout().attr_sizes_[col_id];
+    // 压缩过的block直接解到projection里
+    auto *dest = to->AccessForceNotNull(projection_list_offset);
+    const byte *store_attr = accessor.ReadAttr(slot, col_id, dest);
 
     if (store_attr == nullptr) {
       to->SetNull(projection_list_offset);
-    } else {
-      auto *dest = to->AccessForceNotNull(projection_list_offset);
-      WriteBytes(attr_size, ReadBytes(attr_size, store_attr), dest);
+    } else if (store_attr != dest) {
+      CopyBytes(attr_size, store_attr, dest);
     }
   }
 
@@ -62,15 +141,19 @@ public:
                                      uint16_t projection_list_offset) {
     const byte *store_attr = from.AccessWithNullCheck(projection_list_offset);
     uint16_t col_id = from.ColumnIds()[projection_list_offset];
-    uint8_t attr_size = accessor.GetBlockLayout().attr_sizes_[col_id];
+    uint16_t attr_size = accessor.GetBlockLayout().attr_sizes_[col_id];
     if (store_attr == nullptr) {
       accessor.SetNull(slot, col_id);
     } else {
       auto *dest = accessor.AccessForceNotNull(slot, col_id);
-      WriteBytes(attr_size, ReadBytes(attr_size, store_attr), dest);
+      CopyBytes(attr_size, store_attr, dest);
     }
   }
 
+  /**
+   * Applies the columns of delta that are in buffer's projection (given by
+   * id_to_offset) to buffer. Other columns, e.g. dropped ones, are skipped.
+   */
   static void
   ApplyDelta(const BlockLayout &layout, const ProjectedRow &delta,
              ProjectedRow *buffer,
@@ -79,13 +162,15 @@ public:
       const byte *delta_attr = delta.AccessWithNullCheck(i);
       uint16_t col_id = delta.ColumnIds()[i];
       auto it = id_to_offset.find(col_id);
-      assert(it != id_to_offset.end());
+      if (it == id_to_offset.end()) {
+        continue;
+      }
       if (delta_attr == nullptr) {
         buffer->SetNull(it->second);
       } else {
-        uint8_t attr_size = layout.attr_sizes_[col_id];
+        uint16_t attr_size = layout.attr_sizes_[col_id];
         auto *dest = buffer->AccessForceNotNull(it->second);
-        WriteBytes(attr_size, ReadBytes(attr_size, delta_attr), dest);
+        CopyBytes(attr_size, delta_attr, dest);
       }
     }
   }
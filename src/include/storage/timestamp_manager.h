@@ -0,0 +1,265 @@
+#pragma once
+#include "common/macros.h"
+#include "common/scheduler.h"
+#include "storage/storage_defs.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace noisepage::storage {
+/**
+ * 按epoch分组提交，不用全局计数器
+ * Hands out read and commit timestamps for snapshot isolation without a
+ * global counter that every transaction increments. Time is split into
+ * epochs, advanced every few milliseconds by Advance. A commit timestamp is
+ * the current epoch in the high bits and a per-slot sequence number in the
+ * low bits, so committing only loads the epoch and writes the committer's
+ * own slot. Commit timestamps are always distinct: a slot that commits
+ * 2^SEQUENCE_BITS / max_active times in one epoch advances the epoch
+ * itself before committing again. Snapshots are taken
+ * at epoch boundaries: a read timestamp is the last timestamp of the newest
+ * epoch whose commits have all finished (the stable epoch), which Advance
+ * publishes. Taking one is a load of a word that changes once per epoch.
+ *
+ * Every commit timestamp is greater than the read timestamp of its
+ * transaction, and a snapshot contains either all or none of the commits of
+ * an epoch, all of them fully installed. The price is freshness: a new
+ * snapshot may miss commits from the last epoch or so, so a transaction
+ * that must see an earlier commit (e.g. of the same client) first calls
+ * AwaitVisible on its timestamp.
+ *
+ * Timestamps stay below 2^63, so they never look like the uncommitted
+ * versions DataTable checks for.
+ */
+class TimestampManager {
+  static constexpr uint64_t IDLE = UINT64_MAX;
+
+  struct alignas(64) Slot {
+    std::atomic<bool> in_use_{false};
+    std::atomic<timestamp_t> read_timestamp_{0};
+    // 正在提交的事务所在的epoch，IDLE表示没有
+    std::atomic<uint64_t> commit_epoch_{IDLE};
+    // 只有占着slot的线程会碰
+    uint64_t sequence_epoch_ = 0;
+    uint64_t sequence_ = 0;
+  };
+
+public:
+  static constexpr uint32_t SEQUENCE_BITS = 24;
+
+  /**
+   * Timestamps of one transaction. Takes its read timestamp when created
+   * and keeps it registered for OldestActiveTimestamp until destroyed.
+   */
+  class Transaction {
+  public:
+    explicit Transaction(TimestampManager *manager)
+        : manager_(manager), slot_(manager->Begin()),
+          read_timestamp_(slot_->read_timestamp_.load()) {}
+
+    ~Transaction() {
+      if (commit_timestamp_ != 0) {
+        EndCommit();
+      }
+      slot_->in_use_.store(false, std::memory_order_release);
+    }
+
+    DISALLOW_COPY_AND_MOVE(Transaction);
+
+    timestamp_t ReadTimestamp() const { return read_timestamp_; }
+
+    /**
+     * Picks the commit timestamp. Snapshots cannot include it until
+     * EndCommit, so the writes are installed in between.
+     */
+    timestamp_t BeginCommit() {
+      assert(commit_timestamp_ == 0);
+      commit_timestamp_ = manager_->BeginCommit(slot_);
+      return commit_timestamp_;
+    }
+
+    /**
+     * Marks the writes as installed; the commit becomes visible with the
+     * next Advance.
+     */
+    void EndCommit() {
+      slot_->commit_epoch_.store(IDLE, std::memory_order_release);
+    }
+
+  private:
+    TimestampManager *const manager_;
+    Slot *const slot_;
+    const timestamp_t read_timestamp_;
+    timestamp_t commit_timestamp_ = 0;
+  };
+
+  /**
+   * @param max_active how many Transactions can be alive at once; further
+   * ones wait until one is destroyed
+   */
+  explicit TimestampManager(uint32_t max_active = 128) : slots_(max_active) {}
+
+  ~TimestampManager() { StopEpochAdvancer(); }
+
+  DISALLOW_COPY_AND_MOVE(TimestampManager);
+
+  static uint64_t EpochOf(timestamp_t timestamp) {
+    return timestamp >> SEQUENCE_BITS;
+  }
+
+  uint64_t CurrentEpoch() const { return epoch_.load(); }
+
+  /**
+   * @return a read timestamp: the end of the stable epoch
+   */
+  timestamp_t ReadTimestamp() const {
+    return ((stable_.load(std::memory_order_acquire) + 1) << SEQUENCE_BITS) -
+           1;
+  }
+
+  /**
+   * Starts a new epoch and publishes the newest epoch with no commit still
+   * in progress as the stable one. Only one thread advances at a time;
+   * others return at once.
+   * @return whether this call advanced the epoch
+   */
+  bool Advance() {
+    std::unique_lock<std::mutex> lock(advance_latch_, std::try_to_lock);
+    if (!lock.owns_lock()) {
+      return false;
+    }
+    uint64_t epoch = epoch_.load();
+    epoch_.store(epoch + 1);
+    // 和BeginCommit里的fence配对：要么这里看到它的commit_epoch_，要么它看到新epoch
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t stable = epoch;
+    for (auto &slot : slots_) {
+      uint64_t commit_epoch = slot.commit_epoch_.load();
+      if (commit_epoch != IDLE) {
+        stable = std::min(stable, commit_epoch - 1);
+      }
+    }
+    if (stable > stable_.load(std::memory_order_relaxed)) {
+      stable_.store(stable, std::memory_order_release);
+    }
+    return true;
+  }
+
+  /**
+   * Waits until snapshots taken from now on include the commit at
+   * timestamp, advancing the epoch itself instead of waiting for the
+   * advancer.
+   */
+  void AwaitVisible(timestamp_t timestamp) {
+    while (stable_.load(std::memory_order_acquire) < EpochOf(timestamp)) {
+      if (!Advance()) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  /**
+   * @return a timestamp no newer than the read timestamp of any live
+   * Transaction or of any Transaction created later, for garbage collection
+   */
+  timestamp_t OldestActiveTimestamp() const {
+    // 先读stable_再扫slot，和Begin里的重读配对
+    timestamp_t oldest = ReadTimestamp();
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (const auto &slot : slots_) {
+      if (slot.in_use_.load()) {
+        oldest = std::min(oldest, slot.read_timestamp_.load());
+      }
+    }
+    return oldest;
+  }
+
+  /**
+   * Calls Advance every period as a background task of scheduler until
+   * stopped. The scheduler must outlive the advancer.
+   */
+  void StartEpochAdvancer(Scheduler *scheduler,
+                          std::chrono::microseconds period) {
+    StopEpochAdvancer();
+    scheduler_ = scheduler;
+    periodic_id_ = scheduler->RunPeriodically(period, [this] { Advance(); });
+  }
+
+  void StopEpochAdvancer() {
+    if (scheduler_ != nullptr) {
+      scheduler_->Cancel(periodic_id_);
+      scheduler_ = nullptr;
+    }
+  }
+
+private:
+  std::vector<Slot> slots_;
+  // epoch从1开始，所以最早的snapshot是epoch 0的末尾
+  alignas(64) std::atomic<uint64_t> epoch_{1};
+  alignas(64) std::atomic<uint64_t> stable_{0};
+  std::mutex advance_latch_;
+  Scheduler *scheduler_ = nullptr;
+  uint64_t periodic_id_ = 0;
+
+  Slot *Begin() {
+    // 和EpochManager::Pin一样，上次用过的slot大概率还空着
+    thread_local uint32_t hint = 0;
+    auto num_slots = static_cast<uint32_t>(slots_.size());
+    for (uint32_t i = 0;; i++) {
+      uint32_t index = (hint + i) % num_slots;
+      Slot &slot = slots_[index];
+      bool expected = false;
+      if (!slot.in_use_.load(std::memory_order_relaxed) &&
+          slot.in_use_.compare_exchange_strong(expected, true)) {
+        hint = index;
+        // 登记之后stable_没变，OldestActiveTimestamp就一定能看到这次登记
+        timestamp_t read_timestamp;
+        do {
+          read_timestamp = ReadTimestamp();
+          slot.read_timestamp_.store(read_timestamp);
+          std::atomic_thread_fence(std::memory_order_seq_cst);
+        } while (ReadTimestamp() != read_timestamp);
+        return &slot;
+      }
+      if (i % num_slots == num_slots - 1) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  timestamp_t BeginCommit(Slot *slot) {
+    uint64_t epoch = epoch_.load();
+    while (true) {
+      slot->commit_epoch_.store(epoch);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      uint64_t current = epoch_.load();
+      if (current != epoch) {
+        // Advance可能没看到这次登记，换到新epoch重来
+        epoch = current;
+        continue;
+      }
+      if (slot->sequence_epoch_ != epoch) {
+        slot->sequence_epoch_ = epoch;
+        slot->sequence_ = 0;
+      }
+      // 各个slot的序号交错开，这样同一个epoch里的提交时间戳互不相同
+      uint64_t sequence = slot->sequence_ * slots_.size() +
+                          static_cast<uint64_t>(slot - slots_.data());
+      if (sequence < (uint64_t{1} << SEQUENCE_BITS)) {
+        slot->sequence_++;
+        return (epoch << SEQUENCE_BITS) | sequence;
+      }
+      // 这个epoch里的序号用完了，推进epoch再来
+      while (epoch_.load() == epoch) {
+        if (!Advance()) {
+          std::this_thread::yield();
+        }
+      }
+      epoch = epoch_.load();
+    }
+  }
+};
+} // namespace noisepage::storage
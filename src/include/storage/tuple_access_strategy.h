@@ -2,6 +2,7 @@
 
 #include "common/concurrent_bitmap.h"
 #include "common/macros.h"
+#include "storage/compressed_block.h"
 #include "storage/storage_defs.h"
 #include <cstddef>
 #include <type_traits>
@@ -11,10 +12,10 @@ namespace noisepage {
 
 namespace storage {
 /**
- * mini block存储一列数据
- * ----------------------------------------------------
- * | null-bitmap (pad up to byte) | val1 | val2 | ... |
- * ----------------------------------------------------
+ * mini block存储一列数据，bitmap和值数组都按layout的alignment_对齐
+ * ----------------------------------------------------------------
+ * | null-bitmap (pad up to alignment) | val1 | val2 | ... | pad |
+ * ----------------------------------------------------------------
  */
 struct MiniBlock {
 public:
@@ -26,18 +27,31 @@ public:
   }
 
   byte *ColumnStart(const BlockLayout &layout) {
-    return varlen_contents_ + BitmapSize(layout.num_slots_);
+    return varlen_contents_ + layout.PaddedBitmapSize();
   }
   byte varlen_contents_[0]{};
 };
 
 /**
- * ---------------------------------------------------------------------
- * | block_id | num_records | num_slots | attr_offsets[num_attributes] | //
- * 32-bit fields
- * ---------------------------------------------------------------------
- * | num_attrs (16-bit) | attr_sizes[num_attr] (8-bit) |   ...content  |
- * ---------------------------------------------------------------------
+ * ---------------------------------------------------------------------------
+ * | zone_maps (64-bit) | compressed (64-bit) | block_id | num_records |
+ * ---------------------------------------------------------------------------
+ * | state | referenced | layout_version | num_versioned |
+ * ---------------------------------------------------------------------------
+ * | max_version_timestamp (64-bit) | num_uncommitted | num_rollbacks |
+ * ---------------------------------------------------------------------------
+ * | num_slots | attr_offsets[num_attributes] (32-bit) | num_attrs (16-bit) |
+ * ---------------------------------------------------------------------------
+ * | attr_sizes[num_attr] (16-bit) |   ...content   |
+ * ---------------------------------------------------------------------------
+ * zone_maps points to num_attrs ZoneMaps owned by the DataTable. They do not
+ * live inside the block because a layout can have up to 65535 columns.
+ * compressed is only valid once the block has been compressed. referenced
+ * is the ColdTier's CLOCK bit. layout_version says which of its table's
+ * layouts the block was written with. num_versioned counts the tuples with a
+ * version chain and max_version_timestamp is the newest delta timestamp ever
+ * installed; both only go back to 0 when the block is frozen. num_rollbacks
+ * only grows, so readers can tell that a rollback ran while they read.
  */
 struct Block {
   Block() = delete;
@@ -54,8 +68,8 @@ struct Block {
     return *reinterpret_cast<uint16_t *>(AttrOffsets() + layout.num_cols_);
   }
 
-  uint8_t *AttrSizes(const BlockLayout &layout) {
-    return reinterpret_cast<uint8_t *>(&NumAttrs(layout) + 1);
+  uint16_t *AttrSizes(const BlockLayout &layout) {
+    return &NumAttrs(layout) + 1;
   }
 
   MiniBlock *Column(uint16_t col_offset) {
@@ -63,10 +77,25 @@ struct Block {
     return reinterpret_cast<MiniBlock *>(head);
   }
 
+  ZoneMap *zone_maps_;
+  CompressedBlock *compressed_;
   uint32_t block_id_;
   uint32_t num_records_;
+  std::atomic<BlockState> state_;
+  std::atomic<uint32_t> referenced_;
+  uint32_t layout_version_;
+  std::atomic<uint32_t> num_versioned_;
+  std::atomic<timestamp_t> max_version_timestamp_;
+  std::atomic<uint32_t> num_uncommitted_;
+  std::atomic<uint32_t> num_rollbacks_;
   byte varlen_contents_[0];
 };
+static_assert(offsetof(Block, block_id_) == RawBlock::BLOCK_ID_OFFSET);
+
+inline bool IsCompressed(BlockState state) {
+  return state == BlockState::COMPRESSED ||
+         state == BlockState::DECOMPRESSING;
+}
 
 class TupleAccessStrategy {
 public:
@@ -88,11 +117,34 @@ public:
     return false;
   }
 
+  /**
+   * Points at the attribute in the block, for writers and for whoever else
+   * keeps the block from being compressed. A compressed block keeps its
+   * values elsewhere and must be decompressed first; readers use ReadAttr.
+   */
   byte *ColumnAt(TupleSlot slot, uint16_t col_id) const {
-    byte *column_start = reinterpret_cast<Block *>(slot.GetBlock())
-                             ->Column(col_id)
-                             ->ColumnStart(layout_);
-    return column_start + slot.GetOffset() * layout_.attr_sizes_[col_id];
+    auto *block = reinterpret_cast<Block *>(slot.GetBlock());
+    assert(!IsCompressed(block->state_.load(std::memory_order_relaxed)));
+    return InPlace(block, slot.GetOffset(), col_id);
+  }
+
+  /**
+   * For readers, who may find the block in any state: points at the
+   * attribute in the block, or if the block is compressed decodes it into
+   * buffer, which has room for the attribute, and points there.
+   * @return nullptr if the attribute is null
+   */
+  const byte *ReadAttr(TupleSlot slot, uint16_t col_id, byte *buffer) const {
+    auto *block = reinterpret_cast<Block *>(slot.GetBlock());
+    if (!block->Column(col_id)->NullBitmap()->Test(slot.GetOffset())) {
+      return nullptr;
+    }
+    // 压缩过的block只能读，值要从压缩的副本里解出来
+    if (IsCompressed(block->state_.load(std::memory_order_acquire))) {
+      block->compressed_->AttrAt(layout_, col_id, slot.GetOffset(), buffer);
+      return buffer;
+    }
+    return InPlace(block, slot.GetOffset(), col_id);
   }
 
   byte *AccessWithNullCheck(TupleSlot slot, uint16_t col_id) const {
@@ -115,6 +167,11 @@ public:
 
 private:
   const BlockLayout layout_;
+
+  byte *InPlace(Block *block, uint32_t offset, uint16_t col_id) const {
+    return block->Column(col_id)->ColumnStart(layout_) +
+           static_cast<uint64_t>(offset) * layout_.attr_sizes_[col_id];
+  }
 };
 } // namespace storage
 
@@ -0,0 +1,65 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <limits>
+
+namespace noisepage::storage {
+/**
+ * 每个block每一列的min/max/null count摘要
+ * Per-block, per-column summary referenced from the block header. While a
+ * block is hot the range only ever widens, so it covers every value that was
+ * ever written into the block (including ones that now only live in a version
+ * chain) and null_count_ counts null writes. Freezing a block recomputes all
+ * three exactly from the tuples in it. An empty range (min_ > max_) means the
+ * column never held a non-null value.
+ */
+struct ZoneMap {
+  void Reset() {
+    min_.store(std::numeric_limits<int64_t>::max());
+    max_.store(std::numeric_limits<int64_t>::min());
+    null_count_.store(0);
+  }
+
+  void Widen(int64_t val) {
+    // 多个线程可能同时widen同一列
+    for (auto old_min = min_.load(); val < old_min;) {
+      if (min_.compare_exchange_weak(old_min, val)) {
+        break;
+      }
+    }
+    for (auto old_max = max_.load(); val > old_max;) {
+      if (max_.compare_exchange_weak(old_max, val)) {
+        break;
+      }
+    }
+  }
+
+  void AddNull() { null_count_.fetch_add(1); }
+
+  /**
+   * Replaces the summary with an exactly computed one while readers may be
+   * looking at it. The range is widened to cover the new one before it is
+   * narrowed, so a reader never sees a range missing a value that is in the
+   * block.
+   */
+  void Publish(int64_t min, int64_t max, uint32_t null_count) {
+    if (min <= max) {
+      Widen(min);
+      Widen(max);
+    }
+    min_.store(min);
+    max_.store(max);
+    null_count_.store(null_count);
+  }
+
+  bool Empty() const { return min_.load() > max_.load(); }
+
+  bool MayContain(int64_t lo, int64_t hi) const {
+    return lo <= hi && lo <= max_.load() && hi >= min_.load();
+  }
+
+  std::atomic<int64_t> min_;
+  std::atomic<int64_t> max_;
+  std::atomic<uint32_t> null_count_;
+};
+} // namespace noisepage::storage
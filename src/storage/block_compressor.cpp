@@ -0,0 +1,362 @@
+#include "storage/block_compressor.h"
+#include "storage/predicate_kernels.h"
+#include "storage/storage_util.h"
+#include <algorithm>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+
+namespace noisepage::storage {
+namespace {
+struct EncodedColumn {
+  CompressedColumn column_;
+  std::vector<byte> data_;
+};
+
+uint8_t BitWidth(uint64_t max_code) {
+  return max_code == 0 ? 0
+                       : static_cast<uint8_t>(64 - __builtin_clzll(max_code));
+}
+
+uint64_t PackedSize(uint32_t num_codes, uint8_t bit_width) {
+  return (static_cast<uint64_t>(num_codes) * bit_width + BYTE_SIZE - 1) /
+             BYTE_SIZE +
+         CompressedBlock::PADDING;
+}
+
+void PackCode(byte *data, uint32_t pos, uint8_t bit_width, uint64_t code) {
+  if (bit_width == 0) {
+    return;
+  }
+  uint64_t bit_pos = static_cast<uint64_t>(pos) * bit_width;
+  unsigned __int128 word;
+  std::memcpy(&word, data + bit_pos / BYTE_SIZE, sizeof(word));
+  word |= static_cast<unsigned __int128>(code) << (bit_pos % BYTE_SIZE);
+  std::memcpy(data + bit_pos / BYTE_SIZE, &word, sizeof(word));
+}
+
+// null和未分配的slot的值无所谓，用前一个有效值填上，对RLE和字典都更友好
+std::vector<int64_t> ReadValues(Block *block, const BlockLayout &layout,
+                                uint16_t col_id) {
+  uint32_t num_slots = layout.num_slots_;
+  uint16_t attr_size = layout.attr_sizes_[col_id];
+  auto *allocation_bitmap = block->Column(0)->NullBitmap();
+  auto *null_bitmap = block->Column(col_id)->NullBitmap();
+  const byte *column = block->Column(col_id)->ColumnStart(layout);
+
+  std::vector<int64_t> values(num_slots);
+  bool has_valid = false;
+  int64_t last_valid = 0;
+  for (uint32_t i = 0; i < num_slots; i++) {
+    if (allocation_bitmap->Test(i) && null_bitmap->Test(i)) {
+      last_valid = StorageUtil::ReadInteger(attr_size, column + i * attr_size);
+      if (!has_valid) {
+        std::fill(values.begin(), values.begin() + i, last_valid);
+        has_valid = true;
+      }
+    }
+    values[i] = last_valid;
+  }
+  return values;
+}
+
+EncodedColumn EncodePlain(uint32_t num_slots, uint16_t attr_size,
+                          const byte *plain) {
+  EncodedColumn result{};
+  result.column_.encoding_ = ColumnEncoding::PLAIN;
+  result.column_.attr_size_ = attr_size;
+  result.data_.assign(plain, plain + static_cast<uint64_t>(num_slots) *
+                                         attr_size);
+  return result;
+}
+
+EncodedColumn Encode(const std::vector<int64_t> &values, uint16_t attr_size,
+                     const byte *plain) {
+  auto num_slots = static_cast<uint32_t>(values.size());
+  std::vector<int64_t> dictionary(values);
+  std::sort(dictionary.begin(), dictionary.end());
+  dictionary.erase(std::unique(dictionary.begin(), dictionary.end()),
+                   dictionary.end());
+  uint32_t num_runs = num_slots == 0 ? 0 : 1;
+  for (uint32_t i = 1; i < num_slots; i++) {
+    num_runs += values[i] != values[i - 1];
+  }
+
+  int64_t min = dictionary.empty() ? 0 : dictionary.front();
+  int64_t max = dictionary.empty() ? 0 : dictionary.back();
+  uint8_t for_width =
+      BitWidth(static_cast<uint64_t>(max) - static_cast<uint64_t>(min));
+  auto dictionary_size = static_cast<uint32_t>(dictionary.size());
+  uint8_t dictionary_width =
+      BitWidth(dictionary_size == 0 ? 0 : dictionary_size - 1);
+
+  uint64_t plain_size = static_cast<uint64_t>(num_slots) * attr_size;
+  uint64_t for_size = PackedSize(num_slots, for_width);
+  uint64_t dictionary_size_bytes = dictionary_size * sizeof(int64_t) +
+                                   PackedSize(num_slots, dictionary_width);
+  uint64_t rle_size = num_runs * (sizeof(int64_t) + sizeof(uint32_t));
+  uint64_t best =
+      std::min({plain_size, for_size, dictionary_size_bytes, rle_size});
+  if (best == plain_size) {
+    return EncodePlain(num_slots, attr_size, plain);
+  }
+
+  EncodedColumn result{};
+  CompressedColumn &column = result.column_;
+  column.attr_size_ = attr_size;
+  result.data_.resize(best, static_cast<byte>(0));
+  byte *data = result.data_.data();
+  if (best == for_size) {
+    column.encoding_ = ColumnEncoding::FRAME_OF_REFERENCE;
+    column.bit_width_ = for_width;
+    column.base_ = min;
+    for (uint32_t i = 0; i < num_slots; i++) {
+      PackCode(data, i, for_width,
+               static_cast<uint64_t>(values[i]) - static_cast<uint64_t>(min));
+    }
+  } else if (best == rle_size) {
+    column.encoding_ = ColumnEncoding::RUN_LENGTH;
+    column.num_entries_ = num_runs;
+    auto *run_values = reinterpret_cast<int64_t *>(data);
+    auto *run_ends =
+        reinterpret_cast<uint32_t *>(data + num_runs * sizeof(int64_t));
+    uint32_t run = 0;
+    for (uint32_t i = 0; i < num_slots; i++) {
+      if (i > 0 && values[i] != values[i - 1]) {
+        run_ends[run++] = i;
+      }
+      run_values[run] = values[i];
+    }
+    run_ends[run] = num_slots;
+  } else {
+    column.encoding_ = ColumnEncoding::DICTIONARY;
+    column.bit_width_ = dictionary_width;
+    column.num_entries_ = dictionary_size;
+    std::memcpy(data, dictionary.data(), dictionary_size * sizeof(int64_t));
+    byte *codes = data + dictionary_size * sizeof(int64_t);
+    for (uint32_t i = 0; i < num_slots; i++) {
+      auto code = std::lower_bound(dictionary.begin(), dictionary.end(),
+                                   values[i]) -
+                  dictionary.begin();
+      PackCode(codes, i, dictionary_width, static_cast<uint64_t>(code));
+    }
+  }
+  return result;
+}
+
+// 把值数组中间整页的部分还给操作系统，再次写入时会得到全0的页
+void ReleaseColumnPages(byte *column, uint64_t size) {
+  static const auto page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  uintptr_t start = (reinterpret_cast<uintptr_t>(column) + page_size - 1) &
+                    ~(page_size - 1);
+  uintptr_t end = (reinterpret_cast<uintptr_t>(column) + size) &
+                  ~(page_size - 1);
+  if (start < end) {
+    madvise(reinterpret_cast<void *>(start), end - start, MADV_DONTNEED);
+  }
+}
+
+void ClearBits(uint8_t *selection, uint32_t start, uint32_t end) {
+  for (uint32_t pos = start; pos < end; pos++) {
+    if (pos % BYTE_SIZE == 0 && pos + BYTE_SIZE <= end) {
+      selection[pos / BYTE_SIZE] = 0;
+      pos += BYTE_SIZE - 1;
+    } else {
+      selection[pos / BYTE_SIZE] &= ONE_COLD_MASK(pos % BYTE_SIZE);
+    }
+  }
+}
+
+// 逐个解出code判断，不需要还原成原来的值
+template <typename Match>
+void FilterCodes(const byte *codes, uint8_t bit_width, uint32_t num_slots,
+                 uint8_t *selection, Match match) {
+  for (uint32_t base = 0; base < num_slots; base += BYTE_SIZE) {
+    uint8_t bits = 0;
+    uint32_t end = std::min(base + BYTE_SIZE, num_slots);
+    for (uint32_t pos = base; pos < end; pos++) {
+      if (match(CompressedBlock::UnpackCode(codes, pos, bit_width))) {
+        bits |= ONE_HOT_MASK(pos - base);
+      }
+    }
+    selection[base / BYTE_SIZE] &= bits;
+  }
+}
+} // namespace
+
+bool BlockCompressor::Compress(RawBlock *raw, const BlockLayout &layout,
+                               CompressedBlock **previous) {
+  auto *block = reinterpret_cast<Block *>(raw);
+  if (block->state_.load() != BlockState::FROZEN) {
+    return false;
+  }
+
+  std::vector<EncodedColumn> encoded;
+  uint64_t size = sizeof(CompressedBlock) +
+                  layout.num_cols_ * sizeof(CompressedColumn);
+  for (uint16_t col_id = 0; col_id < layout.num_cols_; col_id++) {
+    uint16_t attr_size = layout.attr_sizes_[col_id];
+    const byte *plain = block->Column(col_id)->ColumnStart(layout);
+    encoded.push_back(
+        StorageUtil::IsInteger(attr_size)
+            ? Encode(ReadValues(block, layout, col_id), attr_size, plain)
+            : EncodePlain(layout.num_slots_, attr_size, plain));
+    size = (size + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t);
+    encoded.back().column_.data_offset_ = size;
+    size += encoded.back().data_.size();
+  }
+
+  auto *compressed = reinterpret_cast<CompressedBlock *>(new byte[size]);
+  compressed->size_ = size;
+  for (uint16_t col_id = 0; col_id < layout.num_cols_; col_id++) {
+    const EncodedColumn &column = encoded[col_id];
+    compressed->Columns()[col_id] = column.column_;
+    std::memcpy(reinterpret_cast<byte *>(compressed) +
+                    column.column_.data_offset_,
+                column.data_.data(), column.data_.size());
+  }
+
+  // 之前解压时留下的副本可能还有reader在读，交给调用者晚点释放
+  *previous = block->compressed_;
+  block->compressed_ = compressed;
+  block->state_.store(BlockState::COMPRESSED, std::memory_order_release);
+  return true;
+}
+
+void BlockCompressor::ReleasePages(RawBlock *raw, const BlockLayout &layout,
+                                   const CompressedBlock *copy) {
+  auto *block = reinterpret_cast<Block *>(raw);
+  // 占住block，还页的时候writer不能解压
+  BlockState expected = BlockState::COMPRESSED;
+  if (!block->state_.compare_exchange_strong(expected,
+                                             BlockState::DECOMPRESSING)) {
+    return;
+  }
+  // 解压之后又压了一次，页归那次压缩管
+  if (block->compressed_ == copy) {
+    for (uint16_t col_id = 0; col_id < layout.num_cols_; col_id++) {
+      ReleaseColumnPages(block->Column(col_id)->ColumnStart(layout),
+                         static_cast<uint64_t>(layout.num_slots_) *
+                             layout.attr_sizes_[col_id]);
+    }
+  }
+  block->state_.store(BlockState::COMPRESSED, std::memory_order_release);
+}
+
+void BlockCompressor::Decompress(RawBlock *raw, const BlockLayout &layout) {
+  auto *block = reinterpret_cast<Block *>(raw);
+  while (true) {
+    BlockState expected = BlockState::COMPRESSED;
+    if (block->state_.compare_exchange_strong(expected,
+                                              BlockState::DECOMPRESSING)) {
+      break;
+    }
+    if (expected != BlockState::DECOMPRESSING) {
+      return;
+    }
+    // 别的writer在解压，或者ReleasePages在还页，等它做完再看
+    while (block->state_.load() == BlockState::DECOMPRESSING) {
+      std::this_thread::yield();
+    }
+  }
+
+  const CompressedBlock *compressed = block->compressed_;
+  for (uint16_t col_id = 0; col_id < layout.num_cols_; col_id++) {
+    uint16_t attr_size = layout.attr_sizes_[col_id];
+    byte *column = block->Column(col_id)->ColumnStart(layout);
+    if (compressed->Columns()[col_id].encoding_ == ColumnEncoding::PLAIN) {
+      std::memcpy(column, compressed->Data(col_id),
+                  static_cast<uint64_t>(layout.num_slots_) * attr_size);
+      continue;
+    }
+    for (uint32_t i = 0; i < layout.num_slots_; i++) {
+      StorageUtil::WriteBytes(
+          attr_size, static_cast<uint64_t>(compressed->ReadInteger(col_id, i)),
+          column + i * attr_size);
+    }
+  }
+  // 压缩的副本要留到下次压缩或者block被还回去时才释放，可能还有reader在读
+  block->state_.store(BlockState::HOT, std::memory_order_release);
+}
+
+void BlockCompressor::Evaluate(const ColumnPredicate &predicate,
+                               const CompressedBlock &compressed,
+                               const RawConcurrentBitmap *null_bitmap,
+                               uint32_t num_slots, uint8_t *selection) {
+  uint16_t col_id = predicate.col_id_;
+  const CompressedColumn &column = compressed.Columns()[col_id];
+  const byte *data = compressed.Data(col_id);
+  int64_t lo, hi;
+  bool satisfiable = predicate.Bounds(&lo, &hi);
+
+  switch (column.encoding_) {
+  case ColumnEncoding::PLAIN:
+    PredicateKernels::Evaluate(predicate, data, column.attr_size_, null_bitmap,
+                               num_slots, selection);
+    return;
+  case ColumnEncoding::RUN_LENGTH: {
+    // 每个run只判断一次
+    const auto *values = reinterpret_cast<const int64_t *>(data);
+    const auto *run_ends = reinterpret_cast<const uint32_t *>(
+        data + column.num_entries_ * sizeof(int64_t));
+    uint32_t start = 0;
+    for (uint32_t run = 0; run < column.num_entries_; run++) {
+      if (!predicate.Evaluate(values[run])) {
+        ClearBits(selection, start, run_ends[run]);
+      }
+      start = run_ends[run];
+    }
+    break;
+  }
+  case ColumnEncoding::DICTIONARY: {
+    // 字典是有序的，谓词先翻译成满足条件的code
+    const auto *dictionary = reinterpret_cast<const int64_t *>(data);
+    std::vector<bool> matching_codes(column.num_entries_);
+    for (uint32_t code = 0; code < column.num_entries_; code++) {
+      matching_codes[code] = predicate.Evaluate(dictionary[code]);
+    }
+    FilterCodes(data + column.num_entries_ * sizeof(int64_t),
+                column.bit_width_, num_slots, selection,
+                [&](uint64_t code) { return matching_codes[code]; });
+    break;
+  }
+  case ColumnEncoding::FRAME_OF_REFERENCE: {
+    // 把[lo, hi]平移到code的空间里，code = value - base
+    uint64_t max_code = column.bit_width_ == 64
+                            ? UINT64_MAX
+                            : (uint64_t(1) << column.bit_width_) - 1;
+    auto to_code = [&](int64_t val) {
+      return static_cast<uint64_t>(val) - static_cast<uint64_t>(column.base_);
+    };
+    if (!satisfiable || hi < column.base_) {
+      ClearBits(selection, 0, num_slots);
+      break;
+    }
+    uint64_t code_lo = lo <= column.base_ ? 0 : to_code(lo);
+    uint64_t code_hi = std::min(to_code(hi), max_code);
+    std::vector<uint64_t> in_codes;
+    if (predicate.type_ == PredicateType::IN) {
+      for (int64_t val : predicate.in_list_) {
+        if (val >= column.base_ && to_code(val) <= max_code) {
+          in_codes.push_back(to_code(val));
+        }
+      }
+    }
+    FilterCodes(data, column.bit_width_, num_slots, selection,
+                [&](uint64_t code) {
+                  if (predicate.type_ == PredicateType::IN) {
+                    return std::find(in_codes.begin(), in_codes.end(), code) !=
+                           in_codes.end();
+                  }
+                  return code_lo <= code && code <= code_hi;
+                });
+    break;
+  }
+  }
+
+  const auto *null_bytes = reinterpret_cast<const uint8_t *>(null_bitmap);
+  for (uint32_t i = 0; i < BitmapSize(num_slots); i++) {
+    selection[i] &= null_bytes[i];
+  }
+}
+} // namespace noisepage::storage
@@ -0,0 +1,58 @@
+#include "storage/block_directory.h"
+#include <cassert>
+#include <cerrno>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <system_error>
+
+namespace noisepage::storage {
+namespace {
+// 只占地址空间，用到的页才会有物理内存，而且一开始都是0
+void *Reserve(uint64_t size) {
+  void *reserved =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (reserved == MAP_FAILED) {
+    throw std::system_error(errno, std::generic_category(),
+                            "Cannot reserve block directory");
+  }
+  return reserved;
+}
+} // namespace
+
+BlockDirectory::BlockDirectory()
+    : addresses_(static_cast<std::atomic<RawBlock *> *>(
+          Reserve(sizeof(std::atomic<RawBlock *>) * MAX_BLOCKS))),
+      writers_(static_cast<std::atomic<uint32_t> *>(
+          Reserve(sizeof(std::atomic<uint32_t>) * MAX_BLOCKS))) {}
+
+BlockDirectory::~BlockDirectory() {
+  munmap(addresses_, sizeof(std::atomic<RawBlock *>) * MAX_BLOCKS);
+  munmap(writers_, sizeof(std::atomic<uint32_t>) * MAX_BLOCKS);
+}
+
+uint32_t BlockDirectory::Register(RawBlock *block) {
+  uint32_t block_id;
+  {
+    std::lock_guard<std::mutex> lock(latch_);
+    if (!free_ids_.empty()) {
+      block_id = free_ids_.back();
+      free_ids_.pop_back();
+    } else if (next_id_ < MAX_BLOCKS) {
+      block_id = next_id_++;
+    } else {
+      throw std::length_error("Out of block ids");
+    }
+  }
+  addresses_[block_id].store(block, std::memory_order_release);
+  return block_id;
+}
+
+void BlockDirectory::Unregister(uint32_t block_id) {
+  assert(block_id != 0);
+  assert(writers_[block_id].load() == 0);
+  addresses_[block_id].store(nullptr, std::memory_order_relaxed);
+  std::lock_guard<std::mutex> lock(latch_);
+  free_ids_.push_back(block_id);
+}
+} // namespace noisepage::storage
@@ -0,0 +1,228 @@
+#include "storage/bulk_loader.h"
+#include "storage/storage_util.h"
+#include <algorithm>
+#include <limits>
+#include <thread>
+
+#define VERSION_VECTOR_COLUMN_ID 0
+
+namespace noisepage::storage {
+namespace {
+template <typename T>
+void Summarize(const byte *column, const uint8_t *present, uint32_t num_rows,
+               ZoneMap *zone_map) {
+  auto *values = reinterpret_cast<const T *>(column);
+  T min = std::numeric_limits<T>::max();
+  T max = std::numeric_limits<T>::min();
+  uint32_t num_nulls = 0;
+  for (uint32_t i = 0; i < num_rows; i += BYTE_SIZE) {
+    uint32_t end = std::min(i + BYTE_SIZE, num_rows);
+    // 大部分byte都是8个非null，不用一个个bit检查
+    if (present[i / BYTE_SIZE] == 0xFF) {
+      for (uint32_t j = i; j < end; j++) {
+        min = std::min(min, values[j]);
+        max = std::max(max, values[j]);
+      }
+      continue;
+    }
+    for (uint32_t j = i; j < end; j++) {
+      if (present[j / BYTE_SIZE] & ONE_HOT_MASK(j % BYTE_SIZE)) {
+        min = std::min(min, values[j]);
+        max = std::max(max, values[j]);
+      } else {
+        num_nulls++;
+      }
+    }
+  }
+  if (num_nulls != num_rows) {
+    zone_map->Widen(min);
+    zone_map->Widen(max);
+  }
+  zone_map->null_count_.fetch_add(num_nulls);
+}
+} // namespace
+
+void BulkLoader::BulkLoad(DataTable *table,
+                          const std::vector<BulkLoadColumn> &columns,
+                          uint32_t num_rows, std::vector<TupleSlot> *slots) {
+  const BlockLayout &layout = table->GetBlockLayout();
+  RawBlock *insertion_head = table->insertion_head_;
+  uint32_t first_row = 0;
+  // 还没用过的insertion head直接拿来装，比如刚建好的表
+  if (num_rows != 0 && table->NumAllocated(insertion_head) == 0) {
+    first_row = std::min(layout.num_slots_, num_rows);
+    LoadBlock(table, insertion_head, columns, 0, first_row);
+    if (slots != nullptr) {
+      for (uint32_t offset = 0; offset < first_row; offset++) {
+        slots->emplace_back(insertion_head, offset);
+      }
+    }
+  }
+  std::vector<RawBlock *> loaded;
+  uint32_t tail_rows =
+      LoadRows(table, columns, first_row, num_rows - first_row, &loaded, slots);
+  if (loaded.empty()) {
+    return;
+  }
+
+  // 最后一个block没装满的话，空位比现在的insertion head多就让它接着收insert
+  bool tail_takes_inserts =
+      layout.num_slots_ - tail_rows >
+      layout.num_slots_ - table->NumAllocated(insertion_head);
+  if (tail_takes_inserts) {
+    reinterpret_cast<Block *>(loaded.back())->state_.store(BlockState::HOT);
+  }
+  table->PublishBlocks(loaded);
+  if (tail_takes_inserts) {
+    table->insertion_head_ = loaded.back();
+  }
+}
+
+void BulkLoader::ParallelBulkLoad(DataTable *table,
+                                  const std::vector<BulkLoadColumn> &columns,
+                                  uint32_t num_rows, uint32_t num_threads,
+                                  std::vector<TupleSlot> *slots) {
+  const BlockLayout &layout = table->GetBlockLayout();
+  num_threads = std::max(1u, num_threads);
+  // 每个线程分到整数个block，这样只有最后一个block可能不满
+  uint64_t num_blocks =
+      (static_cast<uint64_t>(num_rows) + layout.num_slots_ - 1) /
+      layout.num_slots_;
+  uint64_t rows_per_thread =
+      (num_blocks + num_threads - 1) / num_threads * layout.num_slots_;
+
+  BulkLoader loader(table);
+  std::vector<std::vector<TupleSlot>> thread_slots(num_threads);
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < num_threads; i++) {
+    uint64_t first_row = i * rows_per_thread;
+    if (first_row >= num_rows) {
+      break;
+    }
+    auto count = static_cast<uint32_t>(
+        std::min<uint64_t>(rows_per_thread, num_rows - first_row));
+    threads.emplace_back([&, i, first_row, count] {
+      loader.Load(columns, static_cast<uint32_t>(first_row), count,
+                  slots == nullptr ? nullptr : &thread_slots[i]);
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  loader.Commit();
+
+  if (slots != nullptr) {
+    for (const auto &part : thread_slots) {
+      slots->insert(slots->end(), part.begin(), part.end());
+    }
+  }
+}
+
+void BulkLoader::ParallelBulkLoad(DataTable *table,
+                                  const std::vector<BulkLoadColumn> &columns,
+                                  uint32_t num_rows, Scheduler *scheduler,
+                                  std::vector<TupleSlot> *slots) {
+  uint32_t num_slots = table->GetBlockLayout().num_slots_;
+  uint64_t num_blocks =
+      (static_cast<uint64_t>(num_rows) + num_slots - 1) / num_slots;
+
+  BulkLoader loader(table);
+  // 按每段开头的block存，拼起来还是按行的顺序
+  std::vector<std::vector<TupleSlot>> range_slots(num_blocks);
+  scheduler->ParallelFor(0, num_blocks, 1, [&](uint64_t begin, uint64_t end) {
+    uint64_t first_row = begin * num_slots;
+    auto count = static_cast<uint32_t>(
+        std::min<uint64_t>(end * num_slots, num_rows) - first_row);
+    loader.Load(columns, static_cast<uint32_t>(first_row), count,
+                slots == nullptr ? nullptr : &range_slots[begin]);
+  });
+  loader.Commit();
+
+  if (slots != nullptr) {
+    for (const auto &part : range_slots) {
+      slots->insert(slots->end(), part.begin(), part.end());
+    }
+  }
+}
+
+uint32_t BulkLoader::LoadRows(DataTable *table,
+                              const std::vector<BulkLoadColumn> &columns,
+                              uint32_t first_row, uint32_t num_rows,
+                              std::vector<RawBlock *> *blocks,
+                              std::vector<TupleSlot> *slots) {
+  const BlockLayout &layout = table->GetBlockLayout();
+  uint32_t count = 0;
+  for (uint32_t row = 0; row < num_rows; row += count) {
+    count = std::min(layout.num_slots_, num_rows - row);
+    RawBlock *block = table->AllocateBlock();
+    LoadBlock(table, block, columns, first_row + row, count);
+    reinterpret_cast<Block *>(block)->state_.store(BlockState::FROZEN);
+    blocks->push_back(block);
+    if (slots != nullptr) {
+      for (uint32_t offset = 0; offset < count; offset++) {
+        slots->emplace_back(block, offset);
+      }
+    }
+  }
+  return count;
+}
+
+void BulkLoader::LoadBlock(DataTable *table, RawBlock *block,
+                           const std::vector<BulkLoadColumn> &columns,
+                           uint32_t first_row, uint32_t num_rows) {
+  const TupleAccessStrategy &accessor = table->Accessor(block);
+  const BlockLayout &layout = accessor.GetBlockLayout();
+  auto *header = reinterpret_cast<Block *>(block);
+  std::memset(header->Column(VERSION_VECTOR_COLUMN_ID)->ColumnStart(layout), 0,
+              num_rows * sizeof(DeltaRecord *));
+
+  std::vector<bool> loaded(layout.num_cols_, false);
+  for (const auto &column : columns) {
+    uint16_t col_id = column.col_id_;
+    assert(col_id != VERSION_VECTOR_COLUMN_ID && layout.HasColumn(col_id));
+    loaded[col_id] = true;
+    uint16_t attr_size = layout.attr_sizes_[col_id];
+    MiniBlock *mini_block = header->Column(col_id);
+    std::memcpy(mini_block->ColumnStart(layout),
+                column.values_ + static_cast<uint64_t>(first_row) * attr_size,
+                static_cast<uint64_t>(num_rows) * attr_size);
+    auto *present = reinterpret_cast<uint8_t *>(mini_block->NullBitmap());
+    if (column.present_ == nullptr) {
+      StorageUtil::SetBits(present, num_rows);
+    } else {
+      StorageUtil::CopyBits(column.present_, first_row, present, num_rows);
+    }
+
+    ZoneMap *zone_map = &header->zone_maps_[col_id];
+    const byte *values = mini_block->ColumnStart(layout);
+    switch (attr_size) {
+    case 1:
+      Summarize<int8_t>(values, present, num_rows, zone_map);
+      break;
+    case 2:
+      Summarize<int16_t>(values, present, num_rows, zone_map);
+      break;
+    case 4:
+      Summarize<int32_t>(values, present, num_rows, zone_map);
+      break;
+    case 8:
+      Summarize<int64_t>(values, present, num_rows, zone_map);
+      break;
+    default:
+      // 宽的定长类型没有zone map
+      break;
+    }
+  }
+  for (uint16_t col_id = 1; col_id < layout.num_cols_; col_id++) {
+    if (!loaded[col_id]) {
+      header->zone_maps_[col_id].null_count_.fetch_add(num_rows);
+    }
+  }
+
+  // 值和zone map都写好之后才能让slot变成已分配，reader看到slot就能读到值
+  std::atomic_thread_fence(std::memory_order_release);
+  StorageUtil::SetBits(reinterpret_cast<uint8_t *>(
+              accessor.ColumnNullBitmap(block, VERSION_VECTOR_COLUMN_ID)),
+          num_rows);
+}
+} // namespace noisepage::storage
@@ -0,0 +1,223 @@
+#include "storage/cold_tier.h"
+#include <cerrno>
+#include <exception>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace noisepage::storage {
+namespace {
+int OpenScratchFile(const std::string &path) {
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(),
+                            "Cannot open " + path);
+  }
+  unlink(path.c_str());
+  return fd;
+}
+} // namespace
+
+ColdTier::ColdTier(const std::string &path, uint64_t memory_budget)
+    : fd_(OpenScratchFile(path)), memory_budget_(memory_budget),
+      free_extents_(BlockSizeClass(MAX_BLOCK_SIZE) + 1) {}
+
+ColdTier::~ColdTier() {
+  assert(entries_.empty());
+  close(fd_);
+}
+
+void ColdTier::Track(RawBlock *block, uint32_t block_size) {
+  std::vector<Victim> victims;
+  {
+    std::lock_guard<std::mutex> lock(latch_);
+    // 刚freeze的block多半还会被读，先给一次机会
+    Touch(block);
+    auto it = index_.find(block);
+    if (it == index_.end()) {
+      index_[block] = entries_.size();
+      entries_.push_back({block, block_size, NO_EXTENT, false, false, false});
+      resident_bytes_ += block_size;
+    } else if (entries_[it->second].evicted_) {
+      entries_[it->second].evicted_ = false;
+      evicted_bytes_ -= block_size;
+      resident_bytes_ += block_size;
+    }
+    PickVictims(&victims);
+  }
+  Evict(victims);
+}
+
+void ColdTier::Thawed(RawBlock *block) {
+  std::unique_lock<std::mutex> lock(latch_);
+  auto it = index_.find(block);
+  // Thaw抢到block的时候Evict可能还没来得及记下它被驱逐了
+  while (it != index_.end() && entries_[it->second].evicting_) {
+    eviction_done_.wait(lock);
+    it = index_.find(block);
+  }
+  if (it == index_.end() || !entries_[it->second].evicted_) {
+    return;
+  }
+  Entry &entry = entries_[it->second];
+  entry.evicted_ = false;
+  evicted_bytes_ -= entry.block_size_;
+  resident_bytes_ += entry.block_size_;
+}
+
+void ColdTier::Forget(RawBlock *block) {
+  std::unique_lock<std::mutex> lock(latch_);
+  auto it = index_.find(block);
+  while (it != index_.end() && entries_[it->second].evicting_) {
+    eviction_done_.wait(lock);
+    it = index_.find(block);
+  }
+  if (it == index_.end()) {
+    return;
+  }
+  uint64_t i = it->second;
+  Entry &entry = entries_[i];
+  if (entry.file_backed_) {
+    void *mapped = mmap(block, entry.block_size_, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+    if (mapped == MAP_FAILED) {
+      throw std::system_error(errno, std::generic_category(),
+                              "Cannot remap block");
+    }
+  }
+  if (entry.extent_ != NO_EXTENT) {
+    free_extents_[BlockSizeClass(entry.block_size_)].push_back(entry.extent_);
+  }
+  (entry.evicted_ ? evicted_bytes_ : resident_bytes_) -= entry.block_size_;
+
+  index_.erase(it);
+  if (i + 1 != entries_.size()) {
+    entries_[i] = entries_.back();
+    index_[entries_[i].block_] = i;
+  }
+  entries_.pop_back();
+  if (hand_ >= entries_.size()) {
+    hand_ = 0;
+  }
+}
+
+bool ColdTier::IsEvicted(RawBlock *block) {
+  std::lock_guard<std::mutex> lock(latch_);
+  auto it = index_.find(block);
+  return it != index_.end() && entries_[it->second].evicted_;
+}
+
+uint64_t ColdTier::ResidentBytes() {
+  std::lock_guard<std::mutex> lock(latch_);
+  return resident_bytes_;
+}
+
+uint64_t ColdTier::EvictedBytes() {
+  std::lock_guard<std::mutex> lock(latch_);
+  return evicted_bytes_;
+}
+
+void ColdTier::PickVictims(std::vector<Victim> *victims) {
+  // 转两圈还不够说明剩下的都不能驱逐（hot或者压缩过）
+  uint64_t budget = 2 * entries_.size();
+  while (resident_bytes_ > memory_budget_ && budget-- > 0) {
+    Entry &entry = entries_[hand_];
+    hand_ = (hand_ + 1) % entries_.size();
+    if (entry.evicted_ || entry.evicting_) {
+      continue;
+    }
+    auto *header = reinterpret_cast<Block *>(entry.block_);
+    if (header->referenced_.load(std::memory_order_relaxed) != 0) {
+      header->referenced_.store(0, std::memory_order_relaxed);
+      continue;
+    }
+    // 和Thaw抢，抢到了之后writer会等到换完
+    BlockState expected = BlockState::FROZEN;
+    if (!header->state_.compare_exchange_strong(expected,
+                                                BlockState::EVICTING)) {
+      continue;
+    }
+    // 文件里的副本带着reference bit，之后的读就不会再写header了
+    header->referenced_.store(1, std::memory_order_relaxed);
+    if (entry.extent_ == NO_EXTENT) {
+      entry.extent_ = AllocateExtent(entry.block_size_);
+    }
+    entry.evicting_ = true;
+    resident_bytes_ -= entry.block_size_;
+    victims->push_back({entry.block_, entry.block_size_, entry.extent_});
+  }
+}
+
+void ColdTier::Evict(const std::vector<Victim> &victims) {
+  std::exception_ptr error;
+  for (const Victim &victim : victims) {
+    bool evicted = false;
+    // 失败一个之后剩下的也不换了，都放回去
+    if (error == nullptr) {
+      try {
+        WriteOut(victim);
+        evicted = true;
+      } catch (...) {
+        error = std::current_exception();
+      }
+    }
+    reinterpret_cast<Block *>(victim.block_)
+        ->state_.store(BlockState::FROZEN, std::memory_order_release);
+    {
+      std::lock_guard<std::mutex> lock(latch_);
+      // Forget等着evicting_的block，所以entry还在
+      Entry &entry = entries_[index_.at(victim.block_)];
+      entry.evicting_ = false;
+      if (evicted) {
+        entry.evicted_ = true;
+        entry.file_backed_ = true;
+        evicted_bytes_ += victim.block_size_;
+      } else {
+        resident_bytes_ += victim.block_size_;
+      }
+    }
+    eviction_done_.notify_all();
+  }
+  if (error != nullptr) {
+    std::rethrow_exception(error);
+  }
+}
+
+void ColdTier::WriteOut(const Victim &victim) {
+  const auto *data = reinterpret_cast<const byte *>(victim.block_);
+  for (uint64_t written = 0; written < victim.block_size_;) {
+    ssize_t n = pwrite(fd_, data + written, victim.block_size_ - written,
+                       static_cast<off_t>(victim.extent_ + written));
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::system_error(errno, std::generic_category(),
+                              "Cannot evict block");
+    }
+    written += static_cast<uint64_t>(n);
+  }
+  // 文件和内存里的内容一样，换映射的时候reader读到哪个都对
+  void *mapped =
+      mmap(victim.block_, victim.block_size_, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_FIXED, fd_, static_cast<off_t>(victim.extent_));
+  if (mapped == MAP_FAILED) {
+    throw std::system_error(errno, std::generic_category(),
+                            "Cannot map evicted block");
+  }
+}
+
+uint64_t ColdTier::AllocateExtent(uint32_t block_size) {
+  auto &free_extents = free_extents_[BlockSizeClass(block_size)];
+  if (!free_extents.empty()) {
+    uint64_t extent = free_extents.back();
+    free_extents.pop_back();
+    return extent;
+  }
+  // extent按block大小对齐，mmap的offset要求页对齐
+  uint64_t extent = (file_size_ + block_size - 1) & ~uint64_t(block_size - 1);
+  file_size_ = extent + block_size;
+  return extent;
+}
+} // namespace noisepage::storage
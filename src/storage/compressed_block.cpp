@@ -0,0 +1,48 @@
+#include "storage/compressed_block.h"
+#include "storage/storage_util.h"
+#include <algorithm>
+
+namespace noisepage::storage {
+int64_t CompressedBlock::ReadInteger(uint16_t col_id, uint32_t offset) const {
+  const CompressedColumn &column = Columns()[col_id];
+  const byte *data = Data(col_id);
+  switch (column.encoding_) {
+  case ColumnEncoding::PLAIN:
+    return StorageUtil::ReadInteger(column.attr_size_,
+                                    data + offset * column.attr_size_);
+  case ColumnEncoding::DICTIONARY: {
+    const auto *dictionary = reinterpret_cast<const int64_t *>(data);
+    const byte *codes = data + column.num_entries_ * sizeof(int64_t);
+    return dictionary[UnpackCode(codes, offset, column.bit_width_)];
+  }
+  case ColumnEncoding::FRAME_OF_REFERENCE:
+    // 用无符号加法，base和offset之和可能会溢出int64
+    return static_cast<int64_t>(static_cast<uint64_t>(column.base_) +
+                                UnpackCode(data, offset, column.bit_width_));
+  case ColumnEncoding::RUN_LENGTH: {
+    const auto *values = reinterpret_cast<const int64_t *>(data);
+    const auto *run_ends = reinterpret_cast<const uint32_t *>(
+        data + column.num_entries_ * sizeof(int64_t));
+    auto run = std::upper_bound(run_ends, run_ends + column.num_entries_,
+                                offset) -
+               run_ends;
+    return values[run];
+  }
+  }
+  throw std::runtime_error("Invalid column encoding");
+}
+
+void CompressedBlock::AttrAt(const BlockLayout &layout, uint16_t col_id,
+                             uint32_t offset, byte *out) const {
+  const CompressedColumn &column = Columns()[col_id];
+  if (column.encoding_ == ColumnEncoding::PLAIN) {
+    StorageUtil::CopyBytes(
+        column.attr_size_,
+        Data(col_id) + static_cast<uint64_t>(offset) * column.attr_size_, out);
+    return;
+  }
+  StorageUtil::WriteBytes(layout.attr_sizes_[col_id],
+                          static_cast<uint64_t>(ReadInteger(col_id, offset)),
+                          out);
+}
+} // namespace noisepage::storage
@@ -0,0 +1,141 @@
+#include "storage/contention_manager.h"
+#include <thread>
+
+namespace noisepage::storage {
+void Backoff::Pause() {
+  thread_local std::minstd_rand generator(static_cast<uint32_t>(
+      std::hash<std::thread::id>()(std::this_thread::get_id())));
+  int64_t pause = std::uniform_int_distribution<int64_t>(0, bound_)(generator);
+  bound_ = std::min(bound_ * 2, std::max<int64_t>(max_, 1));
+  // 太短的sleep会被系统拉长到几十微秒，就让出CPU转几圈
+  if (pause < 50) {
+    auto until =
+        std::chrono::steady_clock::now() + std::chrono::microseconds(pause);
+    do {
+      std::this_thread::yield();
+    } while (std::chrono::steady_clock::now() < until);
+  } else {
+    std::this_thread::sleep_for(std::chrono::microseconds(pause));
+  }
+}
+
+bool ContentionManager::Update(timestamp_t read_timestamp,
+                               const TupleSlot &slot, const ProjectedRow &redo,
+                               DeltaRecord *undo, bool *undo_installed) {
+  Attempt attempt =
+      TryUpdate(read_timestamp, slot, redo, undo, undo_installed);
+  if (attempt == Attempt::INSTALLED) {
+    return true;
+  }
+  conflicts_.fetch_add(1, std::memory_order_relaxed);
+  bool success = false;
+  if (attempt == Attempt::BLOCKED) {
+    switch (options_.policy_) {
+    case ContentionPolicy::ABORT:
+      break;
+    case ContentionPolicy::BACKOFF:
+      success = UpdateWithBackoff(read_timestamp, slot, redo, undo,
+                                  undo_installed);
+      break;
+    case ContentionPolicy::WAIT:
+      success =
+          UpdateWithWait(read_timestamp, slot, redo, undo, undo_installed);
+      break;
+    }
+  }
+  if (!success) {
+    aborts_.fetch_add(1, std::memory_order_relaxed);
+  }
+  return success;
+}
+
+ContentionManager::Attempt
+ContentionManager::TryUpdate(timestamp_t read_timestamp, const TupleSlot &slot,
+                             const ProjectedRow &redo, DeltaRecord *undo,
+                             bool *undo_installed) {
+  bool installed = false;
+  Attempt attempt = Attempt::BLOCKED;
+  if (table_->Update(slot, redo, undo, &installed)) {
+    attempt = Attempt::INSTALLED;
+    // 挡路的owner提交了：它的版本在snapshot之后，盖上去就把它的更新弄丢了
+    if (installed && undo->CoversNewerCommit(read_timestamp)) {
+      table_->Rollback(slot, undo);
+      installed = false;
+      attempt = Attempt::STALE;
+    }
+  }
+  if (undo_installed != nullptr) {
+    *undo_installed = installed;
+  }
+  return attempt;
+}
+
+bool ContentionManager::UpdateWithBackoff(timestamp_t read_timestamp,
+                                          const TupleSlot &slot,
+                                          const ProjectedRow &redo,
+                                          DeltaRecord *undo,
+                                          bool *undo_installed) {
+  Backoff backoff(options_.min_backoff_, options_.max_backoff_);
+  for (uint32_t i = 1; i < options_.max_attempts_; i++) {
+    backoff.Pause();
+    retries_.fetch_add(1, std::memory_order_relaxed);
+    Attempt attempt =
+        TryUpdate(read_timestamp, slot, redo, undo, undo_installed);
+    if (attempt != Attempt::BLOCKED) {
+      return attempt == Attempt::INSTALLED;
+    }
+  }
+  return false;
+}
+
+bool ContentionManager::UpdateWithWait(timestamp_t read_timestamp,
+                                       const TupleSlot &slot,
+                                       const ProjectedRow &redo,
+                                       DeltaRecord *undo,
+                                       bool *undo_installed) {
+  Stripe &stripe = StripeOf(slot);
+  auto deadline = std::chrono::steady_clock::now() + options_.wait_timeout_;
+  std::unique_lock<std::mutex> lock(stripe.latch_);
+  auto it = stripe.waiters_.find(slot);
+  uint32_t num_waiting = it == stripe.waiters_.end() ? 0 : it->second;
+  if (num_waiting >= options_.max_waiters_) {
+    early_aborts_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  stripe.waiters_[slot]++;
+  // 先登记再重试：owner在Release里要么看到这次登记，要么它的提交已经能被重试看到
+  stripe.num_waiters_.fetch_add(1);
+  Attempt attempt;
+  while (true) {
+    retries_.fetch_add(1, std::memory_order_relaxed);
+    attempt = TryUpdate(read_timestamp, slot, redo, undo, undo_installed);
+    if (attempt != Attempt::BLOCKED) {
+      break;
+    }
+    waits_.fetch_add(1, std::memory_order_relaxed);
+    if (stripe.wakeup_.wait_until(lock, deadline) ==
+        std::cv_status::timeout) {
+      // 超时前最后试一次，可能刚好被放开
+      retries_.fetch_add(1, std::memory_order_relaxed);
+      attempt = TryUpdate(read_timestamp, slot, redo, undo, undo_installed);
+      break;
+    }
+  }
+  stripe.num_waiters_.fetch_sub(1);
+  if (--stripe.waiters_[slot] == 0) {
+    stripe.waiters_.erase(slot);
+  }
+  return attempt == Attempt::INSTALLED;
+}
+
+void ContentionManager::Release(const TupleSlot &slot) {
+  Stripe &stripe = StripeOf(slot);
+  // 和UpdateWithWait里的登记配对，没人等就不拿latch
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (stripe.num_waiters_.load() == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(stripe.latch_);
+  stripe.wakeup_.notify_all();
+}
+} // namespace noisepage::storage
@@ -1,79 +1,971 @@
 #include "storage/data_table.h"
+#include "storage/predicate_kernels.h"
 #include "storage/storage_util.h"
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <thread>
 
 #define VERSION_VECTOR_COLUMN_ID 0
 
 namespace noisepage::storage {
+namespace {
+/**
+ * @return the layout after prev with the given attribute sizes. Columns
+ * keep their order and new ones go last. The block size is the smallest one
+ * that still fits as many slots as prev, so blocks can move between the two
+ * without changing offsets.
+ */
+BlockLayout NextLayout(const BlockLayout &prev,
+                       const std::vector<uint16_t> &attr_sizes) {
+  std::vector<uint16_t> placement(prev.num_cols_);
+  std::iota(placement.begin(), placement.end(), 0);
+  std::stable_sort(placement.begin(), placement.end(),
+                   [&](uint16_t a, uint16_t b) {
+                     return prev.column_offsets_[a] < prev.column_offsets_[b];
+                   });
+  for (auto col_id = prev.num_cols_; col_id < attr_sizes.size(); col_id++) {
+    placement.push_back(static_cast<uint16_t>(col_id));
+  }
+  for (uint32_t block_size = MIN_BLOCK_SIZE; block_size <= MAX_BLOCK_SIZE;
+       block_size <<= 1) {
+    BlockLayout layout(static_cast<uint16_t>(attr_sizes.size()), attr_sizes,
+                       block_size, placement, prev.num_slots_);
+    if (layout.num_slots_ == prev.num_slots_) {
+      return layout;
+    }
+  }
+  throw std::length_error("Rows do not fit the largest block size");
+}
+} // namespace
 
-DataTable::DataTable(BlockStore &store, BlockLayout layout)
-    : block_store_(store), accessor_(layout) {
-  NewBlock();
+DataTable::DataTable(BlockStore &store, BlockLayout layout,
+                     ColdTier *cold_tier)
+    : block_store_(store), versions_(MAX_LAYOUT_VERSIONS),
+      cold_tier_(cold_tier) {
+  AddVersion(layout, std::vector<std::vector<byte>>(layout.num_cols_));
 }
 
 void DataTable::Select(timestamp_t timestamp, const TupleSlot &slot,
                        ProjectedRow *out_buffer) {
-  for (uint16_t i = 0; i < out_buffer->NumColumns(); i++) {
-    StorageUtil::CopyAttrIntoProjection(accessor_, slot, out_buffer, i);
+  EpochManager::Guard guard(&epoch_manager_);
+  SelectInto(timestamp, slot, out_buffer, nullptr);
+}
+
+void DataTable::SelectInto(
+    timestamp_t timestamp, const TupleSlot &slot, ProjectedRow *out_buffer,
+    const std::unordered_map<uint16_t, uint16_t> *id_to_offset) {
+  RawBlock *block = slot.GetBlock();
+  Touch(block);
+  auto &num_rollbacks = reinterpret_cast<Block *>(block)->num_rollbacks_;
+  uint32_t seen;
+  do {
+    seen = num_rollbacks.load(std::memory_order_acquire);
+    ReadVersion(timestamp, slot, out_buffer, id_to_offset);
+  } while (RolledBack(block, seen));
+}
+
+void DataTable::ReadVersion(
+    timestamp_t timestamp, const TupleSlot &slot, ProjectedRow *out_buffer,
+    const std::unordered_map<uint16_t, uint16_t> *id_to_offset) {
+  RawBlock *block = slot.GetBlock();
+  const TupleAccessStrategy &accessor = Accessor(block);
+  {
+    NOISEPAGE_TRACE_SCOPE(COPY);
+    for (uint16_t i = 0; i < out_buffer->NumColumns(); i++) {
+      // block比列老的话就是默认值
+      if (accessor.GetBlockLayout().HasColumn(out_buffer->ColumnIds()[i])) {
+        StorageUtil::CopyAttrIntoProjection(accessor, slot, out_buffer, i);
+      } else {
+        CopyDefault(out_buffer, i);
+      }
+    }
   }
 
+  // block里没有比snapshot新的版本，连version指针都不用读
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (NoNewerVersions(block, timestamp)) {
+    return;
+  }
   DeltaRecord *version_ptr = ReadVersionPtr(slot);
-  if (version_ptr == nullptr) {
+  // 没有比snapshot新的delta就不用建map了
+  if (version_ptr == nullptr || version_ptr->timestamp_ <= timestamp) {
     return;
   }
 
-  std::unordered_map<uint16_t, uint16_t> id_to_offset;
-  for (auto i = 0; i < out_buffer->NumColumns(); i++) {
-    uint16_t col_id = out_buffer->ColumnIds()[i];
-    id_to_offset[col_id] = i;
+  NOISEPAGE_TRACE_SCOPE(CHAIN_WALK);
+  std::unordered_map<uint16_t, uint16_t> local_id_to_offset;
+  if (id_to_offset == nullptr) {
+    for (auto i = 0; i < out_buffer->NumColumns(); i++) {
+      uint16_t col_id = out_buffer->ColumnIds()[i];
+      local_id_to_offset[col_id] = i;
+    }
+    id_to_offset = &local_id_to_offset;
   }
 
   while (version_ptr != nullptr && version_ptr->timestamp_ > timestamp) {
-    StorageUtil::ApplyDelta(accessor_.GetBlockLayout(), *version_ptr->Delta(),
-                            out_buffer, id_to_offset);
+    NOISEPAGE_TRACE_SCOPE(DELTA_APPLY);
+    StorageUtil::ApplyDelta(accessor.GetBlockLayout(), *version_ptr->Delta(),
+                            out_buffer, *id_to_offset);
     version_ptr = version_ptr->next_;
   }
 }
 
 bool DataTable::Update(const TupleSlot &slot, const ProjectedRow &redo,
-                       DeltaRecord *undo) {
-  assert(redo.NumColumns() == undo->Delta()->NumColumns());
+                       DeltaRecord *undo, bool *undo_installed) {
+  assert(redo.NumColumns() <= undo->Delta()->NumColumns());
+  if (undo_installed != nullptr) {
+    *undo_installed = false;
+  }
+  EpochManager::Guard guard(&epoch_manager_);
+  BlockWriter writer(slot);
+  RawBlock *block = writer.GetBlock();
+  TupleAccessStrategy &accessor = Accessor(block);
+  // 还没搬到新layout的block里没有后加的列，写不进去
+  if (reinterpret_cast<Block *>(block)->layout_version_ + 1 !=
+      num_versions_.load(std::memory_order_acquire)) {
+    for (uint16_t i = 0; i < redo.NumColumns(); i++) {
+      if (!accessor.GetBlockLayout().HasColumn(redo.ColumnIds()[i])) {
+        return false;
+      }
+    }
+  }
 
   DeltaRecord *version_ptr = ReadVersionPtr(slot);
 
-  undo->next_ = version_ptr;
-
   if (HasConflict(version_ptr, undo))
     return false;
 
-  for (uint16_t i = 0; i < redo.NumColumns(); i++) {
-    StorageUtil::CopyAttrIntoProjection(accessor_, slot, undo->Delta(), i);
+  // 同一个事务又改这个tuple：并进它自己的delta，链不变长
+  DeltaRecord *own = nullptr;
+  if (version_ptr != nullptr && version_ptr->timestamp_ == undo->timestamp_) {
+    own = version_ptr;
+    if (Covers(*own->Delta(), redo)) {
+      Touch(block);
+      Thaw(block);
+      UpdateZoneMaps(slot, redo);
+      for (uint16_t i = 0; i < redo.NumColumns(); i++) {
+        StorageUtil::CopyAttrFromProjection(redo, accessor, slot, i);
+      }
+      return true;
+    }
+    if (!Covers(*undo->Delta(), *own->Delta())) {
+      own = nullptr;
+    }
   }
 
-  auto *ptr = accessor_.AccessWithNullCheck(slot, VERSION_VECTOR_COLUMN_ID);
+  undo->next_ = own == nullptr ? version_ptr : own->next_;
+
+  // summary在block头里，要等Thaw把正在驱逐的block换完再写，不然会被文件映射盖掉
+  Touch(block);
+  Thaw(block);
+
+  // 先更新block的summary再动tuple，reader拷完值再看summary就不会漏掉
+  NoteVersion(block, undo->timestamp_, version_ptr == nullptr,
+              own != nullptr);
+  UpdateZoneMaps(slot, redo);
+
+  NOISEPAGE_TRACE_SCOPE(COPY);
+  ProjectedRow *delta = undo->Delta();
+  for (uint16_t i = 0; i < delta->NumColumns(); i++) {
+    StorageUtil::CopyAttrIntoProjection(accessor, slot, delta, i);
+  }
+  if (own != nullptr) {
+    // 这个事务改过的列要留最早的before-image，不是现在的值
+    std::unordered_map<uint16_t, uint16_t> id_to_offset;
+    for (uint16_t i = 0; i < delta->NumColumns(); i++) {
+      id_to_offset[delta->ColumnIds()[i]] = i;
+    }
+    StorageUtil::ApplyDelta(accessor.GetBlockLayout(), *own->Delta(), delta,
+                            id_to_offset);
+  }
+
+  auto *ptr = accessor.AccessWithNullCheck(slot, VERSION_VECTOR_COLUMN_ID);
   *reinterpret_cast<DeltaRecord **>(ptr) = undo;
+  if (undo_installed != nullptr) {
+    *undo_installed = true;
+  }
 
   for (uint16_t i = 0; i < redo.NumColumns(); i++) {
-    StorageUtil::CopyAttrFromProjection(redo, accessor_, slot, i);
+    StorageUtil::CopyAttrFromProjection(redo, accessor, slot, i);
   }
   return true;
 }
 
+void DataTable::Commit(const TupleSlot &slot, DeltaRecord *undo,
+                       timestamp_t commit_timestamp) {
+  assert(static_cast<int64_t>(undo->timestamp_) < 0);
+  EpochManager::Guard guard(&epoch_manager_);
+  BlockWriter writer(slot);
+  RawBlock *block = writer.GetBlock();
+  // 先抬高max，计数归零的时候reader看到的max已经盖住这个版本了
+  RaiseMaxVersion(block, commit_timestamp);
+  undo->timestamp_ = commit_timestamp;
+  reinterpret_cast<Block *>(block)->num_uncommitted_.fetch_sub(1);
+}
+
+void DataTable::Rollback(const TupleSlot &slot, DeltaRecord *undo) {
+  EpochManager::Guard guard(&epoch_manager_);
+  BlockWriter writer(slot);
+  assert(ReadVersionPtr(slot) == undo);
+  auto *header = reinterpret_cast<Block *>(writer.GetBlock());
+  TupleAccessStrategy &accessor = Accessor(writer.GetBlock());
+  // 和Update反过来：先恢复值再摘掉undo。拷值的时候还是aborted的值、再看
+  // 指针undo已经摘掉了的reader会靠num_rollbacks_发现，重读
+  const ProjectedRow &delta = *undo->Delta();
+  for (uint16_t i = 0; i < delta.NumColumns(); i++) {
+    StorageUtil::CopyAttrFromProjection(delta, accessor, slot, i);
+  }
+  header->num_rollbacks_.fetch_add(1);
+  std::atomic_thread_fence(std::memory_order_release);
+  auto *ptr = accessor.AccessWithNullCheck(slot, VERSION_VECTOR_COLUMN_ID);
+  *reinterpret_cast<DeltaRecord **>(ptr) = undo->next_;
+  if (static_cast<int64_t>(undo->timestamp_) < 0) {
+    header->num_uncommitted_.fetch_sub(1);
+  }
+}
+
+std::vector<uint16_t> DataTable::UndoColumns(const TupleSlot &slot,
+                                             const ProjectedRow &redo,
+                                             timestamp_t timestamp) {
+  std::vector<uint16_t> col_ids(redo.ColumnIds(),
+                                redo.ColumnIds() + redo.NumColumns());
+  EpochManager::Guard guard(&epoch_manager_);
+  DeltaRecord *version_ptr = ReadVersionPtr(slot);
+  if (version_ptr != nullptr && version_ptr->timestamp_ == timestamp) {
+    const ProjectedRow &delta = *version_ptr->Delta();
+    for (uint16_t i = 0; i < delta.NumColumns(); i++) {
+      uint16_t col_id = delta.ColumnIds()[i];
+      if (std::find(col_ids.begin(), col_ids.end(), col_id) == col_ids.end()) {
+        col_ids.push_back(col_id);
+      }
+    }
+  }
+  return col_ids;
+}
+
 TupleSlot DataTable::Insert(const ProjectedRow &redo, DeltaRecord *undo) {
   TupleSlot result;
-  while (!accessor_.Allocate(insertion_head_, result)) {
-    NewBlock();
+  {
+    NOISEPAGE_TRACE_SCOPE(SLOT_ALLOCATION);
+    while (!Accessor(insertion_head_).Allocate(insertion_head_, result)) {
+      NewBlock();
+    }
   }
 
-  StorageUtil::WriteBytes(
-      sizeof(DeltaRecord *), 0,
-      accessor_.AccessForceNotNull(result, VERSION_VECTOR_COLUMN_ID));
+  StorageUtil::WriteBytes(sizeof(DeltaRecord *), 0,
+                          Accessor(result.GetBlock())
+                              .AccessForceNotNull(result,
+                                                  VERSION_VECTOR_COLUMN_ID));
   Update(result, redo, undo);
   return result;
 }
 
+uint32_t DataTable::Scan(
+    timestamp_t timestamp, const std::vector<ColumnPredicate> &predicates,
+    ProjectedRow *out_buffer,
+    const std::function<void(const TupleSlot &, const ProjectedRow &)>
+        &consumer) {
+  // 只看开始scan时已经发布的block，bulk load要么全看到要么全看不到
+  return ScanBlocks(0, num_published_.load(), timestamp, predicates,
+                    out_buffer, consumer);
+}
+
+uint32_t DataTable::ParallelScan(
+    Scheduler *scheduler, timestamp_t timestamp,
+    const std::vector<ColumnPredicate> &predicates,
+    const ProjectedRowInitializer &initializer,
+    const std::function<void(const TupleSlot &, const ProjectedRow &)>
+        &consumer,
+    uint64_t blocks_per_task) {
+  std::atomic<uint32_t> blocks_read{0};
+  scheduler->ParallelFor(
+      0, num_published_.load(), blocks_per_task,
+      [&](uint64_t begin, uint64_t end) {
+        std::vector<byte> buffer(initializer.ProjectedRowSize());
+        blocks_read.fetch_add(ScanBlocks(begin, end, timestamp, predicates,
+                                         initializer.InitializeRow(
+                                             buffer.data()),
+                                         consumer));
+      });
+  return blocks_read.load();
+}
+
+uint32_t DataTable::ScanBlocks(
+    uint64_t begin, uint64_t end, timestamp_t timestamp,
+    const std::vector<ColumnPredicate> &predicates, ProjectedRow *out_buffer,
+    const std::function<void(const TupleSlot &, const ProjectedRow &)>
+        &consumer) {
+  const BlockLayout &layout = GetBlockLayout();
+  std::unordered_map<uint16_t, uint16_t> id_to_offset;
+  for (uint16_t i = 0; i < out_buffer->NumColumns(); i++) {
+    id_to_offset[out_buffer->ColumnIds()[i]] = i;
+  }
+
+  auto satisfies_predicates = [&] {
+    for (const auto &predicate : predicates) {
+      auto it = id_to_offset.find(predicate.col_id_);
+      assert(it != id_to_offset.end());
+      const byte *attr = out_buffer->AccessWithNullCheck(it->second);
+      if (attr == nullptr ||
+          !predicate.Evaluate(StorageUtil::ReadInteger(
+              layout.attr_sizes_[predicate.col_id_], attr))) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  uint32_t blocks_read = 0;
+  std::vector<uint8_t> selection(BitmapSize(layout.num_slots_));
+  for (uint64_t i = begin; i < end; i++) {
+    // 可能拿到的是刚搬走的老block，pin着它就还没被还回去
+    EpochManager::Guard guard(&epoch_manager_);
+    RawBlock *block =
+        blocks_[static_cast<int64_t>(i)].load(std::memory_order_acquire);
+    if (!BlockMayMatch(block, predicates)) {
+      continue;
+    }
+    blocks_read++;
+    Touch(block);
+
+    auto *header = reinterpret_cast<Block *>(block);
+    const TupleAccessStrategy &accessor = Accessor(block);
+    const BlockLayout &block_layout = accessor.GetBlockLayout();
+    auto *allocation_bitmap =
+        accessor.ColumnNullBitmap(block, VERSION_VECTOR_COLUMN_ID);
+    uint32_t rollbacks = header->num_rollbacks_.load(std::memory_order_acquire);
+    PredicateKernels::InitializeSelection(allocation_bitmap, layout.num_slots_,
+                                          selection.data());
+    // 就算之后被writer解压，压缩的副本也还是可以读的
+    bool compressed = IsCompressed(header->state_.load());
+    for (const auto &predicate : predicates) {
+      uint16_t col_id = predicate.col_id_;
+      // block里没有的列都是默认值，BlockMayMatch已经检查过了
+      if (!block_layout.HasColumn(col_id)) {
+        continue;
+      }
+      auto *null_bitmap = accessor.ColumnNullBitmap(block, col_id);
+      if (compressed) {
+        BlockCompressor::Evaluate(predicate, *header->compressed_, null_bitmap,
+                                  layout.num_slots_, selection.data());
+      } else {
+        PredicateKernels::Evaluate(
+            predicate, header->Column(col_id)->ColumnStart(block_layout),
+            layout.attr_sizes_[col_id], null_bitmap, layout.num_slots_,
+            selection.data());
+      }
+    }
+
+    // kernel之后才看summary：kernel读到的值都已经是可见版本的话，selection
+    // 就是准的，只用看被选中的tuple
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (NoNewerVersions(block, timestamp) && !RolledBack(block, rollbacks)) {
+      for (uint32_t offset = 0; offset < layout.num_slots_; offset++) {
+        if (selection[offset / BYTE_SIZE] & ONE_HOT_MASK(offset % BYTE_SIZE)) {
+          TupleSlot slot(block, offset);
+          SelectInto(timestamp, slot, out_buffer, &id_to_offset);
+          consumer(slot, *out_buffer);
+        }
+      }
+      continue;
+    }
+    for (uint32_t offset = 0; offset < layout.num_slots_; offset++) {
+      if (!allocation_bitmap->Test(offset)) {
+        continue;
+      }
+      TupleSlot slot(block, offset);
+      DeltaRecord *version_ptr = ReadVersionPtr(slot);
+      if ((version_ptr == nullptr || version_ptr->timestamp_ <= timestamp) &&
+          !RolledBack(block, rollbacks)) {
+        // 没有要apply的delta，block里的就是可见版本，直接用kernel的结果
+        if (!(selection[offset / BYTE_SIZE] & ONE_HOT_MASK(offset % BYTE_SIZE)))
+          continue;
+        SelectInto(timestamp, slot, out_buffer, &id_to_offset);
+        consumer(slot, *out_buffer);
+      } else {
+        // 可见版本在version chain里，或者kernel可能读到了回滚掉的值，
+        // 只能拼出来之后再判断
+        SelectInto(timestamp, slot, out_buffer, &id_to_offset);
+        if (satisfies_predicates()) {
+          consumer(slot, *out_buffer);
+        }
+      }
+    }
+  }
+  return blocks_read;
+}
+
+void DataTable::ScanColumns(
+    uint64_t begin, uint64_t end, timestamp_t timestamp,
+    const std::vector<uint16_t> &col_ids,
+    const std::vector<ColumnPredicate> &predicates, ColumnBatch *batch,
+    const std::function<void(ColumnBatch *)> &consumer) {
+  assert(batch->NumColumns() == col_ids.size());
+  const BlockLayout &layout = GetBlockLayout();
+  ProjectedRowInitializer initializer = AllColumns();
+  std::unordered_map<uint16_t, uint16_t> id_to_offset;
+  for (uint16_t i = 0; i < initializer.NumColumns(); i++) {
+    id_to_offset[initializer.ColumnIds()[i]] = i;
+  }
+  std::vector<byte> row_buffer(initializer.ProjectedRowSize());
+  auto *row = initializer.InitializeRow(row_buffer.data());
+
+  std::vector<uint32_t> offsets;
+  std::vector<byte *> values(col_ids.size());
+  std::vector<uint8_t *> present(col_ids.size());
+  for (uint16_t i = 0; i < col_ids.size(); i++) {
+    values[i] = batch->Values(i);
+    present[i] = batch->Present(i);
+  }
+  // 每个batch从byte边界开始，这样bitmap可以整段拷
+  uint32_t window = std::max<uint32_t>(
+      BYTE_SIZE, batch->Capacity() / BYTE_SIZE * BYTE_SIZE);
+  for (uint64_t b = begin; b < end; b++) {
+    EpochManager::Guard guard(&epoch_manager_);
+    RawBlock *block =
+        blocks_[static_cast<int64_t>(b)].load(std::memory_order_acquire);
+    if (!BlockMayMatch(block, predicates)) {
+      continue;
+    }
+    Touch(block);
+    for (uint32_t first = 0; first < layout.num_slots_; first += window) {
+      uint32_t n = CopyColumns(
+          block, first, std::min(window, layout.num_slots_ - first), timestamp,
+          col_ids, values.data(), present.data(), batch->Slots(), row,
+          id_to_offset, &offsets);
+      if (n != 0) {
+        batch->Reset(n);
+        consumer(batch);
+      }
+    }
+  }
+}
+
+uint32_t DataTable::CopyColumns(uint64_t index, timestamp_t timestamp,
+                                const std::vector<uint16_t> &col_ids,
+                                byte *const *values, uint8_t *const *present) {
+  ProjectedRowInitializer initializer = AllColumns();
+  std::unordered_map<uint16_t, uint16_t> id_to_offset;
+  for (uint16_t i = 0; i < initializer.NumColumns(); i++) {
+    id_to_offset[initializer.ColumnIds()[i]] = i;
+  }
+  std::vector<byte> row_buffer(initializer.ProjectedRowSize());
+  auto *row = initializer.InitializeRow(row_buffer.data());
+  std::vector<uint32_t> offsets;
+
+  EpochManager::Guard guard(&epoch_manager_);
+  RawBlock *block =
+      blocks_[static_cast<int64_t>(index)].load(std::memory_order_acquire);
+  return CopyColumns(block, 0, GetBlockLayout().num_slots_, timestamp, col_ids,
+                     values, present, nullptr, row, id_to_offset, &offsets);
+}
+
+uint32_t DataTable::CopyColumns(
+    RawBlock *block, uint32_t first_slot, uint32_t num_slots,
+    timestamp_t timestamp, const std::vector<uint16_t> &col_ids,
+    byte *const *values, uint8_t *const *present, TupleSlot *slots,
+    ProjectedRow *row,
+    const std::unordered_map<uint16_t, uint16_t> &id_to_offset,
+    std::vector<uint32_t> *offsets) {
+  const BlockLayout &layout = GetBlockLayout();
+  auto *header = reinterpret_cast<Block *>(block);
+  const TupleAccessStrategy &accessor = Accessor(block);
+  const BlockLayout &block_layout = accessor.GetBlockLayout();
+  auto *allocation_bitmap =
+      accessor.ColumnNullBitmap(block, VERSION_VECTOR_COLUMN_ID);
+  offsets->clear();
+  for (uint32_t offset = first_slot; offset < first_slot + num_slots;
+       offset++) {
+    if (allocation_bitmap->Test(offset)) {
+      offsets->push_back(offset);
+    }
+  }
+  if (offsets->empty()) {
+    return 0;
+  }
+  uint32_t rollbacks = header->num_rollbacks_.load(std::memory_order_acquire);
+  // 没有删除，只有正在insert的slot会留下空洞
+  auto n = static_cast<uint32_t>(offsets->size());
+  bool dense = offsets->back() - first_slot + 1 == n;
+  // 就算之后被writer解压，压缩的副本也还是可以读的
+  const CompressedBlock *compressed =
+      IsCompressed(header->state_.load(std::memory_order_acquire))
+          ? header->compressed_
+          : nullptr;
+
+  for (uint16_t i = 0; i < col_ids.size(); i++) {
+    uint16_t col_id = col_ids[i];
+    uint16_t attr_size = layout.attr_sizes_[col_id];
+    if (!block_layout.HasColumn(col_id)) {
+      const std::vector<byte> &value = DefaultValue(col_id);
+      std::memset(present[i], 0, BitmapSize(n));
+      if (!value.empty()) {
+        StorageUtil::SetBits(present[i], n);
+        for (uint32_t k = 0; k < n; k++) {
+          std::memcpy(values[i] + static_cast<uint64_t>(k) * attr_size,
+                      value.data(), attr_size);
+        }
+      }
+      continue;
+    }
+    auto *null_bitmap = reinterpret_cast<const uint8_t *>(
+        accessor.ColumnNullBitmap(block, col_id));
+    if (dense) {
+      StorageUtil::CopyBits(null_bitmap, first_slot, present[i], n);
+    } else {
+      std::memset(present[i], 0, BitmapSize(n));
+      for (uint32_t k = 0; k < n; k++) {
+        uint32_t offset = (*offsets)[k];
+        if (null_bitmap[offset / BYTE_SIZE] &
+            ONE_HOT_MASK(offset % BYTE_SIZE)) {
+          present[i][k / BYTE_SIZE] |= ONE_HOT_MASK(k % BYTE_SIZE);
+        }
+      }
+    }
+
+    const byte *column = header->Column(col_id)->ColumnStart(block_layout);
+    if (compressed != nullptr) {
+      if (compressed->Columns()[col_id].encoding_ != ColumnEncoding::PLAIN) {
+        for (uint32_t k = 0; k < n; k++) {
+          StorageUtil::WriteBytes(
+              attr_size,
+              static_cast<uint64_t>(
+                  compressed->ReadInteger(col_id, (*offsets)[k])),
+              values[i] + static_cast<uint64_t>(k) * attr_size);
+        }
+        continue;
+      }
+      column = compressed->Data(col_id);
+    }
+    if (dense) {
+      std::memcpy(values[i],
+                  column + static_cast<uint64_t>(first_slot) * attr_size,
+                  static_cast<uint64_t>(n) * attr_size);
+    } else {
+      for (uint32_t k = 0; k < n; k++) {
+        std::memcpy(values[i] + static_cast<uint64_t>(k) * attr_size,
+                    column + static_cast<uint64_t>((*offsets)[k]) * attr_size,
+                    attr_size);
+      }
+    }
+  }
+
+  // writer先装version指针再改原地的值，拷完再看指针就能发现拷的时候被改过的
+  // tuple，这些和本来就有更新版本的一样从version chain拼出来。中间有回滚的话
+  // 拷到的可能是回滚掉的值，都重新拼
+  std::atomic_thread_fence(std::memory_order_acquire);
+  bool no_newer_versions =
+      NoNewerVersions(block, timestamp) && !RolledBack(block, rollbacks);
+  for (uint32_t k = 0; k < n; k++) {
+    TupleSlot slot(block, (*offsets)[k]);
+    if (slots != nullptr) {
+      slots[k] = slot;
+    }
+    if (no_newer_versions) {
+      continue;
+    }
+    DeltaRecord *version_ptr = ReadVersionPtr(slot);
+    if ((version_ptr == nullptr || version_ptr->timestamp_ <= timestamp) &&
+        !RolledBack(block, rollbacks)) {
+      continue;
+    }
+    SelectInto(timestamp, slot, row, &id_to_offset);
+    for (uint16_t i = 0; i < col_ids.size(); i++) {
+      const byte *attr = row->AccessWithNullCheck(id_to_offset.at(col_ids[i]));
+      if (attr == nullptr) {
+        present[i][k / BYTE_SIZE] &= ONE_COLD_MASK(k % BYTE_SIZE);
+        continue;
+      }
+      present[i][k / BYTE_SIZE] |= ONE_HOT_MASK(k % BYTE_SIZE);
+      uint16_t attr_size = layout.attr_sizes_[col_ids[i]];
+      std::memcpy(values[i] + static_cast<uint64_t>(k) * attr_size, attr,
+                  attr_size);
+    }
+  }
+  return n;
+}
+
+bool DataTable::FreezeBlock(RawBlock *block,
+                            timestamp_t oldest_active_timestamp) {
+  if (block == insertion_head_) {
+    return false;
+  }
+  if (reinterpret_cast<Block *>(block)->state_.load() != BlockState::HOT) {
+    return true;
+  }
+  const TupleAccessStrategy &accessor = Accessor(block);
+  const BlockLayout &layout = accessor.GetBlockLayout();
+  auto *allocation_bitmap =
+      accessor.ColumnNullBitmap(block, VERSION_VECTOR_COLUMN_ID);
+
+  // summary已经说明没有比watermark新的版本就不用一个个看了
+  if (!NoNewerVersions(block, oldest_active_timestamp)) {
+    for (uint32_t offset = 0; offset < layout.num_slots_; offset++) {
+      if (!allocation_bitmap->Test(offset)) {
+        continue;
+      }
+      DeltaRecord *version_ptr =
+          ReadVersionPtr(TupleSlot(block, offset));
+      // 未提交版本的timestamp最高位为1，按无符号比较一定比watermark大
+      if (version_ptr != nullptr &&
+          version_ptr->timestamp_ > oldest_active_timestamp) {
+        return false;
+      }
+    }
+  }
+
+  auto *header = reinterpret_cast<Block *>(block);
+  if (header->num_versioned_.load() != 0) {
+    for (uint32_t offset = 0; offset < layout.num_slots_; offset++) {
+      if (allocation_bitmap->Test(offset)) {
+        TupleSlot slot(block, offset);
+        auto *ptr = accessor.ColumnAt(slot, VERSION_VECTOR_COLUMN_ID);
+        *reinterpret_cast<DeltaRecord **>(ptr) = nullptr;
+      }
+    }
+    header->num_versioned_.store(0);
+    header->max_version_timestamp_.store(0);
+    header->num_uncommitted_.store(0);
+  }
+
+  ZoneMap *zone_maps = reinterpret_cast<Block *>(block)->zone_maps_;
+  for (uint16_t col_id = 1; col_id < layout.num_cols_; col_id++) {
+    if (!StorageUtil::IsInteger(layout.attr_sizes_[col_id])) {
+      continue;
+    }
+    // 并发的Scan还在读zone map，先在本地算好再一次性发布
+    int64_t min = std::numeric_limits<int64_t>::max();
+    int64_t max = std::numeric_limits<int64_t>::min();
+    uint32_t null_count = 0;
+    for (uint32_t offset = 0; offset < layout.num_slots_; offset++) {
+      if (!allocation_bitmap->Test(offset)) {
+        continue;
+      }
+      const byte *attr = accessor.AccessWithNullCheck(
+          TupleSlot(block, offset), col_id);
+      if (attr == nullptr) {
+        null_count++;
+      } else {
+        int64_t val =
+            StorageUtil::ReadInteger(layout.attr_sizes_[col_id], attr);
+        min = std::min(min, val);
+        max = std::max(max, val);
+      }
+    }
+    zone_maps[col_id].Publish(min, max, null_count);
+  }
+
+  reinterpret_cast<Block *>(block)->state_.store(BlockState::FROZEN);
+  TrackFrozen(block);
+  return true;
+}
+
+bool DataTable::CompressBlock(RawBlock *block) {
+  const BlockLayout &layout = Accessor(block).GetBlockLayout();
+  CompressedBlock *previous;
+  if (!BlockCompressor::Compress(block, layout, &previous)) {
+    return false;
+  }
+  // 之前看到block是frozen的reader还在读原来的列，上一份副本也可能还有人在解码
+  struct Retired {
+    const BlockLayout *layout_;
+    RawBlock *block_;
+    CompressedBlock *copy_;
+    CompressedBlock *previous_;
+  };
+  epoch_manager_.Retire(
+      new Retired{&layout, block, reinterpret_cast<Block *>(block)->compressed_,
+                  previous},
+      [](void *ptr) {
+        auto *retired = static_cast<Retired *>(ptr);
+        BlockCompressor::ReleasePages(retired->block_, *retired->layout_,
+                                      retired->copy_);
+        delete[] reinterpret_cast<byte *>(retired->previous_);
+        delete retired;
+      });
+  epoch_manager_.TryReclaim();
+  return true;
+}
+
+bool DataTable::BlockMayMatch(
+    RawBlock *block, const std::vector<ColumnPredicate> &predicates) const {
+  ZoneMap *zone_maps = reinterpret_cast<Block *>(block)->zone_maps_;
+  const BlockLayout &layout = Accessor(block).GetBlockLayout();
+  for (const auto &predicate : predicates) {
+    uint16_t attr_size = GetBlockLayout().attr_sizes_[predicate.col_id_];
+    assert(StorageUtil::IsInteger(attr_size));
+    // block里没有这一列的话，所有tuple都是默认值
+    if (!layout.HasColumn(predicate.col_id_)) {
+      const std::vector<byte> &value = DefaultValue(predicate.col_id_);
+      if (value.empty() || !predicate.Evaluate(StorageUtil::ReadInteger(
+                               attr_size, value.data()))) {
+        return false;
+      }
+      continue;
+    }
+    int64_t lo, hi;
+    const ZoneMap &zone_map = zone_maps[predicate.col_id_];
+    if (!predicate.Bounds(&lo, &hi) || zone_map.Empty() ||
+        !zone_map.MayContain(lo, hi)) {
+      return false;
+    }
+    if (predicate.type_ == PredicateType::IN &&
+        std::none_of(
+            predicate.in_list_.begin(), predicate.in_list_.end(),
+            [&](int64_t val) { return zone_map.MayContain(val, val); })) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint16_t DataTable::AddColumn(uint16_t attr_size, const byte *default_value) {
+  assert(attr_size != 0);
+  const BlockLayout &layout = GetBlockLayout();
+  if (layout.num_cols_ == UINT16_MAX) {
+    throw std::length_error("Too many columns");
+  }
+  auto col_id = layout.num_cols_;
+  std::vector<uint16_t> attr_sizes = layout.attr_sizes_;
+  attr_sizes.push_back(attr_size);
+  std::vector<std::vector<byte>> defaults =
+      versions_[num_versions_.load() - 1]->defaults_;
+  defaults.emplace_back();
+  if (default_value != nullptr) {
+    defaults.back().assign(default_value, default_value + attr_size);
+  }
+  AddVersion(NextLayout(layout, attr_sizes), std::move(defaults));
+  return col_id;
+}
+
+void DataTable::DropColumn(uint16_t col_id) {
+  const BlockLayout &layout = GetBlockLayout();
+  assert(col_id != VERSION_VECTOR_COLUMN_ID && layout.HasColumn(col_id));
+  std::vector<uint16_t> attr_sizes = layout.attr_sizes_;
+  attr_sizes[col_id] = 0;
+  AddVersion(NextLayout(layout, attr_sizes),
+             versions_[num_versions_.load() - 1]->defaults_);
+}
+
+void DataTable::AddVersion(const BlockLayout &layout,
+                           std::vector<std::vector<byte>> defaults) {
+  uint32_t version = num_versions_.load();
+  if (version == MAX_LAYOUT_VERSIONS) {
+    throw std::length_error("Too many schema changes");
+  }
+  versions_[version].reset(
+      new LayoutVersion{TupleAccessStrategy(layout), std::move(defaults)});
+  num_versions_.store(version + 1, std::memory_order_release);
+  migration_cursor_ = 0;
+  // 新的列只有新layout的block里有，insert不能再进老的insertion head
+  NewBlock();
+}
+
+uint32_t DataTable::MigrateBlocks(uint32_t max_blocks) {
+  uint32_t latest = num_versions_.load() - 1;
+  uint32_t num_moved = 0;
+  uint64_t num_blocks = num_published_.load();
+  for (; migration_cursor_ < num_blocks && num_moved < max_blocks;
+       migration_cursor_++) {
+    auto index = static_cast<int64_t>(migration_cursor_);
+    RawBlock *from = blocks_[index].load(std::memory_order_relaxed);
+    if (reinterpret_cast<Block *>(from)->layout_version_ == latest) {
+      continue;
+    }
+    // 新来的writer挡在外面，等已经在里面的写完。directory和blocks_都指向to
+    // 之后再放它们进来，不然scan还会从from读，漏掉写进to的提交
+    auto &writers = BlockDirectory::Get().Writers(from->BlockId());
+    writers.fetch_or(MIGRATING);
+    while ((writers.load() & ~MIGRATING) != 0) {
+      std::this_thread::yield();
+    }
+    RawBlock *to;
+    try {
+      to = MigrateBlock(from);
+    } catch (...) {
+      writers.fetch_and(~MIGRATING);
+      throw;
+    }
+    bool relocated = BlockDirectory::Get().Relocate(from->BlockId(), from, to);
+    assert(relocated);
+    (void)relocated;
+    blocks_[index].store(to, std::memory_order_release);
+    writers.fetch_and(~MIGRATING);
+    if (reinterpret_cast<Block *>(to)->state_.load() == BlockState::FROZEN) {
+      TrackFrozen(to);
+    }
+    // reader可能还在from里，等它们都走了再还
+    RetireBlock(from);
+    num_moved++;
+  }
+  epoch_manager_.TryReclaim();
+  return num_moved;
+}
+
+DataTable::BlockWriter::BlockWriter(const TupleSlot &slot)
+    : writers_(BlockDirectory::Get().Writers(slot.GetBlockId())) {
+  // 正在搬就等搬完，之后directory已经指向新的副本
+  while ((writers_.fetch_add(1) & MIGRATING) != 0) {
+    writers_.fetch_sub(1);
+    while ((writers_.load() & MIGRATING) != 0) {
+      std::this_thread::yield();
+    }
+  }
+  block_ = slot.GetBlock();
+}
+
+RawBlock *DataTable::MigrateBlock(RawBlock *from) {
+  uint32_t version = num_versions_.load() - 1;
+  const LayoutVersion &latest = *versions_[version];
+  const BlockLayout &layout = latest.accessor_.GetBlockLayout();
+  const BlockLayout &old_layout = Accessor(from).GetBlockLayout();
+  assert(layout.num_slots_ == old_layout.num_slots_);
+  auto *source = reinterpret_cast<Block *>(from);
+  RawBlock *to = block_store_.Get(layout.block_size_);
+  InitializeRawBlock(to, layout, from->BlockId());
+  auto *target = reinterpret_cast<Block *>(to);
+  target->zone_maps_ = new ZoneMap[layout.num_cols_];
+  target->layout_version_ = version;
+
+  // ColdTier可能正在换出这个block，文件里的内容是一样的
+  BlockState state = source->state_.load();
+  const CompressedBlock *compressed =
+      IsCompressed(state) ? source->compressed_ : nullptr;
+  auto *allocation_bitmap = reinterpret_cast<const uint8_t *>(
+      source->Column(VERSION_VECTOR_COLUMN_ID)->NullBitmap());
+  for (uint16_t col_id = 0; col_id < layout.num_cols_; col_id++) {
+    if (!layout.HasColumn(col_id)) {
+      continue;
+    }
+    uint16_t attr_size = layout.attr_sizes_[col_id];
+    MiniBlock *column = target->Column(col_id);
+    auto *present = reinterpret_cast<uint8_t *>(column->NullBitmap());
+    byte *values = column->ColumnStart(layout);
+    ZoneMap &zone_map = target->zone_maps_[col_id];
+    zone_map.Reset();
+
+    if (old_layout.HasColumn(col_id)) {
+      std::memcpy(present, source->Column(col_id)->NullBitmap(),
+                  BitmapSize(layout.num_slots_));
+      if (compressed == nullptr) {
+        std::memcpy(values, source->Column(col_id)->ColumnStart(old_layout),
+                    static_cast<uint64_t>(layout.num_slots_) * attr_size);
+      } else {
+        for (uint32_t offset = 0; offset < layout.num_slots_; offset++) {
+          compressed->AttrAt(old_layout, col_id, offset,
+                             values + static_cast<uint64_t>(offset) * attr_size);
+        }
+      }
+      const ZoneMap &old_zone_map = source->zone_maps_[col_id];
+      zone_map.min_.store(old_zone_map.min_.load());
+      zone_map.max_.store(old_zone_map.max_.load());
+      zone_map.null_count_.store(old_zone_map.null_count_.load());
+      continue;
+    }
+
+    // 后加的列，已有的tuple都是默认值
+    const std::vector<byte> &value = latest.defaults_[col_id];
+    uint32_t num_allocated = 0;
+    for (uint32_t offset = 0; offset < layout.num_slots_; offset++) {
+      if (!(allocation_bitmap[offset / BYTE_SIZE] &
+            ONE_HOT_MASK(offset % BYTE_SIZE))) {
+        continue;
+      }
+      num_allocated++;
+      if (value.empty()) {
+        zone_map.AddNull();
+        continue;
+      }
+      present[offset / BYTE_SIZE] |= ONE_HOT_MASK(offset % BYTE_SIZE);
+      std::memcpy(values + static_cast<uint64_t>(offset) * attr_size,
+                  value.data(), attr_size);
+    }
+    if (num_allocated != 0 && !value.empty() &&
+        StorageUtil::IsInteger(attr_size)) {
+      zone_map.Widen(StorageUtil::ReadInteger(attr_size, value.data()));
+    }
+  }
+
+  // version指针跟着第0列拷过来了，summary也要跟上
+  target->num_versioned_.store(source->num_versioned_.load());
+  target->max_version_timestamp_.store(source->max_version_timestamp_.load());
+  target->num_uncommitted_.store(source->num_uncommitted_.load());
+  target->num_rollbacks_.store(source->num_rollbacks_.load());
+  // 压缩过的block搬过来是frozen的，要的话GC再压一次
+  target->state_.store(state == BlockState::HOT ? BlockState::HOT
+                                                : BlockState::FROZEN);
+  return to;
+}
+
+uint32_t DataTable::NumAllocated(RawBlock *block) const {
+  const TupleAccessStrategy &accessor = Accessor(block);
+  auto *bitmap = reinterpret_cast<const uint8_t *>(
+      accessor.ColumnNullBitmap(block, VERSION_VECTOR_COLUMN_ID));
+  uint32_t num_allocated = 0;
+  for (uint32_t i = 0; i < BitmapSize(accessor.GetBlockLayout().num_slots_);
+       i++) {
+    num_allocated += static_cast<uint32_t>(__builtin_popcount(bitmap[i]));
+  }
+  return num_allocated;
+}
+
 DeltaRecord *DataTable::ReadVersionPtr(const TupleSlot &slot) {
-  auto *ptr = accessor_.AccessWithNullCheck(slot, VERSION_VECTOR_COLUMN_ID);
-  return *reinterpret_cast<DeltaRecord **>(ptr);
+  DeltaRecord *version_ptr = nullptr;
+  const byte *ptr =
+      Accessor(slot.GetBlock())
+          .ReadAttr(slot, VERSION_VECTOR_COLUMN_ID,
+                    reinterpret_cast<byte *>(&version_ptr));
+  return ptr == nullptr ? nullptr
+                        : *reinterpret_cast<DeltaRecord *const *>(ptr);
+}
+
+void DataTable::Thaw(RawBlock *block) {
+  auto *header = reinterpret_cast<Block *>(block);
+  BlockState state = header->state_.load();
+  // 写frozen block会让它重新变hot，之后zone map只会变宽。要和ColdTier抢，
+  // 它正在驱逐的话等它换完，不然写的东西会被换掉
+  while (true) {
+    if (state == BlockState::FROZEN) {
+      if (header->state_.compare_exchange_weak(state, BlockState::HOT)) {
+        if (cold_tier_ != nullptr) {
+          cold_tier_->Thawed(block);
+        }
+        return;
+      }
+    } else if (state == BlockState::EVICTING) {
+      std::this_thread::yield();
+      state = header->state_.load();
+    } else {
+      if (IsCompressed(state)) {
+        BlockCompressor::Decompress(block, Accessor(block).GetBlockLayout());
+      }
+      return;
+    }
+  }
+}
+
+void DataTable::UpdateZoneMaps(const TupleSlot &slot,
+                               const ProjectedRow &redo) {
+  const BlockLayout &layout = Accessor(slot.GetBlock()).GetBlockLayout();
+  auto *block = reinterpret_cast<Block *>(slot.GetBlock());
+
+  // 要在写入block之前widen，这样读到新值的reader一定也能看到更宽的zone map
+  ZoneMap *zone_maps = block->zone_maps_;
+  for (uint16_t i = 0; i < redo.NumColumns(); i++) {
+    uint16_t col_id = redo.ColumnIds()[i];
+    // 宽的定长类型没有zone map，也不能出现在谓词里
+    if (!StorageUtil::IsInteger(layout.attr_sizes_[col_id])) {
+      continue;
+    }
+    const byte *attr = redo.AccessWithNullCheck(i);
+    if (attr == nullptr) {
+      zone_maps[col_id].AddNull();
+    } else {
+      zone_maps[col_id].Widen(
+          StorageUtil::ReadInteger(layout.attr_sizes_[col_id], attr));
+    }
+  }
 }
 
 } // namespace noisepage::storage
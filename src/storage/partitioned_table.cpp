@@ -0,0 +1,313 @@
+#include "storage/partitioned_table.h"
+#include "common/concurrent_bitmap.h"
+#include "storage/storage_util.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <limits>
+
+namespace noisepage::storage {
+PartitionedTable::PartitionedTable(BlockStore &store,
+                                   const BlockLayout &layout,
+                                   PartitionScheme scheme)
+    : scheme_(std::move(scheme)),
+      key_size_(layout.attr_sizes_[scheme_.key_col_]) {
+  assert(scheme_.num_partitions_ > 0);
+  assert(StorageUtil::IsInteger(key_size_));
+  assert(std::is_sorted(scheme_.split_points_.begin(),
+                        scheme_.split_points_.end()));
+  for (uint32_t i = 0; i < scheme_.num_partitions_; i++) {
+    partitions_.emplace_back(new DataTable(store, layout));
+    home_workers_.push_back(i);
+  }
+}
+
+uint32_t PartitionedTable::PartitionOf(int64_t key) const {
+  if (scheme_.type_ == PartitionType::RANGE) {
+    const auto &splits = scheme_.split_points_;
+    return static_cast<uint32_t>(
+        std::upper_bound(splits.begin(), splits.end(), key) - splits.begin());
+  }
+  // 连续的key要散开，乘一下取高位
+  uint64_t hash = static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ULL;
+  return static_cast<uint32_t>((hash >> 32) % scheme_.num_partitions_);
+}
+
+uint32_t PartitionedTable::PartitionOf(const ProjectedRow &row) const {
+  for (uint16_t i = 0; i < row.NumColumns(); i++) {
+    if (row.ColumnIds()[i] != scheme_.key_col_) {
+      continue;
+    }
+    const byte *attr = row.AccessWithNullCheck(i);
+    return attr == nullptr
+               ? 0
+               : PartitionOf(StorageUtil::ReadInteger(key_size_, attr));
+  }
+  assert(false && "row lacks the partitioning key");
+  return 0;
+}
+
+TupleSlot PartitionedTable::Insert(const ProjectedRow &redo,
+                                   DeltaRecord *undo, uint32_t *partition) {
+  uint32_t target = PartitionOf(redo);
+  if (partition != nullptr) {
+    *partition = target;
+  }
+  return partitions_[target]->Insert(redo, undo);
+}
+
+void PartitionedTable::Route(
+    const std::vector<BulkLoadColumn> &columns, uint32_t num_rows,
+    std::vector<std::vector<std::vector<byte>>> *buffers,
+    std::vector<std::vector<BulkLoadColumn>> *routed,
+    std::vector<std::vector<uint32_t>> *rows) const {
+  const BlockLayout &layout = partitions_[0]->GetBlockLayout();
+  uint32_t num_partitions = NumPartitions();
+  auto key = std::find_if(columns.begin(), columns.end(),
+                          [this](const BulkLoadColumn &column) {
+                            return column.col_id_ == scheme_.key_col_;
+                          });
+  assert(key != columns.end());
+
+  rows->assign(num_partitions, {});
+  for (uint32_t row = 0; row < num_rows; row++) {
+    bool present =
+        key->present_ == nullptr ||
+        (key->present_[row / BYTE_SIZE] & ONE_HOT_MASK(row % BYTE_SIZE)) != 0;
+    uint32_t partition =
+        present ? PartitionOf(StorageUtil::ReadInteger(
+                      key_size_,
+                      key->values_ + static_cast<uint64_t>(row) * key_size_))
+                : 0;
+    (*rows)[partition].push_back(row);
+  }
+
+  // 每个partition每列两块buffer：值，和有null时的bitmap
+  buffers->assign(num_partitions, {});
+  routed->assign(num_partitions, {});
+  for (uint32_t partition = 0; partition < num_partitions; partition++) {
+    const auto &partition_rows = (*rows)[partition];
+    auto &partition_buffers = (*buffers)[partition];
+    partition_buffers.resize(2 * columns.size());
+    for (uint32_t c = 0; c < columns.size(); c++) {
+      const BulkLoadColumn &column = columns[c];
+      uint16_t attr_size = layout.attr_sizes_[column.col_id_];
+      auto &values = partition_buffers[2 * c];
+      values.resize(partition_rows.size() * attr_size);
+      for (uint32_t i = 0; i < partition_rows.size(); i++) {
+        std::memcpy(values.data() + static_cast<uint64_t>(i) * attr_size,
+                    column.values_ +
+                        static_cast<uint64_t>(partition_rows[i]) * attr_size,
+                    attr_size);
+      }
+      BulkLoadColumn out{column.col_id_, values.data()};
+      if (column.present_ != nullptr) {
+        auto &present = partition_buffers[2 * c + 1];
+        present.assign((partition_rows.size() + BYTE_SIZE - 1) / BYTE_SIZE,
+                       byte(0));
+        for (uint32_t i = 0; i < partition_rows.size(); i++) {
+          uint32_t row = partition_rows[i];
+          if ((column.present_[row / BYTE_SIZE] &
+               ONE_HOT_MASK(row % BYTE_SIZE)) != 0) {
+            present[i / BYTE_SIZE] |=
+                static_cast<byte>(ONE_HOT_MASK(i % BYTE_SIZE));
+          }
+        }
+        out.present_ = reinterpret_cast<const uint8_t *>(present.data());
+      }
+      (*routed)[partition].push_back(out);
+    }
+  }
+}
+
+void PartitionedTable::LoadPartition(
+    uint32_t partition, const std::vector<BulkLoadColumn> &columns,
+    const std::vector<uint32_t> &rows, std::vector<TupleSlot> *slots) {
+  if (rows.empty()) {
+    return;
+  }
+  std::vector<TupleSlot> loaded;
+  BulkLoader::BulkLoad(partitions_[partition].get(), columns,
+                       static_cast<uint32_t>(rows.size()),
+                       slots == nullptr ? nullptr : &loaded);
+  // 各partition写slots里不同的位置，不用latch
+  for (uint32_t i = 0; i < loaded.size(); i++) {
+    (*slots)[rows[i]] = loaded[i];
+  }
+}
+
+void PartitionedTable::BulkLoad(const std::vector<BulkLoadColumn> &columns,
+                                uint32_t num_rows,
+                                std::vector<TupleSlot> *slots) {
+  std::vector<std::vector<std::vector<byte>>> buffers;
+  std::vector<std::vector<BulkLoadColumn>> routed;
+  std::vector<std::vector<uint32_t>> rows;
+  Route(columns, num_rows, &buffers, &routed, &rows);
+  std::vector<TupleSlot> ordered(slots == nullptr ? 0 : num_rows);
+  for (uint32_t partition = 0; partition < NumPartitions(); partition++) {
+    LoadPartition(partition, routed[partition], rows[partition],
+                  slots == nullptr ? nullptr : &ordered);
+  }
+  if (slots != nullptr) {
+    slots->insert(slots->end(), ordered.begin(), ordered.end());
+  }
+}
+
+void PartitionedTable::ParallelBulkLoad(
+    const std::vector<BulkLoadColumn> &columns, uint32_t num_rows,
+    Scheduler *scheduler, std::vector<TupleSlot> *slots) {
+  std::vector<std::vector<std::vector<byte>>> buffers;
+  std::vector<std::vector<BulkLoadColumn>> routed;
+  std::vector<std::vector<uint32_t>> rows;
+  Route(columns, num_rows, &buffers, &routed, &rows);
+  std::vector<TupleSlot> ordered(slots == nullptr ? 0 : num_rows);
+  std::vector<uint32_t> all(NumPartitions());
+  for (uint32_t partition = 0; partition < NumPartitions(); partition++) {
+    all[partition] = partition;
+  }
+  // 一个partition整个由一个worker装，它的block都是这个worker先碰的
+  ForEachPartition(scheduler, all, [&](uint32_t partition) {
+    LoadPartition(partition, routed[partition], rows[partition],
+                  slots == nullptr ? nullptr : &ordered);
+  });
+  if (slots != nullptr) {
+    slots->insert(slots->end(), ordered.begin(), ordered.end());
+  }
+}
+
+bool PartitionedTable::MayMatch(
+    uint32_t partition, const std::vector<ColumnPredicate> &predicates) const {
+  constexpr int64_t min = std::numeric_limits<int64_t>::min();
+  constexpr int64_t max = std::numeric_limits<int64_t>::max();
+  for (const auto &predicate : predicates) {
+    if (predicate.col_id_ != scheme_.key_col_) {
+      continue;
+    }
+    if (predicate.type_ == PredicateType::IN) {
+      bool any = std::any_of(
+          predicate.in_list_.begin(), predicate.in_list_.end(),
+          [&](int64_t key) { return PartitionOf(key) == partition; });
+      if (!any) {
+        return false;
+      }
+      continue;
+    }
+    int64_t lo, hi;
+    if (!predicate.Bounds(&lo, &hi)) {
+      return false;
+    }
+    if (scheme_.type_ == PartitionType::RANGE) {
+      const auto &splits = scheme_.split_points_;
+      int64_t first = partition == 0 ? min : splits[partition - 1];
+      bool last = partition == NumPartitions() - 1;
+      // 空的partition（两个split相同）什么都不放
+      if (!last && splits[partition] == first) {
+        return false;
+      }
+      int64_t end = last ? max : splits[partition] - 1;
+      if (hi < first || lo > end) {
+        return false;
+      }
+      continue;
+    }
+    // hash只能剪掉比partition数还窄的范围
+    uint64_t width = static_cast<uint64_t>(hi) - static_cast<uint64_t>(lo);
+    if (width >= NumPartitions()) {
+      continue;
+    }
+    bool any = false;
+    for (uint64_t i = 0; i <= width && !any; i++) {
+      any = PartitionOf(static_cast<int64_t>(static_cast<uint64_t>(lo) + i)) ==
+            partition;
+    }
+    if (!any) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::vector<uint32_t> PartitionedTable::Candidates(
+    const std::vector<ColumnPredicate> &predicates) const {
+  std::vector<uint32_t> candidates;
+  for (uint32_t partition = 0; partition < NumPartitions(); partition++) {
+    if (MayMatch(partition, predicates)) {
+      candidates.push_back(partition);
+    }
+  }
+  return candidates;
+}
+
+uint32_t PartitionedTable::Scan(
+    timestamp_t timestamp, const std::vector<ColumnPredicate> &predicates,
+    ProjectedRow *out_buffer,
+    const std::function<void(const TupleSlot &, const ProjectedRow &)>
+        &consumer) {
+  uint32_t blocks_read = 0;
+  for (uint32_t partition : Candidates(predicates)) {
+    blocks_read += partitions_[partition]->Scan(timestamp, predicates,
+                                                out_buffer, consumer);
+  }
+  return blocks_read;
+}
+
+uint32_t PartitionedTable::ParallelScan(
+    Scheduler *scheduler, timestamp_t timestamp,
+    const std::vector<ColumnPredicate> &predicates,
+    const ProjectedRowInitializer &initializer,
+    const std::function<void(const TupleSlot &, const ProjectedRow &)>
+        &consumer,
+    uint64_t blocks_per_task) {
+  std::atomic<uint32_t> blocks_read{0};
+  ForEachPartition(scheduler, Candidates(predicates), [&](uint32_t partition) {
+    blocks_read.fetch_add(partitions_[partition]->ParallelScan(
+        scheduler, timestamp, predicates, initializer, consumer,
+        blocks_per_task));
+  });
+  return blocks_read.load();
+}
+
+void PartitionedTable::ForEachPartition(
+    Scheduler *scheduler, const std::vector<uint32_t> &partitions,
+    const std::function<void(uint32_t)> &fn) {
+  if (partitions.empty()) {
+    return;
+  }
+  uint32_t num_workers = scheduler->NumWorkers();
+  std::unique_ptr<std::atomic<bool>[]> claimed(
+      new std::atomic<bool>[partitions.size()]);
+  for (uint32_t i = 0; i < partitions.size(); i++) {
+    claimed[i].store(false, std::memory_order_relaxed);
+  }
+  auto claim = [&](uint32_t i) {
+    return !claimed[i].load(std::memory_order_relaxed) &&
+           !claimed[i].exchange(true);
+  };
+
+  TaskGroup group(scheduler);
+  uint32_t num_tasks =
+      std::min<uint32_t>(num_workers, static_cast<uint32_t>(partitions.size()));
+  for (uint32_t task = 0; task < num_tasks; task++) {
+    group.Run([&] {
+      // 先做自己是home的，再去抢别人还没开始的
+      int32_t worker = Scheduler::CurrentWorker();
+      if (worker >= 0) {
+        for (uint32_t i = 0; i < partitions.size(); i++) {
+          if (home_workers_[partitions[i]] % num_workers ==
+                  static_cast<uint32_t>(worker) &&
+              claim(i)) {
+            fn(partitions[i]);
+          }
+        }
+      }
+      for (uint32_t i = 0; i < partitions.size(); i++) {
+        if (claim(i)) {
+          fn(partitions[i]);
+        }
+      }
+    });
+  }
+  group.Wait();
+}
+} // namespace noisepage::storage
@@ -0,0 +1,303 @@
+#include "storage/predicate_kernels.h"
+#include <cstring>
+#include <immintrin.h>
+#include <stdexcept>
+#include <vector>
+
+namespace noisepage::storage {
+namespace {
+// 每个kernel一次处理64个slot，结果的第i位(从最低位数)对应第i个slot
+constexpr uint32_t SLOTS_PER_MASK = 64;
+
+struct ScalarKernel {
+  template <typename T>
+  static uint64_t RangeMask(const T *vals, T lo, T hi) {
+    uint64_t mask = 0;
+    for (uint32_t i = 0; i < SLOTS_PER_MASK; i++) {
+      mask |= static_cast<uint64_t>(lo <= vals[i] && vals[i] <= hi) << i;
+    }
+    return mask;
+  }
+};
+
+struct Sse4Kernel {
+  template <typename T>
+  __attribute__((target("sse4.2"))) static __m128i
+  OutOfRange(const T *vals, __m128i lo, __m128i hi) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(vals));
+    if constexpr (sizeof(T) == 1) {
+      return _mm_or_si128(_mm_cmpgt_epi8(lo, x), _mm_cmpgt_epi8(x, hi));
+    } else if constexpr (sizeof(T) == 2) {
+      return _mm_or_si128(_mm_cmpgt_epi16(lo, x), _mm_cmpgt_epi16(x, hi));
+    } else if constexpr (sizeof(T) == 4) {
+      return _mm_or_si128(_mm_cmpgt_epi32(lo, x), _mm_cmpgt_epi32(x, hi));
+    } else {
+      return _mm_or_si128(_mm_cmpgt_epi64(lo, x), _mm_cmpgt_epi64(x, hi));
+    }
+  }
+
+  template <typename T>
+  __attribute__((target("sse4.2"))) static uint64_t RangeMask(const T *vals,
+                                                              T lo, T hi) {
+    constexpr uint32_t lanes = 16 / sizeof(T);
+    __m128i vlo, vhi;
+    if constexpr (sizeof(T) == 1) {
+      vlo = _mm_set1_epi8(lo);
+      vhi = _mm_set1_epi8(hi);
+    } else if constexpr (sizeof(T) == 2) {
+      vlo = _mm_set1_epi16(lo);
+      vhi = _mm_set1_epi16(hi);
+    } else if constexpr (sizeof(T) == 4) {
+      vlo = _mm_set1_epi32(lo);
+      vhi = _mm_set1_epi32(hi);
+    } else {
+      vlo = _mm_set1_epi64x(lo);
+      vhi = _mm_set1_epi64x(hi);
+    }
+
+    uint64_t out_of_range = 0;
+    if constexpr (sizeof(T) == 2) {
+      // 两个16位的比较结果pack成一个8位的向量，保持原来的顺序
+      for (uint32_t i = 0; i < SLOTS_PER_MASK; i += 2 * lanes) {
+        __m128i packed =
+            _mm_packs_epi16(OutOfRange(vals + i, vlo, vhi),
+                            OutOfRange(vals + i + lanes, vlo, vhi));
+        out_of_range |= static_cast<uint64_t>(_mm_movemask_epi8(packed)) << i;
+      }
+    } else {
+      for (uint32_t i = 0; i < SLOTS_PER_MASK; i += lanes) {
+        __m128i result = OutOfRange(vals + i, vlo, vhi);
+        uint64_t bits;
+        if constexpr (sizeof(T) == 1) {
+          bits = static_cast<uint32_t>(_mm_movemask_epi8(result));
+        } else if constexpr (sizeof(T) == 4) {
+          bits = static_cast<uint32_t>(
+              _mm_movemask_ps(_mm_castsi128_ps(result)));
+        } else {
+          bits = static_cast<uint32_t>(
+              _mm_movemask_pd(_mm_castsi128_pd(result)));
+        }
+        out_of_range |= bits << i;
+      }
+    }
+    return ~out_of_range;
+  }
+};
+
+struct Avx2Kernel {
+  template <typename T>
+  __attribute__((target("avx2"))) static __m256i
+  OutOfRange(const T *vals, __m256i lo, __m256i hi) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(vals));
+    if constexpr (sizeof(T) == 1) {
+      return _mm256_or_si256(_mm256_cmpgt_epi8(lo, x),
+                             _mm256_cmpgt_epi8(x, hi));
+    } else if constexpr (sizeof(T) == 2) {
+      return _mm256_or_si256(_mm256_cmpgt_epi16(lo, x),
+                             _mm256_cmpgt_epi16(x, hi));
+    } else if constexpr (sizeof(T) == 4) {
+      return _mm256_or_si256(_mm256_cmpgt_epi32(lo, x),
+                             _mm256_cmpgt_epi32(x, hi));
+    } else {
+      return _mm256_or_si256(_mm256_cmpgt_epi64(lo, x),
+                             _mm256_cmpgt_epi64(x, hi));
+    }
+  }
+
+  template <typename T>
+  __attribute__((target("avx2"))) static uint64_t RangeMask(const T *vals,
+                                                            T lo, T hi) {
+    constexpr uint32_t lanes = 32 / sizeof(T);
+    __m256i vlo, vhi;
+    if constexpr (sizeof(T) == 1) {
+      vlo = _mm256_set1_epi8(lo);
+      vhi = _mm256_set1_epi8(hi);
+    } else if constexpr (sizeof(T) == 2) {
+      vlo = _mm256_set1_epi16(lo);
+      vhi = _mm256_set1_epi16(hi);
+    } else if constexpr (sizeof(T) == 4) {
+      vlo = _mm256_set1_epi32(lo);
+      vhi = _mm256_set1_epi32(hi);
+    } else {
+      vlo = _mm256_set1_epi64x(lo);
+      vhi = _mm256_set1_epi64x(hi);
+    }
+
+    uint64_t out_of_range = 0;
+    if constexpr (sizeof(T) == 2) {
+      // packs是按128位的lane交错的，需要再permute一次恢复顺序
+      for (uint32_t i = 0; i < SLOTS_PER_MASK; i += 2 * lanes) {
+        __m256i packed =
+            _mm256_packs_epi16(OutOfRange(vals + i, vlo, vhi),
+                               OutOfRange(vals + i + lanes, vlo, vhi));
+        packed = _mm256_permute4x64_epi64(packed, 0xD8);
+        out_of_range |=
+            static_cast<uint64_t>(
+                static_cast<uint32_t>(_mm256_movemask_epi8(packed)))
+            << i;
+      }
+    } else {
+      for (uint32_t i = 0; i < SLOTS_PER_MASK; i += lanes) {
+        __m256i result = OutOfRange(vals + i, vlo, vhi);
+        uint64_t bits;
+        if constexpr (sizeof(T) == 1) {
+          bits = static_cast<uint32_t>(_mm256_movemask_epi8(result));
+        } else if constexpr (sizeof(T) == 4) {
+          bits = static_cast<uint32_t>(
+              _mm256_movemask_ps(_mm256_castsi256_ps(result)));
+        } else {
+          bits = static_cast<uint32_t>(
+              _mm256_movemask_pd(_mm256_castsi256_pd(result)));
+        }
+        out_of_range |= bits << i;
+      }
+    }
+    return ~out_of_range;
+  }
+};
+
+// kernel的结果是低位在前，bitmap是每个byte高位在前，翻转每个byte里的bit顺序
+uint64_t ReverseBitsInBytes(uint64_t mask) {
+  mask = ((mask >> 1) & 0x5555555555555555ull) |
+         ((mask & 0x5555555555555555ull) << 1);
+  mask = ((mask >> 2) & 0x3333333333333333ull) |
+         ((mask & 0x3333333333333333ull) << 2);
+  mask = ((mask >> 4) & 0x0F0F0F0F0F0F0F0Full) |
+         ((mask & 0x0F0F0F0F0F0F0F0Full) << 4);
+  return mask;
+}
+
+template <typename Kernel, typename T>
+void RangeMasks(const T *vals, uint32_t num_masks, T lo, T hi, bool accumulate,
+                uint64_t *masks) {
+  for (uint32_t i = 0; i < num_masks; i++) {
+    uint64_t mask = Kernel::RangeMask(vals + i * SLOTS_PER_MASK, lo, hi);
+    masks[i] = accumulate ? masks[i] | mask : mask;
+  }
+}
+
+template <typename T>
+void RangeMasks(SimdLevel level, const T *vals, uint32_t num_masks, T lo, T hi,
+                bool accumulate, uint64_t *masks) {
+  switch (level) {
+  case SimdLevel::AVX2:
+    RangeMasks<Avx2Kernel>(vals, num_masks, lo, hi, accumulate, masks);
+    break;
+  case SimdLevel::SSE4:
+    RangeMasks<Sse4Kernel>(vals, num_masks, lo, hi, accumulate, masks);
+    break;
+  default:
+    RangeMasks<ScalarKernel>(vals, num_masks, lo, hi, accumulate, masks);
+  }
+}
+
+// 把[lo, hi]截到T能表示的范围里，没有交集返回false
+template <typename T> bool Clamp(int64_t lo, int64_t hi, T *t_lo, T *t_hi) {
+  constexpr auto t_min = static_cast<int64_t>(std::numeric_limits<T>::min());
+  constexpr auto t_max = static_cast<int64_t>(std::numeric_limits<T>::max());
+  if (lo > hi || lo > t_max || hi < t_min) {
+    return false;
+  }
+  *t_lo = static_cast<T>(std::max(lo, t_min));
+  *t_hi = static_cast<T>(std::min(hi, t_max));
+  return true;
+}
+
+template <typename T>
+void EvaluateTyped(const ColumnPredicate &predicate, const T *vals,
+                   const uint8_t *null_bytes, uint32_t num_slots,
+                   uint8_t *selection, SimdLevel level) {
+  std::vector<std::pair<T, T>> ranges;
+  if (predicate.type_ == PredicateType::IN) {
+    for (int64_t val : predicate.in_list_) {
+      T t_val;
+      if (Clamp(val, val, &t_val, &t_val)) {
+        ranges.emplace_back(t_val, t_val);
+      }
+    }
+  } else {
+    int64_t lo, hi;
+    T t_lo, t_hi;
+    if (predicate.Bounds(&lo, &hi) && Clamp(lo, hi, &t_lo, &t_hi)) {
+      ranges.emplace_back(t_lo, t_hi);
+    }
+  }
+
+  uint32_t num_masks = num_slots / SLOTS_PER_MASK;
+  std::vector<uint64_t> masks(num_masks, 0);
+  for (uint32_t i = 0; i < ranges.size(); i++) {
+    RangeMasks(level, vals, num_masks, ranges[i].first, ranges[i].second,
+               i > 0, masks.data());
+  }
+
+  for (uint32_t i = 0; i < num_masks; i++) {
+    uint64_t selected, nulls;
+    std::memcpy(&selected, selection + i * sizeof(uint64_t), sizeof(uint64_t));
+    std::memcpy(&nulls, null_bytes + i * sizeof(uint64_t), sizeof(uint64_t));
+    selected &= ReverseBitsInBytes(masks[i]) & nulls;
+    std::memcpy(selection + i * sizeof(uint64_t), &selected, sizeof(uint64_t));
+  }
+
+  // 剩下不够64个的slot逐个处理
+  for (uint32_t pos = num_masks * SLOTS_PER_MASK; pos < num_slots; pos++) {
+    bool match = false;
+    for (const auto &range : ranges) {
+      match = match || (range.first <= vals[pos] && vals[pos] <= range.second);
+    }
+    bool not_null = null_bytes[pos / BYTE_SIZE] & ONE_HOT_MASK(pos % BYTE_SIZE);
+    if (!match || !not_null) {
+      selection[pos / BYTE_SIZE] &= ONE_COLD_MASK(pos % BYTE_SIZE);
+    }
+  }
+}
+} // namespace
+
+SimdLevel PredicateKernels::DetectSimdLevel() {
+  static const SimdLevel level = [] {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      return SimdLevel::AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+      return SimdLevel::SSE4;
+    }
+    return SimdLevel::SCALAR;
+  }();
+  return level;
+}
+
+void PredicateKernels::InitializeSelection(const RawConcurrentBitmap *bitmap,
+                                           uint32_t num_slots,
+                                           uint8_t *selection) {
+  // 这里把atomic bitmap当普通的byte数组按字读，和并发的Flip比只是稍旧的值
+  std::memcpy(selection, bitmap, BitmapSize(num_slots));
+}
+
+void PredicateKernels::Evaluate(const ColumnPredicate &predicate,
+                                const byte *column, uint16_t attr_size,
+                                const RawConcurrentBitmap *null_bitmap,
+                                uint32_t num_slots, uint8_t *selection,
+                                SimdLevel level) {
+  const auto *null_bytes = reinterpret_cast<const uint8_t *>(null_bitmap);
+  switch (attr_size) {
+  case 1:
+    EvaluateTyped(predicate, reinterpret_cast<const int8_t *>(column),
+                  null_bytes, num_slots, selection, level);
+    break;
+  case 2:
+    EvaluateTyped(predicate, reinterpret_cast<const int16_t *>(column),
+                  null_bytes, num_slots, selection, level);
+    break;
+  case 4:
+    EvaluateTyped(predicate, reinterpret_cast<const int32_t *>(column),
+                  null_bytes, num_slots, selection, level);
+    break;
+  case 8:
+    EvaluateTyped(predicate, reinterpret_cast<const int64_t *>(column),
+                  null_bytes, num_slots, selection, level);
+    break;
+  default:
+    throw std::runtime_error("Invalid predicate column size");
+  }
+}
+} // namespace noisepage::storage
@@ -0,0 +1,198 @@
+#include "storage/snapshot_file.h"
+#include "storage/data_table.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <unistd.h>
+
+namespace noisepage::storage {
+SnapshotWriter::SnapshotWriter(int fd, const BlockLayout &layout,
+                               std::vector<uint16_t> col_ids,
+                               uint64_t buffer_size)
+    : fd_(fd), col_ids_(std::move(col_ids)) {
+  uint64_t chunk_size = sizeof(uint32_t);
+  for (uint16_t col_id : col_ids_) {
+    attr_sizes_.push_back(layout.attr_sizes_[col_id]);
+    present_offsets_.push_back(chunk_size);
+    chunk_size += BitmapSize(layout.num_slots_);
+    value_offsets_.push_back(chunk_size);
+    chunk_size += static_cast<uint64_t>(layout.num_slots_) *
+                  layout.attr_sizes_[col_id];
+  }
+  buffers_.resize(std::max<uint64_t>(buffer_size / chunk_size, 1),
+                  std::vector<byte>(chunk_size));
+}
+
+void SnapshotWriter::WriteHeader(timestamp_t timestamp) {
+  auto put = [&](const void *data, uint64_t size) {
+    const auto *bytes = static_cast<const byte *>(data);
+    header_.insert(header_.end(), bytes, bytes + size);
+  };
+  auto num_columns = static_cast<uint16_t>(col_ids_.size());
+  put(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+  put(&timestamp, sizeof(timestamp));
+  put(&num_columns, sizeof(num_columns));
+  for (uint16_t i = 0; i < num_columns; i++) {
+    put(&col_ids_[i], sizeof(uint16_t));
+    put(&attr_sizes_[i], sizeof(uint16_t));
+  }
+  // 和第一批chunk一起写出去
+  Append(header_.data(), header_.size());
+}
+
+void SnapshotWriter::CommitChunk(uint32_t num_rows) {
+  if (num_rows == 0) {
+    return;
+  }
+  byte *chunk = Current();
+  std::memcpy(chunk, &num_rows, sizeof(num_rows));
+  Append(chunk, sizeof(num_rows));
+  for (uint16_t i = 0; i < col_ids_.size(); i++) {
+    uint8_t *present = Present(i);
+    if (num_rows % BYTE_SIZE != 0) {
+      present[num_rows / BYTE_SIZE] &=
+          static_cast<uint8_t>(0xFF << (BYTE_SIZE - num_rows % BYTE_SIZE));
+    }
+    Append(present, BitmapSize(num_rows));
+    Append(Values(i), static_cast<uint64_t>(num_rows) * attr_sizes_[i]);
+  }
+  if (++current_ == buffers_.size()) {
+    Flush();
+  }
+}
+
+void SnapshotWriter::Finish() {
+  static const uint32_t end = 0;
+  Append(&end, sizeof(end));
+  Flush();
+}
+
+void SnapshotWriter::Append(const void *data, uint64_t size) {
+  if (size == 0) {
+    return;
+  }
+  // 一个block装满的时候bitmap和值是连着的，合成一个iovec
+  if (!iovecs_.empty()) {
+    iovec &last = iovecs_.back();
+    if (static_cast<byte *>(last.iov_base) + last.iov_len == data) {
+      last.iov_len += size;
+      return;
+    }
+  }
+  iovecs_.push_back({const_cast<void *>(data), size});
+}
+
+void SnapshotWriter::Flush() {
+  uint64_t first = 0;
+  while (first < iovecs_.size()) {
+    int count = static_cast<int>(
+        std::min<uint64_t>(iovecs_.size() - first, IOV_MAX));
+    ssize_t written = writev(fd_, &iovecs_[first], count);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::system_error(errno, std::generic_category(),
+                              "Snapshot write failed");
+    }
+    bytes_written_ += static_cast<uint64_t>(written);
+    // 可能只写了一部分，跳过写完的iovec，从断开的地方继续
+    auto remaining = static_cast<uint64_t>(written);
+    while (first < iovecs_.size() && remaining >= iovecs_[first].iov_len) {
+      remaining -= iovecs_[first].iov_len;
+      first++;
+    }
+    if (remaining != 0) {
+      iovecs_[first].iov_base =
+          static_cast<byte *>(iovecs_[first].iov_base) + remaining;
+      iovecs_[first].iov_len -= remaining;
+    }
+  }
+  iovecs_.clear();
+  current_ = 0;
+}
+
+SnapshotReader::SnapshotReader(int fd) : fd_(fd) {
+  char magic[sizeof(SNAPSHOT_MAGIC)];
+  Read(magic, sizeof(magic));
+  if (std::memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0) {
+    throw std::runtime_error("Invalid snapshot magic");
+  }
+  uint16_t num_columns;
+  Read(&timestamp_, sizeof(timestamp_));
+  Read(&num_columns, sizeof(num_columns));
+  col_ids_.resize(num_columns);
+  attr_sizes_.resize(num_columns);
+  for (uint16_t i = 0; i < num_columns; i++) {
+    Read(&col_ids_[i], sizeof(uint16_t));
+    Read(&attr_sizes_[i], sizeof(uint16_t));
+  }
+}
+
+bool SnapshotReader::NextChunk() {
+  Read(&num_rows_, sizeof(num_rows_));
+  if (num_rows_ == 0) {
+    return false;
+  }
+  present_offsets_.clear();
+  value_offsets_.clear();
+  uint64_t size = 0;
+  for (uint16_t attr_size : attr_sizes_) {
+    present_offsets_.push_back(size);
+    size += BitmapSize(num_rows_);
+    value_offsets_.push_back(size);
+    size += static_cast<uint64_t>(num_rows_) * attr_size;
+  }
+  chunk_.resize(size);
+  Read(chunk_.data(), size);
+  return true;
+}
+
+void SnapshotReader::Read(void *data, uint64_t size) {
+  auto *dst = static_cast<byte *>(data);
+  while (size != 0) {
+    ssize_t n = read(fd_, dst, size);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::system_error(errno, std::generic_category(),
+                              "Snapshot read failed");
+    }
+    if (n == 0) {
+      throw std::runtime_error("Truncated snapshot");
+    }
+    dst += n;
+    size -= static_cast<uint64_t>(n);
+  }
+}
+
+uint64_t ExportSnapshot(DataTable *table, timestamp_t timestamp,
+                        const std::vector<uint16_t> &col_ids, int fd,
+                        uint64_t buffer_size) {
+  SnapshotWriter writer(fd, table->GetBlockLayout(), col_ids, buffer_size);
+  writer.WriteHeader(timestamp);
+  uint64_t num_rows = 0;
+  std::vector<byte *> values(col_ids.size());
+  std::vector<uint8_t *> present(col_ids.size());
+  uint64_t num_blocks = table->NumBlocks();
+  for (uint64_t b = 0; b < num_blocks; b++) {
+    for (uint16_t i = 0; i < col_ids.size(); i++) {
+      values[i] = writer.Values(i);
+      present[i] = writer.Present(i);
+    }
+    uint32_t n = table->CopyColumns(b, timestamp, col_ids, values.data(),
+                                    present.data());
+    if (n == 0) {
+      continue;
+    }
+    writer.CommitChunk(n);
+    num_rows += n;
+  }
+  writer.Finish();
+  return num_rows;
+}
+} // namespace noisepage::storage
@@ -0,0 +1,219 @@
+#include "storage/ssi_manager.h"
+#include "storage/storage_util.h"
+#include <algorithm>
+
+namespace noisepage::storage {
+uint32_t SsiManager::Transaction::Scan(
+    DataTable *table, const std::vector<ColumnPredicate> &predicates,
+    ProjectedRow *out_buffer,
+    const std::function<void(const TupleSlot &, const ProjectedRow &)>
+        &consumer) {
+  RecordPredicateRead(table, predicates);
+  if (!serializable_) {
+    return table->Scan(read_timestamp_, predicates, out_buffer, consumer);
+  }
+  return table->Scan(
+      read_timestamp_, predicates, out_buffer,
+      [&](const TupleSlot &slot, const ProjectedRow &row) {
+        reads_.push_back(std::hash<TupleSlot>()(slot));
+        consumer(slot, row);
+      });
+}
+
+bool SsiManager::Transaction::Update(DataTable *table, const TupleSlot &slot,
+                                     const ProjectedRow &redo,
+                                     DeltaRecord *undo, bool *undo_installed) {
+  bool installed = false;
+  if (!table->Update(slot, redo, undo, &installed)) {
+    return false;
+  }
+  // 没提交的别人的版本Update已经拒了，只剩比snapshot新的已提交版本要查；
+  // 接在自己版本上的第一次装的时候查过了
+  if (installed && undo->CoversNewerCommit(read_timestamp_)) {
+    table->Rollback(slot, undo);
+    return false;
+  }
+  if (installed) {
+    RecordUndo(table, slot, undo, false);
+  }
+  if (undo_installed != nullptr) {
+    *undo_installed = installed;
+  }
+  RecordWrite(table, slot, redo);
+  return true;
+}
+
+void SsiManager::Transaction::RecordWrite(const DataTable *table,
+                                          const TupleSlot &slot,
+                                          const ProjectedRow &redo) {
+  if (!serializable_) {
+    return;
+  }
+  Write write{table, std::hash<TupleSlot>()(slot), {}};
+  const BlockLayout &layout = table->GetBlockLayout();
+  for (uint16_t i = 0; i < redo.NumColumns(); i++) {
+    uint16_t col_id = redo.ColumnIds()[i];
+    uint16_t attr_size = layout.attr_sizes_[col_id];
+    if (!StorageUtil::IsInteger(attr_size)) {
+      continue;
+    }
+    const byte *attr = redo.AccessWithNullCheck(i);
+    write.values_.push_back(
+        {col_id, attr == nullptr,
+         attr == nullptr ? 0 : StorageUtil::ReadInteger(attr_size, attr)});
+  }
+  writes_.push_back(std::move(write));
+}
+
+void SsiManager::Transaction::CommitWrites(timestamp_t commit_timestamp) {
+  for (const Installed &installed : installed_) {
+    installed.table_->Commit(installed.slot_, installed.undo_,
+                             commit_timestamp);
+  }
+  installed_.clear();
+  newest_installed_.clear();
+}
+
+void SsiManager::Transaction::Rollback() {
+  std::vector<Installed> kept;
+  for (auto it = installed_.rbegin(); it != installed_.rend(); ++it) {
+    if (it->insert_) {
+      kept.push_back(*it);
+    } else {
+      it->table_->Rollback(it->slot_, it->undo_);
+    }
+  }
+  installed_.assign(kept.rbegin(), kept.rend());
+  newest_installed_.clear();
+  for (uint64_t i = 0; i < installed_.size(); i++) {
+    newest_installed_[installed_[i].slot_] = i;
+  }
+}
+
+void SsiManager::Transaction::RecordUndo(DataTable *table,
+                                         const TupleSlot &slot,
+                                         DeltaRecord *undo, bool insert) {
+  auto it = newest_installed_.find(slot);
+  // 没有接在自己上一个undo上面，说明是把它换掉了，占它的位置
+  if (it != newest_installed_.end() &&
+      undo->next_ != installed_[it->second].undo_) {
+    installed_[it->second].undo_ = undo;
+    return;
+  }
+  newest_installed_[slot] = installed_.size();
+  installed_.push_back({table, slot, undo, insert});
+}
+
+bool SsiManager::Commit(Transaction *txn, timestamp_t commit_timestamp) {
+  if (!txn->serializable_) {
+    return true;
+  }
+  auto committed = std::make_unique<Committed>();
+  committed->commit_timestamp_ = commit_timestamp;
+  committed->reads_ = std::move(txn->reads_);
+  std::sort(committed->reads_.begin(), committed->reads_.end());
+  committed->writes_ = std::move(txn->writes_);
+  for (const auto &write : committed->writes_) {
+    committed->write_slots_.push_back(write.slot_);
+  }
+  std::sort(committed->write_slots_.begin(), committed->write_slots_.end());
+  committed->predicate_reads_ = std::move(txn->predicate_reads_);
+  committed->in_conflict_ = false;
+  committed->out_conflict_ = false;
+  const bool read_only = committed->writes_.empty();
+
+  std::lock_guard<std::mutex> lock(latch_);
+  // 先只算边，确定能提交了再改别人的标记
+  std::vector<Committed *> out_edges, in_edges;
+  // 从新往旧看，到snapshot里已经有的为止
+  for (auto it = committed_.rbegin(); it != committed_.rend(); ++it) {
+    Committed *other = it->get();
+    if (other->commit_timestamp_ <= txn->read_timestamp_) {
+      break;
+    }
+    // txn读了other改的：txn -rw-> other
+    if (Intersects(committed->reads_, other->write_slots_) ||
+        Phantom(committed->predicate_reads_, other->writes_)) {
+      if (other->out_conflict_) {
+        return false;
+      }
+      committed->out_conflict_ = true;
+      out_edges.push_back(other);
+    }
+    // other读了txn改的：other -rw-> txn；只读事务不会有这种边
+    if (!read_only &&
+        (Intersects(other->reads_, committed->write_slots_) ||
+         Phantom(other->predicate_reads_, committed->writes_))) {
+      if (other->in_conflict_) {
+        return false;
+      }
+      committed->in_conflict_ = true;
+      in_edges.push_back(other);
+    }
+    if (committed->in_conflict_ && committed->out_conflict_) {
+      return false;
+    }
+  }
+  for (Committed *other : out_edges) {
+    other->in_conflict_ = true;
+  }
+  for (Committed *other : in_edges) {
+    other->out_conflict_ = true;
+  }
+  // 提交时间戳基本是按顺序来的，从后面找位置
+  auto position = committed_.end();
+  while (position != committed_.begin() &&
+         (*(position - 1))->commit_timestamp_ > commit_timestamp) {
+    --position;
+  }
+  committed_.insert(position, std::move(committed));
+  return true;
+}
+
+void SsiManager::Prune(timestamp_t oldest_active) {
+  std::lock_guard<std::mutex> lock(latch_);
+  while (!committed_.empty() &&
+         committed_.front()->commit_timestamp_ <= oldest_active) {
+    committed_.pop_front();
+  }
+}
+
+bool SsiManager::Intersects(const std::vector<SlotKey> &sorted_reads,
+                            const std::vector<SlotKey> &sorted_writes) {
+  if (sorted_reads.empty() || sorted_writes.empty()) {
+    return false;
+  }
+  // 写集一般小，拿写去查读
+  for (SlotKey key : sorted_writes) {
+    if (std::binary_search(sorted_reads.begin(), sorted_reads.end(), key)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SsiManager::Phantom(const std::vector<PredicateRead> &predicate_reads,
+                         const std::vector<Write> &writes) {
+  for (const auto &read : predicate_reads) {
+    for (const auto &write : writes) {
+      if (write.table_ != read.table_) {
+        continue;
+      }
+      // 没写谓词列的update不会让tuple进出范围，原来就在范围里的已经记成读了
+      bool touches = false, matches = true;
+      for (const auto &predicate : read.predicates_) {
+        for (const auto &value : write.values_) {
+          if (value.col_id_ == predicate.col_id_) {
+            touches = true;
+            matches &= !value.null_ && predicate.Evaluate(value.value_);
+          }
+        }
+      }
+      if (touches && matches) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+} // namespace noisepage::storage
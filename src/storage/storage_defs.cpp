@@ -1,15 +1,14 @@
 #include "storage/storage_defs.h"
+#include <utility>
 
 namespace noisepage::storage {
 
 uint32_t ProjectedRow::Size(const BlockLayout &layout,
                             const std::vector<uint16_t> &col_ids) {
-  uint32_t row_size = sizeof(uint16_t);
+  uint32_t row_size = HeaderSize(static_cast<uint16_t>(col_ids.size()));
   for (auto col_id : col_ids) {
-    row_size += (sizeof(uint16_t) + sizeof(uint32_t));
     row_size += layout.attr_sizes_[col_id];
   }
-  row_size += BitmapSize(layout.num_cols_ - 1);
   return row_size;
 }
 
@@ -19,14 +18,35 @@ ProjectedRow::InitializeProjectedRow(byte *head, const BlockLayout &layout,
   auto *row = reinterpret_cast<ProjectedRow *>(head);
   row->NumColumns() = static_cast<uint16_t>(col_ids.size());
 
-  uint32_t val_offset = sizeof(uint16_t) +
-                        row->num_cols_ * (sizeof(uint32_t) + sizeof(uint16_t)) +
-                        BitmapSize(row->num_cols_);
+  uint32_t val_offset = HeaderSize(row->num_cols_);
   for (uint16_t i = 0; i < row->num_cols_; i++) {
     row->ColumnIds()[i] = col_ids[i];
     row->AttrValueOffset()[i] = val_offset;
     val_offset += layout.attr_sizes_[col_ids[i]];
   }
+  row->NullBitmap()->SetAll(row->num_cols_, false);
   return row;
 }
+
+ProjectedRowInitializer::ProjectedRowInitializer(const BlockLayout &layout,
+                                                 std::vector<uint16_t> col_ids)
+    : col_ids_(std::move(col_ids)) {
+  // 大的列放前面，第一个值8 byte对齐之后后面的值都是自然对齐的
+  std::stable_sort(col_ids_.begin(), col_ids_.end(),
+                   [&](uint16_t a, uint16_t b) {
+                     return layout.attr_sizes_[a] > layout.attr_sizes_[b];
+                   });
+  auto num_cols = static_cast<uint16_t>(col_ids_.size());
+  uint32_t val_offset = (ProjectedRow::HeaderSize(num_cols) + 7) & ~7u;
+  // null bitmap和对齐的padding都是0，一起拷进去
+  header_.resize(val_offset);
+  auto *row = reinterpret_cast<ProjectedRow *>(header_.data());
+  row->NumColumns() = num_cols;
+  for (uint16_t i = 0; i < num_cols; i++) {
+    row->ColumnIds()[i] = col_ids_[i];
+    row->AttrValueOffset()[i] = val_offset;
+    val_offset += layout.attr_sizes_[col_ids_[i]];
+  }
+  size_ = (val_offset + 7) & ~7u;
+}
 } // namespace noisepage::storage
\ No newline at end of file
@@ -1,20 +1,33 @@
 #include "storage/tuple_access_strategy.h"
 #include "storage/storage_defs.h"
+#include <cstring>
 
 namespace noisepage {
 namespace storage {
 void InitializeRawBlock(RawBlock *raw, const BlockLayout &layout,
                         uint32_t block_id) {
   auto *block = reinterpret_cast<Block *>(raw);
+  block->zone_maps_ = nullptr;
+  block->compressed_ = nullptr;
   block->block_id_ = block_id;
   block->num_records_ = 0;
+  block->state_.store(BlockState::HOT);
+  block->referenced_.store(0);
+  block->layout_version_ = 0;
+  block->num_versioned_.store(0);
+  block->max_version_timestamp_.store(0);
+  block->num_uncommitted_.store(0);
+  block->num_rollbacks_.store(0);
   block->NumSlots() = layout.num_slots_;
 
-  uint32_t attr_offset = layout.header_size_;
   for (auto i = 0; i < layout.num_cols_; i++) {
-    block->AttrOffsets()[i] = attr_offset;
-    attr_offset += layout.attr_sizes_[i] * layout.num_slots_ +
-                   BitmapSize(layout.num_slots_);
+    block->AttrOffsets()[i] = layout.column_offsets_[i];
+    if (!layout.HasColumn(static_cast<uint16_t>(i))) {
+      continue;
+    }
+    // 复用的block里可能还留着之前的bitmap
+    std::memset(reinterpret_cast<byte *>(block->Column(i)->NullBitmap()), 0,
+                BitmapSize(layout.num_slots_));
   }
 
   block->NumAttrs(layout) = layout.num_cols_;
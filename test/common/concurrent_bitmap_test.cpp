@@ -70,4 +70,39 @@ TEST_F(ConcurrentBitmapTests, ConcurrentCorrectnessTest) {
   }
 }
 
-} // namespace noisepage
\ No newline at end of file
+
+// The private bitmap keeps the same bit order, and bulk writes only touch
+// the bits they cover.
+TEST_F(ConcurrentBitmapTests, PrivateBitmapTest) {
+  const uint32_t num_elements = 100;
+  std::default_random_engine generator;
+  std::uniform_int_distribution<uint32_t> pos_dist(0, num_elements);
+  for (uint32_t i = 0; i < 20; i++) {
+    std::vector<uint8_t> bytes(BitmapSize(num_elements));
+    auto *tested = reinterpret_cast<RawPrivateBitmap *>(bytes.data());
+    std::bitset<num_elements> stl_bitmap;
+    for (uint32_t j = 0; j < 50; j++) {
+      uint32_t pos = pos_dist(generator) % num_elements;
+      bool value = generator() % 2 == 0;
+      tested->Set(pos, value);
+      stl_bitmap[pos] = value;
+    }
+    uint32_t n = pos_dist(generator);
+    bool value = generator() % 2 == 0;
+    tested->SetAll(n, value);
+    for (uint32_t pos = 0; pos < n; pos++) {
+      stl_bitmap[pos] = value;
+    }
+    for (uint32_t pos = 0; pos < num_elements; pos++) {
+      EXPECT_EQ((*tested)[pos], stl_bitmap[pos]);
+      // 和共享的bitmap读出来一样
+      EXPECT_EQ(reinterpret_cast<const RawConcurrentBitmap *>(bytes.data())
+                    ->Test(pos),
+                stl_bitmap[pos]);
+    }
+    uint32_t pos = pos_dist(generator) % num_elements;
+    EXPECT_TRUE(tested->Flip(pos, stl_bitmap[pos]));
+    EXPECT_FALSE(tested->Flip(pos, stl_bitmap[pos]));
+  }
+}
+} // namespace noisepage
@@ -0,0 +1,142 @@
+#include "common/epoch_manager.h"
+#include "common/test_util.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <thread>
+
+namespace noisepage {
+class EpochManagerTests : public ::testing::Test {};
+
+struct EpochManagerTestNode {
+  explicit EpochManagerTestNode(uint64_t value) : value_(value) {}
+
+  uint64_t value_;
+  // deleter只做标记，node本身留到测试结束再释放，这样读到回收过的node能被发现
+  std::atomic<bool> reclaimed_{false};
+};
+
+void MarkReclaimed(void *ptr) {
+  static_cast<EpochManagerTestNode *>(ptr)->reclaimed_.store(true);
+}
+
+// An object retired while a guard is alive is only freed once the guard is
+// gone and the epoch has moved on.
+TEST_F(EpochManagerTests, SimpleTest) {
+  EpochManager tested(4, 0);
+  EpochManagerTestNode node(0);
+  {
+    EpochManager::Guard guard(&tested);
+    tested.Retire(&node, MarkReclaimed);
+    for (uint32_t i = 0; i < 10; i++) {
+      EXPECT_EQ(tested.TryReclaim(), 0);
+    }
+    EXPECT_FALSE(node.reclaimed_.load());
+    // the epoch may move once, but never past a pinned thread
+    EXPECT_LE(tested.CurrentEpoch(), 1);
+  }
+  uint32_t num_freed = 0;
+  for (uint32_t i = 0; i < 2; i++) {
+    num_freed += tested.TryReclaim();
+  }
+  EXPECT_EQ(num_freed, 1);
+  EXPECT_TRUE(node.reclaimed_.load());
+}
+
+// Nested guards on one thread share its announcement, so they fit in a single
+// slot, and the epoch stays pinned until the outermost guard is gone.
+TEST_F(EpochManagerTests, NestedGuards) {
+  EpochManager tested(1, 0);
+  EpochManager other(1, 0);
+  EpochManagerTestNode node(0);
+  {
+    EpochManager::Guard outer(&tested);
+    {
+      EpochManager::Guard inner(&tested);
+      EpochManager::Guard elsewhere(&other);
+      EpochManager::Guard innermost(&tested);
+      tested.Retire(&node, MarkReclaimed);
+    }
+    for (uint32_t i = 0; i < 10; i++) {
+      EXPECT_EQ(tested.TryReclaim(), 0);
+    }
+    EXPECT_FALSE(node.reclaimed_.load());
+  }
+  uint32_t num_freed = 0;
+  for (uint32_t i = 0; i < 2; i++) {
+    num_freed += tested.TryReclaim();
+  }
+  EXPECT_EQ(num_freed, 1);
+  // 另一个线程也能拿到唯一的slot
+  std::thread([&] { EpochManager::Guard guard(&tested); }).join();
+}
+
+// Writers keep swapping out a shared node and retiring the old one while
+// readers dereference it under guards. No reader may ever see a node that was
+// already reclaimed, and every retired node is eventually reclaimed.
+TEST_F(EpochManagerTests, ConcurrentCorrectnessTest) {
+  const uint32_t num_threads = 8;
+  const uint32_t num_ops = 20000;
+  EpochManager tested(num_threads, 16);
+  std::vector<EpochManagerTestNode *> all_nodes;
+  std::mutex all_nodes_latch;
+  std::atomic<EpochManagerTestNode *> shared(new EpochManagerTestNode(0));
+  all_nodes.push_back(shared.load());
+
+  auto workload = [&](uint32_t id) {
+    for (uint32_t i = 0; i < num_ops; i++) {
+      EpochManager::Guard guard(&tested);
+      if (id % 2 == 0) {
+        auto *node = new EpochManagerTestNode(i);
+        {
+          std::lock_guard<std::mutex> lock(all_nodes_latch);
+          all_nodes.push_back(node);
+        }
+        tested.Retire(shared.exchange(node), MarkReclaimed);
+      } else {
+        EpochManagerTestNode *node = shared.load();
+        for (uint32_t j = 0; j < 10; j++) {
+          EXPECT_FALSE(node->reclaimed_.load());
+        }
+      }
+    }
+  };
+  testutil::RunThreadUntilFinish(num_threads, workload);
+
+  for (uint32_t i = 0; i < 3; i++) {
+    tested.TryReclaim();
+  }
+  for (auto *node : all_nodes) {
+    EXPECT_EQ(node->reclaimed_.load(), node != shared.load());
+    delete node;
+  }
+}
+
+// Without any explicit reclamation calls, the background thread frees what
+// was retired.
+TEST_F(EpochManagerTests, BackgroundReclamationTest) {
+  std::atomic<uint32_t> num_deleted(0);
+  struct Tracked {
+    explicit Tracked(std::atomic<uint32_t> *counter) : counter_(counter) {}
+    ~Tracked() { (*counter_)++; }
+    std::atomic<uint32_t> *counter_;
+  };
+
+  const uint32_t num_retired = 100;
+  {
+    EpochManager tested(4, 0);
+    tested.StartBackgroundReclamation(std::chrono::microseconds(100));
+    for (uint32_t i = 0; i < num_retired; i++) {
+      EpochManager::Guard guard(&tested);
+      tested.Retire(new Tracked(&num_deleted));
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (num_deleted.load() != num_retired &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(num_deleted.load(), num_retired);
+    tested.StopBackgroundReclamation();
+  }
+  EXPECT_EQ(num_deleted.load(), num_retired);
+}
+} // namespace noisepage
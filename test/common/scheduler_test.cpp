@@ -0,0 +1,195 @@
+#include "common/epoch_manager.h"
+#include "common/scheduler.h"
+#include "common/test_util.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+namespace noisepage {
+class SchedulerTests : public ::testing::Test {};
+
+// Every pushed item comes out exactly once, whether the owner pops it or a
+// thief steals it, also while the deque grows.
+TEST_F(SchedulerTests, DequeConcurrentCorrectness) {
+  const uint32_t num_items = 100000;
+  const uint32_t num_thieves = 3;
+  std::vector<uint32_t> items(num_items);
+  WorkStealingDeque<uint32_t *> deque(2);
+  std::vector<std::atomic<uint32_t>> taken(num_items);
+  std::atomic<bool> done{false};
+
+  auto take = [&](uint32_t *item) {
+    taken[static_cast<uint32_t>(item - items.data())]++;
+  };
+  testutil::RunThreadUntilFinish(num_thieves + 1, [&](uint32_t id) {
+    uint32_t *item;
+    if (id != 0) {
+      while (!done.load()) {
+        if (deque.Steal(item)) {
+          take(item);
+        }
+      }
+      return;
+    }
+    for (uint32_t i = 0; i < num_items; i++) {
+      deque.Push(&items[i]);
+      if (i % 3 == 0 && deque.Pop(item)) {
+        take(item);
+      }
+    }
+    while (deque.Pop(item)) {
+      take(item);
+    }
+    done.store(true);
+  });
+  for (uint32_t i = 0; i < num_items; i++) {
+    EXPECT_EQ(taken[i].load(), 1);
+  }
+}
+
+// Nested parallel loops cover their ranges exactly once and return only
+// when they are done.
+TEST_F(SchedulerTests, ParallelFor) {
+  Scheduler scheduler(4);
+  const uint64_t n = 1000;
+  std::vector<std::atomic<uint32_t>> visits(n * n);
+  scheduler.ParallelFor(0, n, 16, [&](uint64_t begin, uint64_t end) {
+    EXPECT_LE(end - begin, 16);
+    for (uint64_t i = begin; i < end; i++) {
+      scheduler.ParallelFor(0, n, 100, [&, i](uint64_t lo, uint64_t hi) {
+        for (uint64_t j = lo; j < hi; j++) {
+          visits[i * n + j]++;
+        }
+      });
+    }
+  });
+  for (auto &visit : visits) {
+    EXPECT_EQ(visit.load(), 1);
+  }
+  scheduler.ParallelFor(5, 5, 1, [](uint64_t, uint64_t) { FAIL(); });
+}
+
+// A group waits for its tasks, including ones spawned by its tasks, and
+// hands back the first exception.
+TEST_F(SchedulerTests, TaskGroup) {
+  Scheduler scheduler(2);
+  std::atomic<uint32_t> num_run{0};
+  {
+    TaskGroup group(&scheduler);
+    for (uint32_t i = 0; i < 100; i++) {
+      group.Run([&] {
+        group.Run([&] { num_run++; });
+        num_run++;
+      });
+    }
+    group.Wait();
+    EXPECT_EQ(num_run.load(), 200);
+
+    group.Run([] { throw std::runtime_error("task failed"); });
+    group.Run([&] { num_run++; });
+    EXPECT_THROW(group.Wait(), std::runtime_error);
+    EXPECT_EQ(num_run.load(), 201);
+    group.Wait();
+  }
+
+  // worker里调用的Wait也一样
+  std::atomic<bool> done{false};
+  scheduler.Submit([&] {
+    TaskGroup inner(&scheduler);
+    for (uint32_t i = 0; i < 10; i++) {
+      inner.Run([&] { num_run++; });
+    }
+    inner.Wait();
+    done.store(true);
+  });
+  while (!done.load()) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ(num_run.load(), 211);
+}
+
+// Background tasks wait while there is foreground work, and the destructor
+// lets everything submitted finish.
+TEST_F(SchedulerTests, BackgroundWaitsForForeground) {
+  std::atomic<uint32_t> num_foreground{0};
+  std::atomic<uint32_t> foreground_when_background_ran{0};
+  std::atomic<bool> release{false};
+  {
+    Scheduler scheduler(1);
+    // 先占住唯一的worker，后面的task都在排队
+    scheduler.Submit([&] {
+      while (!release.load()) {
+        std::this_thread::yield();
+      }
+    });
+    scheduler.Submit(
+        [&] { foreground_when_background_ran.store(num_foreground.load()); },
+        TaskPriority::BACKGROUND);
+    for (uint32_t i = 0; i < 50; i++) {
+      scheduler.Submit([&] { num_foreground++; });
+    }
+    release.store(true);
+  }
+  EXPECT_EQ(num_foreground.load(), 50);
+  EXPECT_EQ(foreground_when_background_ran.load(), 50);
+}
+
+// Periodic tasks keep running until cancelled, and can drive epoch-based
+// reclamation.
+TEST_F(SchedulerTests, RunPeriodically) {
+  Scheduler scheduler(2);
+  std::atomic<uint32_t> num_runs{0};
+  uint64_t id =
+      scheduler.RunPeriodically(std::chrono::microseconds(100), [&] {
+        num_runs++;
+      });
+  while (num_runs.load() < 5) {
+    std::this_thread::yield();
+  }
+  scheduler.Cancel(id);
+  uint32_t after_cancel = num_runs.load();
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  EXPECT_EQ(num_runs.load(), after_cancel);
+
+  static std::atomic<uint32_t> num_freed{0};
+  struct Tracked {
+    ~Tracked() { num_freed++; }
+  };
+  EpochManager epochs(8, 0);
+  epochs.StartBackgroundReclamation(&scheduler, std::chrono::microseconds(100));
+  for (uint32_t i = 0; i < 10; i++) {
+    epochs.Retire(new Tracked);
+  }
+  while (num_freed.load() < 10) {
+    std::this_thread::yield();
+  }
+  epochs.StopBackgroundReclamation();
+  EXPECT_EQ(num_freed.load(), 10);
+}
+
+// With a single worker busy cancelling, a run of the periodic task that is
+// already queued cannot start; Cancel drops it instead of waiting for it.
+TEST_F(SchedulerTests, CancelFromWorker) {
+  Scheduler scheduler(1);
+  std::atomic<uint32_t> num_runs{0};
+  uint64_t id =
+      scheduler.RunPeriodically(std::chrono::microseconds(100), [&] {
+        num_runs++;
+      });
+  std::atomic<bool> cancelled{false};
+  uint32_t after_cancel = 0;
+  scheduler.Submit([&] {
+    // 等timer把下一次排进队里
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    scheduler.Cancel(id);
+    after_cancel = num_runs.load();
+    cancelled.store(true);
+  });
+  while (!cancelled.load()) {
+    std::this_thread::yield();
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  EXPECT_EQ(num_runs.load(), after_cancel);
+}
+} // namespace noisepage
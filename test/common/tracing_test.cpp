@@ -0,0 +1,92 @@
+#include "common/test_util.h"
+#include "common/tracing.h"
+#include "gtest/gtest.h"
+#include <sstream>
+
+namespace noisepage {
+class TracingTests : public ::testing::Test {
+protected:
+  void SetUp() override {
+    Tracer::Get().EnableEvents(false);
+    Tracer::Get().Reset();
+  }
+};
+
+// Small values are counted exactly, larger ones land in a bucket whose upper
+// bound is within 1/16 of the value.
+TEST_F(TracingTests, HistogramPercentiles) {
+  LatencyHistogram histogram;
+  EXPECT_EQ(histogram.Percentile(0.5), 0);
+  for (uint64_t value = 0; value < 32; value++) {
+    EXPECT_EQ(LatencyHistogram::BucketUpperBound(
+                  LatencyHistogram::BucketIndex(value)),
+              value);
+  }
+  std::default_random_engine generator;
+  for (uint32_t i = 0; i < 10000; i++) {
+    uint64_t value = generator() << (generator() % 32);
+    uint64_t bound = LatencyHistogram::BucketUpperBound(
+        LatencyHistogram::BucketIndex(value));
+    EXPECT_GE(bound, value);
+    EXPECT_LE(bound - value, value / LatencyHistogram::SUB_BUCKETS);
+  }
+  EXPECT_LT(LatencyHistogram::BucketIndex(UINT64_MAX),
+            LatencyHistogram::NUM_BUCKETS);
+
+  for (uint64_t value = 1; value <= 1000; value++) {
+    histogram.Record(value);
+  }
+  EXPECT_EQ(histogram.Count(), 1000);
+  EXPECT_NEAR(histogram.Percentile(0.5), 500, 500 / 16);
+  EXPECT_NEAR(histogram.Percentile(0.99), 990, 990 / 16);
+  EXPECT_GE(histogram.Percentile(1), 1000);
+
+  LatencyHistogram copy(histogram);
+  copy.Merge(histogram);
+  EXPECT_EQ(copy.Count(), 2000);
+  EXPECT_EQ(copy.Percentile(0.5), histogram.Percentile(0.5));
+}
+
+// Every thread records into its own histograms, and the tracer merges them.
+TEST_F(TracingTests, MergesThreads) {
+  const uint32_t num_threads = 4;
+  const uint32_t num_scopes = 1000;
+  testutil::RunThreadUntilFinish(num_threads, [](uint32_t) {
+    for (uint32_t i = 0; i < num_scopes; i++) {
+      ScopedTimer timer(TracePoint::CHAIN_WALK);
+    }
+  });
+  EXPECT_EQ(Tracer::Get().Histogram(TracePoint::CHAIN_WALK).Count(),
+            num_threads * num_scopes);
+  EXPECT_EQ(Tracer::Get().Histogram(TracePoint::COPY).Count(), 0);
+
+  Tracer::Get().Reset();
+  EXPECT_EQ(Tracer::Get().Histogram(TracePoint::CHAIN_WALK).Count(), 0);
+}
+
+// Events are only kept while enabled, and come out as complete ("X") events
+// in the Chrome trace format.
+TEST_F(TracingTests, ChromeTraceDump) {
+  { ScopedTimer timer(TracePoint::COPY); }
+  Tracer::Get().EnableEvents(true, 2);
+  {
+    ScopedTimer outer(TracePoint::SLOT_ALLOCATION);
+    ScopedTimer inner(TracePoint::BLOCK_ALLOCATION);
+  }
+  // 超过每个线程的上限之后只统计，不再记event
+  { ScopedTimer timer(TracePoint::DELTA_APPLY); }
+  Tracer::Get().EnableEvents(false);
+
+  std::ostringstream out;
+  Tracer::Get().DumpChromeTrace(out);
+  std::string json = out.str();
+  EXPECT_EQ(json.rfind("{\"traceEvents\":[", 0), 0);
+  EXPECT_NE(json.find("\"name\":\"slot_allocation\""), std::string::npos);
+  EXPECT_NE(json.find("\"name\":\"block_allocation\""), std::string::npos);
+  EXPECT_EQ(json.find("\"name\":\"copy\""), std::string::npos);
+  EXPECT_EQ(json.find("\"name\":\"delta_apply\""), std::string::npos);
+  EXPECT_NE(json.find("\"ph\":\"X\""), std::string::npos);
+  EXPECT_EQ(Tracer::Get().Histogram(TracePoint::DELTA_APPLY).Count(), 1);
+  EXPECT_GT(Tracer::Get().CyclesPerMicrosecond(), 0);
+}
+} // namespace noisepage
@@ -0,0 +1,282 @@
+#include "execution/basic_operators.h"
+#include "execution/hash_aggregate.h"
+#include "execution/hash_join.h"
+#include "execution/sort.h"
+#include "execution/table_scan.h"
+#include "storage/bulk_loader.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace noisepage {
+using execution::AggregateSpec;
+using execution::AggregateType;
+
+struct ExecutionTests : public ::testing::Test {
+  storage::BlockStore block_store_{100};
+  std::default_random_engine generator_;
+  // key(8) value(4) group(2)
+  storage::BlockLayout layout_{4, {8, 8, 4, 2}, storage::MIN_BLOCK_SIZE};
+  std::vector<int64_t> keys_;
+  std::vector<int32_t> values_;
+  std::vector<int16_t> groups_;
+  std::vector<uint8_t> values_present_;
+  std::vector<storage::TupleSlot> slots_;
+
+  // 每13行有一个value是null
+  void Load(storage::DataTable *table, uint32_t num_rows) {
+    keys_.resize(num_rows);
+    values_.resize(num_rows);
+    groups_.resize(num_rows);
+    values_present_.assign((num_rows + BYTE_SIZE - 1) / BYTE_SIZE, 0);
+    for (uint32_t i = 0; i < num_rows; i++) {
+      keys_[i] = i;
+      values_[i] = static_cast<int32_t>(generator_() % 1000) - 500;
+      groups_[i] = static_cast<int16_t>(i % 7);
+      if (i % 13 != 0) {
+        values_present_[i / BYTE_SIZE] |= ONE_HOT_MASK(i % BYTE_SIZE);
+      }
+    }
+    storage::BulkLoader::BulkLoad(
+        table,
+        {{1, reinterpret_cast<const byte *>(keys_.data())},
+         {2, reinterpret_cast<const byte *>(values_.data()),
+          values_present_.data()},
+         {3, reinterpret_cast<const byte *>(groups_.data())}},
+        num_rows, &slots_);
+  }
+
+  bool ValueIsNull(uint32_t i) const { return i % 13 == 0; }
+};
+
+// Pushed down and pipelined filters and a projection keep exactly the rows
+// a tuple-at-a-time check keeps.
+TEST_F(ExecutionTests, ScanFilterProject) {
+  storage::DataTable table(block_store_, layout_);
+  const uint32_t num_rows = layout_.num_slots_ * 5 + 17;
+  Load(&table, num_rows);
+
+  execution::ResultCollector result;
+  execution::Project project({1}, &result);
+  execution::Filter filter(
+      {{1, storage::PredicateType::BETWEEN, 100, 3000}}, &project);
+  execution::TableScan scan(&table, 0, {2, 1},
+                            {{2, storage::PredicateType::GREATER_EQUAL, 0}},
+                            &filter, 96);
+  scan.Run();
+
+  std::vector<int64_t> expected;
+  for (uint32_t i = 0; i < num_rows; i++) {
+    if (!ValueIsNull(i) && values_[i] >= 0 && i >= 100 && i <= 3000) {
+      expected.push_back(i);
+    }
+  }
+  ASSERT_EQ(result.NumRows(), expected.size());
+  const execution::RowBuffer *rows = result.Rows();
+  ASSERT_EQ(rows->NumColumns(), 1);
+  std::vector<int64_t> actual;
+  for (uint64_t row = 0; row < rows->NumRows(); row++) {
+    actual.push_back(rows->ReadInteger(0, row));
+  }
+  std::sort(actual.begin(), actual.end());
+  EXPECT_EQ(actual, expected);
+}
+
+// Grouped aggregates match ones computed directly, also when the pipeline
+// runs on several workers; a global aggregate over no rows is one row.
+TEST_F(ExecutionTests, HashAggregate) {
+  storage::DataTable table(block_store_, layout_);
+  const uint32_t num_rows = layout_.num_slots_ * 6 + 5;
+  Load(&table, num_rows);
+
+  struct Expected {
+    int64_t count_star_ = 0, count_ = 0, sum_ = 0;
+    int64_t min_ = INT64_MAX, max_ = INT64_MIN;
+  };
+  std::map<int64_t, Expected> expected;
+  for (uint32_t i = 0; i < num_rows; i++) {
+    Expected &group = expected[groups_[i]];
+    group.count_star_++;
+    if (!ValueIsNull(i)) {
+      group.count_++;
+      group.sum_ += values_[i];
+      group.min_ = std::min<int64_t>(group.min_, values_[i]);
+      group.max_ = std::max<int64_t>(group.max_, values_[i]);
+    }
+  }
+
+  std::vector<AggregateSpec> aggregates{{AggregateType::COUNT_STAR, 0},
+                                        {AggregateType::COUNT, 0},
+                                        {AggregateType::SUM, 0},
+                                        {AggregateType::MIN, 0},
+                                        {AggregateType::MAX, 0}};
+  auto check = [&](const execution::ResultCollector &result) {
+    ASSERT_EQ(result.NumRows(), expected.size());
+    const execution::RowBuffer *rows = result.Rows();
+    for (uint64_t row = 0; row < rows->NumRows(); row++) {
+      const Expected &group = expected.at(rows->ReadInteger(0, row));
+      EXPECT_EQ(rows->ReadInteger(1, row), group.count_star_);
+      EXPECT_EQ(rows->ReadInteger(2, row), group.count_);
+      EXPECT_EQ(rows->ReadInteger(3, row), group.sum_);
+      EXPECT_EQ(rows->ReadInteger(4, row), group.min_);
+      EXPECT_EQ(rows->ReadInteger(5, row), group.max_);
+    }
+  };
+
+  execution::ResultCollector serial;
+  execution::HashAggregate serial_agg({1}, aggregates, &serial);
+  execution::TableScan(&table, 0, {2, 3}, {}, &serial_agg).Run();
+  check(serial);
+
+  Scheduler scheduler(4);
+  execution::ResultCollector parallel;
+  execution::HashAggregate parallel_agg({1}, aggregates, &parallel);
+  execution::TableScan(&table, 0, {2, 3}, {}, &parallel_agg, 64)
+      .Run(&scheduler);
+  check(parallel);
+
+  execution::ResultCollector empty;
+  execution::HashAggregate global({}, aggregates, &empty);
+  execution::TableScan(&table, 0, {2},
+                       {{2, storage::PredicateType::GREATER, 10000}}, &global)
+      .Run();
+  ASSERT_EQ(empty.NumRows(), 1);
+  EXPECT_EQ(empty.Rows()->ReadInteger(0, 0), 0);
+  EXPECT_EQ(empty.Rows()->ReadInteger(1, 0), 0);
+  EXPECT_TRUE(empty.Rows()->IsNull(2, 0));
+  EXPECT_TRUE(empty.Rows()->IsNull(3, 0));
+}
+
+// Every probe row comes out once per build row with the same key, with the
+// probe columns first.
+TEST_F(ExecutionTests, HashJoin) {
+  storage::BlockLayout dim_layout(3, {8, 8, 8}, storage::MIN_BLOCK_SIZE);
+  storage::DataTable dim(block_store_, dim_layout);
+  // 每个group出现两次，group 6没有
+  std::vector<int64_t> dim_keys{0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5};
+  std::vector<int64_t> payloads;
+  for (uint32_t i = 0; i < dim_keys.size(); i++) {
+    payloads.push_back(100 * dim_keys[i] + i);
+  }
+  storage::BulkLoader::BulkLoad(
+      &dim,
+      {{1, reinterpret_cast<const byte *>(dim_keys.data())},
+       {2, reinterpret_cast<const byte *>(payloads.data())}},
+      static_cast<uint32_t>(dim_keys.size()));
+
+  storage::DataTable fact(block_store_, layout_);
+  const uint32_t num_rows = layout_.num_slots_ * 3 + 11;
+  Load(&fact, num_rows);
+
+  Scheduler scheduler(4);
+  execution::HashJoinBuild build({0});
+  execution::TableScan(&dim, 0, {1, 2}, {}, &build).Run(&scheduler);
+  EXPECT_EQ(build.NumRows(), dim_keys.size());
+
+  execution::ResultCollector result;
+  execution::HashJoinProbe probe(&build, {1}, &result);
+  execution::TableScan(&fact, 0, {1, 3}, {}, &probe, 128).Run(&scheduler);
+
+  uint64_t expected = 0;
+  for (uint32_t i = 0; i < num_rows; i++) {
+    expected += groups_[i] == 6 ? 0 : 2;
+  }
+  ASSERT_EQ(result.NumRows(), expected);
+  const execution::RowBuffer *rows = result.Rows();
+  ASSERT_EQ(rows->NumColumns(), 4);
+  std::vector<uint32_t> matches(num_rows, 0);
+  for (uint64_t row = 0; row < rows->NumRows(); row++) {
+    int64_t key = rows->ReadInteger(0, row);
+    int64_t group = rows->ReadInteger(1, row);
+    EXPECT_EQ(group, groups_[key]);
+    EXPECT_EQ(rows->ReadInteger(2, row), group);
+    EXPECT_EQ(rows->ReadInteger(3, row) / 100, group);
+    matches[key]++;
+  }
+  for (uint32_t i = 0; i < num_rows; i++) {
+    EXPECT_EQ(matches[i], groups_[i] == 6 ? 0 : 2);
+  }
+}
+
+// A top-k sort emits the k smallest rows in order, nulls first, and a
+// limit after a full sort cuts the same prefix.
+TEST_F(ExecutionTests, SortLimit) {
+  storage::DataTable table(block_store_, layout_);
+  const uint32_t num_rows = layout_.num_slots_ * 4 + 3;
+  Load(&table, num_rows);
+  Scheduler scheduler(4);
+
+  std::vector<std::pair<int64_t, int64_t>> expected;
+  for (uint32_t i = 0; i < num_rows; i++) {
+    expected.emplace_back(ValueIsNull(i) ? INT64_MIN : values_[i],
+                          -static_cast<int64_t>(i));
+  }
+  std::sort(expected.begin(), expected.end());
+  const uint64_t k = 2000;
+
+  auto check = [&](const execution::ResultCollector &result) {
+    ASSERT_EQ(result.NumRows(), k);
+    const execution::RowBuffer *rows = result.Rows();
+    for (uint64_t row = 0; row < k; row++) {
+      EXPECT_EQ(rows->IsNull(0, row), expected[row].first == INT64_MIN);
+      if (!rows->IsNull(0, row)) {
+        EXPECT_EQ(rows->ReadInteger(0, row), expected[row].first);
+      }
+      EXPECT_EQ(rows->ReadInteger(1, row), -expected[row].second);
+    }
+  };
+
+  std::vector<execution::SortKey> keys{{0, true}, {1, false}};
+  execution::ResultCollector top_k;
+  execution::Sort top_k_sort(keys, &top_k, k);
+  execution::TableScan(&table, 0, {2, 1}, {}, &top_k_sort).Run(&scheduler);
+  check(top_k);
+
+  execution::ResultCollector limited;
+  execution::Limit limit(k, &limited);
+  execution::Sort full_sort(keys, &limit);
+  execution::TableScan(&table, 0, {2, 1}, {}, &full_sort).Run(&scheduler);
+  check(limited);
+}
+
+// Batches hold the version of every tuple visible at the scan's timestamp.
+TEST_F(ExecutionTests, ScanSeesSnapshot) {
+  storage::DataTable table(block_store_, layout_);
+  const uint32_t num_rows = layout_.num_slots_ * 2;
+  Load(&table, num_rows);
+
+  std::vector<uint16_t> col_ids{1};
+  std::vector<byte> redo_buffer(storage::ProjectedRow::Size(layout_, col_ids));
+  auto *redo = storage::ProjectedRow::InitializeProjectedRow(
+      redo_buffer.data(), layout_, col_ids);
+  *reinterpret_cast<int64_t *>(redo->AccessForceNotNull(0)) = -1;
+  std::vector<std::unique_ptr<byte[]>> undo_buffers;
+  for (uint32_t i = 0; i < num_rows; i += 10) {
+    undo_buffers.emplace_back(
+        new byte[storage::DeltaRecord::Size(layout_, col_ids)]);
+    auto *undo = storage::DeltaRecord::InitializeDeltaRecord(
+        undo_buffers.back().get(), 10, layout_, col_ids);
+    ASSERT_TRUE(table.Update(slots_[i], *redo, undo));
+  }
+
+  auto sum_keys = [&](timestamp_t timestamp) {
+    execution::ResultCollector result;
+    execution::HashAggregate sum(
+        {}, {{AggregateType::SUM, 0}, {AggregateType::MIN, 0}}, &result);
+    execution::TableScan(&table, timestamp, {1}, {}, &sum).Run();
+    return std::make_pair(result.Rows()->ReadInteger(0, 0),
+                          result.Rows()->ReadInteger(1, 0));
+  };
+  int64_t all = static_cast<int64_t>(num_rows) * (num_rows - 1) / 2;
+  int64_t updated = 0, num_updated = 0;
+  for (uint32_t i = 0; i < num_rows; i += 10) {
+    updated += i;
+    num_updated++;
+  }
+  EXPECT_EQ(sum_keys(5), std::make_pair(all, int64_t{0}));
+  EXPECT_EQ(sum_keys(10), std::make_pair(all - updated - num_updated,
+                                         int64_t{-1}));
+}
+} // namespace noisepage
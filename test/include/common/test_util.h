@@ -1,8 +1,12 @@
 #pragma once
 
+#include "storage/storage_defs.h"
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <random>
 #include <thread>
+#include <vector>
 
 namespace noisepage {
 namespace testutil {
@@ -23,5 +27,49 @@ void RunThreadUntilFinish(uint32_t num_threads,
     thread.join();
   }
 }
+
+// 未提交的时间戳最高位是1
+/**
+ * The timestamp an uncommitted transaction txn_id stamps on its undo
+ * records: readers at any snapshot apply them.
+ */
+inline timestamp_t Uncommitted(uint64_t txn_id) {
+  return timestamp_t(1) << 63 | txn_id;
+}
+
+/**
+ * Hands out zeroed undo records that live as long as this object does, so
+ * keep it around longer than the tables linking them. Thread-safe. Used by
+ * every storage test that builds version chains by hand, starting with the
+ * zone map tests.
+ */
+class UndoBuffers {
+public:
+  storage::DeltaRecord *
+  NewUndo(timestamp_t timestamp,
+          const storage::ProjectedRowInitializer &initializer) {
+    return storage::DeltaRecord::InitializeDeltaRecord(
+        Allocate(storage::DeltaRecord::Size(initializer)), timestamp,
+        initializer);
+  }
+
+  storage::DeltaRecord *NewUndo(timestamp_t timestamp,
+                                const storage::BlockLayout &layout,
+                                const std::vector<uint16_t> &col_ids) {
+    return storage::DeltaRecord::InitializeDeltaRecord(
+        Allocate(storage::DeltaRecord::Size(layout, col_ids)), timestamp,
+        layout, col_ids);
+  }
+
+private:
+  std::mutex latch_;
+  std::vector<std::unique_ptr<byte[]>> buffers_;
+
+  byte *Allocate(uint32_t size) {
+    std::lock_guard<std::mutex> lock(latch_);
+    buffers_.emplace_back(new byte[size]());
+    return buffers_.back().get();
+  }
+};
 } // namespace testutil
 } // namespace noisepage
@@ -11,8 +11,8 @@ template <typename Random>
 storage::BlockLayout RandomLayout(Random &generator,
                                   uint16_t max_col = UINT16_MAX) {
   uint16_t num_attrs = std::uniform_int_distribution<>(2, max_col)(generator);
-  std::vector<uint8_t> possible_attr_sizes = {1, 2, 4, 8};
-  std::vector<uint8_t> attr_sizes(num_attrs);
+  std::vector<uint16_t> possible_attr_sizes = {1, 2, 4, 8};
+  std::vector<uint16_t> attr_sizes(num_attrs);
   attr_sizes[0] = 8; // 第一个attr总是version_ptr
   for (auto i = 1; i < num_attrs; i++) {
     auto it = UniformRandomElement(possible_attr_sizes, generator);
@@ -50,8 +50,11 @@ void PrintRow(storage::ProjectedRow *row, const storage::BlockLayout &layout) {
     uint16_t col_id = row->ColumnIds()[i];
     byte *out = row->AccessWithNullCheck(i);
     if (out) {
-      printf("col_id: %u is %lx \n", col_id,
-             storage::StorageUtil::ReadBytes(layout.attr_sizes_[col_id], out));
+      printf("col_id: %u is", col_id);
+      for (uint16_t j = 0; j < layout.attr_sizes_[col_id]; j++) {
+        printf(" %02x", static_cast<uint8_t>(out[j]));
+      }
+      printf("\n");
     } else {
       printf("col_id: %u is NULL\n", col_id);
     }
@@ -96,7 +99,7 @@ bool ProjectionListEqual(const storage::BlockLayout &layout,
 
   for (uint16_t i = 0; i < one.NumColumns(); i++) {
     uint16_t col_id = one.ColumnIds()[i];
-    uint8_t attr_size = layout.attr_sizes_[col_id];
+    uint16_t attr_size = layout.attr_sizes_[col_id];
     auto *one_pos = one.AccessWithNullCheck(i);
     auto *other_pos = other.AccessWithNullCheck(i);
 
@@ -108,10 +111,9 @@ bool ProjectionListEqual(const storage::BlockLayout &layout,
       }
     }
 
-    uint64_t one_val = storage::StorageUtil::ReadBytes(attr_size, one_pos);
-    uint64_t other_val = storage::StorageUtil::ReadBytes(attr_size, other_pos);
-    EXPECT_EQ(one_val, other_val);
-    if (one_val != other_val)
+    bool equal = memcmp(one_pos, other_pos, attr_size) == 0;
+    EXPECT_TRUE(equal);
+    if (!equal)
       return false;
   }
   return true;
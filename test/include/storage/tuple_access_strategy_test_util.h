@@ -14,7 +14,7 @@ template <typename Random>
 void RandomTupleContent(const storage::BlockLayout &layout, byte *contents,
                         Random &generator) {
   std::uniform_int_distribution<uint8_t> dist(0, UINT8_MAX);
-  for (uint16_t i = 0; i < layout.num_cols_; i++) {
+  for (uint32_t i = 0; i < layout.tuple_size_; i++) {
     contents[i] = static_cast<byte>(dist(generator));
   }
 }
@@ -33,9 +33,8 @@ struct FakeRawTuple {
 
   ~FakeRawTuple() { delete[] contents_; }
 
-  uint64_t Attribute(uint16_t col_id) const {
-    byte *pos = contents_ + attr_offsets_[col_id];
-    return storage::StorageUtil::ReadBytes(layout_.attr_sizes_[col_id], pos);
+  const byte *Attribute(uint16_t col_id) const {
+    return contents_ + attr_offsets_[col_id];
   }
 
   const storage::BlockLayout layout_;
@@ -49,8 +48,8 @@ void InsertTuple(const FakeRawTuple &tuple, const storage::BlockLayout &layout,
   storage::TupleSlot slot(block, offset);
   for (uint16_t i = 0; i < layout.num_cols_; i++) {
     auto *pos = tested.AccessForceNotNull(slot, i);
-    uint64_t val = tuple.Attribute(i);
-    storage::StorageUtil::WriteBytes(layout.attr_sizes_[i], val, pos);
+    storage::StorageUtil::CopyBytes(layout.attr_sizes_[i], tuple.Attribute(i),
+                                    pos);
   }
 }
 
@@ -0,0 +1,268 @@
+#include "storage/block_compressor.h"
+#include "storage/data_table.h"
+#include "storage/storage_test_util.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <random>
+#include <thread>
+
+namespace noisepage {
+struct BlockCompressorTests : public ::testing::Test {
+  storage::BlockStore block_store_{10};
+  // version ptr, sequential key, long runs, three distinct values, random
+  // values and a column that is always null
+  storage::BlockLayout layout_{6, {8, 8, 4, 8, 8, 8}};
+  std::vector<uint16_t> col_ids_{
+      testutil::ProjectionListAllColumns(layout_)};
+  uint32_t redo_size_ = storage::ProjectedRow::Size(layout_, col_ids_);
+  std::vector<byte *> loose_pointers_;
+  testutil::UndoBuffers undos_;
+  std::default_random_engine generator_;
+
+  void TearDown() override {
+    for (auto *ptr : loose_pointers_) {
+      delete[] ptr;
+    }
+  }
+
+  storage::ProjectedRow *NewRow(int64_t key) {
+    byte *buffer = new byte[redo_size_];
+    loose_pointers_.push_back(buffer);
+    memset(buffer, 0, redo_size_);
+    auto *row = storage::ProjectedRow::InitializeProjectedRow(buffer, layout_,
+                                                              col_ids_);
+    const int64_t distinct[] = {-1000000000000, 5, 7000000000000000};
+    std::uniform_int_distribution<int64_t> dist(INT64_MIN, INT64_MAX);
+    storage::StorageUtil::WriteBytes(8, static_cast<uint64_t>(key),
+                                     row->AccessForceNotNull(0));
+    storage::StorageUtil::WriteBytes(4, static_cast<uint32_t>(key / 1000),
+                                     row->AccessForceNotNull(1));
+    storage::StorageUtil::WriteBytes(
+        8, static_cast<uint64_t>(distinct[key * 7 % 3]),
+        row->AccessForceNotNull(2));
+    storage::StorageUtil::WriteBytes(8, static_cast<uint64_t>(dist(generator_)),
+                                     row->AccessForceNotNull(3));
+    row->SetNull(4);
+    return row;
+  }
+
+  storage::DeltaRecord *NewUndo(timestamp_t timestamp) {
+    return undos_.NewUndo(timestamp, layout_, col_ids_);
+  }
+
+  // 返回所有可见tuple的全部列，按key排序
+  std::vector<std::vector<int64_t>>
+  ScanRows(storage::DataTable *table, timestamp_t timestamp,
+           const std::vector<storage::ColumnPredicate> &predicates) {
+    std::vector<byte> buffer(redo_size_);
+    auto *row = storage::ProjectedRow::InitializeProjectedRow(
+        buffer.data(), layout_, col_ids_);
+    std::vector<std::vector<int64_t>> rows;
+    table->Scan(
+        timestamp, predicates, row,
+        [&](const storage::TupleSlot &, const storage::ProjectedRow &result) {
+          std::vector<int64_t> values;
+          for (uint16_t i = 0; i < result.NumColumns(); i++) {
+            const byte *attr = result.AccessWithNullCheck(i);
+            values.push_back(attr == nullptr
+                                 ? INT64_MIN
+                                 : storage::StorageUtil::ReadInteger(
+                                       layout_.attr_sizes_[col_ids_[i]],
+                                       attr));
+          }
+          rows.push_back(values);
+        });
+    std::sort(rows.begin(), rows.end());
+    return rows;
+  }
+
+  std::vector<int64_t> SelectRow(storage::DataTable *table,
+                                 const storage::TupleSlot &slot) {
+    std::vector<byte> buffer(redo_size_);
+    auto *row = storage::ProjectedRow::InitializeProjectedRow(
+        buffer.data(), layout_, col_ids_);
+    table->Select(10, slot, row);
+    std::vector<int64_t> values;
+    for (uint16_t i = 0; i < row->NumColumns(); i++) {
+      const byte *attr = row->AccessWithNullCheck(i);
+      values.push_back(attr == nullptr
+                           ? INT64_MIN
+                           : storage::StorageUtil::ReadInteger(
+                                 layout_.attr_sizes_[col_ids_[i]], attr));
+    }
+    return values;
+  }
+};
+
+// Each column gets the encoding that suits its data, and the encoded block is
+// much smaller than the value arrays it replaces.
+TEST_F(BlockCompressorTests, ChoosesEncodingPerColumn) {
+  storage::DataTable table(block_store_, layout_);
+  std::vector<storage::TupleSlot> slots;
+  for (int64_t key = 0; key < layout_.num_slots_ + 1; key++) {
+    slots.push_back(table.Insert(*NewRow(key), NewUndo(0)));
+  }
+  storage::RawBlock *block = slots[0].GetBlock();
+  ASSERT_NE(block, slots.back().GetBlock());
+
+  // only frozen blocks can be compressed
+  EXPECT_FALSE(table.CompressBlock(block));
+  ASSERT_TRUE(table.FreezeBlock(block, 1));
+  ASSERT_TRUE(table.CompressBlock(block));
+
+  auto *header = reinterpret_cast<storage::Block *>(block);
+  EXPECT_EQ(header->state_.load(), storage::BlockState::COMPRESSED);
+  const storage::CompressedColumn *columns = header->compressed_->Columns();
+  // 冻结之后版本指针全是null，只有一个run
+  EXPECT_EQ(columns[0].encoding_, storage::ColumnEncoding::RUN_LENGTH);
+  EXPECT_EQ(columns[0].num_entries_, 1);
+  EXPECT_EQ(columns[1].encoding_, storage::ColumnEncoding::FRAME_OF_REFERENCE);
+  EXPECT_EQ(columns[1].base_, 0);
+  EXPECT_EQ(columns[2].encoding_, storage::ColumnEncoding::RUN_LENGTH);
+  EXPECT_EQ(columns[3].encoding_, storage::ColumnEncoding::DICTIONARY);
+  EXPECT_EQ(columns[3].num_entries_, 3);
+  EXPECT_EQ(columns[3].bit_width_, 2);
+  EXPECT_EQ(columns[4].encoding_, storage::ColumnEncoding::PLAIN);
+  EXPECT_EQ(columns[5].encoding_, storage::ColumnEncoding::RUN_LENGTH);
+
+  uint64_t plain_size = 0;
+  for (uint16_t col_id = 0; col_id < layout_.num_cols_; col_id++) {
+    plain_size += layout_.num_slots_ * layout_.attr_sizes_[col_id];
+  }
+  EXPECT_LT(header->compressed_->size_, plain_size / 2);
+}
+
+// Point reads and scans see the same data before and after compression, and
+// writing to a compressed block decompresses it first.
+TEST_F(BlockCompressorTests, ReadsAndWritesThroughCompression) {
+  storage::DataTable table(block_store_, layout_);
+  std::vector<storage::TupleSlot> slots;
+  for (int64_t key = 0; key < 2 * layout_.num_slots_; key++) {
+    slots.push_back(table.Insert(*NewRow(key), NewUndo(0)));
+  }
+  storage::RawBlock *block = slots[0].GetBlock();
+
+  std::vector<std::vector<storage::ColumnPredicate>> queries{
+      {},
+      {{1, storage::PredicateType::BETWEEN, 100, 5000}},
+      {{2, storage::PredicateType::GREATER_EQUAL, 3},
+       {3, storage::PredicateType::EQUAL, 5}},
+      {{3, std::vector<int64_t>{5, 7000000000000000, 42}}},
+      {{4, storage::PredicateType::LESS, 0}},
+      {{5, storage::PredicateType::LESS, 0}}};
+  std::vector<std::vector<std::vector<int64_t>>> expected;
+  for (const auto &query : queries) {
+    expected.push_back(ScanRows(&table, 1, query));
+  }
+  std::vector<std::vector<int64_t>> expected_rows;
+  for (const auto &slot : slots) {
+    expected_rows.push_back(SelectRow(&table, slot));
+  }
+
+  ASSERT_TRUE(table.FreezeBlock(block, 1));
+  ASSERT_TRUE(table.CompressBlock(block));
+  for (uint32_t i = 0; i < queries.size(); i++) {
+    EXPECT_EQ(ScanRows(&table, 1, queries[i]), expected[i]);
+  }
+  for (uint32_t i = 0; i < slots.size(); i++) {
+    EXPECT_EQ(SelectRow(&table, slots[i]), expected_rows[i]);
+  }
+
+  EXPECT_TRUE(table.Update(slots[5], *NewRow(-5), NewUndo(2)));
+  EXPECT_EQ(reinterpret_cast<storage::Block *>(block)->state_.load(),
+            storage::BlockState::HOT);
+  EXPECT_EQ(SelectRow(&table, slots[5])[0], -5);
+  for (uint32_t i = 0; i < slots.size(); i++) {
+    if (i != 5) {
+      EXPECT_EQ(SelectRow(&table, slots[i]), expected_rows[i]);
+    }
+  }
+  // 旧版本还在undo链上
+  EXPECT_EQ(ScanRows(&table, 1, queries[0]), expected[0]);
+}
+
+// Every column decodes into the buffer it is given, so decoding one does not
+// overwrite what an earlier decode returned.
+TEST_F(BlockCompressorTests, DecodesIntoCallerBuffer) {
+  storage::DataTable table(block_store_, layout_);
+  std::vector<storage::TupleSlot> slots;
+  for (int64_t key = 0; key < layout_.num_slots_ + 1; key++) {
+    slots.push_back(table.Insert(*NewRow(key), NewUndo(0)));
+  }
+  storage::RawBlock *block = slots[0].GetBlock();
+  ASSERT_TRUE(table.FreezeBlock(block, 1));
+  ASSERT_TRUE(table.CompressBlock(block));
+
+  const storage::CompressedBlock *compressed =
+      reinterpret_cast<storage::Block *>(block)->compressed_;
+  uint64_t key = 0, key_div = 0;
+  compressed->AttrAt(layout_, 1, 1234, reinterpret_cast<byte *>(&key));
+  compressed->AttrAt(layout_, 2, 1234, reinterpret_cast<byte *>(&key_div));
+  EXPECT_EQ(key, 1234);
+  EXPECT_EQ(key_div, 1);
+}
+
+// Readers that found the block frozen may still be inside its value arrays
+// when it gets compressed, so they must keep seeing the data while writers
+// keep decompressing it again.
+TEST_F(BlockCompressorTests, ReadersDuringCompression) {
+  storage::DataTable table(block_store_, layout_);
+  std::vector<storage::TupleSlot> slots;
+  for (int64_t key = 0; key < layout_.num_slots_ + 1; key++) {
+    slots.push_back(table.Insert(*NewRow(key), NewUndo(0)));
+  }
+  storage::RawBlock *block = slots[0].GetBlock();
+  const timestamp_t read_timestamp = 1000000;
+
+  std::atomic<bool> done{false};
+  std::atomic<uint32_t> errors{0};
+  auto reader = [&](uint32_t id) {
+    std::vector<byte> buffer(redo_size_);
+    auto *row = storage::ProjectedRow::InitializeProjectedRow(
+        buffer.data(), layout_, col_ids_);
+    std::default_random_engine generator(id);
+    std::uniform_int_distribution<uint32_t> dist(0, layout_.num_slots_ - 1);
+    while (!done.load()) {
+      uint32_t i = dist(generator);
+      table.Select(read_timestamp, slots[i], row);
+      if (row->AccessWithNullCheck(0) == nullptr ||
+          storage::StorageUtil::ReadInteger(8, row->AccessWithNullCheck(0)) !=
+              i ||
+          storage::StorageUtil::ReadInteger(4, row->AccessWithNullCheck(1)) !=
+              i / 1000) {
+        errors++;
+      }
+      uint32_t seen = 0;
+      table.Scan(read_timestamp, {}, row,
+                 [&](const storage::TupleSlot &slot,
+                     const storage::ProjectedRow &result) {
+                   uint64_t key = storage::StorageUtil::ReadInteger(
+                       8, result.AccessWithNullCheck(0));
+                   if (key >= slots.size() || slot != slots[key]) {
+                     errors++;
+                   }
+                   seen++;
+                 });
+      if (seen != slots.size()) {
+        errors++;
+      }
+    }
+  };
+  std::vector<std::thread> readers;
+  for (uint32_t id = 0; id < 4; id++) {
+    readers.emplace_back(reader, id);
+  }
+  for (timestamp_t timestamp = 1; timestamp < 200; timestamp++) {
+    // 每轮写一行把block解压回来，内容不变
+    int64_t key = static_cast<int64_t>(timestamp * 37 % layout_.num_slots_);
+    ASSERT_TRUE(table.FreezeBlock(block, timestamp));
+    ASSERT_TRUE(table.CompressBlock(block));
+    ASSERT_TRUE(table.Update(slots[key], *NewRow(key), NewUndo(timestamp)));
+  }
+  done = true;
+  for (auto &thread : readers) {
+    thread.join();
+  }
+  EXPECT_EQ(errors.load(), 0);
+}
+} // namespace noisepage
@@ -0,0 +1,88 @@
+#include "storage/storage_test_util.h"
+#include "storage/tuple_access_strategy.h"
+#include "storage/tuple_access_strategy_test_util.h"
+#include "gtest/gtest.h"
+#include <unordered_map>
+#include <unordered_set>
+
+namespace noisepage {
+struct BlockDirectoryTests : public ::testing::Test {
+  storage::BlockStore block_store_{10};
+  storage::BlockDirectory &directory_ = storage::BlockDirectory::Get();
+};
+
+// Ids are never 0, unique while registered, and reused once freed.
+TEST_F(BlockDirectoryTests, RegisterAndReuse) {
+  EXPECT_EQ(storage::TupleSlot().GetBlock(), nullptr);
+  std::vector<storage::RawBlock *> blocks;
+  std::unordered_set<uint32_t> block_ids;
+  for (uint32_t i = 0; i < 10; i++) {
+    blocks.push_back(block_store_.Get(storage::MIN_BLOCK_SIZE));
+    uint32_t block_id = directory_.Register(blocks.back());
+    EXPECT_NE(block_id, 0);
+    EXPECT_TRUE(block_ids.insert(block_id).second);
+    EXPECT_EQ(directory_.Resolve(block_id), blocks.back());
+  }
+  for (uint32_t block_id : block_ids) {
+    directory_.Unregister(block_id);
+    EXPECT_EQ(directory_.Resolve(block_id), nullptr);
+  }
+  for (storage::RawBlock *block : blocks) {
+    EXPECT_EQ(block_ids.count(directory_.Register(block)), 1);
+  }
+  for (uint32_t block_id : block_ids) {
+    directory_.Unregister(block_id);
+  }
+  for (storage::RawBlock *block : blocks) {
+    block_store_.Release(block, storage::MIN_BLOCK_SIZE);
+  }
+}
+
+// A block copied somewhere else and relocated is read and written through
+// the slots taken before the move; the old copy is never touched again.
+TEST_F(BlockDirectoryTests, RelocateKeepsSlots) {
+  std::default_random_engine generator;
+  storage::BlockLayout layout = testutil::RandomLayout(generator);
+  storage::TupleAccessStrategy tested(layout);
+  storage::RawBlock *from = block_store_.Get(layout.block_size_);
+  uint32_t block_id = directory_.Register(from);
+  storage::InitializeRawBlock(from, layout, block_id);
+
+  std::unordered_map<uint32_t, testutil::FakeRawTuple> tuples;
+  std::vector<storage::TupleSlot> slots;
+  for (uint32_t i = 0; i < 100 && i + 1 < layout.num_slots_; i++) {
+    testutil::TryInsertFakeTuple(layout, tested, from, tuples, generator);
+  }
+  for (const auto &tuple : tuples) {
+    slots.emplace_back(from, tuple.first);
+  }
+
+  storage::RawBlock *to = block_store_.Get(layout.block_size_);
+  std::memcpy(reinterpret_cast<byte *>(to), reinterpret_cast<byte *>(from),
+              layout.block_size_);
+  ASSERT_TRUE(directory_.Relocate(block_id, from, to));
+  // 原来的地方写成垃圾，读到旧副本就会错
+  std::memset(reinterpret_cast<byte *>(from), 0xFF, layout.block_size_);
+  for (const auto &slot : slots) {
+    EXPECT_EQ(slot.GetBlock(), to);
+    const testutil::FakeRawTuple &tuple = tuples.at(slot.GetOffset());
+    for (uint16_t col_id = 0; col_id < layout.num_cols_; col_id++) {
+      EXPECT_EQ(std::memcmp(tuple.Attribute(col_id),
+                            tested.AccessWithNullCheck(slot, col_id),
+                            layout.attr_sizes_[col_id]),
+                0);
+    }
+  }
+  testutil::TryInsertFakeTuple(layout, tested, to, tuples, generator);
+  EXPECT_EQ(to->BlockId(), block_id);
+  EXPECT_EQ(storage::TupleSlot(to, slots[0].GetOffset()), slots[0]);
+
+  // 已经搬走了，再从from搬一次会失败
+  EXPECT_FALSE(directory_.Relocate(block_id, from, from));
+  EXPECT_EQ(directory_.Resolve(block_id), to);
+
+  directory_.Unregister(block_id);
+  block_store_.Release(from, layout.block_size_);
+  block_store_.Release(to, layout.block_size_);
+}
+} // namespace noisepage
@@ -0,0 +1,115 @@
+#include "storage/data_table.h"
+#include "storage/storage_test_util.h"
+#include "gtest/gtest.h"
+#include <random>
+
+namespace noisepage {
+struct BlockStoreTests : public ::testing::Test {
+  storage::BlockStore block_store_{10};
+};
+
+// Every supported block size comes back aligned to itself, and a TupleSlot
+// into it decodes to the same block and offset.
+TEST_F(BlockStoreTests, TupleSlotRoundTrip) {
+  std::default_random_engine generator;
+  for (uint32_t block_size = storage::MIN_BLOCK_SIZE;
+       block_size <= storage::MAX_BLOCK_SIZE; block_size <<= 1) {
+    storage::RawBlock *block = block_store_.Get(block_size);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(block) & (block_size - 1), 0);
+    uint32_t block_id = storage::BlockDirectory::Get().Register(block);
+    EXPECT_NE(block_id, 0);
+
+    std::uniform_int_distribution<uint32_t> dist;
+    for (uint32_t offset : {0u, UINT32_MAX, dist(generator)}) {
+      storage::TupleSlot slot(block_id, offset);
+      EXPECT_EQ(slot.GetBlock(), block);
+      EXPECT_EQ(slot.GetBlockId(), block_id);
+      EXPECT_EQ(slot.GetOffset(), offset);
+    }
+    storage::BlockDirectory::Get().Unregister(block_id);
+    block_store_.Release(block, block_size);
+    // 同样大小的block会被复用
+    EXPECT_EQ(block_store_.Get(block_size), block);
+    block_store_.Release(block, block_size);
+  }
+}
+
+// A small table with 16-byte attributes in 64 KB blocks: values wider than a
+// machine word round-trip through inserts, updates, version chains and
+// compression.
+TEST_F(BlockStoreTests, WideAttributesInSmallBlocks) {
+  storage::BlockLayout layout(3, {8, 8, 16}, storage::MIN_BLOCK_SIZE);
+  EXPECT_GT(layout.num_slots_, 0);
+  EXPECT_LT(layout.num_slots_ * layout.tuple_size_, storage::MIN_BLOCK_SIZE);
+
+  std::vector<uint16_t> col_ids{testutil::ProjectionListAllColumns(layout)};
+  uint32_t redo_size = storage::ProjectedRow::Size(layout, col_ids);
+  uint32_t undo_size = storage::DeltaRecord::Size(layout, col_ids);
+  std::vector<byte *> loose_pointers;
+  std::default_random_engine generator;
+  auto new_row = [&](int64_t key) {
+    byte *buffer = new byte[redo_size];
+    loose_pointers.push_back(buffer);
+    auto *row =
+        storage::ProjectedRow::InitializeProjectedRow(buffer, layout, col_ids);
+    storage::StorageUtil::WriteBytes(8, static_cast<uint64_t>(key),
+                                     row->AccessForceNotNull(0));
+    testutil::FillWithRandomBytes(16, row->AccessForceNotNull(1), generator);
+    return row;
+  };
+  auto new_undo = [&](timestamp_t timestamp) {
+    byte *buffer = new byte[undo_size];
+    loose_pointers.push_back(buffer);
+    return storage::DeltaRecord::InitializeDeltaRecord(buffer, timestamp,
+                                                       layout, col_ids);
+  };
+
+  {
+    storage::DataTable table(block_store_, layout);
+    std::vector<storage::TupleSlot> slots;
+    std::vector<storage::ProjectedRow *> rows;
+    for (int64_t key = 0; key < 3 * layout.num_slots_; key++) {
+      rows.push_back(new_row(key));
+      slots.push_back(table.Insert(*rows.back(), new_undo(0)));
+    }
+    EXPECT_NE(slots.front().GetBlock(), slots.back().GetBlock());
+
+    std::vector<byte> buffer(redo_size);
+    auto *out = storage::ProjectedRow::InitializeProjectedRow(buffer.data(),
+                                                              layout, col_ids);
+    auto *updated = new_row(-1);
+    EXPECT_TRUE(table.Update(slots[1], *updated, new_undo(2)));
+    table.Select(1, slots[1], out);
+    EXPECT_TRUE(testutil::ProjectionListEqual(layout, *out, *rows[1]));
+    table.Select(2, slots[1], out);
+    EXPECT_TRUE(testutil::ProjectionListEqual(layout, *out, *updated));
+    rows[1] = updated;
+
+    // 宽的列在压缩之后原样保存
+    ASSERT_TRUE(table.FreezeBlock(slots[1].GetBlock(), 2));
+    ASSERT_TRUE(table.CompressBlock(slots[1].GetBlock()));
+    auto *compressed =
+        reinterpret_cast<storage::Block *>(slots[1].GetBlock())->compressed_;
+    EXPECT_EQ(compressed->Columns()[2].encoding_,
+              storage::ColumnEncoding::PLAIN);
+    for (uint32_t i = 0; i < slots.size(); i++) {
+      table.Select(2, slots[i], out);
+      EXPECT_TRUE(testutil::ProjectionListEqual(layout, *out, *rows[i]));
+    }
+
+    std::vector<int64_t> keys;
+    table.Scan(2, {{1, storage::PredicateType::LESS, 10}}, out,
+               [&](const storage::TupleSlot &,
+                   const storage::ProjectedRow &row) {
+                 keys.push_back(storage::StorageUtil::ReadInteger(
+                     8, row.AccessWithNullCheck(0)));
+               });
+    std::sort(keys.begin(), keys.end());
+    EXPECT_EQ(keys, (std::vector<int64_t>{-1, 0, 2, 3, 4, 5, 6, 7, 8, 9}));
+  }
+
+  for (auto *ptr : loose_pointers) {
+    delete[] ptr;
+  }
+}
+} // namespace noisepage
@@ -0,0 +1,248 @@
+#include "common/test_util.h"
+#include "storage/bulk_loader.h"
+#include "storage/data_table.h"
+#include "storage/storage_test_util.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <random>
+#include <thread>
+#include <unordered_map>
+
+namespace noisepage {
+struct BulkLoaderTests : public ::testing::Test {
+  storage::BlockStore block_store_{10};
+  std::default_random_engine generator_;
+  std::uniform_real_distribution<double> null_ratio_{0.0, 1.0};
+};
+
+// Bulk-loaded rows read back exactly like the columnar input at every
+// timestamp, blocks that were filled come out frozen, and the partially
+// filled last block keeps taking inserts.
+TEST_F(BulkLoaderTests, BulkLoadSelect) {
+  const uint32_t repeat = 10;
+  const uint16_t max_col = 20;
+  std::vector<uint16_t> possible_attr_sizes{1, 2, 4, 8, 16};
+  for (uint32_t i = 0; i < repeat; i++) {
+    auto num_cols =
+        std::uniform_int_distribution<uint16_t>(3, max_col)(generator_);
+    std::vector<uint16_t> attr_sizes{8};
+    for (uint16_t col_id = 1; col_id < num_cols; col_id++) {
+      attr_sizes.push_back(
+          *testutil::UniformRandomElement(possible_attr_sizes, generator_));
+    }
+    storage::BlockLayout layout(num_cols, attr_sizes, storage::MIN_BLOCK_SIZE);
+    storage::DataTable table(block_store_, layout);
+
+    // 最后一列不给，应该都是null
+    auto num_rows = static_cast<uint32_t>(
+        layout.num_slots_ * 2 +
+        std::uniform_int_distribution<uint32_t>(1, layout.num_slots_ - 1)(
+            generator_));
+    std::bernoulli_distribution coin(1 - null_ratio_(generator_));
+    std::vector<std::vector<byte>> values(num_cols);
+    std::vector<std::vector<uint8_t>> present(num_cols);
+    std::vector<storage::BulkLoadColumn> columns;
+    for (uint16_t col_id = 1; col_id + 1 < num_cols; col_id++) {
+      values[col_id].resize(num_rows * attr_sizes[col_id]);
+      testutil::FillWithRandomBytes(
+          static_cast<uint32_t>(values[col_id].size()), values[col_id].data(),
+          generator_);
+      present[col_id].resize(BitmapSize(num_rows));
+      for (uint32_t row = 0; row < num_rows; row++) {
+        if (coin(generator_)) {
+          present[col_id][row / BYTE_SIZE] |= ONE_HOT_MASK(row % BYTE_SIZE);
+        }
+      }
+      // 有一列不带bitmap，全都不是null
+      columns.push_back({col_id, values[col_id].data(),
+                         col_id == 1 ? nullptr : present[col_id].data()});
+    }
+    std::vector<storage::TupleSlot> slots;
+    storage::BulkLoader::BulkLoad(&table, columns, num_rows, &slots);
+    ASSERT_EQ(slots.size(), num_rows);
+
+    std::vector<uint16_t> col_ids = testutil::ProjectionListAllColumns(layout);
+    std::vector<byte> buffer(storage::ProjectedRow::Size(layout, col_ids));
+    auto *row = storage::ProjectedRow::InitializeProjectedRow(buffer.data(),
+                                                              layout, col_ids);
+    for (uint32_t r = 0; r < num_rows; r++) {
+      EXPECT_EQ(slots[r].GetBlock(), slots[r / layout.num_slots_ *
+                                           layout.num_slots_]
+                                         .GetBlock());
+      for (timestamp_t timestamp : {timestamp_t(0), timestamp_t(UINT64_MAX)}) {
+        table.Select(timestamp, slots[r], row);
+        for (uint16_t j = 0; j < row->NumColumns(); j++) {
+          uint16_t col_id = row->ColumnIds()[j];
+          const byte *attr = row->AccessWithNullCheck(j);
+          bool is_present =
+              col_id == 1 ||
+              (col_id + 1 < num_cols &&
+               present[col_id][r / BYTE_SIZE] & ONE_HOT_MASK(r % BYTE_SIZE));
+          ASSERT_EQ(attr != nullptr, is_present);
+          if (is_present) {
+            EXPECT_EQ(std::memcmp(attr,
+                                  &values[col_id][r * attr_sizes[col_id]],
+                                  attr_sizes[col_id]),
+                      0);
+          }
+        }
+      }
+    }
+
+    auto *full = reinterpret_cast<storage::Block *>(
+        slots[layout.num_slots_].GetBlock());
+    EXPECT_EQ(full->state_.load(), storage::BlockState::FROZEN);
+    std::vector<byte> redo_buffer(storage::ProjectedRow::Size(layout, col_ids));
+    auto *redo = storage::ProjectedRow::InitializeProjectedRow(
+        redo_buffer.data(), layout, col_ids);
+    std::vector<byte> undo_buffer(storage::DeltaRecord::Size(layout, col_ids));
+    auto *undo = storage::DeltaRecord::InitializeDeltaRecord(
+        undo_buffer.data(), 0, layout, col_ids);
+    EXPECT_EQ(table.Insert(*redo, undo).GetBlock(),
+              slots.back().GetBlock());
+  }
+}
+
+// Zone maps of bulk-loaded blocks are exact, so scans prune them and find
+// the same rows as a full pass over the input.
+TEST_F(BulkLoaderTests, BulkLoadScan) {
+  storage::BlockLayout layout(3, {8, 8, 4}, storage::MIN_BLOCK_SIZE);
+  storage::DataTable table(block_store_, layout);
+  const uint32_t num_rows = layout.num_slots_ * 5 + 3;
+  std::vector<int64_t> keys(num_rows);
+  std::vector<int32_t> values(num_rows);
+  for (uint32_t i = 0; i < num_rows; i++) {
+    keys[i] = i;
+    values[i] = static_cast<int32_t>(generator_() % 100);
+  }
+  storage::BulkLoader::BulkLoad(
+      &table,
+      {{1, reinterpret_cast<const byte *>(keys.data())},
+       {2, reinterpret_cast<const byte *>(values.data())}},
+      num_rows);
+
+  std::vector<uint16_t> col_ids{1, 2};
+  std::vector<byte> buffer(storage::ProjectedRow::Size(layout, col_ids));
+  auto *out = storage::ProjectedRow::InitializeProjectedRow(buffer.data(),
+                                                            layout, col_ids);
+  int64_t lo = layout.num_slots_ + 10, hi = 2 * layout.num_slots_ + 10;
+  uint32_t expected = 0;
+  for (int64_t key = lo; key <= hi; key++) {
+    expected += values[key] < 50;
+  }
+  uint32_t matched = 0;
+  uint32_t blocks_read = table.Scan(
+      0,
+      {{1, storage::PredicateType::BETWEEN, lo, hi},
+       {2, storage::PredicateType::LESS, 50}},
+      out,
+      [&](const storage::TupleSlot &, const storage::ProjectedRow &row) {
+        int64_t key = *reinterpret_cast<const int64_t *>(
+            row.AccessWithNullCheck(0));
+        EXPECT_GE(key, lo);
+        EXPECT_LE(key, hi);
+        matched++;
+      });
+  EXPECT_EQ(matched, expected);
+  EXPECT_EQ(blocks_read, 2);
+}
+
+// Rows split over several loader threads come back in order, and every block
+// but the last one is full.
+TEST_F(BulkLoaderTests, ParallelBulkLoad) {
+  storage::BlockLayout layout(3, {8, 8, 2}, storage::MIN_BLOCK_SIZE);
+  storage::DataTable table(block_store_, layout);
+  const uint32_t num_rows = layout.num_slots_ * 10 + layout.num_slots_ / 2;
+  std::vector<int64_t> keys(num_rows);
+  std::vector<uint8_t> present(BitmapSize(num_rows));
+  for (uint32_t i = 0; i < num_rows; i++) {
+    keys[i] = i;
+    if (i % 3 != 0) {
+      present[i / BYTE_SIZE] |= ONE_HOT_MASK(i % BYTE_SIZE);
+    }
+  }
+  std::vector<storage::TupleSlot> slots;
+  storage::BulkLoader::ParallelBulkLoad(
+      &table,
+      {{1, reinterpret_cast<const byte *>(keys.data()), present.data()}},
+      num_rows, 4, &slots);
+  ASSERT_EQ(slots.size(), num_rows);
+
+  std::vector<uint16_t> col_ids{1, 2};
+  std::vector<byte> buffer(storage::ProjectedRow::Size(layout, col_ids));
+  auto *row = storage::ProjectedRow::InitializeProjectedRow(buffer.data(),
+                                                            layout, col_ids);
+  std::unordered_map<storage::RawBlock *, uint32_t> rows_per_block;
+  for (uint32_t i = 0; i < num_rows; i++) {
+    table.Select(0, slots[i], row);
+    const byte *key = row->AccessWithNullCheck(0);
+    ASSERT_EQ(key == nullptr, i % 3 == 0);
+    if (key != nullptr) {
+      EXPECT_EQ(*reinterpret_cast<const int64_t *>(key), i);
+    }
+    EXPECT_EQ(row->AccessWithNullCheck(1), nullptr);
+    rows_per_block[slots[i].GetBlock()]++;
+  }
+  EXPECT_EQ(rows_per_block.size(), 11);
+  EXPECT_EQ(rows_per_block[slots.back().GetBlock()], layout.num_slots_ / 2);
+
+  // 0个线程当1个
+  storage::DataTable single(block_store_, layout);
+  uint32_t no_threads = 0;
+  slots.clear();
+  storage::BulkLoader::ParallelBulkLoad(
+      &single,
+      {{1, reinterpret_cast<const byte *>(keys.data()), present.data()}}, 10,
+      no_threads, &slots);
+  EXPECT_EQ(slots.size(), 10);
+}
+
+// Scans running during a parallel load see either none or all of its rows,
+// and a loader that never commits leaves nothing behind.
+TEST_F(BulkLoaderTests, BulkLoaderCommitIsAtomic) {
+  storage::BlockLayout layout(2, {8, 8}, storage::MIN_BLOCK_SIZE);
+  storage::DataTable table(block_store_, layout);
+  const uint32_t num_threads = 4;
+  const uint32_t rows_per_thread = layout.num_slots_ * 3;
+  const uint32_t num_rows = num_threads * rows_per_thread;
+  std::vector<int64_t> keys(num_rows, 42);
+  std::vector<storage::BulkLoadColumn> columns{
+      {1, reinterpret_cast<const byte *>(keys.data())}};
+
+  std::vector<uint16_t> col_ids{1};
+  auto count_rows = [&] {
+    std::vector<byte> buffer(storage::ProjectedRow::Size(layout, col_ids));
+    auto *out = storage::ProjectedRow::InitializeProjectedRow(
+        buffer.data(), layout, col_ids);
+    uint32_t num_seen = 0;
+    table.Scan(0, {}, out,
+               [&](const storage::TupleSlot &, const storage::ProjectedRow &) {
+                 num_seen++;
+               });
+    return num_seen;
+  };
+
+  {
+    storage::BulkLoader aborted(&table);
+    aborted.Load(columns, 0, num_rows);
+  }
+  EXPECT_EQ(count_rows(), 0);
+
+  std::atomic<bool> done(false);
+  std::thread reader([&] {
+    while (!done.load()) {
+      uint32_t num_seen = count_rows();
+      EXPECT_TRUE(num_seen == 0 || num_seen == num_rows);
+    }
+  });
+  storage::BulkLoader loader(&table);
+  testutil::RunThreadUntilFinish(num_threads, [&](uint32_t id) {
+    loader.Load(columns, id * rows_per_thread, rows_per_thread);
+  });
+  EXPECT_EQ(count_rows(), 0);
+  loader.Commit();
+  EXPECT_EQ(count_rows(), num_rows);
+  done.store(true);
+  reader.join();
+}
+} // namespace noisepage
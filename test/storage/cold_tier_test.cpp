@@ -0,0 +1,252 @@
+#include "common/test_util.h"
+#include "storage/bulk_loader.h"
+#include "storage/cold_tier.h"
+#include "storage/data_table.h"
+#include "storage/storage_test_util.h"
+#include "gtest/gtest.h"
+#include <atomic>
+
+namespace noisepage {
+struct ColdTierTests : public ::testing::Test {
+  storage::BlockStore block_store_{100};
+  storage::BlockLayout layout_{3, {8, 8, 8}, storage::MIN_BLOCK_SIZE};
+  std::vector<uint16_t> col_ids_{testutil::ProjectionListAllColumns(layout_)};
+  // 只留两个frozen block在内存里
+  storage::ColdTier cold_tier_{::testing::TempDir() + "cold_tier_test",
+                               2 * layout_.block_size_};
+
+  // 第i行的两列是i和3 * i
+  std::vector<storage::TupleSlot> Load(storage::DataTable *table,
+                                       uint32_t first_row, uint32_t num_rows) {
+    std::vector<int64_t> keys(num_rows), values(num_rows);
+    for (uint32_t i = 0; i < num_rows; i++) {
+      keys[i] = first_row + i;
+      values[i] = 3 * keys[i];
+    }
+    std::vector<storage::TupleSlot> slots;
+    storage::BulkLoader::BulkLoad(
+        table,
+        {{1, reinterpret_cast<const byte *>(keys.data())},
+         {2, reinterpret_cast<const byte *>(values.data())}},
+        num_rows, &slots);
+    return slots;
+  }
+
+  bool Check(storage::DataTable *table, timestamp_t timestamp,
+             const std::vector<storage::TupleSlot> &slots) {
+    std::vector<byte> buffer(storage::ProjectedRow::Size(layout_, col_ids_));
+    auto *row = storage::ProjectedRow::InitializeProjectedRow(
+        buffer.data(), layout_, col_ids_);
+    for (uint64_t i = 0; i < slots.size(); i++) {
+      table->Select(timestamp, slots[i], row);
+      if (*reinterpret_cast<int64_t *>(row->AccessWithNullCheck(0)) !=
+              static_cast<int64_t>(i) ||
+          *reinterpret_cast<int64_t *>(row->AccessWithNullCheck(1)) !=
+              3 * static_cast<int64_t>(i)) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+// Frozen blocks beyond the budget go to the file, still read back through
+// their old slots, and take writes again.
+TEST_F(ColdTierTests, EvictsOverBudget) {
+  const uint32_t num_blocks = 9;
+  std::vector<storage::TupleSlot> slots;
+  {
+    storage::DataTable table(block_store_, layout_, &cold_tier_);
+    // 第一个block是原来的insertion head，不会freeze
+    slots = Load(&table, 0, num_blocks * layout_.num_slots_);
+    EXPECT_EQ(cold_tier_.ResidentBytes(), 2 * layout_.block_size_);
+    EXPECT_EQ(cold_tier_.EvictedBytes(),
+              (num_blocks - 3) * layout_.block_size_);
+    EXPECT_TRUE(Check(&table, 0, slots));
+    uint32_t num_matches = 0;
+    std::vector<byte> buffer(storage::ProjectedRow::Size(layout_, col_ids_));
+    table.Scan(0,
+               {storage::ColumnPredicate(1, storage::PredicateType::LESS,
+                                         1000)},
+               storage::ProjectedRow::InitializeProjectedRow(
+                   buffer.data(), layout_, col_ids_),
+               [&](const storage::TupleSlot &, const storage::ProjectedRow &) {
+                 num_matches++;
+               });
+    EXPECT_EQ(num_matches, 1000);
+
+    storage::TupleSlot slot = slots[layout_.num_slots_ + 7];
+    ASSERT_TRUE(cold_tier_.IsEvicted(slot.GetBlock()));
+    std::vector<uint16_t> update_col_ids{2};
+    std::vector<byte> redo_buffer(
+        storage::ProjectedRow::Size(layout_, update_col_ids));
+    auto *redo = storage::ProjectedRow::InitializeProjectedRow(
+        redo_buffer.data(), layout_, update_col_ids);
+    *reinterpret_cast<int64_t *>(redo->AccessForceNotNull(0)) = -1;
+    std::vector<byte> undo_buffer(
+        storage::DeltaRecord::Size(layout_, update_col_ids));
+    ASSERT_TRUE(table.Update(slot, *redo,
+                             storage::DeltaRecord::InitializeDeltaRecord(
+                                 undo_buffer.data(), 5, layout_,
+                                 update_col_ids)));
+    EXPECT_TRUE(Check(&table, 1, slots));
+    // 写过的block算回内存里
+    EXPECT_FALSE(cold_tier_.IsEvicted(slot.GetBlock()));
+    EXPECT_EQ(cold_tier_.ResidentBytes(), 3 * layout_.block_size_);
+    EXPECT_EQ(cold_tier_.EvictedBytes(),
+              (num_blocks - 4) * layout_.block_size_);
+    std::vector<byte> buffer2(storage::ProjectedRow::Size(layout_, col_ids_));
+    auto *row = storage::ProjectedRow::InitializeProjectedRow(
+        buffer2.data(), layout_, col_ids_);
+    table.Select(10, slot, row);
+    EXPECT_EQ(*reinterpret_cast<int64_t *>(row->AccessWithNullCheck(1)), -1);
+
+    // 重新freeze之后会再挤掉别的block
+    ASSERT_TRUE(table.FreezeBlock(slot.GetBlock(), 100));
+    EXPECT_EQ(cold_tier_.ResidentBytes(), 2 * layout_.block_size_);
+    table.Select(0, slot, row);
+    EXPECT_EQ(*reinterpret_cast<int64_t *>(row->AccessWithNullCheck(1)), -1);
+  }
+  EXPECT_EQ(cold_tier_.ResidentBytes(), 0);
+  EXPECT_EQ(cold_tier_.EvictedBytes(), 0);
+
+  // 还回去的block是普通内存，可以给别的表用
+  storage::DataTable table(block_store_, layout_);
+  slots = Load(&table, 0, num_blocks * layout_.num_slots_);
+  EXPECT_TRUE(Check(&table, 0, slots));
+}
+
+// CLOCK evicts the blocks nobody read since the last sweep first.
+TEST_F(ColdTierTests, ClockKeepsReferencedBlocks) {
+  storage::DataTable table(block_store_, layout_, &cold_tier_);
+  // 第一次load先把insertion head填满，剩下的是A
+  std::vector<storage::TupleSlot> slots =
+      Load(&table, 0, 2 * layout_.num_slots_);
+  storage::RawBlock *a = slots.back().GetBlock();
+  storage::RawBlock *b =
+      Load(&table, 0, layout_.num_slots_).back().GetBlock();
+  // C超出预算，一圈扫下来所有的bit都清掉了，A先被换出去
+  storage::RawBlock *c =
+      Load(&table, 0, layout_.num_slots_).back().GetBlock();
+  EXPECT_TRUE(cold_tier_.IsEvicted(a));
+  EXPECT_FALSE(cold_tier_.IsEvicted(b));
+  EXPECT_FALSE(cold_tier_.IsEvicted(c));
+
+  std::vector<byte> buffer(storage::ProjectedRow::Size(layout_, col_ids_));
+  table.Select(0, storage::TupleSlot(c, 0),
+               storage::ProjectedRow::InitializeProjectedRow(
+                   buffer.data(), layout_, col_ids_));
+  storage::RawBlock *d =
+      Load(&table, 0, layout_.num_slots_).back().GetBlock();
+  EXPECT_TRUE(cold_tier_.IsEvicted(b));
+  EXPECT_FALSE(cold_tier_.IsEvicted(c));
+  EXPECT_FALSE(cold_tier_.IsEvicted(d));
+}
+
+// Readers keep seeing the same values while their blocks are swapped out
+// underneath them.
+TEST_F(ColdTierTests, ConcurrentReaders) {
+  storage::DataTable table(block_store_, layout_, &cold_tier_);
+  std::vector<storage::TupleSlot> slots =
+      Load(&table, 0, 4 * layout_.num_slots_);
+  std::atomic<bool> done{false};
+  std::atomic<uint32_t> num_failures{0};
+  std::thread reader([&] {
+    do {
+      if (!Check(&table, 0, slots)) {
+        num_failures++;
+      }
+    } while (!done.load());
+  });
+  for (uint32_t i = 0; i < 16; i++) {
+    Load(&table, 0, layout_.num_slots_);
+  }
+  done.store(true);
+  reader.join();
+  EXPECT_EQ(num_failures.load(), 0);
+  EXPECT_GE(cold_tier_.EvictedBytes(), 16 * layout_.block_size_);
+}
+
+// Threads update tuples of their own table's frozen blocks, commit and
+// freeze the blocks again, which makes the tier evict the others' blocks
+// while they are being written. Every uncommitted version stays in its
+// block's summary, so readers never see it and Commit finds it counted.
+TEST_F(ColdTierTests, ConcurrentEvictionAndUpdates) {
+  const uint32_t num_threads = 4, num_updates = 2000;
+  std::atomic<uint32_t> num_lost_versions{0}, num_dirty_reads{0};
+  testutil::RunThreadUntilFinish(num_threads, [&](uint32_t) {
+    storage::DataTable table(block_store_, layout_, &cold_tier_);
+    // 第一个block是insertion head，只改后面frozen的
+    std::vector<storage::TupleSlot> slots =
+        Load(&table, 0, 4 * layout_.num_slots_);
+    slots.erase(slots.begin(), slots.begin() + layout_.num_slots_);
+    testutil::UndoBuffers undos;
+    std::vector<uint16_t> update_col_ids{2};
+    std::vector<byte> redo_buffer(
+        storage::ProjectedRow::Size(layout_, update_col_ids));
+    auto *redo = storage::ProjectedRow::InitializeProjectedRow(
+        redo_buffer.data(), layout_, update_col_ids);
+    std::vector<byte> buffer(storage::ProjectedRow::Size(layout_, col_ids_));
+    auto *row = storage::ProjectedRow::InitializeProjectedRow(
+        buffer.data(), layout_, col_ids_);
+    std::vector<int64_t> expected(slots.size());
+    for (uint64_t i = 0; i < slots.size(); i++) {
+      expected[i] = 3 * static_cast<int64_t>(i + layout_.num_slots_);
+    }
+    for (uint32_t i = 0; i < num_updates; i++) {
+      uint64_t index = (i * 7919ULL) % slots.size();
+      storage::TupleSlot slot = slots[index];
+      auto *header = reinterpret_cast<storage::Block *>(slot.GetBlock());
+      *reinterpret_cast<int64_t *>(redo->AccessForceNotNull(0)) = -int64_t(i);
+      storage::DeltaRecord *undo =
+          undos.NewUndo(testutil::Uncommitted(i), layout_, update_col_ids);
+      ASSERT_TRUE(table.Update(slot, *redo, undo));
+      if (header->num_uncommitted_.load() != 1) {
+        num_lost_versions++;
+      }
+      table.Select(i, slot, row);
+      if (*reinterpret_cast<int64_t *>(row->AccessWithNullCheck(1)) !=
+          expected[index]) {
+        num_dirty_reads++;
+      }
+      table.Commit(slot, undo, i + 1);
+      expected[index] = -int64_t(i);
+      ASSERT_TRUE(table.FreezeBlock(slot.GetBlock(), i + 2));
+    }
+    for (uint64_t i = 0; i < slots.size(); i++) {
+      table.Select(num_updates + 1, slots[i], row);
+      EXPECT_EQ(*reinterpret_cast<int64_t *>(row->AccessWithNullCheck(1)),
+                expected[i]);
+    }
+  });
+  EXPECT_EQ(num_lost_versions.load(), 0);
+  EXPECT_EQ(num_dirty_reads.load(), 0);
+}
+
+// Tables that load and drop blocks at the same time through one tier keep
+// its counts straight, and blocks that were mapped over by the file go back
+// to the BlockStore and get reused.
+TEST_F(ColdTierTests, ConcurrentTables) {
+  const uint32_t num_threads = 4, num_rounds = 3;
+  std::atomic<uint32_t> num_failures{0};
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t < num_threads; t++) {
+    threads.emplace_back([&] {
+      for (uint32_t round = 0; round < num_rounds; round++) {
+        storage::DataTable table(block_store_, layout_, &cold_tier_);
+        std::vector<storage::TupleSlot> slots =
+            Load(&table, 0, 4 * layout_.num_slots_);
+        if (!Check(&table, 0, slots)) {
+          num_failures++;
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(num_failures.load(), 0);
+  EXPECT_EQ(cold_tier_.ResidentBytes(), 0);
+  EXPECT_EQ(cold_tier_.EvictedBytes(), 0);
+}
+} // namespace noisepage
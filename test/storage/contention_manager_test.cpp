@@ -0,0 +1,210 @@
+#include "common/test_util.h"
+#include "storage/bulk_loader.h"
+#include "storage/contention_manager.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace noisepage {
+class ContentionManagerTests : public ::testing::Test {
+public:
+  storage::BlockStore block_store_{10};
+  storage::BlockLayout layout_{2, {8, 8}, storage::MIN_BLOCK_SIZE};
+  storage::ProjectedRowInitializer initializer_{layout_, {1}};
+  testutil::UndoBuffers undos_;
+
+  storage::DeltaRecord *NewUndo(timestamp_t timestamp) {
+    return undos_.NewUndo(timestamp, initializer_);
+  }
+};
+
+using testutil::Uncommitted;
+
+// Each policy gives up on a tuple whose owner never finishes, counting the
+// conflict. Once the owner has committed, writers whose snapshot predates
+// the commit give up at once and later ones go through.
+TEST_F(ContentionManagerTests, PoliciesGiveUpAndSucceed) {
+  storage::DataTable table(block_store_, layout_);
+  std::vector<int64_t> values{0};
+  std::vector<storage::TupleSlot> slots;
+  storage::BulkLoader::BulkLoad(
+      &table, {{1, reinterpret_cast<const byte *>(values.data())}}, 1, &slots);
+  std::vector<byte> buffer(initializer_.ProjectedRowSize());
+  auto *row = initializer_.InitializeRow(buffer.data());
+  *reinterpret_cast<int64_t *>(row->AccessForceNotNull(0)) = 1;
+
+  storage::DeltaRecord *owner = NewUndo(Uncommitted(1));
+  ASSERT_TRUE(table.Update(slots[0], *row, owner));
+
+  storage::ContentionOptions options;
+  options.policy_ = storage::ContentionPolicy::ABORT;
+  storage::ContentionManager abort(&table, options);
+  EXPECT_FALSE(abort.Update(0, slots[0], *row, NewUndo(Uncommitted(2))));
+  EXPECT_EQ(abort.Stats().conflicts_, 1);
+  EXPECT_EQ(abort.Stats().retries_, 0);
+  EXPECT_EQ(abort.Stats().aborts_, 1);
+
+  options.policy_ = storage::ContentionPolicy::BACKOFF;
+  options.max_attempts_ = 4;
+  storage::ContentionManager backoff(&table, options);
+  EXPECT_FALSE(backoff.Update(0, slots[0], *row, NewUndo(Uncommitted(2))));
+  EXPECT_EQ(backoff.Stats().retries_, 3);
+  EXPECT_EQ(backoff.Stats().aborts_, 1);
+
+  options.policy_ = storage::ContentionPolicy::WAIT;
+  options.wait_timeout_ = std::chrono::milliseconds(5);
+  options.max_waiters_ = 0;
+  storage::ContentionManager full(&table, options);
+  EXPECT_FALSE(full.Update(0, slots[0], *row, NewUndo(Uncommitted(2))));
+  EXPECT_EQ(full.Stats().early_aborts_, 1);
+  EXPECT_EQ(full.Stats().waits_, 0);
+
+  options.max_waiters_ = 8;
+  storage::ContentionManager wait(&table, options);
+  EXPECT_FALSE(wait.Update(0, slots[0], *row, NewUndo(Uncommitted(2))));
+  EXPECT_GE(wait.Stats().waits_, 1);
+  EXPECT_EQ(wait.Stats().aborts_, 1);
+  EXPECT_EQ(wait.Stats().early_aborts_, 0);
+
+  // owner在这些writer的snapshot之后提交，它们马上放弃，不重试
+  table.Commit(slots[0], owner, 5);
+  wait.Release(slots[0]);
+  std::vector<byte> select_buffer(initializer_.ProjectedRowSize());
+  auto *select_row = initializer_.InitializeRow(select_buffer.data());
+  for (auto *manager : {&abort, &backoff, &wait}) {
+    uint64_t retries = manager->Stats().retries_;
+    bool installed = true;
+    EXPECT_FALSE(manager->Update(4, slots[0], *row, NewUndo(Uncommitted(3)),
+                                 &installed));
+    EXPECT_FALSE(installed);
+    EXPECT_EQ(manager->Stats().retries_, retries);
+    table.Select(10, slots[0], select_row);
+    EXPECT_EQ(*reinterpret_cast<int64_t *>(select_row->AccessWithNullCheck(0)),
+              1);
+  }
+  EXPECT_EQ(backoff.Stats().conflicts_, 2);
+
+  timestamp_t commit_timestamp = 6;
+  for (auto *manager : {&abort, &backoff, &wait}) {
+    storage::DeltaRecord *undo = NewUndo(Uncommitted(4));
+    EXPECT_TRUE(manager->Update(commit_timestamp - 1, slots[0], *row, undo));
+    table.Commit(slots[0], undo, commit_timestamp++);
+  }
+  EXPECT_EQ(backoff.Stats().conflicts_, 2);
+}
+
+// A waiting writer is woken by Release as soon as the owner finishes, well
+// before its timeout. It goes through if the owner rolled back, and gives
+// up if the owner committed after the waiter's snapshot.
+TEST_F(ContentionManagerTests, WaiterWakesOnRelease) {
+  storage::DataTable table(block_store_, layout_);
+  std::vector<int64_t> values{0};
+  std::vector<storage::TupleSlot> slots;
+  storage::BulkLoader::BulkLoad(
+      &table, {{1, reinterpret_cast<const byte *>(values.data())}}, 1, &slots);
+  std::vector<byte> buffer(initializer_.ProjectedRowSize());
+  auto *row = initializer_.InitializeRow(buffer.data());
+  *reinterpret_cast<int64_t *>(row->AccessForceNotNull(0)) = 1;
+
+  storage::ContentionOptions options;
+  options.policy_ = storage::ContentionPolicy::WAIT;
+  options.wait_timeout_ = std::chrono::seconds(60);
+  storage::ContentionManager tested(&table, options);
+  for (bool commit : {false, true}) {
+    storage::DeltaRecord *owner = NewUndo(Uncommitted(1));
+    ASSERT_TRUE(tested.Update(0, slots[0], *row, owner));
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t waits = tested.Stats().waits_;
+    storage::DeltaRecord *waiter_undo = NewUndo(Uncommitted(2));
+    std::thread waiter([&] {
+      EXPECT_EQ(tested.Update(0, slots[0], *row, waiter_undo), !commit);
+    });
+    while (tested.Stats().waits_ == waits) {
+      std::this_thread::yield();
+    }
+    if (commit) {
+      table.Commit(slots[0], owner, 5);
+    } else {
+      table.Rollback(slots[0], owner);
+    }
+    tested.Release(slots[0]);
+    waiter.join();
+    EXPECT_LT(std::chrono::steady_clock::now() - start,
+              std::chrono::seconds(30));
+    if (!commit) {
+      table.Rollback(slots[0], waiter_undo);
+    }
+  }
+  EXPECT_EQ(tested.Stats().aborts_, 1);
+}
+
+// Writers hammering a few rows each add one to a row they read at their
+// snapshot, commit and release right after the update, and start over with
+// a fresh snapshot when the manager gives up. Under WAIT and under BACKOFF
+// every increment lands: none overwrites a version committed after the
+// snapshot it read.
+TEST_F(ContentionManagerTests, HotRows) {
+  const uint32_t num_threads = 4;
+  const uint32_t num_txns = 500;
+  const uint32_t num_rows = 3;
+  for (auto policy :
+       {storage::ContentionPolicy::WAIT, storage::ContentionPolicy::BACKOFF}) {
+    storage::DataTable table(block_store_, layout_);
+    std::vector<int64_t> values(num_rows, 0);
+    std::vector<storage::TupleSlot> slots;
+    storage::BulkLoader::BulkLoad(
+        &table, {{1, reinterpret_cast<const byte *>(values.data())}}, num_rows,
+        &slots);
+    storage::ContentionOptions options;
+    options.policy_ = policy;
+    options.max_attempts_ = UINT32_MAX;
+    options.wait_timeout_ = std::chrono::seconds(60);
+    options.max_waiters_ = num_threads;
+    storage::ContentionManager tested(&table, options);
+    // 提交和取snapshot都拿latch，snapshot之前的提交都已经写完
+    std::mutex commit_latch;
+    timestamp_t last_committed = 0;
+    std::atomic<uint64_t> txn_id{0};
+
+    testutil::RunThreadUntilFinish(num_threads, [&](uint32_t id) {
+      std::vector<byte> buffer(initializer_.ProjectedRowSize());
+      auto *row = initializer_.InitializeRow(buffer.data());
+      for (uint32_t i = 0; i < num_txns; i++) {
+        const storage::TupleSlot &slot = slots[(id + i) % num_rows];
+        while (true) {
+          timestamp_t read_timestamp;
+          {
+            std::lock_guard<std::mutex> lock(commit_latch);
+            read_timestamp = last_committed;
+          }
+          table.Select(read_timestamp, slot, row);
+          ++*reinterpret_cast<int64_t *>(row->AccessForceNotNull(0));
+          storage::DeltaRecord *undo = NewUndo(Uncommitted(txn_id++));
+          if (tested.Update(read_timestamp, slot, *row, undo)) {
+            // 拿着这行多待一会，让别的writer撞上
+            std::this_thread::yield();
+            {
+              std::lock_guard<std::mutex> lock(commit_latch);
+              table.Commit(slot, undo, ++last_committed);
+            }
+            tested.Release(slot);
+            break;
+          }
+        }
+      }
+    });
+    std::vector<byte> buffer(initializer_.ProjectedRowSize());
+    auto *row = initializer_.InitializeRow(buffer.data());
+    int64_t sum = 0;
+    for (const auto &slot : slots) {
+      table.Select(last_committed, slot, row);
+      sum += *reinterpret_cast<int64_t *>(row->AccessWithNullCheck(0));
+    }
+    EXPECT_EQ(sum, num_threads * num_txns);
+    EXPECT_EQ(last_committed, num_threads * num_txns);
+  }
+}
+} // namespace noisepage
@@ -1,6 +1,9 @@
+#include "storage/bulk_loader.h"
 #include "storage/data_table.h"
 #include "storage/storage_test_util.h"
 #include "gtest/gtest.h"
+#include <algorithm>
+#include <numeric>
 #include <random>
 
 namespace noisepage {
@@ -178,4 +181,241 @@ TEST_F(DataTableConcurrentTests, ConcurrentUpdateOneWriterWins) {
     EXPECT_EQ(num_threads - 1, fail);
   }
 }
-} // namespace noisepage
\ No newline at end of file
+
+// One thread keeps updating tuples and rolling the updates back while the
+// others read them through Select, Scan and ScanColumns. Rollback restores
+// the values before it unlinks the undo, so a reader that copied an aborted
+// value must notice and read again; none may ever return one.
+TEST_F(DataTableConcurrentTests, ReadersDuringRollback) {
+  const uint32_t num_readers = 3;
+  const uint32_t num_rows = 4;
+  const uint32_t num_rounds = 1000000;
+  const int64_t committed = 100;
+  storage::BlockLayout layout(2, {8, 8}, storage::MIN_BLOCK_SIZE);
+  testutil::UndoBuffers undos;
+  storage::DataTable table(block_store_, layout);
+  std::vector<int64_t> values(num_rows, committed);
+  std::vector<storage::TupleSlot> slots;
+  storage::BulkLoader::BulkLoad(
+      &table, {{1, reinterpret_cast<const byte *>(values.data())}}, num_rows,
+      &slots);
+  storage::ProjectedRowInitializer initializer(layout, {1});
+
+  std::atomic<bool> done{false};
+  std::atomic<uint32_t> aborted_reads{0};
+  testutil::RunThreadUntilFinish(num_readers + 1, [&](uint32_t id) {
+    std::vector<byte> buffer(initializer.ProjectedRowSize());
+    auto *row = initializer.InitializeRow(buffer.data());
+    auto *value = reinterpret_cast<int64_t *>(row->AccessForceNotNull(0));
+    if (id == 0) {
+      for (uint32_t i = 0; i < num_rounds; i++) {
+        const storage::TupleSlot &slot = slots[i % num_rows];
+        *value = -1;
+        storage::DeltaRecord *undo =
+            undos.NewUndo(testutil::Uncommitted(i), initializer);
+        EXPECT_TRUE(table.Update(slot, *row, undo));
+        table.Rollback(slot, undo);
+      }
+      done = true;
+      return;
+    }
+    storage::ColumnBatch batch({8});
+    std::vector<storage::ColumnPredicate> predicates{
+        {1, storage::PredicateType::BETWEEN, committed, committed}};
+    while (!done) {
+      for (const auto &slot : slots) {
+        table.Select(1, slot, row);
+        aborted_reads += *value != committed;
+      }
+      uint32_t matched = 0;
+      table.Scan(1, predicates, row,
+                 [&](const storage::TupleSlot &,
+                     const storage::ProjectedRow &) { matched++; });
+      aborted_reads += matched != num_rows;
+      table.ScanColumns(0, table.NumBlocks(), 1, {1}, {}, &batch,
+                        [&](storage::ColumnBatch *result) {
+                          for (uint32_t r = 0; r < result->NumRows(); r++) {
+                            aborted_reads +=
+                                result->ReadInteger(0, r) != committed;
+                          }
+                        });
+    }
+  });
+  EXPECT_EQ(aborted_reads.load(), 0);
+}
+
+// Readers may scan a block while the GC freezes it, so the zone maps must
+// never look narrower than the values in the block.
+TEST_F(DataTableConcurrentTests, ScanDuringFreeze) {
+  const uint32_t num_readers = 3;
+  const uint32_t num_rounds = 10000;
+  storage::BlockLayout layout(2, {8, 8}, storage::MIN_BLOCK_SIZE);
+  const int64_t num_rows = layout.num_slots_;
+  testutil::UndoBuffers undos;
+  storage::DataTable table(block_store_, layout);
+  // one extra row so that the first block is no longer the insertion head
+  std::vector<int64_t> values(num_rows + 1);
+  std::iota(values.begin(), values.end(), 0);
+  std::vector<storage::TupleSlot> slots;
+  storage::BulkLoader::BulkLoad(
+      &table, {{1, reinterpret_cast<const byte *>(values.data())}},
+      num_rows + 1, &slots);
+  storage::RawBlock *block = slots[0].GetBlock();
+  ASSERT_NE(block, slots.back().GetBlock());
+  storage::ProjectedRowInitializer initializer(layout, {1});
+
+  std::atomic<bool> done{false};
+  std::atomic<uint32_t> missed_scans{0};
+  testutil::RunThreadUntilFinish(num_readers + 1, [&](uint32_t id) {
+    std::vector<byte> buffer(initializer.ProjectedRowSize());
+    auto *row = initializer.InitializeRow(buffer.data());
+    if (id == 0) {
+      for (uint32_t i = 0; i < num_rounds; i++) {
+        // rewriting a value makes the block hot again
+        const storage::TupleSlot &slot = slots[i % num_rows];
+        *reinterpret_cast<int64_t *>(row->AccessForceNotNull(0)) =
+            values[i % num_rows];
+        EXPECT_TRUE(table.Update(slot, *row, undos.NewUndo(1, initializer)));
+        EXPECT_TRUE(table.FreezeBlock(block, 2));
+      }
+      done = true;
+      return;
+    }
+    std::vector<std::vector<storage::ColumnPredicate>> predicates{
+        {{1, storage::PredicateType::EQUAL, 0}},
+        {{1, storage::PredicateType::EQUAL, num_rows - 1}},
+        {{1, storage::PredicateType::BETWEEN, 0, num_rows - 1}}};
+    std::vector<uint32_t> expected{1, 1, static_cast<uint32_t>(num_rows)};
+    while (!done) {
+      for (uint32_t i = 0; i < predicates.size(); i++) {
+        uint32_t matched = 0;
+        table.Scan(2, predicates[i], row,
+                   [&](const storage::TupleSlot &,
+                       const storage::ProjectedRow &) { matched++; });
+        missed_scans += matched != expected[i];
+      }
+    }
+  });
+  EXPECT_EQ(missed_scans.load(), 0);
+}
+
+// MigrateBlocks moves every block after each schema change while writers
+// keep updating and committing their own tuples and readers select and scan
+// them. No update may be lost in a block that moved under its writer, no
+// reader may see anything but a value that was written, and no reader may
+// see a row go back to an older value.
+TEST_F(DataTableConcurrentTests, MigrateDuringTraffic) {
+  const uint32_t num_writers = 2, num_readers = 2, num_schema_changes = 8;
+  storage::BlockLayout layout(2, {8, 8}, storage::MIN_BLOCK_SIZE);
+  const uint32_t num_rows = 8 * layout.num_slots_;
+  // 第i行的值是i * ROW_STRIDE加上被改过的次数
+  const int64_t ROW_STRIDE = 1 << 20;
+  testutil::UndoBuffers undos;
+  storage::DataTable table(block_store_, layout);
+  std::vector<int64_t> values(num_rows);
+  for (uint32_t i = 0; i < num_rows; i++) {
+    values[i] = i * ROW_STRIDE;
+  }
+  std::vector<storage::TupleSlot> slots;
+  storage::BulkLoader::BulkLoad(
+      &table, {{1, reinterpret_cast<const byte *>(values.data())}}, num_rows,
+      &slots);
+  storage::ProjectedRowInitializer initializer(layout, {1});
+  const timestamp_t latest = INT64_MAX;
+  std::atomic<timestamp_t> next_timestamp{1};
+  std::atomic<uint32_t> num_bad_reads{0};
+  // 每行最后提交的值，reader拿来当下界
+  std::vector<std::atomic<int64_t>> committed(num_rows);
+  for (uint32_t i = 0; i < num_rows; i++) {
+    committed[i] = values[i];
+  }
+
+  for (uint32_t round = 0; round < num_schema_changes; round++) {
+    table.AddColumn(8);
+    std::atomic<bool> done{false};
+    std::thread migrator([&] {
+      while (table.MigrateBlocks(1) != 0) {
+      }
+      done = true;
+    });
+    testutil::RunThreadUntilFinish(
+        num_writers + num_readers, [&](uint32_t id) {
+          std::vector<byte> buffer(initializer.ProjectedRowSize());
+          auto *row = initializer.InitializeRow(buffer.data());
+          auto *value = reinterpret_cast<int64_t *>(row->AccessForceNotNull(0));
+          if (id < num_writers) {
+            // 每个writer只改自己的行，不会有写写冲突
+            for (uint32_t i = id; !done || i < num_rows; i += num_writers) {
+              uint32_t row_id = i % num_rows;
+              *value = ++values[row_id];
+              storage::DeltaRecord *undo =
+                  undos.NewUndo(testutil::Uncommitted(id), initializer);
+              EXPECT_TRUE(table.Update(slots[row_id], *row, undo));
+              table.Commit(slots[row_id], undo, next_timestamp++);
+              committed[row_id] = *value;
+            }
+            return;
+          }
+          // 不能读到比开始读之前就提交了的还旧的值：directory已经指向to、
+          // 写进to的提交之后，scan不能再从from读
+          std::vector<int64_t> seen(num_rows, 0);
+          storage::ColumnBatch batch({8});
+          auto check = [&](uint32_t row_id, int64_t read) {
+            num_bad_reads += read / ROW_STRIDE != row_id || read < seen[row_id];
+            seen[row_id] = std::max(seen[row_id], read);
+          };
+          while (!done) {
+            for (uint32_t i = 0; i < num_rows; i += 97) {
+              table.Select(latest, slots[i], row);
+              check(i, *value);
+            }
+            for (uint32_t i = 0; i < num_rows; i++) {
+              seen[i] = std::max(seen[i], committed[i].load());
+            }
+            uint32_t num_matched = 0;
+            table.Scan(latest, {}, row,
+                       [&](const storage::TupleSlot &slot,
+                           const storage::ProjectedRow &scanned) {
+                         num_matched++;
+                         int64_t read = *reinterpret_cast<const int64_t *>(
+                             scanned.AccessWithNullCheck(0));
+                         auto row_id = static_cast<uint32_t>(read / ROW_STRIDE);
+                         num_bad_reads += row_id >= num_rows ||
+                                          slots[row_id] != slot;
+                         if (row_id < num_rows) {
+                           check(row_id, read);
+                         }
+                       });
+            num_bad_reads += num_matched != num_rows;
+            // ScanColumns直接从blocks_里的block拷值，不经过directory
+            num_matched = 0;
+            table.ScanColumns(
+                0, table.NumBlocks(), latest, {1}, {}, &batch,
+                [&](storage::ColumnBatch *result) {
+                  for (uint32_t r = 0; r < result->NumRows(); r++) {
+                    num_matched++;
+                    int64_t read = result->ReadInteger(0, r);
+                    auto row_id = static_cast<uint32_t>(read / ROW_STRIDE);
+                    num_bad_reads += row_id >= num_rows ||
+                                     slots[row_id] != result->Slots()[r];
+                    if (row_id < num_rows) {
+                      check(row_id, read);
+                    }
+                  }
+                });
+            num_bad_reads += num_matched != num_rows;
+          }
+        });
+    migrator.join();
+  }
+
+  EXPECT_EQ(num_bad_reads.load(), 0);
+  std::vector<byte> buffer(initializer.ProjectedRowSize());
+  auto *row = initializer.InitializeRow(buffer.data());
+  for (uint32_t i = 0; i < num_rows; i++) {
+    table.Select(latest, slots[i], row);
+    EXPECT_EQ(*reinterpret_cast<const int64_t *>(row->AccessWithNullCheck(0)),
+              values[i]);
+  }
+}
+} // namespace noisepage
@@ -1,7 +1,11 @@
+#include "storage/bulk_loader.h"
 #include "storage/data_table.h"
+#include "storage/snapshot_file.h"
 #include "storage/storage_test_util.h"
 #include "gtest/gtest.h"
+#include <numeric>
 #include <random>
+#include <unistd.h>
 
 namespace noisepage {
 class RandomDataTableTestObject {
@@ -121,6 +125,7 @@ struct DataTableTests : public ::testing::Test {
   storage::BlockStore block_store_{10};
   std::default_random_engine generator_;
   std::uniform_real_distribution<double> null_ratio_{0.0, 1.0};
+  testutil::UndoBuffers undos_;
 };
 
 TEST_F(DataTableTests, SimpleInsertSelect) {
@@ -188,4 +193,409 @@ TEST_F(DataTableTests, WriteWriteConfilictUpdateFails) {
   }
 }
 
+// Loading and scanning on a scheduler gives the same rows as doing it on
+// one thread, each visited exactly once.
+TEST_F(DataTableTests, ParallelScan) {
+  storage::BlockLayout layout(3, {8, 8, 4}, storage::MIN_BLOCK_SIZE);
+  storage::DataTable table(block_store_, layout);
+  Scheduler scheduler(4);
+  const uint32_t num_rows = layout.num_slots_ * 9 + 7;
+  std::vector<int64_t> keys(num_rows);
+  std::vector<int32_t> values(num_rows);
+  for (uint32_t i = 0; i < num_rows; i++) {
+    keys[i] = i;
+    values[i] = static_cast<int32_t>(generator_() % 100);
+  }
+  std::vector<storage::TupleSlot> slots;
+  storage::BulkLoader::ParallelBulkLoad(
+      &table,
+      {{1, reinterpret_cast<const byte *>(keys.data())},
+       {2, reinterpret_cast<const byte *>(values.data())}},
+      num_rows, &scheduler, &slots);
+  ASSERT_EQ(slots.size(), num_rows);
+
+  storage::ProjectedRowInitializer initializer(layout, {1, 2});
+  std::vector<byte> buffer(initializer.ProjectedRowSize());
+  auto *row = initializer.InitializeRow(buffer.data());
+  for (uint32_t i = 0; i < num_rows; i++) {
+    table.Select(0, slots[i], row);
+    EXPECT_EQ(*reinterpret_cast<const int64_t *>(row->AccessWithNullCheck(0)),
+              i);
+  }
+
+  std::vector<storage::ColumnPredicate> predicates{
+      {2, storage::PredicateType::LESS, 50}};
+  uint32_t expected = 0;
+  uint32_t expected_blocks = table.Scan(
+      0, predicates, row,
+      [&](const storage::TupleSlot &, const storage::ProjectedRow &) {
+        expected++;
+      });
+  std::vector<std::atomic<uint32_t>> seen(num_rows);
+  std::atomic<uint32_t> matched{0};
+  uint32_t blocks_read = table.ParallelScan(
+      &scheduler, 0, predicates, initializer,
+      [&](const storage::TupleSlot &, const storage::ProjectedRow &row) {
+        auto key = *reinterpret_cast<const int64_t *>(
+            row.AccessWithNullCheck(0));
+        EXPECT_LT(*reinterpret_cast<const int32_t *>(
+                      row.AccessWithNullCheck(1)),
+                  50);
+        seen[key]++;
+        matched++;
+      });
+  EXPECT_EQ(blocks_read, expected_blocks);
+  EXPECT_EQ(matched.load(), expected);
+  for (uint32_t i = 0; i < num_rows; i++) {
+    EXPECT_EQ(seen[i].load(), values[i] < 50 ? 1 : 0);
+  }
+}
+
+// Every block counts its tuples with version chains and remembers its newest
+// delta, so reads at later timestamps skip the chains; freezing the block
+// clears both.
+TEST_F(DataTableTests, VersionSummary) {
+  storage::BlockLayout layout(2, {8, 8}, storage::MIN_BLOCK_SIZE);
+  storage::DataTable table(block_store_, layout);
+  const uint32_t num_rows = layout.num_slots_ * 3;
+  std::vector<int64_t> keys(num_rows);
+  for (uint32_t i = 0; i < num_rows; i++) {
+    keys[i] = i;
+  }
+  std::vector<storage::TupleSlot> slots;
+  storage::BulkLoader::BulkLoad(
+      &table, {{1, reinterpret_cast<const byte *>(keys.data())}}, num_rows,
+      &slots);
+  // 第二个block是frozen的，insertion head不能freeze
+  const uint32_t first = layout.num_slots_;
+  auto *block = reinterpret_cast<storage::Block *>(slots[first].GetBlock());
+  EXPECT_EQ(block->num_versioned_.load(), 0);
+  EXPECT_EQ(block->max_version_timestamp_.load(), 0);
+
+  storage::ProjectedRowInitializer initializer(layout, {1});
+  std::vector<byte> buffer(initializer.ProjectedRowSize());
+  auto *row = initializer.InitializeRow(buffer.data());
+  auto update = [&](uint32_t i, timestamp_t timestamp) {
+    *reinterpret_cast<int64_t *>(row->AccessForceNotNull(0)) = -1;
+    EXPECT_TRUE(
+        table.Update(slots[i], *row, undos_.NewUndo(timestamp, initializer)));
+  };
+  update(first, 10);
+  update(first, 12);
+  update(first + 1, 11);
+  EXPECT_EQ(block->num_versioned_.load(), 2);
+  EXPECT_EQ(block->max_version_timestamp_.load(), 12);
+
+  auto count_negative = [&](timestamp_t timestamp) {
+    uint32_t count = 0;
+    table.Scan(timestamp, {{1, storage::PredicateType::LESS, 0}}, row,
+               [&](const storage::TupleSlot &, const storage::ProjectedRow &) {
+                 count++;
+               });
+    return count;
+  };
+  auto read = [&](uint32_t i, timestamp_t timestamp) {
+    table.Select(timestamp, slots[i], row);
+    return *reinterpret_cast<const int64_t *>(row->AccessWithNullCheck(0));
+  };
+  EXPECT_EQ(count_negative(5), 0);
+  EXPECT_EQ(count_negative(11), 2);
+  EXPECT_EQ(count_negative(100), 2);
+  EXPECT_EQ(read(first, 5), first);
+  EXPECT_EQ(read(first + 1, 10), first + 1);
+  EXPECT_EQ(read(first + 1, 100), -1);
+  EXPECT_EQ(read(first + 2, 0), first + 2);
+
+  EXPECT_FALSE(table.FreezeBlock(slots[first].GetBlock(), 11));
+  EXPECT_TRUE(table.FreezeBlock(slots[first].GetBlock(), 12));
+  EXPECT_EQ(block->num_versioned_.load(), 0);
+  EXPECT_EQ(block->max_version_timestamp_.load(), 0);
+  EXPECT_EQ(read(first, 0), -1);
+  EXPECT_EQ(count_negative(0), 2);
+}
+
+// Versions installed with a transaction id keep every reader on the chain
+// path; committing them through Commit lowers the summary to the commit
+// timestamp, and only once the last one in the block is committed.
+TEST_F(DataTableTests, VersionSummaryCommit) {
+  storage::BlockLayout layout(2, {8, 8}, storage::MIN_BLOCK_SIZE);
+  storage::DataTable table(block_store_, layout);
+  const uint32_t num_rows = layout.num_slots_ * 3;
+  std::vector<int64_t> keys(num_rows);
+  for (uint32_t i = 0; i < num_rows; i++) {
+    keys[i] = i;
+  }
+  std::vector<storage::TupleSlot> slots;
+  storage::BulkLoader::BulkLoad(
+      &table, {{1, reinterpret_cast<const byte *>(keys.data())}}, num_rows,
+      &slots);
+  const uint32_t first = layout.num_slots_;
+  auto *header = reinterpret_cast<storage::Block *>(slots[first].GetBlock());
+
+  storage::ProjectedRowInitializer initializer(layout, {1});
+  std::vector<byte> buffer(initializer.ProjectedRowSize());
+  auto *row = initializer.InitializeRow(buffer.data());
+  auto update = [&](uint32_t i, timestamp_t timestamp) {
+    *reinterpret_cast<int64_t *>(row->AccessForceNotNull(0)) = -1;
+    auto *undo = undos_.NewUndo(timestamp, initializer);
+    EXPECT_TRUE(table.Update(slots[i], *row, undo));
+    return undo;
+  };
+  auto read = [&](uint32_t i, timestamp_t timestamp) {
+    table.Select(timestamp, slots[i], row);
+    return *reinterpret_cast<const int64_t *>(row->AccessWithNullCheck(0));
+  };
+
+  storage::DeltaRecord *a = update(first, testutil::Uncommitted(1));
+  storage::DeltaRecord *b = update(first + 1, testutil::Uncommitted(2));
+  EXPECT_EQ(header->num_uncommitted_.load(), 2);
+  EXPECT_EQ(header->max_version_timestamp_.load(), 0);
+  EXPECT_EQ(read(first, 100), first);
+
+  table.Commit(slots[first], a, 10);
+  EXPECT_EQ(header->num_uncommitted_.load(), 1);
+  EXPECT_EQ(header->max_version_timestamp_.load(), 10);
+  EXPECT_EQ(read(first, 5), first);
+  EXPECT_EQ(read(first, 10), -1);
+  EXPECT_EQ(read(first + 1, 100), first + 1);
+
+  table.Commit(slots[first + 1], b, 11);
+  EXPECT_EQ(header->num_uncommitted_.load(), 0);
+  EXPECT_EQ(header->max_version_timestamp_.load(), 11);
+  EXPECT_EQ(read(first + 1, 10), first + 1);
+  EXPECT_EQ(read(first + 1, 11), -1);
+
+  // 回滚的版本也不再挡着
+  storage::DeltaRecord *c = update(first + 2, testutil::Uncommitted(3));
+  EXPECT_EQ(header->num_uncommitted_.load(), 1);
+  table.Rollback(slots[first + 2], c);
+  EXPECT_EQ(header->num_uncommitted_.load(), 0);
+  EXPECT_EQ(read(first + 2, 100), first + 2);
+}
+
+// Repeated updates of a tuple by one transaction merge into its one delta,
+// widened when new columns are written, so the chain stays one record per
+// transaction and older snapshots still see the values from before it.
+TEST_F(DataTableTests, CoalesceOwnUpdates) {
+  storage::BlockLayout layout(3, {8, 8, 8}, storage::MIN_BLOCK_SIZE);
+  storage::DataTable table(block_store_, layout);
+  std::vector<int64_t> keys{100}, values{200};
+  std::vector<storage::TupleSlot> slots;
+  storage::BulkLoader::BulkLoad(
+      &table,
+      {{1, reinterpret_cast<const byte *>(keys.data())},
+       {2, reinterpret_cast<const byte *>(values.data())}},
+      1, &slots);
+  const storage::TupleSlot slot = slots[0];
+
+  auto new_undo = [&](timestamp_t timestamp,
+                      const std::vector<uint16_t> &col_ids) {
+    return undos_.NewUndo(timestamp, layout, col_ids);
+  };
+  std::vector<byte> redo_buffer(storage::ProjectedRow::Size(layout, {1}));
+  auto redo_of = [&](uint16_t col_id, int64_t value) {
+    auto *redo = storage::ProjectedRow::InitializeProjectedRow(
+        redo_buffer.data(), layout, {col_id});
+    *reinterpret_cast<int64_t *>(redo->AccessForceNotNull(0)) = value;
+    return redo;
+  };
+  // 返回undo有没有进version chain
+  storage::DeltaRecord *last = nullptr;
+  auto update = [&](timestamp_t timestamp, uint16_t col_id, int64_t value) {
+    auto *redo = redo_of(col_id, value);
+    last = new_undo(timestamp, table.UndoColumns(slot, *redo, timestamp));
+    bool installed = false;
+    EXPECT_TRUE(table.Update(slot, *redo, last, &installed));
+    return installed;
+  };
+  std::vector<byte> buffer(storage::ProjectedRow::Size(layout, {1, 2}));
+  auto *row = storage::ProjectedRow::InitializeProjectedRow(buffer.data(),
+                                                            layout, {1, 2});
+  auto read = [&](timestamp_t timestamp, uint16_t col_id) {
+    table.Select(timestamp, slot, row);
+    uint16_t offset = row->ColumnIds()[0] == col_id ? 0 : 1;
+    return *reinterpret_cast<const int64_t *>(row->AccessWithNullCheck(offset));
+  };
+
+  EXPECT_TRUE(update(10, 1, 101));
+  storage::DeltaRecord *committed = last;
+  const timestamp_t txn = testutil::Uncommitted(7);
+  EXPECT_TRUE(update(txn, 1, 102));
+  storage::DeltaRecord *own = last;
+  EXPECT_EQ(own->next_, committed);
+  for (int64_t i = 0; i < 10; i++) {
+    EXPECT_FALSE(update(txn, 1, 103 + i));
+  }
+
+  // 新的列：换成同时有两列的delta，接在原来那个的位置
+  EXPECT_EQ(table.UndoColumns(slot, *redo_of(2, 0), txn).size(), 2);
+  EXPECT_TRUE(update(txn, 2, 201));
+  EXPECT_EQ(last->next_, committed);
+  EXPECT_EQ(last->Delta()->NumColumns(), 2);
+  EXPECT_FALSE(update(txn, 2, 202));
+  EXPECT_FALSE(update(txn, 1, 120));
+
+  EXPECT_EQ(read(5, 1), 100);
+  EXPECT_EQ(read(5, 2), 200);
+  EXPECT_EQ(read(10, 1), 101);
+  EXPECT_EQ(read(10, 2), 200);
+  EXPECT_EQ(read(txn, 1), 120);
+  EXPECT_EQ(read(txn, 2), 202);
+
+  // 别的事务还是冲突
+  EXPECT_FALSE(table.Update(slot, *redo_of(1, 0), new_undo(20, {1})));
+
+  // undo只有redo的列时退回到往链上加
+  std::vector<storage::TupleSlot> fresh;
+  storage::BulkLoader::BulkLoad(
+      &table, {{1, reinterpret_cast<const byte *>(keys.data())}}, 1, &fresh);
+  const timestamp_t other = testutil::Uncommitted(8);
+  storage::DeltaRecord *first = new_undo(other, {1});
+  EXPECT_TRUE(table.Update(fresh[0], *redo_of(1, 1), first));
+  storage::DeltaRecord *second = new_undo(other, {2});
+  bool installed = false;
+  EXPECT_TRUE(table.Update(fresh[0], *redo_of(2, 2), second, &installed));
+  EXPECT_TRUE(installed);
+  EXPECT_EQ(second->next_, first);
+}
+
+// Adding and dropping columns leaves existing blocks alone: their tuples
+// read the new column's default until MigrateBlocks moves them, under the
+// same slots, into the current layout.
+TEST_F(DataTableTests, AddAndDropColumns) {
+  storage::BlockLayout layout(3, {8, 8, 4}, storage::MIN_BLOCK_SIZE);
+  storage::DataTable table(block_store_, layout);
+  const uint32_t num_rows = layout.num_slots_ * 3;
+  std::vector<int64_t> keys(num_rows);
+  std::vector<int32_t> values(num_rows);
+  for (uint32_t i = 0; i < num_rows; i++) {
+    keys[i] = i;
+    values[i] = static_cast<int32_t>(i % 100);
+  }
+  std::vector<storage::TupleSlot> slots;
+  storage::BulkLoader::BulkLoad(
+      &table,
+      {{1, reinterpret_cast<const byte *>(keys.data())},
+       {2, reinterpret_cast<const byte *>(values.data())}},
+      num_rows, &slots);
+  // 第一个block是原来的insertion head，不是frozen的
+  ASSERT_TRUE(table.CompressBlock(slots[layout.num_slots_].GetBlock()));
+
+  const int64_t fill = 42;
+  uint16_t new_col = table.AddColumn(8, reinterpret_cast<const byte *>(&fill));
+  EXPECT_EQ(new_col, 3);
+  const storage::BlockLayout &current = table.GetBlockLayout();
+  EXPECT_EQ(current.num_slots_, layout.num_slots_);
+
+  std::vector<uint16_t> col_ids{1, 3};
+  std::vector<byte> buffer(storage::ProjectedRow::Size(current, col_ids));
+  auto *row = storage::ProjectedRow::InitializeProjectedRow(buffer.data(),
+                                                            current, col_ids);
+  auto *redo = storage::ProjectedRow::InitializeProjectedRow(
+      new byte[buffer.size()], current, col_ids);
+  *reinterpret_cast<int64_t *>(redo->AccessForceNotNull(0)) = -1;
+  *reinterpret_cast<int64_t *>(redo->AccessForceNotNull(1)) = 7;
+  auto new_undo = [&](timestamp_t timestamp) {
+    return undos_.NewUndo(timestamp, current, col_ids);
+  };
+  storage::TupleSlot inserted = table.Insert(*redo, new_undo(0));
+  // 老block里还没有新列
+  EXPECT_FALSE(table.Update(slots[5], *redo, new_undo(1)));
+
+  auto check = [&](bool migrated) {
+    for (uint32_t i = 0; i < num_rows; i++) {
+      table.Select(2, slots[i], row);
+      EXPECT_EQ(*reinterpret_cast<int64_t *>(row->AccessWithNullCheck(0)), i);
+      EXPECT_EQ(*reinterpret_cast<int64_t *>(row->AccessWithNullCheck(1)),
+                migrated && i == 5 ? 7 : fill);
+    }
+    table.Select(2, inserted, row);
+    EXPECT_EQ(*reinterpret_cast<int64_t *>(row->AccessWithNullCheck(1)), 7);
+
+    uint32_t num_matches = 0;
+    table.Scan(2, {{3, storage::PredicateType::EQUAL, fill}}, row,
+               [&](const storage::TupleSlot &, const storage::ProjectedRow &) {
+                 num_matches++;
+               });
+    EXPECT_EQ(num_matches, migrated ? num_rows - 1 : num_rows);
+    num_matches = 0;
+    uint32_t blocks_read =
+        table.Scan(2, {{3, storage::PredicateType::LESS, 10}}, row,
+                   [&](const storage::TupleSlot &,
+                       const storage::ProjectedRow &) { num_matches++; });
+    EXPECT_EQ(num_matches, migrated ? 2 : 1);
+    if (!migrated) {
+      EXPECT_EQ(blocks_read, 1);
+    }
+  };
+  check(false);
+
+  FILE *file = tmpfile();
+  ASSERT_NE(file, nullptr);
+  EXPECT_EQ(storage::ExportSnapshot(&table, 2, {3}, fileno(file)),
+            num_rows + 1);
+  ASSERT_EQ(lseek(fileno(file), 0, SEEK_SET), 0);
+  storage::SnapshotReader reader(fileno(file));
+  std::vector<int64_t> exported;
+  while (reader.NextChunk()) {
+    auto *column = reinterpret_cast<const int64_t *>(reader.Values(0));
+    exported.insert(exported.end(), column, column + reader.NumRows());
+  }
+  fclose(file);
+  EXPECT_EQ(std::count(exported.begin(), exported.end(), fill), num_rows);
+  EXPECT_EQ(std::count(exported.begin(), exported.end(), 7), 1);
+
+  table.DropColumn(2);
+  EXPECT_FALSE(table.GetBlockLayout().HasColumn(2));
+  EXPECT_EQ(table.MigrateBlocks(1), 1);
+  EXPECT_GT(table.MigrateBlocks(100), 0);
+  EXPECT_EQ(table.MigrateBlocks(100), 0);
+  EXPECT_TRUE(table.Update(slots[5], *redo, new_undo(1)));
+  *reinterpret_cast<int64_t *>(redo->AccessForceNotNull(0)) = 5;
+  EXPECT_TRUE(table.Update(slots[5], *redo, new_undo(1)));
+  check(true);
+  delete[] reinterpret_cast<byte *>(redo);
+}
+
+// A column that no longer fits the old block size moves tuples into bigger
+// blocks on migration; the slots handed out before still compare and hash
+// equal to the ones Scan hands out afterwards.
+TEST_F(DataTableTests, SlotsStableAcrossBlockSizes) {
+  storage::BlockLayout layout(2, {8, 8}, storage::MIN_BLOCK_SIZE);
+  storage::DataTable table(block_store_, layout);
+  const uint32_t num_rows = layout.num_slots_ * 3;
+  std::vector<int64_t> keys(num_rows);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::vector<storage::TupleSlot> slots;
+  storage::BulkLoader::BulkLoad(
+      &table, {{1, reinterpret_cast<const byte *>(keys.data())}}, num_rows,
+      &slots);
+  table.AddColumn(8);
+  ASSERT_GT(table.GetBlockLayout().block_size_, layout.block_size_);
+  while (table.MigrateBlocks(100) != 0) {
+  }
+
+  std::unordered_map<storage::TupleSlot, int64_t> loaded;
+  for (uint32_t i = 0; i < num_rows; i++) {
+    loaded[slots[i]] = i;
+  }
+  std::vector<uint16_t> col_ids{1};
+  std::vector<byte> buffer(
+      storage::ProjectedRow::Size(table.GetBlockLayout(), col_ids));
+  auto *row = storage::ProjectedRow::InitializeProjectedRow(
+      buffer.data(), table.GetBlockLayout(), col_ids);
+  uint32_t num_found = 0;
+  table.Scan(0, {}, row,
+             [&](const storage::TupleSlot &slot,
+                 const storage::ProjectedRow &scanned) {
+               auto it = loaded.find(slot);
+               ASSERT_NE(it, loaded.end());
+               EXPECT_EQ(*reinterpret_cast<const int64_t *>(
+                             scanned.AccessWithNullCheck(0)),
+                         it->second);
+               num_found++;
+             });
+  EXPECT_EQ(num_found, num_rows);
+}
+
 } // namespace noisepage
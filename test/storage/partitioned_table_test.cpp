@@ -0,0 +1,246 @@
+#include "common/concurrent_bitmap.h"
+#include "storage/partitioned_table.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <vector>
+
+namespace noisepage {
+class PartitionedTableTests : public ::testing::Test {
+public:
+  storage::BlockStore block_store_{100};
+  storage::BlockLayout layout_{3, {8, 8, 4}, storage::MIN_BLOCK_SIZE};
+  storage::ProjectedRowInitializer initializer_{layout_, {1, 2}};
+  std::default_random_engine generator_;
+  std::vector<std::unique_ptr<byte[]>> buffers_;
+  std::mutex buffer_latch_;
+
+  storage::TupleSlot Insert(storage::PartitionedTable *table, int64_t key,
+                            int32_t value, uint32_t *partition = nullptr) {
+    byte *redo_buffer = NewBuffer(initializer_.ProjectedRowSize());
+    auto *redo = initializer_.InitializeRow(redo_buffer);
+    *reinterpret_cast<int64_t *>(redo->AccessForceNotNull(0)) = key;
+    *reinterpret_cast<int32_t *>(redo->AccessForceNotNull(1)) = value;
+    auto *undo = storage::DeltaRecord::InitializeDeltaRecord(
+        NewBuffer(storage::DeltaRecord::Size(initializer_)), 0, initializer_);
+    return table->Insert(*redo, undo, partition);
+  }
+
+  uint32_t Count(storage::PartitionedTable *table,
+                 const std::vector<storage::ColumnPredicate> &predicates,
+                 uint32_t *blocks_read = nullptr) {
+    std::vector<byte> buffer(initializer_.ProjectedRowSize());
+    auto *row = initializer_.InitializeRow(buffer.data());
+    uint32_t matched = 0;
+    uint32_t blocks = table->Scan(
+        0, predicates, row,
+        [&](const storage::TupleSlot &, const storage::ProjectedRow &) {
+          matched++;
+        });
+    if (blocks_read != nullptr) {
+      *blocks_read = blocks;
+    }
+    return matched;
+  }
+
+private:
+  byte *NewBuffer(uint32_t size) {
+    std::lock_guard<std::mutex> lock(buffer_latch_);
+    buffers_.emplace_back(new byte[size]);
+    return buffers_.back().get();
+  }
+};
+
+// Rows land in the partition of their key range, null keys in the first,
+// and scans only read the partitions a key predicate can match.
+TEST_F(PartitionedTableTests, RangeRoutingAndPruning) {
+  storage::PartitionedTable table(
+      block_store_, layout_, storage::PartitionScheme::Range(1, {1000, 2000}));
+  ASSERT_EQ(table.NumPartitions(), 3);
+  EXPECT_EQ(table.PartitionOf(-5), 0);
+  EXPECT_EQ(table.PartitionOf(999), 0);
+  EXPECT_EQ(table.PartitionOf(1000), 1);
+  EXPECT_EQ(table.PartitionOf(2000), 2);
+
+  const uint32_t num_rows = 3000;
+  std::vector<int64_t> keys(num_rows);
+  std::vector<int32_t> values(num_rows);
+  std::vector<uint8_t> present(BitmapSize(num_rows));
+  // 倒着放，分区之后顺序要对得上
+  for (uint32_t i = 0; i < num_rows; i++) {
+    keys[i] = num_rows - 1 - i;
+    values[i] = static_cast<int32_t>(generator_() % 100);
+    if (i % 100 != 7) {
+      present[i / BYTE_SIZE] |= ONE_HOT_MASK(i % BYTE_SIZE);
+    }
+  }
+  std::vector<storage::TupleSlot> slots;
+  table.BulkLoad({{1, reinterpret_cast<const byte *>(keys.data()),
+                   present.data()},
+                  {2, reinterpret_cast<const byte *>(values.data())}},
+                 num_rows, &slots);
+  ASSERT_EQ(slots.size(), num_rows);
+
+  std::vector<byte> buffer(initializer_.ProjectedRowSize());
+  auto *row = initializer_.InitializeRow(buffer.data());
+  for (uint32_t i = 0; i < num_rows; i++) {
+    bool null = i % 100 == 7;
+    table.Partition(null ? 0 : table.PartitionOf(keys[i]))
+        .Select(0, slots[i], row);
+    const byte *key = row->AccessWithNullCheck(0);
+    ASSERT_EQ(key == nullptr, null);
+    if (!null) {
+      EXPECT_EQ(*reinterpret_cast<const int64_t *>(key), keys[i]);
+    }
+    EXPECT_EQ(*reinterpret_cast<const int32_t *>(row->AccessWithNullCheck(1)),
+              values[i]);
+  }
+
+  std::vector<storage::ColumnPredicate> middle{
+      {1, storage::PredicateType::BETWEEN, 1200, 1500}};
+  EXPECT_FALSE(table.MayMatch(0, middle));
+  EXPECT_TRUE(table.MayMatch(1, middle));
+  EXPECT_FALSE(table.MayMatch(2, middle));
+  uint32_t expected = 0;
+  for (uint32_t i = 0; i < num_rows; i++) {
+    expected += i % 100 != 7 && keys[i] >= 1200 && keys[i] <= 1500;
+  }
+  uint32_t blocks_read;
+  EXPECT_EQ(Count(&table, middle, &blocks_read), expected);
+  EXPECT_LE(blocks_read, table.Partition(1).NumBlocks());
+
+  std::vector<storage::ColumnPredicate> upper{
+      {1, storage::PredicateType::GREATER_EQUAL, 2000},
+      {2, storage::PredicateType::LESS, 50}};
+  EXPECT_FALSE(table.MayMatch(0, upper));
+  EXPECT_FALSE(table.MayMatch(1, upper));
+  expected = 0;
+  for (uint32_t i = 0; i < num_rows; i++) {
+    expected += i % 100 != 7 && keys[i] >= 2000 && values[i] < 50;
+  }
+  EXPECT_EQ(Count(&table, upper), expected);
+  EXPECT_EQ(Count(&table, {{1, storage::PredicateType::LESS, -10}}), 0);
+}
+
+// Hash partitions can only be pruned by equality: EQUAL and IN read the
+// partitions of their keys, ranges read everything.
+TEST_F(PartitionedTableTests, HashRoutingAndPruning) {
+  storage::PartitionedTable table(block_store_, layout_,
+                                  storage::PartitionScheme::Hash(1, 4));
+  std::vector<uint32_t> rows_per_partition(4);
+  for (int64_t key = 0; key < 400; key++) {
+    uint32_t partition;
+    storage::TupleSlot slot =
+        Insert(&table, key, static_cast<int32_t>(key % 10), &partition);
+    ASSERT_EQ(partition, table.PartitionOf(key));
+    rows_per_partition[partition]++;
+
+    std::vector<byte> buffer(initializer_.ProjectedRowSize());
+    auto *row = initializer_.InitializeRow(buffer.data());
+    table.Partition(partition).Select(0, slot, row);
+    EXPECT_EQ(*reinterpret_cast<const int64_t *>(row->AccessWithNullCheck(0)),
+              key);
+  }
+  // 连续的key应该大致均匀
+  for (uint32_t partition = 0; partition < 4; partition++) {
+    EXPECT_GT(rows_per_partition[partition], 50);
+  }
+
+  for (int64_t key : {0, 17, 399}) {
+    std::vector<storage::ColumnPredicate> equal{
+        {1, storage::PredicateType::EQUAL, key}};
+    for (uint32_t partition = 0; partition < 4; partition++) {
+      EXPECT_EQ(table.MayMatch(partition, equal),
+                partition == table.PartitionOf(key));
+    }
+    EXPECT_EQ(Count(&table, equal), 1);
+  }
+
+  std::vector<storage::ColumnPredicate> in{{1, {3, 4, 1000}}};
+  for (uint32_t partition = 0; partition < 4; partition++) {
+    EXPECT_EQ(table.MayMatch(partition, in),
+              partition == table.PartitionOf(3) ||
+                  partition == table.PartitionOf(4) ||
+                  partition == table.PartitionOf(1000));
+  }
+  EXPECT_EQ(Count(&table, in), 2);
+
+  std::vector<storage::ColumnPredicate> range{
+      {1, storage::PredicateType::BETWEEN, 100, 199},
+      {2, storage::PredicateType::EQUAL, 3}};
+  for (uint32_t partition = 0; partition < 4; partition++) {
+    EXPECT_TRUE(table.MayMatch(partition, range));
+  }
+  EXPECT_EQ(Count(&table, range), 10);
+}
+
+// Loading and scanning on a scheduler visits every row exactly once, also
+// with inserts added from the workers afterwards.
+TEST_F(PartitionedTableTests, ParallelLoadAndScan) {
+  Scheduler scheduler(4);
+  storage::PartitionedTable table(block_store_, layout_,
+                                  storage::PartitionScheme::Hash(1, 8));
+  table.SetHomeWorker(7, 0);
+  EXPECT_EQ(table.HomeWorker(7), 0);
+  EXPECT_EQ(table.HomeWorker(5), 5);
+
+  const uint32_t num_loaded = 20000, num_inserted = 2000;
+  std::vector<int64_t> keys(num_loaded);
+  std::vector<int32_t> values(num_loaded);
+  for (uint32_t i = 0; i < num_loaded; i++) {
+    keys[i] = i;
+    values[i] = static_cast<int32_t>(generator_() % 100);
+  }
+  std::vector<storage::TupleSlot> slots;
+  table.ParallelBulkLoad({{1, reinterpret_cast<const byte *>(keys.data())},
+                          {2, reinterpret_cast<const byte *>(values.data())}},
+                         num_loaded, &scheduler, &slots);
+  ASSERT_EQ(slots.size(), num_loaded);
+  std::vector<byte> buffer(initializer_.ProjectedRowSize());
+  auto *row = initializer_.InitializeRow(buffer.data());
+  for (uint32_t i = 0; i < num_loaded; i++) {
+    table.Partition(table.PartitionOf(keys[i])).Select(0, slots[i], row);
+    EXPECT_EQ(*reinterpret_cast<const int64_t *>(row->AccessWithNullCheck(0)),
+              keys[i]);
+  }
+
+  scheduler.ParallelFor(0, num_inserted, 64, [&](uint64_t begin, uint64_t end) {
+    for (uint64_t key = num_loaded + begin; key < num_loaded + end; key++) {
+      Insert(&table, static_cast<int64_t>(key), static_cast<int32_t>(key % 2));
+    }
+  });
+
+  std::vector<storage::ColumnPredicate> predicates{
+      {2, storage::PredicateType::LESS, 50}};
+  uint32_t expected_blocks;
+  uint32_t expected = Count(&table, predicates, &expected_blocks);
+  std::vector<std::atomic<uint32_t>> seen(num_loaded + num_inserted);
+  std::atomic<uint32_t> matched{0};
+  uint32_t blocks_read = table.ParallelScan(
+      &scheduler, 0, predicates, initializer_,
+      [&](const storage::TupleSlot &, const storage::ProjectedRow &row) {
+        auto key = *reinterpret_cast<const int64_t *>(
+            row.AccessWithNullCheck(0));
+        seen[key]++;
+        matched++;
+      });
+  EXPECT_EQ(blocks_read, expected_blocks);
+  EXPECT_EQ(matched.load(), expected);
+  for (uint32_t i = 0; i < num_loaded + num_inserted; i++) {
+    bool match = i < num_loaded ? values[i] < 50 : true;
+    EXPECT_EQ(seen[i].load(), match ? 1 : 0);
+  }
+
+  std::vector<storage::ColumnPredicate> one{
+      {1, storage::PredicateType::EQUAL, 12345}};
+  matched = 0;
+  table.ParallelScan(
+      &scheduler, 0, one, initializer_,
+      [&](const storage::TupleSlot &, const storage::ProjectedRow &) {
+        matched++;
+      });
+  EXPECT_EQ(matched.load(), 1);
+}
+} // namespace noisepage
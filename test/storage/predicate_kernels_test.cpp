@@ -0,0 +1,124 @@
+#include "storage/predicate_kernels.h"
+#include "storage/storage_test_util.h"
+#include "gtest/gtest.h"
+#include <random>
+
+namespace noisepage {
+struct PredicateKernelsTests : public ::testing::Test {
+  std::default_random_engine generator_;
+
+  std::vector<storage::SimdLevel> SupportedLevels() {
+    std::vector<storage::SimdLevel> levels{storage::SimdLevel::SCALAR};
+    auto best = storage::PredicateKernels::DetectSimdLevel();
+    if (best >= storage::SimdLevel::SSE4) {
+      levels.push_back(storage::SimdLevel::SSE4);
+    }
+    if (best >= storage::SimdLevel::AVX2) {
+      levels.push_back(storage::SimdLevel::AVX2);
+    }
+    return levels;
+  }
+
+  storage::ColumnPredicate RandomPredicate() {
+    std::uniform_int_distribution<int64_t> val_dist(-25, 25);
+    auto type = static_cast<storage::PredicateType>(
+        std::uniform_int_distribution<uint8_t>(
+            0, static_cast<uint8_t>(storage::PredicateType::IN))(generator_));
+    if (type == storage::PredicateType::IN) {
+      std::vector<int64_t> in_list;
+      for (uint32_t i = 0; i < 4; i++) {
+        in_list.push_back(val_dist(generator_));
+      }
+      // values that do not fit in narrow columns must never match
+      in_list.push_back(INT64_MAX);
+      return {1, in_list};
+    }
+    int64_t lo = val_dist(generator_);
+    return {1, type, lo, lo + val_dist(generator_) + 25};
+  }
+};
+
+// Every SIMD level must agree bit for bit with evaluating the predicate one
+// slot at a time.
+TEST_F(PredicateKernelsTests, MatchesReference) {
+  const uint32_t repeat = 200;
+  const uint32_t max_slots = 2000;
+  std::vector<uint8_t> possible_sizes{1, 2, 4, 8};
+  for (uint32_t i = 0; i < repeat; i++) {
+    uint32_t num_slots =
+        std::uniform_int_distribution<uint32_t>(1, max_slots)(generator_);
+    uint8_t attr_size =
+        *testutil::UniformRandomElement(possible_sizes, generator_);
+    auto predicate = RandomPredicate();
+
+    std::vector<byte> column(num_slots * attr_size);
+    std::vector<uint8_t> nulls(BitmapSize(num_slots));
+    std::vector<uint8_t> initial(BitmapSize(num_slots));
+    testutil::FillWithRandomBytes(static_cast<uint32_t>(nulls.size()),
+                                  reinterpret_cast<byte *>(nulls.data()),
+                                  generator_);
+    testutil::FillWithRandomBytes(static_cast<uint32_t>(initial.size()),
+                                  reinterpret_cast<byte *>(initial.data()),
+                                  generator_);
+    std::uniform_int_distribution<int64_t> val_dist(-30, 30);
+    for (uint32_t slot = 0; slot < num_slots; slot++) {
+      storage::StorageUtil::WriteBytes(
+          attr_size, static_cast<uint64_t>(val_dist(generator_)),
+          column.data() + slot * attr_size);
+    }
+    auto *null_bitmap =
+        reinterpret_cast<const RawConcurrentBitmap *>(nulls.data());
+    auto *initial_bitmap =
+        reinterpret_cast<const RawConcurrentBitmap *>(initial.data());
+
+    for (auto level : SupportedLevels()) {
+      std::vector<uint8_t> selection(BitmapSize(num_slots));
+      storage::PredicateKernels::InitializeSelection(initial_bitmap, num_slots,
+                                                     selection.data());
+      storage::PredicateKernels::Evaluate(predicate, column.data(), attr_size,
+                                          null_bitmap, num_slots,
+                                          selection.data(), level);
+      auto *result =
+          reinterpret_cast<const RawConcurrentBitmap *>(selection.data());
+      for (uint32_t slot = 0; slot < num_slots; slot++) {
+        int64_t val = storage::StorageUtil::ReadInteger(
+            attr_size, column.data() + slot * attr_size);
+        bool expected = initial_bitmap->Test(slot) &&
+                        null_bitmap->Test(slot) && predicate.Evaluate(val);
+        EXPECT_EQ(result->Test(slot), expected);
+      }
+    }
+  }
+}
+
+// Bounds outside of the range of the column type are clamped instead of
+// wrapping around.
+TEST_F(PredicateKernelsTests, ClampsToColumnType) {
+  const uint32_t num_slots = 256;
+  std::vector<int8_t> column(num_slots);
+  for (uint32_t i = 0; i < num_slots; i++) {
+    column[i] = static_cast<int8_t>(i);
+  }
+  std::vector<uint8_t> nulls(BitmapSize(num_slots), 0xFF);
+  auto *null_bitmap =
+      reinterpret_cast<const RawConcurrentBitmap *>(nulls.data());
+
+  for (auto level : SupportedLevels()) {
+    std::vector<uint8_t> selection(BitmapSize(num_slots), 0xFF);
+    storage::PredicateKernels::Evaluate(
+        {1, storage::PredicateType::LESS, 1000},
+        reinterpret_cast<const byte *>(column.data()), 1, null_bitmap,
+        num_slots, selection.data(), level);
+    for (auto bits : selection) {
+      EXPECT_EQ(bits, 0xFF);
+    }
+    storage::PredicateKernels::Evaluate(
+        {1, storage::PredicateType::EQUAL, 256},
+        reinterpret_cast<const byte *>(column.data()), 1, null_bitmap,
+        num_slots, selection.data(), level);
+    for (auto bits : selection) {
+      EXPECT_EQ(bits, 0);
+    }
+  }
+}
+} // namespace noisepage
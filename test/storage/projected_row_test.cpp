@@ -1,6 +1,7 @@
 #include "storage/storage_defs.h"
 #include "storage/storage_test_util.h"
 #include "gtest/gtest.h"
+#include <algorithm>
 #include <random>
 
 namespace noisepage {
@@ -31,4 +32,58 @@ TEST_F(ProjectedRowTests, SimpleTest) {
     // testutil::PrintRow(redo, layout);
   }
 }
+
+// Rows stamped out by the initializer look like hand-built ones of the same
+// projection, just with columns ordered by size and values aligned.
+TEST_F(ProjectedRowTests, InitializerTest) {
+  std::default_random_engine generator;
+  const uint32_t max_col = 100;
+  const uint32_t repeat = 10;
+  for (uint32_t i = 0; i < repeat; i++) {
+    storage::BlockLayout layout = testutil::RandomLayout(generator, max_col);
+    std::vector<uint16_t> col_ids;
+    for (uint16_t col_id = 1; col_id < layout.num_cols_; col_id++) {
+      if (generator() % 2 == 0) {
+        col_ids.push_back(col_id);
+      }
+    }
+    storage::ProjectedRowInitializer initializer(layout, col_ids);
+    EXPECT_EQ(initializer.NumColumns(), col_ids.size());
+    EXPECT_EQ(initializer.ProjectedRowSize() % 8, 0);
+    EXPECT_GE(initializer.ProjectedRowSize(),
+              storage::ProjectedRow::Size(layout, col_ids));
+
+    std::vector<byte> buffer(initializer.ProjectedRowSize(), byte{0xFF});
+    storage::ProjectedRow *row = initializer.InitializeRow(buffer.data());
+    ASSERT_EQ(row->NumColumns(), col_ids.size());
+    for (uint16_t j = 0; j < row->NumColumns(); j++) {
+      uint16_t col_id = row->ColumnIds()[j];
+      EXPECT_EQ(col_id, initializer.ColumnIds()[j]);
+      EXPECT_NE(std::find(col_ids.begin(), col_ids.end(), col_id),
+                col_ids.end());
+      if (j > 0) {
+        EXPECT_GE(layout.attr_sizes_[row->ColumnIds()[j - 1]],
+                  layout.attr_sizes_[col_id]);
+      }
+      uint32_t alignment = std::min<uint32_t>(layout.attr_sizes_[col_id], 8);
+      EXPECT_EQ(row->AttrValueOffset()[j] % alignment, 0);
+      EXPECT_LE(row->AttrValueOffset()[j] + layout.attr_sizes_[col_id],
+                initializer.ProjectedRowSize());
+      EXPECT_EQ(row->AccessWithNullCheck(j), nullptr);
+    }
+    testutil::PopulateRandomRow(row, layout, 0.1, generator);
+
+    // undo record里的row和单独的row一样
+    std::vector<byte> undo_buffer(storage::DeltaRecord::Size(initializer));
+    storage::DeltaRecord *undo = storage::DeltaRecord::InitializeDeltaRecord(
+        undo_buffer.data(), 7, initializer);
+    EXPECT_EQ(undo->timestamp_, 7);
+    EXPECT_EQ(undo->next_, nullptr);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(undo->Delta()) % 8, 0);
+    row = initializer.InitializeRow(buffer.data());
+    EXPECT_EQ(std::memcmp(undo->Delta(), row,
+                          storage::ProjectedRow::HeaderSize(row->NumColumns())),
+              0);
+  }
+}
 } // namespace noisepage
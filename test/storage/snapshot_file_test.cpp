@@ -0,0 +1,261 @@
+#include "common/test_util.h"
+#include "storage/bulk_loader.h"
+#include "storage/data_table.h"
+#include "storage/snapshot_file.h"
+#include "storage/storage_test_util.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <unistd.h>
+
+namespace noisepage {
+struct SnapshotFileTests : public ::testing::Test {
+  storage::BlockStore block_store_{100};
+  storage::BlockLayout layout_{5, {8, 8, 4, 16, 2}, storage::MIN_BLOCK_SIZE};
+  std::vector<uint16_t> all_col_ids_{
+      testutil::ProjectionListAllColumns(layout_)};
+  std::default_random_engine generator_;
+
+  // 每列随机给一些null，最后一列不给，全是null
+  std::vector<storage::TupleSlot> BulkLoad(storage::DataTable *table,
+                                           uint32_t num_rows) {
+    std::bernoulli_distribution coin(0.8);
+    std::vector<storage::BulkLoadColumn> columns;
+    for (uint16_t col_id = 1; col_id + 1 < layout_.num_cols_; col_id++) {
+      values_.emplace_back(num_rows * layout_.attr_sizes_[col_id]);
+      testutil::FillWithRandomBytes(
+          static_cast<uint32_t>(values_.back().size()), values_.back().data(),
+          generator_);
+      present_.emplace_back(BitmapSize(num_rows));
+      for (uint32_t row = 0; row < num_rows; row++) {
+        if (coin(generator_)) {
+          present_.back()[row / BYTE_SIZE] |= ONE_HOT_MASK(row % BYTE_SIZE);
+        }
+      }
+      columns.push_back({col_id, values_.back().data(),
+                         present_.back().data()});
+    }
+    std::vector<storage::TupleSlot> slots;
+    storage::BulkLoader::BulkLoad(table, columns, num_rows, &slots);
+    return slots;
+  }
+
+  void Update(storage::DataTable *table, const storage::TupleSlot &slot,
+              timestamp_t timestamp) {
+    std::vector<uint16_t> col_ids =
+        testutil::ProjectionListRandomColumns(layout_, generator_);
+    std::vector<byte> redo_buffer(
+        storage::ProjectedRow::Size(layout_, col_ids));
+    auto *redo = storage::ProjectedRow::InitializeProjectedRow(
+        redo_buffer.data(), layout_, col_ids);
+    testutil::PopulateRandomRow(redo, layout_, 0.2, generator_);
+    undo_buffers_.emplace_back(storage::DeltaRecord::Size(layout_, col_ids));
+    auto *undo = storage::DeltaRecord::InitializeDeltaRecord(
+        undo_buffers_.back().data(), timestamp, layout_, col_ids);
+    ASSERT_TRUE(table->Update(slot, *redo, undo));
+  }
+
+  // 导出到临时文件再读回来，每一行都要和Select的结果一样
+  void ExportAndCompare(storage::DataTable *table, timestamp_t timestamp,
+                        const std::vector<uint16_t> &col_ids,
+                        const std::vector<storage::TupleSlot> &slots,
+                        uint64_t buffer_size) {
+    FILE *file = tmpfile();
+    ASSERT_NE(file, nullptr);
+    int fd = fileno(file);
+    EXPECT_EQ(storage::ExportSnapshot(table, timestamp, col_ids, fd,
+                                      buffer_size),
+              slots.size());
+    ASSERT_EQ(lseek(fd, 0, SEEK_SET), 0);
+
+    // 部分列的Select不能apply别的列的delta，所以读整行
+    std::vector<byte> buffer(
+        storage::ProjectedRow::Size(layout_, all_col_ids_));
+    auto *row = storage::ProjectedRow::InitializeProjectedRow(
+        buffer.data(), layout_, all_col_ids_);
+    storage::SnapshotReader reader(fd);
+    EXPECT_EQ(reader.Timestamp(), timestamp);
+    ASSERT_EQ(reader.ColumnIds(), col_ids);
+    uint64_t r = 0;
+    while (reader.NextChunk()) {
+      for (uint16_t i = 0; i < col_ids.size(); i++) {
+        const uint8_t *present = reader.Present(i);
+        uint32_t n = reader.NumRows();
+        if (n % BYTE_SIZE != 0) {
+          EXPECT_EQ(present[n / BYTE_SIZE] & (0xFF >> (n % BYTE_SIZE)), 0);
+        }
+      }
+      for (uint32_t k = 0; k < reader.NumRows(); k++, r++) {
+        ASSERT_LT(r, slots.size());
+        table->Select(timestamp, slots[r], row);
+        for (uint16_t i = 0; i < col_ids.size(); i++) {
+          uint16_t attr_size = reader.AttrSizes()[i];
+          ASSERT_EQ(attr_size, layout_.attr_sizes_[col_ids[i]]);
+          const byte *attr = row->AccessWithNullCheck(
+              static_cast<uint16_t>(col_ids[i] - 1));
+          bool present =
+              reader.Present(i)[k / BYTE_SIZE] & ONE_HOT_MASK(k % BYTE_SIZE);
+          ASSERT_EQ(present, attr != nullptr);
+          if (present) {
+            EXPECT_EQ(std::memcmp(reader.Values(i) +
+                                      static_cast<uint64_t>(k) * attr_size,
+                                  attr, attr_size),
+                      0);
+          }
+        }
+      }
+    }
+    EXPECT_EQ(r, slots.size());
+    fclose(file);
+  }
+
+private:
+  std::vector<std::vector<byte>> values_;
+  std::vector<std::vector<uint8_t>> present_;
+  std::vector<std::vector<byte>> undo_buffers_;
+};
+
+// Bulk-loaded and inserted rows, some of them updated after the snapshot,
+// come back in block order exactly as Select sees them, whether every chunk
+// is written on its own or many go out in one writev.
+TEST_F(SnapshotFileTests, ExportMatchesSelect) {
+  storage::DataTable table(block_store_, layout_);
+  std::vector<storage::TupleSlot> slots =
+      BulkLoad(&table, layout_.num_slots_ * 5 / 2);
+  std::vector<byte> redo_buffer(
+      storage::ProjectedRow::Size(layout_, all_col_ids_));
+  auto *redo = storage::ProjectedRow::InitializeProjectedRow(
+      redo_buffer.data(), layout_, all_col_ids_);
+  std::vector<std::vector<byte>> insert_undos;
+  for (uint32_t i = 0; i < layout_.num_slots_; i++) {
+    testutil::PopulateRandomRow(redo, layout_, 0.2, generator_);
+    insert_undos.emplace_back(
+        storage::DeltaRecord::Size(layout_, all_col_ids_));
+    slots.push_back(table.Insert(
+        *redo, storage::DeltaRecord::InitializeDeltaRecord(
+                   insert_undos.back().data(), 0, layout_, all_col_ids_)));
+  }
+  for (uint32_t r = 0; r < slots.size(); r += 5) {
+    Update(&table, slots[r], 10);
+  }
+
+  for (timestamp_t timestamp : {timestamp_t(5), timestamp_t(20)}) {
+    for (uint64_t buffer_size :
+         {uint64_t(1), storage::SnapshotWriter::DEFAULT_BUFFER_SIZE}) {
+      ExportAndCompare(&table, timestamp, all_col_ids_, slots, buffer_size);
+      ExportAndCompare(&table, timestamp, {3, 1}, slots, buffer_size);
+    }
+  }
+}
+
+// Compressed blocks are exported from their encoded copy, also after a
+// writer decompressed one again.
+TEST_F(SnapshotFileTests, CompressedBlocks) {
+  storage::DataTable table(block_store_, layout_);
+  std::vector<storage::TupleSlot> slots =
+      BulkLoad(&table, layout_.num_slots_ * 3);
+  // 第一个block是bulk load之前的insertion head，不是frozen的
+  for (uint32_t r = layout_.num_slots_; r < slots.size();
+       r += layout_.num_slots_) {
+    ASSERT_TRUE(table.CompressBlock(slots[r].GetBlock()));
+  }
+  ExportAndCompare(&table, 5, all_col_ids_, slots,
+                   storage::SnapshotWriter::DEFAULT_BUFFER_SIZE);
+  Update(&table, slots[layout_.num_slots_ + 3], 10);
+  ExportAndCompare(&table, 5, all_col_ids_, slots,
+                   storage::SnapshotWriter::DEFAULT_BUFFER_SIZE);
+  ExportAndCompare(&table, 20, {2, 4}, slots,
+                   storage::SnapshotWriter::DEFAULT_BUFFER_SIZE);
+}
+
+// Rows updated while the export is copying their block still come out as
+// of the snapshot.
+TEST_F(SnapshotFileTests, ConcurrentUpdates) {
+  storage::DataTable table(block_store_, layout_);
+  std::vector<storage::TupleSlot> slots =
+      BulkLoad(&table, layout_.num_slots_ * 8);
+  std::vector<uint16_t> col_ids{1, 2};
+  std::vector<byte> buffer(storage::ProjectedRow::Size(layout_, col_ids));
+  auto *row = storage::ProjectedRow::InitializeProjectedRow(buffer.data(),
+                                                            layout_, col_ids);
+  std::vector<std::vector<byte>> expected;
+  for (const auto &slot : slots) {
+    table.Select(0, slot, row);
+    expected.emplace_back(reinterpret_cast<byte *>(row),
+                          reinterpret_cast<byte *>(row) + buffer.size());
+  }
+
+  // 更新几轮，让export有机会碰上正在被改的block
+  const uint32_t num_rounds = 4;
+  std::vector<uint16_t> update_col_ids{1};
+  uint32_t undo_size = storage::DeltaRecord::Size(layout_, update_col_ids);
+  std::vector<byte> undo_buffers(num_rounds * slots.size() * undo_size);
+  std::atomic<bool> done{false};
+  std::thread writer([&] {
+    std::vector<byte> redo_buffer(
+        storage::ProjectedRow::Size(layout_, update_col_ids));
+    auto *redo = storage::ProjectedRow::InitializeProjectedRow(
+        redo_buffer.data(), layout_, update_col_ids);
+    byte *undo = undo_buffers.data();
+    for (uint32_t round = 0; round < num_rounds; round++) {
+      storage::StorageUtil::WriteBytes(8, UINT64_MAX - round,
+                                       redo->AccessForceNotNull(0));
+      for (const auto &slot : slots) {
+        table.Update(slot, *redo,
+                     storage::DeltaRecord::InitializeDeltaRecord(
+                         undo, 100 + round, layout_, update_col_ids));
+        undo += undo_size;
+      }
+    }
+    done.store(true);
+  });
+
+  // 线程还在跑，不能用ASSERT中途退出
+  uint64_t num_mismatches = 0;
+  do {
+    FILE *file = tmpfile();
+    int fd = fileno(file);
+    EXPECT_EQ(storage::ExportSnapshot(&table, 50, col_ids, fd), slots.size());
+    lseek(fd, 0, SEEK_SET);
+    storage::SnapshotReader reader(fd);
+    uint64_t r = 0;
+    while (reader.NextChunk()) {
+      for (uint32_t k = 0; k < reader.NumRows(); k++, r++) {
+        auto *expected_row =
+            reinterpret_cast<storage::ProjectedRow *>(expected[r].data());
+        for (uint16_t i = 0; i < col_ids.size(); i++) {
+          const byte *attr = expected_row->AccessWithNullCheck(i);
+          bool present =
+              reader.Present(i)[k / BYTE_SIZE] & ONE_HOT_MASK(k % BYTE_SIZE);
+          uint16_t attr_size = reader.AttrSizes()[i];
+          if (present != (attr != nullptr) ||
+              (present && std::memcmp(reader.Values(i) +
+                                          static_cast<uint64_t>(k) * attr_size,
+                                      attr, attr_size) != 0)) {
+            num_mismatches++;
+          }
+        }
+      }
+    }
+    EXPECT_EQ(r, slots.size());
+    fclose(file);
+  } while (!done.load());
+  writer.join();
+  EXPECT_EQ(num_mismatches, 0);
+}
+
+// Anything that does not start with the magic is rejected.
+TEST_F(SnapshotFileTests, RejectsGarbage) {
+  FILE *file = tmpfile();
+  ASSERT_NE(file, nullptr);
+  const char garbage[] = "definitely not a snapshot";
+  ASSERT_EQ(fwrite(garbage, 1, sizeof(garbage), file), sizeof(garbage));
+  fflush(file);
+  ASSERT_EQ(lseek(fileno(file), 0, SEEK_SET), 0);
+  EXPECT_THROW(storage::SnapshotReader reader(fileno(file)),
+               std::runtime_error);
+  fclose(file);
+}
+} // namespace noisepage
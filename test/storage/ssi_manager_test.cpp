@@ -0,0 +1,299 @@
+#include "common/test_util.h"
+#include "storage/bulk_loader.h"
+#include "storage/ssi_manager.h"
+#include "storage/timestamp_manager.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace noisepage {
+class SsiManagerTests : public ::testing::Test {
+public:
+  storage::BlockStore block_store_{10};
+  storage::BlockLayout layout_{2, {8, 8}, storage::MIN_BLOCK_SIZE};
+  storage::ProjectedRowInitializer initializer_{layout_, {1}};
+  testutil::UndoBuffers undos_;
+
+  int64_t Read(storage::SsiManager::Transaction *txn,
+               storage::DataTable *table, const storage::TupleSlot &slot) {
+    std::vector<byte> buffer(initializer_.ProjectedRowSize());
+    auto *row = initializer_.InitializeRow(buffer.data());
+    txn->Select(table, slot, row);
+    return *reinterpret_cast<const int64_t *>(row->AccessWithNullCheck(0));
+  }
+
+  bool Write(storage::SsiManager::Transaction *txn, storage::DataTable *table,
+             const storage::TupleSlot &slot, int64_t value, uint64_t txn_id) {
+    std::vector<byte> buffer(initializer_.ProjectedRowSize());
+    auto *row = initializer_.InitializeRow(buffer.data());
+    *reinterpret_cast<int64_t *>(row->AccessForceNotNull(0)) = value;
+    return txn->Update(
+        table, slot, *row,
+        undos_.NewUndo(testutil::Uncommitted(txn_id), initializer_));
+  }
+};
+
+// Two transactions that each read both accounts and withdraw from a
+// different one commit under snapshot isolation and overdraw the total;
+// under SSI the second is refused and rolled back.
+TEST_F(SsiManagerTests, WriteSkew) {
+  for (bool serializable : {false, true}) {
+    storage::DataTable table(block_store_, layout_);
+    std::vector<int64_t> balances{50, 50};
+    std::vector<storage::TupleSlot> slots;
+    storage::BulkLoader::BulkLoad(
+        &table, {{1, reinterpret_cast<const byte *>(balances.data())}}, 2,
+        &slots);
+    storage::SsiManager tested;
+    storage::SsiManager::Transaction first(1, serializable);
+    storage::SsiManager::Transaction second(1, serializable);
+    EXPECT_EQ(Read(&first, &table, slots[0]) + Read(&first, &table, slots[1]),
+              100);
+    EXPECT_EQ(
+        Read(&second, &table, slots[0]) + Read(&second, &table, slots[1]),
+        100);
+    ASSERT_TRUE(Write(&first, &table, slots[0], -50, 1));
+    ASSERT_TRUE(Write(&second, &table, slots[1], -50, 2));
+
+    EXPECT_TRUE(tested.Commit(&first, 2));
+    first.CommitWrites(2);
+    if (serializable) {
+      EXPECT_FALSE(tested.Commit(&second, 3));
+      second.Rollback();
+    } else {
+      EXPECT_TRUE(tested.Commit(&second, 3));
+      second.CommitWrites(3);
+    }
+    storage::SsiManager::Transaction check(10, false);
+    EXPECT_EQ(Read(&check, &table, slots[0]), -50);
+    EXPECT_EQ(Read(&check, &table, slots[1]), serializable ? 50 : -50);
+    EXPECT_EQ(tested.NumRetained(), serializable ? 1 : 0);
+  }
+}
+
+// A transaction reads a tuple, another overwrites it blindly and commits,
+// then the first writes back what it computed from its read. Its update must
+// fail rather than lose the committed one, under either isolation level.
+TEST_F(SsiManagerTests, LostUpdate) {
+  for (bool serializable : {false, true}) {
+    storage::DataTable table(block_store_, layout_);
+    std::vector<int64_t> values{100};
+    std::vector<storage::TupleSlot> slots;
+    storage::BulkLoader::BulkLoad(
+        &table, {{1, reinterpret_cast<const byte *>(values.data())}}, 1,
+        &slots);
+    storage::SsiManager tested;
+    storage::SsiManager::Transaction first(1, serializable);
+    storage::SsiManager::Transaction second(1, serializable);
+    int64_t read = Read(&first, &table, slots[0]);
+    EXPECT_EQ(read, 100);
+    ASSERT_TRUE(Write(&second, &table, slots[0], 500, 2));
+    EXPECT_TRUE(tested.Commit(&second, 2));
+    second.CommitWrites(2);
+
+    EXPECT_FALSE(Write(&first, &table, slots[0], read + 1, 1));
+    first.Rollback();
+    auto *header = reinterpret_cast<storage::Block *>(slots[0].GetBlock());
+    EXPECT_EQ(header->num_uncommitted_.load(), 0);
+    storage::SsiManager::Transaction check(10, false);
+    EXPECT_EQ(Read(&check, &table, slots[0]), 500);
+    storage::SsiManager::Transaction old(1, false);
+    EXPECT_EQ(Read(&old, &table, slots[0]), 100);
+  }
+}
+
+// Each transaction scans a key range and moves a tuple into the other's
+// range; the second to commit is refused because of the predicate read,
+// though neither read a tuple the other wrote before it.
+TEST_F(SsiManagerTests, Phantom) {
+  storage::DataTable table(block_store_, layout_);
+  std::vector<int64_t> keys{1, 2, 100, 500};
+  std::vector<storage::TupleSlot> slots;
+  storage::BulkLoader::BulkLoad(
+      &table, {{1, reinterpret_cast<const byte *>(keys.data())}}, 4, &slots);
+  std::vector<byte> buffer(initializer_.ProjectedRowSize());
+  auto *row = initializer_.InitializeRow(buffer.data());
+  auto count = [&](storage::SsiManager::Transaction *txn, int64_t lo,
+                   int64_t hi) {
+    uint32_t num = 0;
+    txn->Scan(&table, {{1, storage::PredicateType::BETWEEN, lo, hi}}, row,
+              [&](const storage::TupleSlot &, const storage::ProjectedRow &) {
+                num++;
+              });
+    return num;
+  };
+
+  storage::SsiManager tested;
+  storage::SsiManager::Transaction first(1);
+  storage::SsiManager::Transaction second(1);
+  EXPECT_EQ(count(&first, 0, 10), 2);
+  EXPECT_EQ(count(&second, 100, 199), 1);
+  ASSERT_TRUE(Write(&first, &table, slots[3], 150, 1));
+  ASSERT_TRUE(Write(&second, &table, slots[2], 5, 2));
+  EXPECT_TRUE(tested.Commit(&first, 2));
+  first.CommitWrites(2);
+  EXPECT_FALSE(tested.Commit(&second, 3));
+  second.Rollback();
+}
+
+// Transactions touching different tuples, and read-only ones, commit; Prune
+// drops what no snapshot can overlap any more.
+TEST_F(SsiManagerTests, DisjointAndPrune) {
+  storage::DataTable table(block_store_, layout_);
+  std::vector<int64_t> values{1, 2, 3};
+  std::vector<storage::TupleSlot> slots;
+  storage::BulkLoader::BulkLoad(
+      &table, {{1, reinterpret_cast<const byte *>(values.data())}}, 3, &slots);
+  storage::SsiManager tested;
+  storage::SsiManager::Transaction first(1), second(1), reader(1);
+  Read(&first, &table, slots[0]);
+  ASSERT_TRUE(Write(&first, &table, slots[0], 10, 1));
+  Read(&second, &table, slots[1]);
+  ASSERT_TRUE(Write(&second, &table, slots[1], 20, 2));
+  Read(&reader, &table, slots[0]);
+  Read(&reader, &table, slots[1]);
+  Read(&reader, &table, slots[2]);
+  EXPECT_TRUE(tested.Commit(&first, 2));
+  EXPECT_TRUE(tested.Commit(&second, 3));
+  EXPECT_TRUE(tested.Commit(&reader, 4));
+  EXPECT_EQ(tested.NumRetained(), 3);
+  tested.Prune(3);
+  EXPECT_EQ(tested.NumRetained(), 1);
+  tested.Prune(4);
+  EXPECT_EQ(tested.NumRetained(), 0);
+}
+
+// A transaction writes a tuple several times, so Update writes in place,
+// stacks an undo on its own and replaces its own; Rollback still undoes each
+// installed undo once, newest first, and keeps the transaction's insert.
+TEST_F(SsiManagerTests, RollbackRepeatedWrites) {
+  storage::BlockLayout layout(3, {8, 8, 8}, storage::MIN_BLOCK_SIZE);
+  storage::DataTable table(block_store_, layout);
+  std::vector<int64_t> keys{100}, values{200};
+  std::vector<storage::TupleSlot> slots;
+  storage::BulkLoader::BulkLoad(
+      &table,
+      {{1, reinterpret_cast<const byte *>(keys.data())},
+       {2, reinterpret_cast<const byte *>(values.data())}},
+      1, &slots);
+  const timestamp_t txn_id = testutil::Uncommitted(1);
+  storage::SsiManager::Transaction txn(1);
+  std::vector<byte> redo_buffer(storage::ProjectedRow::Size(layout, {1}));
+  // 返回undo有没有装上
+  auto write = [&](uint16_t col_id, int64_t value,
+                   const std::vector<uint16_t> &undo_col_ids) {
+    auto *redo = storage::ProjectedRow::InitializeProjectedRow(
+        redo_buffer.data(), layout, {col_id});
+    *reinterpret_cast<int64_t *>(redo->AccessForceNotNull(0)) = value;
+    bool installed = false;
+    EXPECT_TRUE(txn.Update(&table, slots[0], *redo,
+                           undos_.NewUndo(txn_id, layout, undo_col_ids),
+                           &installed));
+    return installed;
+  };
+
+  EXPECT_TRUE(write(1, 101, {1}));
+  EXPECT_FALSE(write(1, 102, {1}));
+  EXPECT_TRUE(write(2, 201, {2}));
+  // 盖住了自己的delta，换掉它
+  EXPECT_TRUE(write(1, 103, {1, 2}));
+  storage::ProjectedRowInitializer all(layout, {1, 2});
+  std::vector<byte> row_buffer(all.ProjectedRowSize());
+  auto *row = all.InitializeRow(row_buffer.data());
+  for (uint16_t i = 0; i < row->NumColumns(); i++) {
+    *reinterpret_cast<int64_t *>(row->AccessForceNotNull(i)) = -1;
+  }
+  storage::TupleSlot inserted =
+      txn.Insert(&table, *row, undos_.NewUndo(txn_id, all));
+
+  txn.Rollback();
+  txn.CommitWrites(2);
+  auto *header = reinterpret_cast<storage::Block *>(slots[0].GetBlock());
+  EXPECT_EQ(header->num_uncommitted_.load(), 0);
+  auto read = [&](const storage::TupleSlot &slot, timestamp_t timestamp) {
+    table.Select(timestamp, slot, row);
+    std::vector<int64_t> result;
+    for (uint16_t i = 0; i < row->NumColumns(); i++) {
+      result.push_back(
+          *reinterpret_cast<const int64_t *>(row->AccessWithNullCheck(i)));
+    }
+    return result;
+  };
+  EXPECT_EQ(read(slots[0], 2), (std::vector<int64_t>{100, 200}));
+  EXPECT_EQ(read(inserted, 2), (std::vector<int64_t>{-1, -1}));
+}
+
+// Threads withdraw from one of two accounts only if the total stays
+// non-negative, with timestamps from a TimestampManager. Under SSI the
+// invariant holds at the end however the withdrawals interleave.
+TEST_F(SsiManagerTests, ConcurrentWithdrawals) {
+  const uint32_t num_threads = 4;
+  const uint32_t num_txns = 300;
+  storage::DataTable table(block_store_, layout_);
+  std::vector<int64_t> balances{500, 500};
+  std::vector<storage::TupleSlot> slots;
+  storage::BulkLoader::BulkLoad(
+      &table, {{1, reinterpret_cast<const byte *>(balances.data())}}, 2,
+      &slots);
+  storage::SsiManager tested;
+  storage::TimestampManager timestamps(num_threads * 2);
+  std::atomic<uint64_t> next_txn_id{0};
+  std::atomic<uint32_t> num_committed{0};
+
+  testutil::RunThreadUntilFinish(num_threads, [&](uint32_t id) {
+    std::default_random_engine generator(id);
+    std::vector<byte> buffer(initializer_.ProjectedRowSize());
+    auto *row = initializer_.InitializeRow(buffer.data());
+    auto *value = reinterpret_cast<int64_t *>(row->AccessForceNotNull(0));
+    for (uint32_t i = 0; i < num_txns; i++) {
+      timestamps.Advance();
+      storage::TimestampManager::Transaction txn(&timestamps);
+      storage::SsiManager::Transaction ssi(txn.ReadTimestamp());
+      int64_t total = 0;
+      for (const auto &slot : slots) {
+        ssi.Select(&table, slot, row);
+        total += *value;
+      }
+      if (total < 10) {
+        continue;
+      }
+      // 让别的线程插进来，制造并发
+      std::this_thread::yield();
+      const storage::TupleSlot &slot = slots[generator() % 2];
+      ssi.Select(&table, slot, row);
+      *value -= 10;
+      storage::DeltaRecord *undo = undos_.NewUndo(
+          testutil::Uncommitted(next_txn_id++), initializer_);
+      if (!ssi.Update(&table, slot, *row, undo)) {
+        continue;
+      }
+      timestamp_t commit_timestamp = txn.BeginCommit();
+      if (tested.Commit(&ssi, commit_timestamp)) {
+        ssi.CommitWrites(commit_timestamp);
+        num_committed++;
+      } else {
+        ssi.Rollback();
+      }
+      txn.EndCommit();
+      if (i % 16 == 0) {
+        tested.Prune(timestamps.OldestActiveTimestamp());
+      }
+    }
+  });
+
+  timestamps.Advance();
+  timestamps.Advance();
+  storage::SsiManager::Transaction check(timestamps.ReadTimestamp(), false);
+  std::vector<byte> buffer(initializer_.ProjectedRowSize());
+  auto *row = initializer_.InitializeRow(buffer.data());
+  int64_t total = 0;
+  for (const auto &slot : slots) {
+    check.Select(&table, slot, row);
+    total += *reinterpret_cast<const int64_t *>(row->AccessWithNullCheck(0));
+  }
+  EXPECT_GE(total, 0);
+  EXPECT_EQ(total, 1000 - 10 * int64_t(num_committed.load()));
+}
+} // namespace noisepage
@@ -0,0 +1,175 @@
+#include "common/test_util.h"
+#include "storage/bulk_loader.h"
+#include "storage/data_table.h"
+#include "storage/timestamp_manager.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace noisepage {
+class TimestampManagerTests : public ::testing::Test {};
+
+// A commit comes after its own snapshot, stays out of new snapshots until it
+// ends and the epoch moves, and then is in every later one.
+TEST_F(TimestampManagerTests, SimpleTest) {
+  storage::TimestampManager tested(4);
+  timestamp_t commit_timestamp;
+  {
+    storage::TimestampManager::Transaction txn(&tested);
+    commit_timestamp = txn.BeginCommit();
+    EXPECT_GT(commit_timestamp, txn.ReadTimestamp());
+    EXPECT_GE(static_cast<int64_t>(commit_timestamp), 0);
+    for (uint32_t i = 0; i < 5; i++) {
+      EXPECT_TRUE(tested.Advance());
+      EXPECT_LT(tested.ReadTimestamp(), commit_timestamp);
+    }
+    EXPECT_EQ(tested.OldestActiveTimestamp(), txn.ReadTimestamp());
+    txn.EndCommit();
+  }
+  tested.AwaitVisible(commit_timestamp);
+  storage::TimestampManager::Transaction later(&tested);
+  EXPECT_GE(later.ReadTimestamp(), commit_timestamp);
+
+  // 同一个epoch里的提交各不相同，且都在后来的snapshot里
+  storage::TimestampManager::Transaction first(&tested);
+  timestamp_t a = first.BeginCommit();
+  first.EndCommit();
+  storage::TimestampManager::Transaction second(&tested);
+  timestamp_t b = second.BeginCommit();
+  second.EndCommit();
+  EXPECT_NE(a, b);
+  tested.Advance();
+  EXPECT_GE(tested.ReadTimestamp(), std::max(a, b));
+}
+
+// A slot that uses up its sequence numbers in an epoch moves on to the next
+// epoch instead of handing out a timestamp twice.
+TEST_F(TimestampManagerTests, CommitsPastSequenceSpace) {
+  const uint32_t max_active = 4096;
+  storage::TimestampManager tested(max_active);
+  const uint64_t per_epoch =
+      (uint64_t{1} << storage::TimestampManager::SEQUENCE_BITS) / max_active;
+  uint64_t first_epoch = tested.CurrentEpoch();
+  timestamp_t previous = 0;
+  for (uint64_t i = 0; i < 3 * per_epoch; i++) {
+    storage::TimestampManager::Transaction txn(&tested);
+    timestamp_t timestamp = txn.BeginCommit();
+    // 同一个slot上的提交时间戳严格递增，所以不会重复
+    ASSERT_GT(timestamp, previous);
+    ASSERT_GT(timestamp, txn.ReadTimestamp());
+    previous = timestamp;
+    txn.EndCommit();
+  }
+  EXPECT_GE(tested.CurrentEpoch(), first_epoch + 2);
+  tested.AwaitVisible(previous);
+  storage::TimestampManager::Transaction later(&tested);
+  EXPECT_GE(later.ReadTimestamp(), previous);
+}
+
+// While committers, an advancer and readers all run, a snapshot never
+// includes a commit that has not ended, and never drops below a live
+// transaction's registered read timestamp in OldestActiveTimestamp.
+TEST_F(TimestampManagerTests, ConcurrentCorrectnessTest) {
+  const uint32_t num_committers = 4;
+  const uint32_t num_commits = 5000;
+  storage::TimestampManager tested(16);
+  struct Entry {
+    std::atomic<timestamp_t> timestamp_{UINT64_MAX};
+    std::atomic<bool> ended_{false};
+  };
+  std::vector<Entry> entries(num_committers * num_commits);
+  std::atomic<uint32_t> num_done{0};
+
+  testutil::RunThreadUntilFinish(num_committers + 2, [&](uint32_t id) {
+    if (id < num_committers) {
+      for (uint32_t i = 0; i < num_commits; i++) {
+        Entry &entry = entries[id * num_commits + i];
+        storage::TimestampManager::Transaction txn(&tested);
+        timestamp_t timestamp = txn.BeginCommit();
+        EXPECT_GT(timestamp, txn.ReadTimestamp());
+        entry.timestamp_.store(timestamp);
+        std::this_thread::yield();
+        entry.ended_.store(true);
+        txn.EndCommit();
+      }
+      num_done++;
+    } else if (id == num_committers) {
+      while (num_done.load() < num_committers) {
+        tested.Advance();
+        std::this_thread::yield();
+      }
+    } else {
+      while (num_done.load() < num_committers) {
+        storage::TimestampManager::Transaction txn(&tested);
+        timestamp_t snapshot = txn.ReadTimestamp();
+        EXPECT_LE(tested.OldestActiveTimestamp(), snapshot);
+        for (auto &entry : entries) {
+          if (entry.timestamp_.load() <= snapshot) {
+            EXPECT_TRUE(entry.ended_.load());
+          }
+        }
+      }
+    }
+  });
+}
+
+// One writer moves amounts between two tuples, installing both updates
+// between BeginCommit and EndCommit, while readers select at their read
+// timestamps: every snapshot sees the total unchanged.
+TEST_F(TimestampManagerTests, SnapshotsOfDataTable) {
+  storage::BlockStore block_store{10};
+  storage::BlockLayout layout(2, {8, 8}, storage::MIN_BLOCK_SIZE);
+  storage::DataTable table(block_store, layout);
+  storage::TimestampManager tested(8);
+  std::vector<uint16_t> col_ids{1};
+  storage::ProjectedRowInitializer initializer(layout, col_ids);
+  std::vector<int64_t> balances{1000, 1000};
+  std::vector<storage::TupleSlot> slots;
+  storage::BulkLoader::BulkLoad(
+      &table, {{1, reinterpret_cast<const byte *>(balances.data())}}, 2,
+      &slots);
+
+  const uint32_t num_transfers = 5000;
+  std::vector<std::unique_ptr<byte[]>> undo_buffers;
+  std::atomic<bool> done{false};
+  testutil::RunThreadUntilFinish(4, [&](uint32_t id) {
+    std::vector<byte> buffer(initializer.ProjectedRowSize());
+    auto *row = initializer.InitializeRow(buffer.data());
+    auto *value = reinterpret_cast<int64_t *>(row->AccessForceNotNull(0));
+    if (id == 0) {
+      for (uint32_t i = 0; i < num_transfers; i++) {
+        storage::TimestampManager::Transaction txn(&tested);
+        timestamp_t timestamp = txn.BeginCommit();
+        int64_t amount = i % 2 == 0 ? 7 : -5;
+        for (uint32_t k = 0; k < 2; k++) {
+          balances[k] += k == 0 ? -amount : amount;
+          *value = balances[k];
+          undo_buffers.emplace_back(
+              new byte[storage::DeltaRecord::Size(initializer)]);
+          auto *undo = storage::DeltaRecord::InitializeDeltaRecord(
+              undo_buffers.back().get(), timestamp, initializer);
+          EXPECT_TRUE(table.Update(slots[k], *row, undo));
+        }
+        txn.EndCommit();
+      }
+      done.store(true);
+    } else if (id == 1) {
+      while (!done.load()) {
+        tested.Advance();
+        std::this_thread::yield();
+      }
+    } else {
+      while (!done.load()) {
+        storage::TimestampManager::Transaction txn(&tested);
+        int64_t total = 0;
+        for (uint32_t k = 0; k < 2; k++) {
+          table.Select(txn.ReadTimestamp(), slots[k], row);
+          total += *value;
+        }
+        EXPECT_EQ(total, 2000);
+      }
+    }
+  });
+}
+} // namespace noisepage
@@ -6,12 +6,20 @@
 
 namespace noisepage {
 struct TupleAccessStrategyTests : public ::testing::Test {
+  storage::BlockStore block_store_{1};
   storage::RawBlock *raw_block_ = nullptr;
+  uint32_t block_id_ = 0;
 
 protected:
-  void SetUp() override { raw_block_ = new storage::RawBlock(); }
+  void SetUp() override {
+    raw_block_ = block_store_.Get(storage::BLOCK_SIZE);
+    block_id_ = storage::BlockDirectory::Get().Register(raw_block_);
+  }
 
-  void TearDown() override { delete raw_block_; }
+  void TearDown() override {
+    storage::BlockDirectory::Get().Unregister(block_id_);
+    block_store_.Release(raw_block_, storage::BLOCK_SIZE);
+  }
 };
 
 TEST_F(TupleAccessStrategyTests, NullTest) {
@@ -21,8 +29,8 @@ TEST_F(TupleAccessStrategyTests, NullTest) {
   for (auto i = 0; i < repeat; i++) {
     storage::BlockLayout layout = testutil::RandomLayout(generator);
     storage::TupleAccessStrategy tested(layout);
-    memset(raw_block_, 0, sizeof(storage::RawBlock));
-    storage::InitializeRawBlock(raw_block_, layout, 0);
+    memset(reinterpret_cast<byte *>(raw_block_), 0, storage::BLOCK_SIZE);
+    storage::InitializeRawBlock(raw_block_, layout, block_id_);
 
     storage::TupleSlot slot;
     EXPECT_TRUE(tested.Allocate(raw_block_, slot));
@@ -59,8 +67,8 @@ TEST_F(TupleAccessStrategyTests, SimpleInsertTest) {
   for (uint32_t i = 0; i < repeat; i++) {
     storage::BlockLayout layout = testutil::RandomLayout(generator, max_col);
     storage::TupleAccessStrategy tested(layout);
-    memset(raw_block_, 0, sizeof(storage::RawBlock));
-    storage::InitializeRawBlock(raw_block_, layout, 0);
+    memset(reinterpret_cast<byte *>(raw_block_), 0, storage::BLOCK_SIZE);
+    storage::InitializeRawBlock(raw_block_, layout, block_id_);
 
     std::unordered_map<uint32_t, testutil::FakeRawTuple> tuples;
 
@@ -74,12 +82,11 @@ TEST_F(TupleAccessStrategyTests, SimpleInsertTest) {
     for (const auto &tuple : tuples) {
       auto offset = tuple.first;
       for (uint16_t col_id = 0; col_id < layout.num_cols_; col_id++) {
-        auto val1 = tuple.second.Attribute(col_id);
         storage::TupleSlot slot(raw_block_, offset);
         byte *pos = tested.AccessWithNullCheck(slot, col_id);
-        auto val2 =
-            storage::StorageUtil::ReadBytes(layout.attr_sizes_[col_id], pos);
-        EXPECT_EQ(val1, val2);
+        EXPECT_EQ(memcmp(tuple.second.Attribute(col_id), pos,
+                         layout.attr_sizes_[col_id]),
+                  0);
       }
     }
   }
@@ -94,8 +101,8 @@ TEST_F(TupleAccessStrategyTests, ConcureentInsertTest) {
   for (uint32_t i = 0; i < repeat; i++) {
     storage::BlockLayout layout = testutil::RandomLayout(generator, max_col);
     storage::TupleAccessStrategy tested(layout);
-    memset(raw_block_, 0, sizeof(storage::RawBlock));
-    storage::InitializeRawBlock(raw_block_, layout, 0);
+    memset(reinterpret_cast<byte *>(raw_block_), 0, storage::BLOCK_SIZE);
+    storage::InitializeRawBlock(raw_block_, layout, block_id_);
 
     std::vector<std::unordered_map<uint32_t, testutil::FakeRawTuple>> tuples(
         num_thread);
@@ -114,16 +121,104 @@ TEST_F(TupleAccessStrategyTests, ConcureentInsertTest) {
     for (auto &thread_tuple : tuples) {
       for (auto &tuple : thread_tuple) {
         for (uint16_t col_id = 0; col_id < layout.num_cols_; col_id++) {
-          auto val1 = tuple.second.Attribute(col_id);
           storage::TupleSlot slot(raw_block_, tuple.first);
           auto *pos = tested.AccessWithNullCheck(slot, col_id);
-          auto val2 =
-              storage::StorageUtil::ReadBytes(layout.attr_sizes_[col_id], pos);
-          EXPECT_EQ(val1, val2);
+          EXPECT_EQ(memcmp(tuple.second.Attribute(col_id), pos,
+                           layout.attr_sizes_[col_id]),
+                    0);
         }
       }
     }
   }
 }
 
+// Bitmaps and value arrays start on their own cache lines, never overlap, and
+// the layout holds exactly as many slots as fit in the block.
+TEST_F(TupleAccessStrategyTests, CachelineAlignedLayout) {
+  std::default_random_engine generator;
+  const uint32_t repeat = 50;
+  for (uint32_t i = 0; i < repeat; i++) {
+    storage::BlockLayout layout = testutil::RandomLayout(generator, 100);
+    ASSERT_EQ(layout.alignment_, storage::CACHELINE_SIZE);
+    storage::InitializeRawBlock(raw_block_, layout, block_id_);
+    auto *block = reinterpret_cast<storage::Block *>(raw_block_);
+
+    auto padded = [&](uint64_t size) {
+      return (size + storage::CACHELINE_SIZE - 1) / storage::CACHELINE_SIZE *
+             storage::CACHELINE_SIZE;
+    };
+    auto block_bytes = [&](uint32_t num_slots) {
+      uint64_t size = padded(layout.header_size_);
+      for (auto attr_size : layout.attr_sizes_) {
+        size += padded(BitmapSize(num_slots)) +
+                padded(static_cast<uint64_t>(num_slots) * attr_size);
+      }
+      return size;
+    };
+    EXPECT_LE(block_bytes(layout.num_slots_), layout.block_size_);
+    EXPECT_GT(block_bytes(layout.num_slots_ + 1), layout.block_size_);
+
+    std::vector<std::pair<uintptr_t, uintptr_t>> extents;
+    auto base = reinterpret_cast<uintptr_t>(raw_block_);
+    for (uint16_t col_id = 0; col_id < layout.num_cols_; col_id++) {
+      auto bitmap = reinterpret_cast<uintptr_t>(block->Column(col_id));
+      auto values = reinterpret_cast<uintptr_t>(
+          block->Column(col_id)->ColumnStart(layout));
+      EXPECT_EQ(bitmap % storage::CACHELINE_SIZE, 0);
+      EXPECT_EQ(values % storage::CACHELINE_SIZE, 0);
+      EXPECT_GE(values, bitmap + BitmapSize(layout.num_slots_));
+      uint64_t values_size = static_cast<uint64_t>(layout.num_slots_) *
+                             layout.attr_sizes_[col_id];
+      extents.emplace_back(bitmap, values + values_size);
+    }
+    std::sort(extents.begin(), extents.end());
+    EXPECT_GE(extents.front().first, base + layout.header_size_);
+    EXPECT_LE(extents.back().second, base + layout.block_size_);
+    for (uint32_t j = 1; j < extents.size(); j++) {
+      EXPECT_LE(extents[j - 1].second, extents[j].first);
+    }
+  }
+}
+
+// Columns can be laid out in a different order than they are declared in,
+// without changing what is stored under each column id.
+TEST_F(TupleAccessStrategyTests, ColumnPlacement) {
+  std::vector<uint16_t> attr_sizes{8, 1, 16, 4, 8};
+  EXPECT_EQ(storage::BlockLayout::OrderColumns(attr_sizes),
+            (std::vector<uint16_t>{0, 2, 4, 3, 1}));
+  EXPECT_EQ(storage::BlockLayout::OrderColumns(attr_sizes, {0, 5, 1, 0, 5}),
+            (std::vector<uint16_t>{0, 4, 1, 2, 3}));
+
+  std::default_random_engine generator;
+  auto placement = storage::BlockLayout::OrderColumns(attr_sizes);
+  storage::BlockLayout layout(5, attr_sizes, storage::BLOCK_SIZE, placement);
+  for (uint32_t j = 1; j < placement.size(); j++) {
+    EXPECT_LT(layout.column_offsets_[placement[j - 1]],
+              layout.column_offsets_[placement[j]]);
+  }
+
+  storage::TupleAccessStrategy tested(layout);
+  storage::InitializeRawBlock(raw_block_, layout, block_id_);
+  std::unordered_map<uint32_t, testutil::FakeRawTuple> tuples;
+  for (uint32_t j = 0; j < 100; j++) {
+    testutil::TryInsertFakeTuple(layout, tested, raw_block_, tuples,
+                                 generator);
+  }
+  for (const auto &tuple : tuples) {
+    storage::TupleSlot slot(raw_block_, tuple.first);
+    for (uint16_t col_id = 0; col_id < layout.num_cols_; col_id++) {
+      EXPECT_EQ(memcmp(tuple.second.Attribute(col_id),
+                       tested.AccessWithNullCheck(slot, col_id),
+                       layout.attr_sizes_[col_id]),
+                0);
+    }
+  }
+
+  // 复用block时之前的bitmap会被清掉
+  storage::InitializeRawBlock(raw_block_, layout, block_id_);
+  storage::TupleSlot slot;
+  EXPECT_TRUE(tested.Allocate(raw_block_, slot));
+  EXPECT_EQ(slot.GetOffset(), 0);
+}
+
 } // namespace noisepage
@@ -0,0 +1,243 @@
+#include "storage/data_table.h"
+#include "storage/storage_test_util.h"
+#include "gtest/gtest.h"
+#include <random>
+
+namespace noisepage {
+struct ZoneMapTests : public ::testing::Test {
+  storage::BlockStore block_store_{10};
+  // version ptr, 8-byte key, 4-byte payload, and padding to make rows wide
+  // enough that a few thousand inserts span several blocks
+  storage::BlockLayout layout_{8, {8, 8, 4, 8, 8, 8, 8, 8}};
+  std::vector<uint16_t> col_ids_{
+      testutil::ProjectionListAllColumns(layout_)};
+  uint32_t redo_size_ = storage::ProjectedRow::Size(layout_, col_ids_);
+  std::vector<byte *> loose_pointers_;
+  testutil::UndoBuffers undos_;
+
+  void TearDown() override {
+    for (auto *ptr : loose_pointers_) {
+      delete[] ptr;
+    }
+  }
+
+  storage::ProjectedRow *NewRow(int64_t key, int32_t payload) {
+    byte *buffer = new byte[redo_size_];
+    loose_pointers_.push_back(buffer);
+    memset(buffer, 0, redo_size_);
+    auto *row = storage::ProjectedRow::InitializeProjectedRow(buffer, layout_,
+                                                              col_ids_);
+    storage::StorageUtil::WriteBytes(8, static_cast<uint64_t>(key),
+                                     row->AccessForceNotNull(0));
+    storage::StorageUtil::WriteBytes(4, static_cast<uint32_t>(payload),
+                                     row->AccessForceNotNull(1));
+    return row;
+  }
+
+  storage::DeltaRecord *NewUndo(timestamp_t timestamp) {
+    return undos_.NewUndo(timestamp, layout_, col_ids_);
+  }
+
+  storage::TupleSlot Insert(storage::DataTable *table, int64_t key,
+                            int32_t payload) {
+    return table->Insert(*NewRow(key, payload), NewUndo(0));
+  }
+
+  std::vector<int64_t>
+  ScanKeys(storage::DataTable *table, timestamp_t timestamp,
+           const std::vector<storage::ColumnPredicate> &predicates,
+           uint32_t *blocks_read) {
+    std::vector<byte> buffer(redo_size_);
+    auto *row = storage::ProjectedRow::InitializeProjectedRow(
+        buffer.data(), layout_, col_ids_);
+    std::vector<int64_t> keys;
+    *blocks_read = table->Scan(
+        timestamp, predicates, row,
+        [&](const storage::TupleSlot &, const storage::ProjectedRow &result) {
+          keys.push_back(storage::StorageUtil::ReadInteger(
+              8, result.AccessWithNullCheck(0)));
+        });
+    std::sort(keys.begin(), keys.end());
+    return keys;
+  }
+};
+
+TEST_F(ZoneMapTests, WidenOnly) {
+  storage::ZoneMap zone_map;
+  zone_map.Reset();
+  EXPECT_TRUE(zone_map.Empty());
+
+  std::default_random_engine generator;
+  std::uniform_int_distribution<int64_t> dist(-1000, 1000);
+  int64_t min = INT64_MAX, max = INT64_MIN;
+  for (uint32_t i = 0; i < 100; i++) {
+    int64_t val = dist(generator);
+    zone_map.Widen(val);
+    min = std::min(min, val);
+    max = std::max(max, val);
+    EXPECT_EQ(zone_map.min_.load(), min);
+    EXPECT_EQ(zone_map.max_.load(), max);
+  }
+  EXPECT_FALSE(zone_map.Empty());
+  EXPECT_TRUE(zone_map.MayContain(min, min));
+  EXPECT_FALSE(zone_map.MayContain(max + 1, INT64_MAX));
+  EXPECT_FALSE(zone_map.MayContain(INT64_MIN, min - 1));
+}
+
+TEST_F(ZoneMapTests, ConcurrentWiden) {
+  const uint32_t num_threads = 8;
+  const int64_t num_values = 10000;
+  storage::ZoneMap zone_map;
+  zone_map.Reset();
+  auto workload = [&](uint32_t id) {
+    for (int64_t i = 0; i < num_values; i++) {
+      zone_map.Widen(id % 2 == 0 ? i : -i);
+    }
+  };
+  testutil::RunThreadUntilFinish(num_threads, workload);
+  EXPECT_EQ(zone_map.min_.load(), -(num_values - 1));
+  EXPECT_EQ(zone_map.max_.load(), num_values - 1);
+}
+
+TEST_F(ZoneMapTests, PredicateBounds) {
+  int64_t lo, hi;
+  EXPECT_FALSE(storage::ColumnPredicate(1, storage::PredicateType::LESS,
+                                        INT64_MIN)
+                   .Bounds(&lo, &hi));
+  EXPECT_TRUE(
+      storage::ColumnPredicate(1, storage::PredicateType::GREATER, 5)
+          .Bounds(&lo, &hi));
+  EXPECT_EQ(lo, 6);
+  EXPECT_EQ(hi, INT64_MAX);
+  EXPECT_TRUE(storage::ColumnPredicate(1, {7, -3, 4}).Bounds(&lo, &hi));
+  EXPECT_EQ(lo, -3);
+  EXPECT_EQ(hi, 7);
+  EXPECT_FALSE(storage::ColumnPredicate(1, {7, -3, 4}).Evaluate(0));
+  EXPECT_TRUE(storage::ColumnPredicate(1, {7, -3, 4}).Evaluate(4));
+  EXPECT_FALSE(storage::ColumnPredicate(1, storage::PredicateType::BETWEEN, 3,
+                                        2)
+                   .Bounds(&lo, &hi));
+}
+
+// Bounds must not step past the ends of the int64_t range.
+TEST_F(ZoneMapTests, PredicateBoundsEdgeValues) {
+  int64_t lo, hi;
+  EXPECT_FALSE(storage::ColumnPredicate(1, storage::PredicateType::GREATER,
+                                        INT64_MAX)
+                   .Bounds(&lo, &hi));
+  EXPECT_FALSE(
+      storage::ColumnPredicate(1, storage::PredicateType::LESS, INT64_MIN)
+          .Evaluate(INT64_MIN));
+  EXPECT_FALSE(
+      storage::ColumnPredicate(1, storage::PredicateType::GREATER, INT64_MAX)
+          .Evaluate(INT64_MAX));
+
+  EXPECT_TRUE(storage::ColumnPredicate(1, storage::PredicateType::LESS,
+                                       INT64_MIN + 1)
+                  .Bounds(&lo, &hi));
+  EXPECT_EQ(lo, INT64_MIN);
+  EXPECT_EQ(hi, INT64_MIN);
+  EXPECT_TRUE(storage::ColumnPredicate(1, storage::PredicateType::GREATER,
+                                       INT64_MAX - 1)
+                  .Bounds(&lo, &hi));
+  EXPECT_EQ(lo, INT64_MAX);
+  EXPECT_EQ(hi, INT64_MAX);
+  EXPECT_TRUE(storage::ColumnPredicate(1, storage::PredicateType::LESS_EQUAL,
+                                       INT64_MIN)
+                  .Evaluate(INT64_MIN));
+  EXPECT_TRUE(
+      storage::ColumnPredicate(1, storage::PredicateType::GREATER_EQUAL,
+                               INT64_MAX)
+          .Evaluate(INT64_MAX));
+
+  storage::ZoneMap zone_map;
+  zone_map.Reset();
+  zone_map.Widen(INT64_MIN);
+  zone_map.Widen(INT64_MAX);
+  ASSERT_TRUE(storage::ColumnPredicate(1, storage::PredicateType::GREATER,
+                                       INT64_MAX - 1)
+                  .Bounds(&lo, &hi));
+  EXPECT_TRUE(zone_map.MayContain(lo, hi));
+}
+
+// Sequential keys on an append-only table: a narrow range scan should only
+// read the block(s) that the range falls into, and return the same tuples as
+// a full scan filtered by hand.
+TEST_F(ZoneMapTests, RangeScanSkipsBlocks) {
+  storage::DataTable table(block_store_, layout_);
+  const int64_t num_inserts = 5 * layout_.num_slots_;
+  for (int64_t key = 0; key < num_inserts; key++) {
+    Insert(&table, key, static_cast<int32_t>(key % 7));
+  }
+
+  uint32_t all_blocks;
+  auto all_keys = ScanKeys(&table, 1, {}, &all_blocks);
+  EXPECT_EQ(all_keys.size(), num_inserts);
+  EXPECT_GE(all_blocks, 5);
+
+  const int64_t lo = 2 * layout_.num_slots_ + 10, hi = lo + 100;
+  uint32_t blocks_read;
+  auto keys = ScanKeys(
+      &table, 1,
+      {{1, storage::PredicateType::BETWEEN, lo, hi},
+       {2, storage::PredicateType::LESS, 3}},
+      &blocks_read);
+  EXPECT_EQ(blocks_read, 1);
+  std::vector<int64_t> expected;
+  for (int64_t key = lo; key <= hi; key++) {
+    if (key % 7 < 3) {
+      expected.push_back(key);
+    }
+  }
+  EXPECT_EQ(keys, expected);
+
+  // no block holds either value even though the range spans all of them
+  keys = ScanKeys(&table, 1, {{1, std::vector<int64_t>{-5, num_inserts}}},
+                  &blocks_read);
+  EXPECT_EQ(blocks_read, 0);
+  EXPECT_TRUE(keys.empty());
+}
+
+// Updates widen the zone map of a hot block, even after the value is
+// overwritten again, until the block is frozen.
+TEST_F(ZoneMapTests, FreezeRecomputesExactly) {
+  storage::DataTable table(block_store_, layout_);
+  std::vector<storage::TupleSlot> slots;
+  for (int64_t key = 0; key < layout_.num_slots_ + 1; key++) {
+    slots.push_back(Insert(&table, key, 0));
+  }
+  storage::RawBlock *block = slots[0].GetBlock();
+  ASSERT_NE(block, slots.back().GetBlock());
+
+  const int64_t outlier = 1000000000;
+  EXPECT_TRUE(table.Update(slots[5], *NewRow(outlier, 0), NewUndo(1)));
+  EXPECT_TRUE(table.Update(slots[5], *NewRow(5, 0), NewUndo(2)));
+
+  storage::ColumnPredicate find_outlier(1, storage::PredicateType::EQUAL,
+                                        outlier);
+  EXPECT_TRUE(table.BlockMayMatch(block, {find_outlier}));
+
+  // the old version is still visible at timestamp 1
+  uint32_t blocks_read;
+  auto keys = ScanKeys(&table, 1, {find_outlier}, &blocks_read);
+  EXPECT_EQ(keys, std::vector<int64_t>{outlier});
+
+  // a reader at timestamp 1 may still need the chain
+  EXPECT_FALSE(table.FreezeBlock(block, 1));
+  EXPECT_FALSE(table.FreezeBlock(slots.back().GetBlock(), 2));
+  EXPECT_TRUE(table.FreezeBlock(block, 2));
+  EXPECT_FALSE(table.BlockMayMatch(block, {find_outlier}));
+
+  auto *zone_maps = reinterpret_cast<storage::Block *>(block)->zone_maps_;
+  EXPECT_EQ(zone_maps[1].min_.load(), 0);
+  EXPECT_EQ(zone_maps[1].max_.load(), layout_.num_slots_ - 1);
+  EXPECT_EQ(zone_maps[1].null_count_.load(), 0);
+  EXPECT_EQ(zone_maps[3].null_count_.load(), layout_.num_slots_);
+
+  // writing to a frozen block makes it hot again
+  EXPECT_TRUE(table.Update(slots[5], *NewRow(outlier, 0), NewUndo(3)));
+  EXPECT_EQ(reinterpret_cast<storage::Block *>(block)->state_.load(),
+            storage::BlockState::HOT);
+  EXPECT_TRUE(table.BlockMayMatch(block, {find_outlier}));
+}
+} // namespace noisepage